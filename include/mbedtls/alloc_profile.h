@@ -0,0 +1,157 @@
+/**
+ * \file alloc_profile.h
+ *
+ * \brief Accounting of the memory used by the SSL and X.509 modules
+ */
+/*
+ *  Copyright (C) 2006-2019, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *  This file is part of mbed TLS (https://tls.mbed.org)
+ */
+#ifndef MBEDTLS_ALLOC_PROFILE_H
+#define MBEDTLS_ALLOC_PROFILE_H
+
+#if !defined(MBEDTLS_CONFIG_FILE)
+#include "mbedtls/config.h"
+#else
+#include MBEDTLS_CONFIG_FILE
+#endif
+
+#include <stddef.h>
+
+/*
+ * Allocation categories
+ */
+#define MBEDTLS_ALLOC_PROFILE_IO            0   /**< Record input/output and compression buffers. */
+#define MBEDTLS_ALLOC_PROFILE_HANDSHAKE     1   /**< Handshake parameters. */
+#define MBEDTLS_ALLOC_PROFILE_SESSION       2   /**< Sessions and transforms. */
+#define MBEDTLS_ALLOC_PROFILE_FLIGHT        3   /**< DTLS flights and reassembly buffers. */
+#define MBEDTLS_ALLOC_PROFILE_X509          4   /**< Parsed certificates, CRLs and CSRs. */
+#define MBEDTLS_ALLOC_PROFILE_CACHE         5   /**< Session cache entries. */
+#define MBEDTLS_ALLOC_PROFILE_CATEGORIES    6   /**< Number of categories. */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * \brief          Memory usage counters for one allocation category.
+ */
+typedef struct mbedtls_alloc_profile_stats
+{
+    size_t current;     /*!< bytes currently allocated          */
+    size_t peak;        /*!< highest value reached by current   */
+    size_t allocs;      /*!< number of successful allocations   */
+}
+mbedtls_alloc_profile_stats;
+
+#if defined(MBEDTLS_ALLOC_PROFILE)
+
+/**
+ * \brief          Initialize the global counters and start counting.
+ *
+ * \note           Allocations are always recorded in the per-context
+ *                 counters; the global counters are only updated between
+ *                 calls to this function and mbedtls_alloc_profile_free().
+ *                 When MBEDTLS_THREADING_C is enabled, this function must
+ *                 be called before any other thread allocates, and the
+ *                 state of the global counters is then protected by a
+ *                 mutex.
+ */
+void mbedtls_alloc_profile_init( void );
+
+/**
+ * \brief          Stop updating the global counters and release the
+ *                 resources of the module.
+ *
+ * \note           When MBEDTLS_THREADING_C is enabled, this function must
+ *                 be called once the other threads have stopped allocating.
+ */
+void mbedtls_alloc_profile_free( void );
+
+/**
+ * \brief          Get the global counters for a category.
+ *
+ * \param category One of the MBEDTLS_ALLOC_PROFILE_XXX categories.
+ * \param stats    Structure receiving the counters.
+ *
+ * \return         0 if successful, or -1 if the category is invalid.
+ */
+int mbedtls_alloc_profile_get( int category,
+                               mbedtls_alloc_profile_stats *stats );
+
+/**
+ * \brief          Reset the peak of the global counters of every category
+ *                 to their current value.
+ */
+void mbedtls_alloc_profile_reset_peak( void );
+
+/**
+ * \brief          Return a printable name for a category.
+ *
+ * \param category One of the MBEDTLS_ALLOC_PROFILE_XXX categories.
+ *
+ * \return         A static string, or "unknown".
+ */
+const char *mbedtls_alloc_profile_category_name( int category );
+
+/**
+ * \brief          Allocate \p len zeroed bytes with mbedtls_calloc() and
+ *                 account them to \p category.
+ *
+ * \param stats    Per-context counters for \p category, or NULL.
+ * \param category Category of the allocation.
+ * \param len      Number of bytes to allocate.
+ *
+ * \return         The allocated buffer, or NULL on failure.
+ */
+void *mbedtls_alloc_profile_calloc( mbedtls_alloc_profile_stats *stats,
+                                    int category, size_t len );
+
+/**
+ * \brief          Release a buffer obtained from
+ *                 mbedtls_alloc_profile_calloc().
+ *
+ * \param stats    The per-context counters given at allocation, or NULL.
+ * \param category The category given at allocation.
+ * \param p        The buffer, or NULL.
+ * \param len      The length given at allocation.
+ *
+ * \note           No header is prepended to the buffers, so the caller is
+ *                 responsible for passing the same length as at allocation.
+ */
+void mbedtls_alloc_profile_release( mbedtls_alloc_profile_stats *stats,
+                                    int category, void *p, size_t len );
+
+#define MBEDTLS_ALLOC_PROFILE_CALLOC( stats, cat, len )         \
+    mbedtls_alloc_profile_calloc( (stats), (cat), (len) )
+#define MBEDTLS_ALLOC_PROFILE_FREE( stats, cat, p, len )        \
+    mbedtls_alloc_profile_release( (stats), (cat), (p), (len) )
+
+#else /* MBEDTLS_ALLOC_PROFILE */
+
+#define MBEDTLS_ALLOC_PROFILE_CALLOC( stats, cat, len )         \
+    mbedtls_calloc( 1, (len) )
+#define MBEDTLS_ALLOC_PROFILE_FREE( stats, cat, p, len )        \
+    mbedtls_free( (p) )
+
+#endif /* MBEDTLS_ALLOC_PROFILE */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* alloc_profile.h */
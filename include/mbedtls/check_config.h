@@ -79,6 +79,10 @@
 #error "MBEDTLS_CTR_DRBG_C defined, but not all prerequisites"
 #endif
 
+#if defined(MBEDTLS_DEBUG_BINARY_TRACE) && !defined(MBEDTLS_DEBUG_C)
+#error "MBEDTLS_DEBUG_BINARY_TRACE defined, but not all prerequisites"
+#endif
+
 #if defined(MBEDTLS_DHM_C) && !defined(MBEDTLS_BIGNUM_C)
 #error "MBEDTLS_DHM_C defined, but not all prerequisites"
 #endif
@@ -646,6 +650,12 @@
 #error "MBEDTLS_SSL_DTLS_ANTI_REPLAY  defined, but not all prerequisites"
 #endif
 
+#if defined(MBEDTLS_SSL_DTLS_REPLAY_WINDOW) &&                            \
+    ( MBEDTLS_SSL_DTLS_REPLAY_WINDOW < 64 ||                              \
+      MBEDTLS_SSL_DTLS_REPLAY_WINDOW % 64 != 0 )
+#error "MBEDTLS_SSL_DTLS_REPLAY_WINDOW must be a positive multiple of 64"
+#endif
+
 #if defined(MBEDTLS_SSL_DTLS_CONNECTION_ID) &&                              \
     ( !defined(MBEDTLS_SSL_TLS_C) || !defined(MBEDTLS_SSL_PROTO_DTLS) )
 #error "MBEDTLS_SSL_DTLS_CONNECTION_ID  defined, but not all prerequisites"
@@ -682,6 +692,37 @@
 #error "MBEDTLS_SSL_EXTENDED_MASTER_SECRET defined, but not all prerequsites"
 #endif
 
+#if defined(MBEDTLS_SSL_ASYNC_ENGINE_C) &&            \
+    ( !defined(MBEDTLS_SSL_ASYNC_PRIVATE) ||           \
+      !defined(MBEDTLS_SSL_SRV_C) ||                   \
+      !defined(MBEDTLS_X509_CRT_PARSE_C) ||            \
+      !defined(MBEDTLS_THREADING_C) ||                 \
+      !defined(MBEDTLS_THREADING_PTHREAD) )
+#error "MBEDTLS_SSL_ASYNC_ENGINE_C defined, but not all prerequisites"
+#endif
+
+#if defined(MBEDTLS_SSL_ASYNC_VERIFY) && !defined(MBEDTLS_X509_CRT_PARSE_C)
+#error "MBEDTLS_SSL_ASYNC_VERIFY defined, but not all prerequisites"
+#endif
+
+#if defined(MBEDTLS_SSL_SNI_REGISTRY_C) &&              \
+    !defined(MBEDTLS_SSL_SERVER_NAME_INDICATION)
+#error "MBEDTLS_SSL_SNI_REGISTRY_C defined, but not all prerequisites"
+#endif
+
+#if defined(MBEDTLS_SSL_CREDENTIALS_C) &&                \
+    ( !defined(MBEDTLS_SSL_TLS_C) ||                     \
+      !defined(MBEDTLS_X509_CRT_PARSE_C) ||              \
+      !defined(MBEDTLS_PK_PARSE_C) )
+#error "MBEDTLS_SSL_CREDENTIALS_C defined, but not all prerequisites"
+#endif
+
+#if defined(MBEDTLS_SSL_SNI_CACHE_C) &&                 \
+    ( !defined(MBEDTLS_SSL_SERVER_NAME_INDICATION) ||    \
+      !defined(MBEDTLS_PK_PARSE_C) )
+#error "MBEDTLS_SSL_SNI_CACHE_C defined, but not all prerequisites"
+#endif
+
 #if defined(MBEDTLS_SSL_TICKET_C) && !defined(MBEDTLS_CIPHER_C)
 #error "MBEDTLS_SSL_TICKET_C defined, but not all prerequisites"
 #endif
@@ -739,6 +780,20 @@
 #error "MBEDTLS_X509_CRT_PARSE_C defined, but not all prerequisites"
 #endif
 
+#if defined(MBEDTLS_X509_CRT_PARSE_PATH_PARALLEL) &&                     \
+    ( !defined(MBEDTLS_X509_CRT_PARSE_C) || !defined(MBEDTLS_FS_IO) ||    \
+      !defined(MBEDTLS_THREADING_PTHREAD) )
+#error "MBEDTLS_X509_CRT_PARSE_PATH_PARALLEL defined, but not all prerequisites"
+#endif
+
+#if defined(MBEDTLS_X509_CRT_SNAPSHOT) && !defined(MBEDTLS_X509_CRT_PARSE_C)
+#error "MBEDTLS_X509_CRT_SNAPSHOT defined, but not all prerequisites"
+#endif
+
+#if defined(MBEDTLS_X509_CRT_CONTIGUOUS) && !defined(MBEDTLS_X509_CRT_PARSE_C)
+#error "MBEDTLS_X509_CRT_CONTIGUOUS defined, but not all prerequisites"
+#endif
+
 #if defined(MBEDTLS_X509_CRL_PARSE_C) && ( !defined(MBEDTLS_X509_USE_C) )
 #error "MBEDTLS_X509_CRL_PARSE_C defined, but not all prerequisites"
 #endif
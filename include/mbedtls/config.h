@@ -1403,6 +1403,21 @@
  */
 //#define MBEDTLS_SSL_ASYNC_PRIVATE
 
+/**
+ * \def MBEDTLS_SSL_ASYNC_VERIFY
+ *
+ * Enable asynchronous verification of the peer certificate chain in SSL.
+ * This allows you to configure an SSL connection to hand the chain received
+ * from the peer to an external verifier, for example a thread pool or an
+ * OCSP-aware service, and to resume the handshake once the verifier reports
+ * its result. See mbedtls_ssl_conf_async_verify().
+ *
+ * Requires: MBEDTLS_X509_CRT_PARSE_C
+ *
+ * Uncomment to enable asynchronous certificate verification.
+ */
+//#define MBEDTLS_SSL_ASYNC_VERIFY
+
 /**
  * \def MBEDTLS_SSL_CONTEXT_SERIALIZATION
  *
@@ -1446,6 +1461,48 @@
  */
 //#define MBEDTLS_SSL_DEBUG_ALL
 
+/**
+ * \def MBEDTLS_DEBUG_BINARY_TRACE
+ *
+ * Enable binary recording of debug messages.
+ *
+ * When a ring buffer is provided with mbedtls_ssl_conf_dbg_trace(), debug
+ * messages are stored in it as raw arguments instead of being formatted,
+ * which makes high debug levels usable on loaded servers. The records are
+ * exported with mbedtls_debug_trace_export() and formatted offline with
+ * programs/util/trace_decode.
+ *
+ * Module:  library/debug.c
+ *
+ * Requires: MBEDTLS_DEBUG_C
+ *
+ * Uncomment this macro to enable binary debug tracing.
+ */
+//#define MBEDTLS_DEBUG_BINARY_TRACE
+
+/**
+ * \def MBEDTLS_ALLOC_PROFILE
+ *
+ * Enable accounting of the memory allocated by the SSL and X.509 modules.
+ *
+ * Allocations made for record buffers, handshake state, sessions and
+ * transforms, DTLS flights, certificates and the session cache are tagged
+ * with a category, and the current and peak number of bytes is tracked per
+ * category, globally and for each SSL context. See
+ * mbedtls_alloc_profile_get() and mbedtls_ssl_get_alloc_profile().
+ *
+ * Module:  library/alloc_profile.c
+ * Caller:  library/ssl_tls.c
+ *          library/ssl_cache.c
+ *          library/x509.c
+ *          library/x509_crt.c
+ *          library/x509_crl.c
+ *          library/x509_csr.c
+ *
+ * Uncomment this macro to enable allocation profiling.
+ */
+//#define MBEDTLS_ALLOC_PROFILE
+
 /** \def MBEDTLS_SSL_ENCRYPT_THEN_MAC
  *
  * Enable support for Encrypt-then-MAC, RFC 7366.
@@ -1897,6 +1954,72 @@
  */
 //#define MBEDTLS_X509_TRUSTED_CERTIFICATE_CALLBACK
 
+/**
+ * \def MBEDTLS_X509_CRT_PARSE_PATH_PARALLEL
+ *
+ * Enable mbedtls_x509_crt_parse_path_parallel(), which loads the files of a
+ * CA directory on several threads and skips duplicate certificates.
+ *
+ * Requires: MBEDTLS_X509_CRT_PARSE_C, MBEDTLS_FS_IO,
+ *           MBEDTLS_THREADING_PTHREAD
+ *
+ * Uncomment to enable the parallel directory loader.
+ */
+//#define MBEDTLS_X509_CRT_PARSE_PATH_PARALLEL
+
+/**
+ * \def MBEDTLS_X509_CRT_SNAPSHOT
+ *
+ * Enable trust store snapshots: mbedtls_x509_crt_write_snapshot() saves the
+ * DER encoding of a chain with an index, and
+ * mbedtls_x509_crt_parse_snapshot() reloads it, possibly from a
+ * memory-mapped file, without PEM decoding or directory traversal.
+ *
+ * Requires: MBEDTLS_X509_CRT_PARSE_C
+ *
+ * Uncomment to enable trust store snapshots.
+ */
+//#define MBEDTLS_X509_CRT_SNAPSHOT
+
+/**
+ * \def MBEDTLS_X509_CRT_CONTIGUOUS
+ *
+ * Lay out each parsed certificate in a single block: the copy of the DER
+ * data, the issuer and subject name lists, the subjectAltName, extended key
+ * usage and certificate policies lists and the canonical names are moved
+ * into one allocation, sized once the certificate is parsed. This reduces
+ * the number of allocations per certificate, keeps the data walked during
+ * chain building together, and lets mbedtls_x509_crt_free() release it
+ * with a single free. The public key keeps its own allocations.
+ *
+ * Applications must not add nodes to the lists of a parsed certificate
+ * when this option is enabled.
+ *
+ * Requires: MBEDTLS_X509_CRT_PARSE_C
+ *
+ * Uncomment to lay out certificates in a single block.
+ */
+//#define MBEDTLS_X509_CRT_CONTIGUOUS
+
+/**
+ * \def MBEDTLS_X509_PEM_FAST_DECODE
+ *
+ * Decode the PEM certificates, CRLs and CSRs given to the X.509 parsers in a
+ * single pass, 16 characters at a time with SSSE3 when the CPU supports it
+ * (detected at run time on x86-64 with GCC or Clang), instead of going
+ * through the generic PEM reader and base64 decoder. This speeds up loading
+ * large CA bundles and CRLs.
+ *
+ * Blocks with anything other than base64 digits, line breaks and final
+ * padding, such as encapsulated headers, are still handed to
+ * mbedtls_pem_read_buffer(), so the results and error codes do not change.
+ *
+ * This option has no effect unless MBEDTLS_PEM_PARSE_C is enabled.
+ *
+ * Comment this macro to always use the generic PEM reader.
+ */
+#define MBEDTLS_X509_PEM_FAST_DECODE
+
 /**
  * \def MBEDTLS_X509_CHECK_KEY_USAGE
  *
@@ -2996,6 +3119,27 @@
  */
 #define MBEDTLS_SHA512_C
 
+/**
+ * \def MBEDTLS_SSL_ASYNC_ENGINE_C
+ *
+ * Enable the asynchronous private key engine.
+ *
+ * This module implements the callbacks of mbedtls_ssl_conf_async_private_cb()
+ * with a pool of worker threads, so that the private key operations of a
+ * server handshake do not block the thread running the event loop. The
+ * workers are POSIX threads; they lock through the threading layer.
+ *
+ * Module:  library/ssl_async_engine.c
+ * Caller:
+ *
+ * Requires: MBEDTLS_SSL_ASYNC_PRIVATE, MBEDTLS_SSL_SRV_C,
+ *           MBEDTLS_X509_CRT_PARSE_C, MBEDTLS_THREADING_C,
+ *           MBEDTLS_THREADING_PTHREAD
+ *
+ * Uncomment this macro to enable the asynchronous private key engine.
+ */
+//#define MBEDTLS_SSL_ASYNC_ENGINE_C
+
 /**
  * \def MBEDTLS_SSL_CACHE_C
  *
@@ -3018,6 +3162,56 @@
  */
 #define MBEDTLS_SSL_COOKIE_C
 
+/**
+ * \def MBEDTLS_SSL_CREDENTIALS_C
+ *
+ * Enable reference-counted credentials: own certificates and keys, trusted
+ * CAs and CRLs that are shared by several configurations and can be
+ * replaced with mbedtls_ssl_conf_credentials() while handshakes are
+ * running. Each handshake keeps the credentials it started with.
+ *
+ * Module:  library/ssl_credentials.c
+ * Caller:  library/ssl_tls.c
+ *
+ * Requires: MBEDTLS_SSL_TLS_C, MBEDTLS_X509_CRT_PARSE_C, MBEDTLS_PK_PARSE_C
+ *
+ * Uncomment this macro to enable reference-counted credentials.
+ */
+//#define MBEDTLS_SSL_CREDENTIALS_C
+
+/**
+ * \def MBEDTLS_SSL_SNI_REGISTRY_C
+ *
+ * Enable the SNI registry, which selects the server certificate and key for
+ * the hostname sent by the client from hash tables of exact and wildcard
+ * names. It is used as the callback of mbedtls_ssl_conf_sni().
+ *
+ * Module:  library/ssl_sni_registry.c
+ * Caller:
+ *
+ * Requires: MBEDTLS_SSL_SERVER_NAME_INDICATION
+ *
+ * Uncomment this macro to enable the SNI registry.
+ */
+//#define MBEDTLS_SSL_SNI_REGISTRY_C
+
+/**
+ * \def MBEDTLS_SSL_SNI_CACHE_C
+ *
+ * Enable the SNI cache, which loads the certificate chain and private key
+ * of a hostname from a provider when a client first asks for it, and keeps
+ * a bounded number of them parsed, dropping the least recently used. It is
+ * used as the callback of mbedtls_ssl_conf_sni().
+ *
+ * Module:  library/ssl_sni_cache.c
+ * Caller:
+ *
+ * Requires: MBEDTLS_SSL_SERVER_NAME_INDICATION, MBEDTLS_PK_PARSE_C
+ *
+ * Uncomment this macro to enable the SNI cache.
+ */
+//#define MBEDTLS_SSL_SNI_CACHE_C
+
 /**
  * \def MBEDTLS_SSL_TICKET_C
  *
@@ -3355,6 +3549,13 @@
  */
 //#define MBEDTLS_PARAM_FAILED( cond )               assert( cond )
 
+/* SSL asynchronous engine options */
+//#define MBEDTLS_SSL_ASYNC_ENGINE_MAX_WORKERS      16 /**< Maximum number of worker threads */
+//#define MBEDTLS_SSL_ASYNC_ENGINE_MAX_BATCH         8 /**< Maximum number of operations a worker takes at once */
+
+/* SSL SNI cache options */
+//#define MBEDTLS_SSL_SNI_CACHE_DEFAULT_MAX_ENTRIES  1024 /**< Maximum parsed hostnames kept */
+
 /* SSL Cache options */
 //#define MBEDTLS_SSL_CACHE_DEFAULT_TIMEOUT       86400 /**< 1 day  */
 //#define MBEDTLS_SSL_CACHE_DEFAULT_MAX_ENTRIES      50 /**< Maximum entries in cache */
@@ -3481,9 +3682,31 @@
  * to reassembly a large handshake message (such as a certificate)
  * while buffering multiple smaller handshake messages.
  *
+ * This amount is allocated as a single block the first time a handshake
+ * needs to buffer or reassemble a message, and released at the end of
+ * the handshake.
+ *
  */
 //#define MBEDTLS_SSL_DTLS_MAX_BUFFERING             32768
 
+/** \def MBEDTLS_SSL_DTLS_REPLAY_WINDOW
+ *
+ * Maximum size, in records, of the DTLS anti-replay window.
+ *
+ * Records whose sequence number is more than this many records behind the
+ * most recent validated record are dropped as potential replays. A larger
+ * window tolerates more reordering on high-bandwidth links, at the cost of
+ * MBEDTLS_SSL_DTLS_REPLAY_WINDOW / 8 + 8 bytes of RAM per SSL context.
+ *
+ * The window actually used can be lowered at runtime with
+ * mbedtls_ssl_conf_dtls_anti_replay_window().
+ *
+ * Must be a positive multiple of 64.
+ *
+ * Requires: MBEDTLS_SSL_DTLS_ANTI_REPLAY
+ */
+//#define MBEDTLS_SSL_DTLS_REPLAY_WINDOW             64
+
 //#define MBEDTLS_SSL_DEFAULT_TICKET_LIFETIME     86400 /**< Lifetime of session tickets (if enabled) */
 //#define MBEDTLS_PSK_MAX_LEN               32 /**< Max size of TLS pre-shared keys, in bytes (default 256 bits) */
 //#define MBEDTLS_SSL_COOKIE_TIMEOUT        60 /**< Default expiration delay of DTLS cookies, in seconds if HAVE_TIME, or in number of cookies issued */
@@ -82,6 +82,35 @@
 
 #endif /* MBEDTLS_DEBUG_C */
 
+#if defined(MBEDTLS_DEBUG_BINARY_TRACE)
+/*
+ * Record types in a binary trace
+ */
+#define MBEDTLS_DEBUG_TRACE_MSG     1   /**< mbedtls_debug_print_msg()    */
+#define MBEDTLS_DEBUG_TRACE_RET     2   /**< mbedtls_debug_print_ret()    */
+#define MBEDTLS_DEBUG_TRACE_BUF     3   /**< mbedtls_debug_print_buf()    */
+
+#define MBEDTLS_DEBUG_TRACE_VERSION 1   /**< Version of the export format */
+
+/**
+ * \brief          Ring buffer receiving binary debug records.
+ *
+ *                 A ring must only be written to by one thread at a time:
+ *                 use one ring per thread, returned by the callback set
+ *                 with mbedtls_ssl_conf_dbg_trace(). When the ring is full,
+ *                 the oldest records are overwritten.
+ */
+struct mbedtls_debug_trace
+{
+    unsigned char *buf;         /*!< storage for the records          */
+    size_t size;                /*!< size of buf                      */
+    size_t head;                /*!< offset of the next record        */
+    size_t tail;                /*!< offset of the oldest record      */
+    size_t used;                /*!< bytes used by records            */
+    uint32_t lost;              /*!< records overwritten or dropped   */
+};
+#endif /* MBEDTLS_DEBUG_BINARY_TRACE */
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -257,6 +286,59 @@ void mbedtls_debug_printf_ecdh( const mbedtls_ssl_context *ssl, int level,
                                 mbedtls_debug_ecdh_attr attr );
 #endif
 
+#if defined(MBEDTLS_DEBUG_BINARY_TRACE)
+/**
+ * \brief          Initialize a binary trace ring over a caller-provided
+ *                 buffer.
+ *
+ * \param trace    Ring to initialize
+ * \param buf      Storage for the records, which must remain valid as
+ *                 long as the ring is used
+ * \param size     Size of \p buf in bytes
+ */
+void mbedtls_debug_trace_init( mbedtls_debug_trace *trace,
+                               unsigned char *buf, size_t size );
+
+/**
+ * \brief          Export the records currently in a binary trace ring,
+ *                 oldest first, for offline decoding with the
+ *                 programs/util/trace_decode program.
+ *
+ *                 Records hold the raw arguments of the debug calls, and
+ *                 references to the file names and format strings, which
+ *                 are resolved here. The format string of each debug
+ *                 message must therefore still be valid, which is always
+ *                 the case for the messages of the library itself.
+ *
+ * \param trace    Ring to export
+ * \param out      Output buffer, or NULL to query the required size
+ * \param out_size Size of \p out
+ * \param olen     On success, the number of bytes written. On
+ *                 #MBEDTLS_ERR_SSL_BUFFER_TOO_SMALL, the size required.
+ *
+ * \return         0 on success, #MBEDTLS_ERR_SSL_BUFFER_TOO_SMALL if
+ *                 \p out_size is too small.
+ */
+int mbedtls_debug_trace_export( const mbedtls_debug_trace *trace,
+                                unsigned char *out, size_t out_size,
+                                size_t *olen );
+
+#if defined(MBEDTLS_FS_IO)
+/**
+ * \brief          Export the records of a binary trace ring to a file,
+ *                 see mbedtls_debug_trace_export().
+ *
+ * \param trace    Ring to export
+ * \param path     Name of the file to write
+ *
+ * \return         0 on success, #MBEDTLS_ERR_SSL_ALLOC_FAILED or
+ *                 #MBEDTLS_ERR_SSL_BAD_INPUT_DATA on failure.
+ */
+int mbedtls_debug_trace_write_file( const mbedtls_debug_trace *trace,
+                                    const char *path );
+#endif /* MBEDTLS_FS_IO */
+#endif /* MBEDTLS_DEBUG_BINARY_TRACE */
+
 #ifdef __cplusplus
 }
 #endif
@@ -69,6 +69,14 @@
 #include "psa/crypto.h"
 #endif /* MBEDTLS_USE_PSA_CRYPTO */
 
+#if defined(MBEDTLS_THREADING_C)
+#include "mbedtls/threading.h"
+#endif
+
+#if defined(MBEDTLS_ALLOC_PROFILE)
+#include "mbedtls/alloc_profile.h"
+#endif
+
 /*
  * SSL Error codes
  */
@@ -261,6 +269,13 @@
 #define MBEDTLS_SSL_DTLS_MAX_BUFFERING 32768
 #endif
 
+/*
+ * Maximum size of the DTLS anti-replay window, in records.
+ */
+#if !defined(MBEDTLS_SSL_DTLS_REPLAY_WINDOW)
+#define MBEDTLS_SSL_DTLS_REPLAY_WINDOW 64
+#endif
+
 /*
  * Maximum length of CIDs for incoming and outgoing messages.
  */
@@ -287,6 +302,14 @@
 #define MBEDTLS_SSL_VERIFY_DATA_MAX_LEN 12
 #endif
 
+/*
+ * Number of 64-bit words in the DTLS anti-replay ring bitmap. One extra word
+ * is kept so that a full window always fits, whatever the position of the
+ * most recent record within its word.
+ */
+#define MBEDTLS_SSL_DTLS_REPLAY_WINDOW_WORDS                        \
+    ( MBEDTLS_SSL_DTLS_REPLAY_WINDOW / 64 + 1 )
+
 /*
  * Signaling ciphersuite values (SCSV)
  */
@@ -597,6 +620,26 @@ typedef void mbedtls_ssl_set_timer_t( void * ctx,
  */
 typedef int mbedtls_ssl_get_timer_t( void * ctx );
 
+/**
+ * \brief          Callback type: read a millisecond clock
+ *
+ * \param ctx      Context pointer
+ *
+ * \return         The current value of a monotonic clock, in milliseconds.
+ *                 The origin is arbitrary, and the value may wrap around.
+ */
+typedef uint32_t mbedtls_ssl_get_clock_t( void * ctx );
+
+/**
+ * \brief          Callback type: read a high-resolution clock
+ *
+ * \param ctx      Context pointer
+ *
+ * \return         The current value of a monotonic clock, in nanoseconds.
+ *                 The origin is arbitrary.
+ */
+typedef uint64_t mbedtls_ssl_get_time_ns_t( void * ctx );
+
 /* Defined below */
 typedef struct mbedtls_ssl_session mbedtls_ssl_session;
 typedef struct mbedtls_ssl_context mbedtls_ssl_context;
@@ -609,10 +652,37 @@ typedef struct mbedtls_ssl_sig_hash_set_t mbedtls_ssl_sig_hash_set_t;
 #if defined(MBEDTLS_X509_CRT_PARSE_C)
 typedef struct mbedtls_ssl_key_cert mbedtls_ssl_key_cert;
 #endif
+#if defined(MBEDTLS_SSL_CREDENTIALS_C)
+/* Defined in ssl_credentials.h */
+typedef struct mbedtls_ssl_credentials mbedtls_ssl_credentials;
+#endif
 #if defined(MBEDTLS_SSL_PROTO_DTLS)
 typedef struct mbedtls_ssl_flight_item mbedtls_ssl_flight_item;
 #endif
 
+#if defined(MBEDTLS_DEBUG_BINARY_TRACE)
+/* Defined in debug.h */
+typedef struct mbedtls_debug_trace mbedtls_debug_trace;
+#endif
+
+/**
+ * \brief          Callback type: report the duration of a handshake step
+ *
+ * \param ctx      Context pointer
+ * \param ssl      SSL context performing the handshake
+ * \param state    Handshake state that was processed (one of the
+ *                 \c mbedtls_ssl_states values)
+ * \param start_ns Clock value when processing of \p state started
+ * \param end_ns   Clock value when processing of \p state returned
+ * \param bytes    Number of bytes read from and written to the underlying
+ *                 transport while processing \p state
+ */
+typedef void mbedtls_ssl_hs_timing_t( void *ctx,
+                                      const mbedtls_ssl_context *ssl,
+                                      int state,
+                                      uint64_t start_ns, uint64_t end_ns,
+                                      size_t bytes );
+
 #if defined(MBEDTLS_SSL_ASYNC_PRIVATE)
 #if defined(MBEDTLS_X509_CRT_PARSE_C)
 /**
@@ -825,6 +895,108 @@ typedef int mbedtls_ssl_async_resume_t( mbedtls_ssl_context *ssl,
 typedef void mbedtls_ssl_async_cancel_t( mbedtls_ssl_context *ssl );
 #endif /* MBEDTLS_SSL_ASYNC_PRIVATE */
 
+#if defined(MBEDTLS_SSL_ASYNC_VERIFY)
+/**
+ * \brief           Callback type: start asynchronous verification of the
+ *                  peer certificate chain.
+ *
+ *                  This callback is called during an SSL handshake, once the
+ *                  peer's Certificate message has been parsed, in place of
+ *                  the call to mbedtls_x509_crt_verify_restartable(). It
+ *                  should start verifying \p chain, typically by handing it
+ *                  to another thread or to an external service, and return
+ *                  without waiting for the result.
+ *
+ *                  The trusted CAs, CRLs, profile and verification callback
+ *                  configured on the SSL context are not used by the library
+ *                  when this callback takes over; the verifier is responsible
+ *                  for applying its own policy. The checks that do not
+ *                  depend on the chain (key usage, allowed curves and the
+ *                  authentication mode) are still performed by the library
+ *                  on the result.
+ *
+ * \param p_verify  The value given to mbedtls_ssl_conf_async_verify().
+ * \param ssl       The SSL connection instance. It should not be modified.
+ * \param chain     The peer certificate chain. It remains valid and is not
+ *                  modified until the resume callback returns a value other
+ *                  than #MBEDTLS_ERR_SSL_ASYNC_IN_PROGRESS or the cancel
+ *                  callback is called.
+ * \param hostname  The expected peer hostname set with
+ *                  mbedtls_ssl_set_hostname(), or \c NULL.
+ * \param op        On success, an operation context that is passed to the
+ *                  resume and cancel callbacks.
+ *
+ * \return          0 if the operation was started successfully and the SSL
+ *                  stack should call the resume callback immediately.
+ * \return          #MBEDTLS_ERR_SSL_ASYNC_IN_PROGRESS if the operation
+ *                  was started successfully and the SSL stack should return
+ *                  immediately without calling the resume callback yet.
+ * \return          #MBEDTLS_ERR_SSL_HW_ACCEL_FALLTHROUGH if the verifier
+ *                  declines this chain. The SSL stack will verify it itself
+ *                  with the configured trusted CAs.
+ * \return          Any other error indicates a fatal failure and is
+ *                  propagated up the call chain.
+ */
+typedef int mbedtls_ssl_async_verify_start_t( void *p_verify,
+                                              mbedtls_ssl_context *ssl,
+                                              mbedtls_x509_crt *chain,
+                                              const char *hostname,
+                                              void **op );
+
+/**
+ * \brief           Callback type: resume asynchronous verification of the
+ *                  peer certificate chain.
+ *
+ *                  This callback is called each time the handshake is
+ *                  resumed after ::mbedtls_ssl_async_verify_start_t returned
+ *                  #MBEDTLS_ERR_SSL_ASYNC_IN_PROGRESS. It should check the
+ *                  status of the operation without waiting for it.
+ *
+ *                  When this function returns a status other than
+ *                  #MBEDTLS_ERR_SSL_ASYNC_IN_PROGRESS, it must free any
+ *                  resources associated with \p op.
+ *
+ * \param p_verify  The value given to mbedtls_ssl_conf_async_verify().
+ * \param ssl       The SSL connection instance. It should not be modified.
+ * \param op        The operation context returned by the start callback.
+ * \param flags     On completion, the verification result, as a bitwise
+ *                  combination of the MBEDTLS_X509_BADCERT_XXX and
+ *                  MBEDTLS_X509_BADCRL_XXX flags.
+ *
+ * \return          0 if the chain was verified successfully.
+ * \return          #MBEDTLS_ERR_X509_CERT_VERIFY_FAILED if the chain was
+ *                  rejected, with the reasons in \p flags. The handshake is
+ *                  then aborted or continued according to the
+ *                  authentication mode.
+ * \return          #MBEDTLS_ERR_SSL_ASYNC_IN_PROGRESS if the verification
+ *                  is still in progress.
+ * \return          Any other error aborts the handshake.
+ */
+typedef int mbedtls_ssl_async_verify_resume_t( void *p_verify,
+                                               mbedtls_ssl_context *ssl,
+                                               void *op,
+                                               uint32_t *flags );
+
+/**
+ * \brief           Callback type: cancel asynchronous verification of the
+ *                  peer certificate chain.
+ *
+ *                  This callback is called if an SSL connection is closed or
+ *                  reset while a verification is in progress. It is not
+ *                  called once ::mbedtls_ssl_async_verify_resume_t has
+ *                  returned a value other than
+ *                  #MBEDTLS_ERR_SSL_ASYNC_IN_PROGRESS. When it returns, the
+ *                  verifier must no longer access the chain.
+ *
+ * \param p_verify  The value given to mbedtls_ssl_conf_async_verify().
+ * \param ssl       The SSL connection instance. It should not be modified.
+ * \param op        The operation context returned by the start callback.
+ */
+typedef void mbedtls_ssl_async_verify_cancel_t( void *p_verify,
+                                                mbedtls_ssl_context *ssl,
+                                                void *op );
+#endif /* MBEDTLS_SSL_ASYNC_VERIFY */
+
 #if defined(MBEDTLS_KEY_EXCHANGE__WITH_CERT__ENABLED) &&        \
     !defined(MBEDTLS_SSL_KEEP_PEER_CERTIFICATE)
 #define MBEDTLS_SSL_PEER_CERT_DIGEST_MAX_LEN  48
@@ -914,6 +1086,20 @@ struct mbedtls_ssl_config
     /** Callback for printing debug output                                  */
     void (*f_dbg)(void *, int, const char *, int, const char *);
     void *p_dbg;                    /*!< context for the debug function     */
+    int dbg_threshold;              /*!< debug threshold, or -1 for global  */
+    uint32_t dbg_sample;            /*!< 1 in dbg_sample contexts uses
+                                         dbg_threshold                      */
+
+#if defined(MBEDTLS_DEBUG_BINARY_TRACE)
+    /** Callback to get the binary trace ring of the current thread         */
+    mbedtls_debug_trace *(*f_trace)(void *, const mbedtls_ssl_context *);
+    void *p_trace;                  /*!< context for the trace callback     */
+#endif
+
+    /** Clock and callback for handshake step timing                        */
+    mbedtls_ssl_get_time_ns_t *f_time_ns;
+    mbedtls_ssl_hs_timing_t *f_hs_timing;
+    void *p_hs_timing;              /*!< context for the timing callbacks   */
 
     /** Callback for getting (pseudo-)random numbers                        */
     int  (*f_rng)(void *, unsigned char *, size_t);
@@ -943,6 +1129,12 @@ struct mbedtls_ssl_config
     void *p_psk;                    /*!< context for PSK callback           */
 #endif
 
+#if defined(MBEDTLS_SSL_PROTO_DTLS)
+    /** Callback to read a clock, for handshake round-trip time estimation  */
+    mbedtls_ssl_get_clock_t *f_clock;
+    void *p_clock;                  /*!< context for the clock callback     */
+#endif
+
 #if defined(MBEDTLS_SSL_DTLS_HELLO_VERIFY) && defined(MBEDTLS_SSL_SRV_C)
     /** Callback to create & write a cookie for ClientHello veirifcation    */
     int (*f_cookie_write)( void *, unsigned char **, unsigned char *,
@@ -983,6 +1175,13 @@ struct mbedtls_ssl_config
     mbedtls_ssl_key_cert *key_cert; /*!< own certificate/key pair(s)        */
     mbedtls_x509_crt *ca_chain;     /*!< trusted CAs                        */
     mbedtls_x509_crl *ca_crl;       /*!< trusted CAs CRLs                   */
+#if defined(MBEDTLS_SSL_CREDENTIALS_C)
+    mbedtls_ssl_credentials *credentials; /*!< shared certificates, keys
+                                               and CAs, or NULL            */
+#if defined(MBEDTLS_THREADING_C)
+    mbedtls_threading_mutex_t credentials_mutex; /*!< protects credentials */
+#endif
+#endif /* MBEDTLS_SSL_CREDENTIALS_C */
 #if defined(MBEDTLS_X509_TRUSTED_CERTIFICATE_CALLBACK)
     mbedtls_x509_crt_ca_cb_t f_ca_cb;
     void *p_ca_cb;
@@ -999,6 +1198,13 @@ struct mbedtls_ssl_config
     void *p_async_config_data; /*!< Configuration data set by mbedtls_ssl_conf_async_private_cb(). */
 #endif /* MBEDTLS_SSL_ASYNC_PRIVATE */
 
+#if defined(MBEDTLS_SSL_ASYNC_VERIFY)
+    mbedtls_ssl_async_verify_start_t *f_async_verify_start; /*!< start chain verification */
+    mbedtls_ssl_async_verify_resume_t *f_async_verify_resume; /*!< resume chain verification */
+    mbedtls_ssl_async_verify_cancel_t *f_async_verify_cancel; /*!< cancel chain verification */
+    void *p_async_verify; /*!< context for the verification callbacks */
+#endif /* MBEDTLS_SSL_ASYNC_VERIFY */
+
 #if defined(MBEDTLS_KEY_EXCHANGE__WITH_CERT__ENABLED)
     const int *sig_hashes;          /*!< allowed signature hashes           */
 #endif
@@ -1060,6 +1266,9 @@ struct mbedtls_ssl_config
                                          retransmission timeout (ms)        */
     uint32_t hs_timeout_max;        /*!< maximum value of the handshake
                                          retransmission timeout (ms)        */
+    uint32_t hs_rto_min;            /*!< minimum value of the handshake
+                                         retransmission timeout derived from
+                                         the measured round-trip time (ms)  */
 #endif
 
 #if defined(MBEDTLS_SSL_RENEGOTIATION)
@@ -1068,6 +1277,10 @@ struct mbedtls_ssl_config
                                          that triggers renegotiation        */
 #endif
 
+#if defined(MBEDTLS_SSL_DTLS_ANTI_REPLAY)
+    unsigned int anti_replay_window; /*!< size of the anti-replay window    */
+#endif
+
 #if defined(MBEDTLS_SSL_DTLS_BADMAC_LIMIT)
     unsigned int badmac_limit;      /*!< limit of records with a bad MAC    */
 #endif
@@ -1131,6 +1344,25 @@ struct mbedtls_ssl_config
 #endif /* MBEDTLS_SSL_DTLS_CONNECTION_ID */
 };
 
+/**
+ * \brief          Cumulative record layer counters of an SSL context,
+ *                 as returned by mbedtls_ssl_get_stats().
+ */
+typedef struct mbedtls_ssl_stats
+{
+    uint64_t records_in;        /*!< records successfully received      */
+    uint64_t records_out;       /*!< records written                    */
+    uint64_t bytes_encrypted;   /*!< payload bytes protected for sending */
+    uint64_t bytes_decrypted;   /*!< payload bytes of received protected
+                                     records, after decryption          */
+    uint32_t bad_mac;           /*!< received records that failed
+                                     authentication                     */
+    uint32_t retransmissions;   /*!< DTLS: handshake flights resent     */
+    uint32_t buffered_records;  /*!< DTLS: records from the next epoch
+                                     buffered for later processing      */
+    uint32_t renegotiations;    /*!< renegotiations completed           */
+}
+mbedtls_ssl_stats;
 
 struct mbedtls_ssl_context
 {
@@ -1154,6 +1386,15 @@ struct mbedtls_ssl_context
     unsigned badmac_seen;       /*!< records with a bad MAC received    */
 #endif /* MBEDTLS_SSL_DTLS_BADMAC_LIMIT */
 
+    int dbg_threshold;          /*!< debug threshold, or -1 for global  */
+
+    mbedtls_ssl_stats stats;    /*!< traffic counters                   */
+
+#if defined(MBEDTLS_ALLOC_PROFILE)
+    mbedtls_alloc_profile_stats alloc_profile[MBEDTLS_ALLOC_PROFILE_CATEGORIES];
+                                /*!< memory used by this context        */
+#endif
+
 #if defined(MBEDTLS_X509_CRT_PARSE_C)
     /** Callback to customize X.509 certificate chain verification          */
     int (*f_vrfy)(void *, mbedtls_x509_crt *, int, uint32_t *);
@@ -1221,7 +1462,8 @@ struct mbedtls_ssl_context
 #endif /* MBEDTLS_SSL_PROTO_DTLS */
 #if defined(MBEDTLS_SSL_DTLS_ANTI_REPLAY)
     uint64_t in_window_top;     /*!< last validated record seq_num    */
-    uint64_t in_window;         /*!< bitmask for replay detection     */
+    uint64_t in_window[MBEDTLS_SSL_DTLS_REPLAY_WINDOW_WORDS];
+                                /*!< ring bitmap for replay detection */
 #endif /* MBEDTLS_SSL_DTLS_ANTI_REPLAY */
 
     size_t in_hslen;            /*!< current handshake message length,
@@ -1278,6 +1520,8 @@ struct mbedtls_ssl_context
 #if defined(MBEDTLS_X509_CRT_PARSE_C)
     char *hostname;             /*!< expected peer CN for verification
                                      (and SNI if available)                 */
+    mbedtls_x509_crt_hostname *hostname_match; /*!< hostname prepared
+                                     for certificate name matching          */
 #endif /* MBEDTLS_X509_CRT_PARSE_C */
 
 #if defined(MBEDTLS_SSL_ALPN)
@@ -1505,6 +1749,96 @@ void mbedtls_ssl_conf_dbg( mbedtls_ssl_config *conf,
                   void (*f_dbg)(void *, int, const char *, int, const char *),
                   void  *p_dbg );
 
+/**
+ * \brief          Set a debug threshold for the SSL contexts using this
+ *                 configuration, instead of the global threshold set with
+ *                 mbedtls_debug_set_threshold().
+ *                 Default: -1 (use the global threshold).
+ *
+ *                 Optionally, only one context in \p sample uses this
+ *                 threshold, the others using the global threshold. The
+ *                 choice is made randomly with the RNG of the
+ *                 configuration at mbedtls_ssl_setup() and
+ *                 mbedtls_ssl_session_reset() time, which allows tracing
+ *                 a fraction of the connections of a busy server.
+ *
+ * \param conf      SSL configuration
+ * \param threshold Debug threshold, see mbedtls_debug_set_threshold(),
+ *                  or -1 to use the global threshold.
+ * \param sample    Use \p threshold for one context in \p sample; 0 or 1
+ *                  for all contexts.
+ */
+void mbedtls_ssl_conf_dbg_threshold( mbedtls_ssl_config *conf,
+                                     int threshold, uint32_t sample );
+
+/**
+ * \brief          Set the debug threshold of an SSL context, for example
+ *                 to trace the connection with a single peer. This
+ *                 overrides the choice made from the configuration (see
+ *                 mbedtls_ssl_conf_dbg_threshold()) until the next
+ *                 session reset.
+ *
+ * \param ssl       SSL context
+ * \param threshold Debug threshold, see mbedtls_debug_set_threshold(),
+ *                  or -1 to use the global threshold.
+ */
+void mbedtls_ssl_set_dbg_threshold( mbedtls_ssl_context *ssl,
+                                    int threshold );
+
+#if defined(MBEDTLS_DEBUG_BINARY_TRACE)
+/**
+ * \brief          Set the binary debug trace callback.
+ *                 Default: none.
+ *
+ *                 When the callback returns a ring, debug messages, return
+ *                 values and buffers below the debug threshold are stored
+ *                 in it as binary records holding the raw arguments,
+ *                 instead of being formatted and passed to the debug
+ *                 callback. Formatting is deferred to the offline decoder,
+ *                 see mbedtls_debug_trace_export(). Other debug output,
+ *                 such as certificates and big numbers, is still sent to
+ *                 the debug callback.
+ *
+ * \param conf     SSL configuration
+ * \param f_trace  Callback returning the ring of the calling thread. It
+ *                 may return NULL to use the debug callback instead.
+ * \param p_trace  Context for the callback
+ */
+void mbedtls_ssl_conf_dbg_trace( mbedtls_ssl_config *conf,
+        mbedtls_debug_trace *(*f_trace)(void *, const mbedtls_ssl_context *),
+        void *p_trace );
+#endif /* MBEDTLS_DEBUG_BINARY_TRACE */
+
+/**
+ * \brief          Set the handshake timing callbacks.
+ *                 Default: none.
+ *
+ *                 When set, each call to mbedtls_ssl_handshake_step() that
+ *                 processes a handshake state reports the state, the
+ *                 values of \p f_time before and after processing it, and
+ *                 the number of bytes exchanged with the peer meanwhile.
+ *
+ * \param conf     SSL configuration
+ * \param f_time   Clock callback, or NULL to disable timing.
+ * \param f_timing Callback receiving the timing of each step, or NULL to
+ *                 disable timing.
+ * \param p_timing Context passed to both callbacks.
+ *
+ * \note           With non-blocking I/O, a state whose processing returns
+ *                 #MBEDTLS_ERR_SSL_WANT_READ or #MBEDTLS_ERR_SSL_WANT_WRITE
+ *                 is reported each time it is retried. Callers interested
+ *                 in the total time spent per state should add up the
+ *                 reports for the same \p state.
+ *
+ * \note           The callbacks are invoked from within the handshake and
+ *                 must not call any function on \p ssl other than
+ *                 read-only accessors.
+ */
+void mbedtls_ssl_conf_handshake_timing( mbedtls_ssl_config *conf,
+                                        mbedtls_ssl_get_time_ns_t *f_time,
+                                        mbedtls_ssl_hs_timing_t *f_timing,
+                                        void *p_timing );
+
 /**
  * \brief          Set the underlying BIO callbacks for write, read and
  *                 read-with-timeout.
@@ -2088,6 +2422,41 @@ void mbedtls_ssl_set_async_operation_data( mbedtls_ssl_context *ssl,
                                  void *ctx );
 #endif /* MBEDTLS_SSL_ASYNC_PRIVATE */
 
+#if defined(MBEDTLS_SSL_ASYNC_VERIFY)
+/**
+ * \brief           Configure asynchronous verification of the peer
+ *                  certificate chain.
+ *
+ *                  When these callbacks are set, the verification of the
+ *                  peer chain is delegated to \p f_start and
+ *                  mbedtls_ssl_handshake() returns
+ *                  #MBEDTLS_ERR_SSL_ASYNC_IN_PROGRESS while it is pending.
+ *                  The application should call mbedtls_ssl_handshake()
+ *                  again once the verifier has made progress.
+ *
+ * \param conf      SSL configuration context
+ * \param f_start   Callback to start a verification. See
+ *                  ::mbedtls_ssl_async_verify_start_t. Pass \c NULL to
+ *                  disable asynchronous verification.
+ * \param f_resume  Callback to resume a verification. See
+ *                  ::mbedtls_ssl_async_verify_resume_t. This may not be
+ *                  \c NULL unless \p f_start is \c NULL.
+ * \param f_cancel  Callback to cancel a verification. See
+ *                  ::mbedtls_ssl_async_verify_cancel_t. This may be \c NULL
+ *                  if no cleanup is needed.
+ * \param p_verify  Context for the callbacks. The library stores this value
+ *                  without dereferencing it.
+ *
+ * \return          0 if successful, or MBEDTLS_ERR_SSL_BAD_INPUT_DATA if
+ *                  \p f_start is set without \p f_resume.
+ */
+int mbedtls_ssl_conf_async_verify( mbedtls_ssl_config *conf,
+                                   mbedtls_ssl_async_verify_start_t *f_start,
+                                   mbedtls_ssl_async_verify_resume_t *f_resume,
+                                   mbedtls_ssl_async_verify_cancel_t *f_cancel,
+                                   void *p_verify );
+#endif /* MBEDTLS_SSL_ASYNC_VERIFY */
+
 /**
  * \brief          Callback type: generate a cookie
  *
@@ -2199,6 +2568,29 @@ int mbedtls_ssl_set_client_transport_id( mbedtls_ssl_context *ssl,
  *                 transmission strategy, then you'll want to disable this.
  */
 void mbedtls_ssl_conf_dtls_anti_replay( mbedtls_ssl_config *conf, char mode );
+
+/**
+ * \brief          Set the size of the anti-replay window for DTLS.
+ *                 (DTLS only, no effect on TLS.)
+ *                 Default: MBEDTLS_SSL_DTLS_REPLAY_WINDOW.
+ *
+ * \param conf     SSL configuration
+ * \param window   Number of records behind the most recent one that are
+ *                 still tracked. Records older than that are dropped.
+ *                 Must be a positive multiple of 64, not larger than
+ *                 MBEDTLS_SSL_DTLS_REPLAY_WINDOW.
+ *
+ * \note           A larger window lets more records reordered in transit
+ *                 through (instead of being dropped and retransmitted by
+ *                 the upper layer). Its maximum, and hence the RAM reserved
+ *                 in each SSL context, is fixed at compile time by
+ *                 MBEDTLS_SSL_DTLS_REPLAY_WINDOW.
+ *
+ * \return         0 on success, or MBEDTLS_ERR_SSL_BAD_INPUT_DATA if
+ *                 \p window is not acceptable.
+ */
+int mbedtls_ssl_conf_dtls_anti_replay_window( mbedtls_ssl_config *conf,
+                                              unsigned int window );
 #endif /* MBEDTLS_SSL_DTLS_ANTI_REPLAY */
 
 #if defined(MBEDTLS_SSL_DTLS_BADMAC_LIMIT)
@@ -2293,6 +2685,42 @@ void mbedtls_ssl_set_datagram_packing( mbedtls_ssl_context *ssl,
  *                 resend ... 5s -> give up and return a timeout error.
  */
 void mbedtls_ssl_conf_handshake_timeout( mbedtls_ssl_config *conf, uint32_t min, uint32_t max );
+
+/**
+ * \brief          Enable adaptive retransmit timeouts for the DTLS handshake,
+ *                 based on the measured round-trip time to the peer.
+ *                 (DTLS only, no effect on TLS.)
+ *                 Default: disabled.
+ *
+ *                 The time between the first transmission of each outgoing
+ *                 flight and the reception of the peer's next flight is
+ *                 measured with \p f_clock, and fed into a smoothed estimator
+ *                 of the round-trip time and its variation, as is done for
+ *                 TCP in RFC 6298. Once a first measurement is available,
+ *                 the initial timeout for each following flight is
+ *                 SRTT + 4 * RTTVAR instead of the 'min' value set with
+ *                 mbedtls_ssl_conf_handshake_timeout(). It is then doubled
+ *                 at each retransmission as usual.
+ *
+ * \param conf     SSL configuration
+ * \param f_clock  Clock callback, or NULL to disable adaptive timeouts.
+ * \param p_clock  Context for the clock callback.
+ * \param rto_min  Lower bound for timeouts derived from the round-trip
+ *                 time, in milliseconds. They are also bounded above by the
+ *                 'max' value set with mbedtls_ssl_conf_handshake_timeout().
+ *
+ * \note           Flights that had to be retransmitted are not measured, as
+ *                 the peer's answer can't be matched to a transmission.
+ *
+ * \note           The measured time includes the time the peer needs to
+ *                 process the flight. Choose \p rto_min with the same
+ *                 considerations as the 'min' value of
+ *                 mbedtls_ssl_conf_handshake_timeout().
+ */
+void mbedtls_ssl_conf_handshake_rtt( mbedtls_ssl_config *conf,
+                                     mbedtls_ssl_get_clock_t *f_clock,
+                                     void *p_clock,
+                                     uint32_t rto_min );
 #endif /* MBEDTLS_SSL_PROTO_DTLS */
 
 #if defined(MBEDTLS_SSL_SRV_C)
@@ -2637,6 +3065,14 @@ void mbedtls_ssl_conf_ca_cb( mbedtls_ssl_config *conf,
  *                 this check yourself, but be aware that this function can
  *                 be computationally expensive on some key types.
  *
+ * \note           This function encodes \p own_cert for the Certificate
+ *                 message, and all handshakes with this configuration send
+ *                 that encoding. Certificates parsed into \p own_cert or
+ *                 removed from it afterwards are not taken into account:
+ *                 the handshakes keep sending the chain as it was when
+ *                 this function was called. To change the chain, set up a
+ *                 new configuration.
+ *
  * \param conf     SSL configuration
  * \param own_cert own public certificate chain
  * \param pk_key   own private key
@@ -3495,6 +3931,46 @@ const char *mbedtls_ssl_get_version( const mbedtls_ssl_context *ssl );
  */
 int mbedtls_ssl_get_record_expansion( const mbedtls_ssl_context *ssl );
 
+/**
+ * \brief          Return the record layer counters of an SSL context.
+ *
+ *                 The counters are maintained unconditionally, and are
+ *                 cleared by mbedtls_ssl_setup() and
+ *                 mbedtls_ssl_session_reset(). Plaintext handled before the
+ *                 first ChangeCipherSpec is counted in \c records_in and
+ *                 \c records_out only.
+ *
+ * \param ssl      SSL context
+ * \param stats    Structure to fill with a copy of the counters
+ *
+ * \return         0 if successful, or MBEDTLS_ERR_SSL_BAD_INPUT_DATA.
+ */
+int mbedtls_ssl_get_stats( const mbedtls_ssl_context *ssl,
+                           mbedtls_ssl_stats *stats );
+
+#if defined(MBEDTLS_ALLOC_PROFILE)
+/**
+ * \brief          Return the memory used by an SSL context in one of the
+ *                 MBEDTLS_ALLOC_PROFILE_XXX categories.
+ *
+ *                 This covers the record buffers, the handshake
+ *                 parameters, the sessions and transforms and the DTLS
+ *                 flights owned by the context, but not the certificates
+ *                 and keys shared through the configuration. The counters
+ *                 are kept for the lifetime of the context, across
+ *                 mbedtls_ssl_session_reset().
+ *
+ * \param ssl      SSL context
+ * \param category Category to query
+ * \param stats    Structure to fill with a copy of the counters
+ *
+ * \return         0 if successful, or MBEDTLS_ERR_SSL_BAD_INPUT_DATA.
+ */
+int mbedtls_ssl_get_alloc_profile( const mbedtls_ssl_context *ssl,
+                                   int category,
+                                   mbedtls_alloc_profile_stats *stats );
+#endif /* MBEDTLS_ALLOC_PROFILE */
+
 #if defined(MBEDTLS_SSL_MAX_FRAGMENT_LENGTH)
 /**
  * \brief          Return the maximum fragment length (payload, in bytes).
@@ -0,0 +1,245 @@
+/**
+ * \file ssl_async_engine.h
+ *
+ * \brief Asynchronous private key operations on a pool of worker threads
+ */
+/*
+ *  Copyright (C) 2006-2019, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *  This file is part of mbed TLS (https://tls.mbed.org)
+ */
+#ifndef MBEDTLS_SSL_ASYNC_ENGINE_H
+#define MBEDTLS_SSL_ASYNC_ENGINE_H
+
+#if !defined(MBEDTLS_CONFIG_FILE)
+#include "mbedtls/config.h"
+#else
+#include MBEDTLS_CONFIG_FILE
+#endif
+
+#include "mbedtls/ssl.h"
+#include "mbedtls/threading.h"
+
+#include <pthread.h>
+
+/**
+ * \name SECTION: Module settings
+ *
+ * The configuration options you can set for this module are in this section.
+ * Either change them in config.h or define them on the compiler command line.
+ * \{
+ */
+
+#if !defined(MBEDTLS_SSL_ASYNC_ENGINE_MAX_WORKERS)
+#define MBEDTLS_SSL_ASYNC_ENGINE_MAX_WORKERS    16  /**< Maximum number of worker threads */
+#endif
+
+#if !defined(MBEDTLS_SSL_ASYNC_ENGINE_MAX_BATCH)
+#define MBEDTLS_SSL_ASYNC_ENGINE_MAX_BATCH       8  /**< Maximum number of operations a worker takes at once */
+#endif
+
+/* \} name SECTION: Module settings */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct mbedtls_ssl_async_job mbedtls_ssl_async_job;
+typedef struct mbedtls_ssl_async_engine mbedtls_ssl_async_engine;
+
+/**
+ * \brief          Worker thread of an asynchronous private key engine.
+ */
+typedef struct mbedtls_ssl_async_worker
+{
+    mbedtls_ssl_async_engine *engine;   /*!< engine of the worker       */
+    pthread_t thread;                   /*!< the thread itself          */
+    const mbedtls_pk_context *key;      /*!< key in use, or NULL        */
+}
+mbedtls_ssl_async_worker;
+
+/**
+ * \brief          Asynchronous private key engine.
+ */
+struct mbedtls_ssl_async_engine
+{
+    mbedtls_ssl_async_worker workers[MBEDTLS_SSL_ASYNC_ENGINE_MAX_WORKERS];
+    unsigned int worker_count;      /*!< number of running workers      */
+
+    mbedtls_threading_mutex_t mutex; /*!< protects the fields below and
+                                          the key of each worker        */
+    mbedtls_ssl_async_job *head;    /*!< oldest queued job              */
+    mbedtls_ssl_async_job *tail;    /*!< newest queued job              */
+    size_t queued;                  /*!< jobs waiting for a worker      */
+    size_t pending;                 /*!< jobs started, not yet resumed  */
+    size_t max_batch;               /*!< jobs a worker takes at once    */
+    int shutdown;                   /*!< workers must exit              */
+
+    int wake_fds[2];                /*!< one byte per worker wakeup     */
+    int read_fd;                    /*!< readable when jobs complete    */
+    int write_fd;                   /*!< written to by the workers      */
+
+    int (*f_rng)(void *, unsigned char *, size_t); /*!< RNG for the keys */
+    void *p_rng;                    /*!< context for the RNG function   */
+};
+
+/**
+ * \brief          Initialize an engine.
+ *
+ * \param engine   Engine to initialize
+ */
+void mbedtls_ssl_async_engine_init( mbedtls_ssl_async_engine *engine );
+
+/**
+ * \brief          Start the worker threads and create the completion
+ *                 descriptor.
+ *
+ * \param engine   Engine to set up
+ * \param workers  Number of worker threads, between 1 and
+ *                 MBEDTLS_SSL_ASYNC_ENGINE_MAX_WORKERS
+ * \param f_rng    RNG function used by the private key operations. It is
+ *                 called from the worker threads concurrently, so it must
+ *                 be thread-safe (for example mbedtls_ctr_drbg_random()
+ *                 with MBEDTLS_THREADING_C).
+ * \param p_rng    RNG parameter
+ *
+ * \return         0 if successful,
+ *                 MBEDTLS_ERR_SSL_BAD_INPUT_DATA if \p workers is invalid,
+ *                 or MBEDTLS_ERR_SSL_INTERNAL_ERROR if the threads or the
+ *                 descriptor could not be created.
+ */
+int mbedtls_ssl_async_engine_setup( mbedtls_ssl_async_engine *engine,
+                                    unsigned int workers,
+                                    int (*f_rng)(void *, unsigned char *, size_t),
+                                    void *p_rng );
+
+/**
+ * \brief          Set the maximum number of queued operations a worker
+ *                 takes and runs in one go (default:
+ *                 MBEDTLS_SSL_ASYNC_ENGINE_MAX_BATCH).
+ *
+ *                 When many handshakes are waiting, a worker takes several
+ *                 queued operations on the same key at once, runs them back
+ *                 to back, and signals their completion together. A worker
+ *                 never takes more than its share of the queue, so that
+ *                 idle workers are not starved. A value of 1 disables
+ *                 batching.
+ *
+ * \note           This must be called before mbedtls_ssl_async_engine_setup().
+ *
+ * \param engine   Engine
+ * \param max_batch Maximum batch size, between 1 and
+ *                 MBEDTLS_SSL_ASYNC_ENGINE_MAX_BATCH
+ *
+ * \return         0 if successful, or MBEDTLS_ERR_SSL_BAD_INPUT_DATA.
+ */
+int mbedtls_ssl_async_engine_set_batch( mbedtls_ssl_async_engine *engine,
+                                        size_t max_batch );
+
+/**
+ * \brief          Route the private key operations of a configuration to
+ *                 an engine.
+ *
+ *                 This calls mbedtls_ssl_conf_async_private_cb() with
+ *                 callbacks that perform the RSA and ECDSA signatures of
+ *                 the ServerKeyExchange and the RSA decryption of the
+ *                 ClientKeyExchange on the workers, using the key given to
+ *                 mbedtls_ssl_conf_own_cert() or selected by the SNI
+ *                 callback.
+ *
+ *                 While an operation is running, mbedtls_ssl_handshake()
+ *                 returns #MBEDTLS_ERR_SSL_ASYNC_IN_PROGRESS. The descriptor
+ *                 returned by mbedtls_ssl_async_engine_get_fd() becomes
+ *                 readable when an operation completes; the handshake of
+ *                 the connections waiting for the engine should then be
+ *                 called again.
+ *
+ * \note           Threading: the private keys are used from the worker
+ *                 threads while the handshake is suspended, but never by
+ *                 two workers at the same time. Operations on different
+ *                 keys run in parallel; operations on the same key run one
+ *                 after the other, in the order they were started. This is
+ *                 required because a key context is not safe for concurrent
+ *                 use: ECDSA fills the precomputed tables of its group on
+ *                 first use, and RSA serializes its private operations on
+ *                 the mutex of the context anyway. A key that carries more
+ *                 load than one worker can serve should be loaded several
+ *                 times, in the configurations of different listeners.
+ *
+ * \note           While the engine is running, the keys must not be freed
+ *                 or modified, and must not be used by other threads, for
+ *                 example by handshakes on configurations that do not use
+ *                 the engine.
+ *
+ * \note           Each SSL context must be driven by one thread at a time,
+ *                 as usual. The functions of this module other than
+ *                 mbedtls_ssl_async_engine_setup() and
+ *                 mbedtls_ssl_async_engine_free() may be called from
+ *                 several threads.
+ *
+ * \param conf     SSL configuration
+ * \param engine   Engine set up with mbedtls_ssl_async_engine_setup()
+ */
+void mbedtls_ssl_async_engine_conf( mbedtls_ssl_config *conf,
+                                    mbedtls_ssl_async_engine *engine );
+
+/**
+ * \brief          Return the completion descriptor of an engine.
+ *
+ *                 The descriptor is non-blocking and is suitable for
+ *                 poll(), select() or epoll. It is an eventfd on Linux and
+ *                 the read end of a pipe elsewhere.
+ *
+ * \param engine   Engine
+ *
+ * \return         The descriptor, or -1 if the engine is not set up.
+ */
+int mbedtls_ssl_async_engine_get_fd( const mbedtls_ssl_async_engine *engine );
+
+/**
+ * \brief          Consume the completion notifications, so that the
+ *                 descriptor is no longer readable until the next
+ *                 operation completes.
+ *
+ * \param engine   Engine
+ */
+void mbedtls_ssl_async_engine_ack( mbedtls_ssl_async_engine *engine );
+
+/**
+ * \brief          Return the number of operations started and not yet
+ *                 collected by a handshake or cancelled.
+ *
+ * \param engine   Engine
+ *
+ * \return         The number of pending operations.
+ */
+size_t mbedtls_ssl_async_engine_pending( mbedtls_ssl_async_engine *engine );
+
+/**
+ * \brief          Stop the workers and free the resources of an engine.
+ *
+ * \note           The SSL contexts using the engine must be freed or reset
+ *                 first.
+ *
+ * \param engine   Engine to free
+ */
+void mbedtls_ssl_async_engine_free( mbedtls_ssl_async_engine *engine );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ssl_async_engine.h */
@@ -0,0 +1,267 @@
+/**
+ * \file ssl_credentials.h
+ *
+ * \brief Reference-counted certificates and keys shared between
+ *        configurations
+ */
+/*
+ *  Copyright (C) 2006-2019, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *  This file is part of mbed TLS (https://tls.mbed.org)
+ */
+#ifndef MBEDTLS_SSL_CREDENTIALS_H
+#define MBEDTLS_SSL_CREDENTIALS_H
+
+#if !defined(MBEDTLS_CONFIG_FILE)
+#include "mbedtls/config.h"
+#else
+#include MBEDTLS_CONFIG_FILE
+#endif
+
+#include "mbedtls/ssl.h"
+
+#if defined(MBEDTLS_THREADING_C)
+#include "mbedtls/threading.h"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(MBEDTLS_SSL_CREDENTIALS_C) && defined(MBEDTLS_X509_CRT_PARSE_C)
+
+/**
+ * \brief          Own certificates and keys, trusted CAs and CRLs, owned
+ *                 and freed together.
+ *
+ *                 A credentials object is filled once, then attached to one
+ *                 or more configurations with mbedtls_ssl_conf_credentials().
+ *                 From then on it is immutable, and each handshake holds a
+ *                 reference to the credentials it started with, so that
+ *                 they can be replaced while handshakes are running.
+ */
+struct mbedtls_ssl_credentials
+{
+    mbedtls_ssl_key_cert *key_cert;     /*!< own key/cert pairs, owned      */
+    mbedtls_x509_crt ca_chain;          /*!< trusted CAs                    */
+#if defined(MBEDTLS_X509_CRL_PARSE_C)
+    mbedtls_x509_crl ca_crl;            /*!< trusted CAs CRLs               */
+#endif
+    unsigned int refs;                  /*!< number of references           */
+    int frozen;                         /*!< attached to a configuration    */
+
+#if defined(MBEDTLS_THREADING_C)
+    mbedtls_threading_mutex_t mutex;    /*!< protects refs and frozen       */
+#endif
+};
+
+/**
+ * \brief          Allocate an empty credentials object.
+ *
+ * \param creds    Where to store the new object, which holds one reference
+ *                 owned by the caller
+ *
+ * \return         0 if successful, or MBEDTLS_ERR_SSL_ALLOC_FAILED.
+ */
+int mbedtls_ssl_credentials_new( mbedtls_ssl_credentials **creds );
+
+/**
+ * \brief          Drop a reference to a credentials object. The object and
+ *                 all its certificates and keys are freed with the last
+ *                 reference.
+ *
+ * \param creds    Credentials, or NULL
+ */
+void mbedtls_ssl_credentials_release( mbedtls_ssl_credentials *creds );
+
+/**
+ * \brief          Parse a certificate chain and its private key and add
+ *                 them to the own certificates.
+ *
+ *                 As with mbedtls_ssl_conf_own_cert(), several pairs may be
+ *                 added (for example an RSA and an ECDSA certificate), and
+ *                 the handshake picks one.
+ *
+ * \param creds    Credentials not yet attached to a configuration
+ * \param crt      Certificate chain, PEM or DER (PEM must be
+ *                 null-terminated, with the terminator counted in
+ *                 \p crt_len)
+ * \param crt_len  Length of \p crt
+ * \param key      Private key, PEM or DER, as for mbedtls_pk_parse_key()
+ * \param key_len  Length of \p key
+ * \param pwd      Password of the key, or NULL
+ * \param pwd_len  Length of \p pwd
+ *
+ * \return         0 if successful, MBEDTLS_ERR_SSL_BAD_INPUT_DATA if the
+ *                 credentials are already attached, or a parsing or
+ *                 allocation error.
+ */
+int mbedtls_ssl_credentials_add_own_cert( mbedtls_ssl_credentials *creds,
+                                          const unsigned char *crt,
+                                          size_t crt_len,
+                                          const unsigned char *key,
+                                          size_t key_len,
+                                          const unsigned char *pwd,
+                                          size_t pwd_len );
+
+/**
+ * \brief          Parse certificates and add them to the trusted CAs.
+ *
+ *                 If no CA is added, handshakes use the CA chain or the CA
+ *                 callback of the configuration.
+ *
+ * \param creds    Credentials not yet attached to a configuration
+ * \param buf      Certificates, as for mbedtls_x509_crt_parse()
+ * \param len      Length of \p buf
+ *
+ * \return         0 if successful, MBEDTLS_ERR_SSL_BAD_INPUT_DATA if the
+ *                 credentials are already attached, or a parsing error.
+ */
+int mbedtls_ssl_credentials_add_ca( mbedtls_ssl_credentials *creds,
+                                    const unsigned char *buf, size_t len );
+
+#if defined(MBEDTLS_X509_CRL_PARSE_C)
+/**
+ * \brief          Parse CRLs and add them to the CRLs of the trusted CAs.
+ *
+ * \param creds    Credentials not yet attached to a configuration
+ * \param buf      CRLs, as for mbedtls_x509_crl_parse()
+ * \param len      Length of \p buf
+ *
+ * \return         0 if successful, MBEDTLS_ERR_SSL_BAD_INPUT_DATA if the
+ *                 credentials are already attached, or a parsing error.
+ */
+int mbedtls_ssl_credentials_add_crl( mbedtls_ssl_credentials *creds,
+                                     const unsigned char *buf, size_t len );
+#endif /* MBEDTLS_X509_CRL_PARSE_C */
+
+#if defined(MBEDTLS_FS_IO)
+/**
+ * \brief          Same as mbedtls_ssl_credentials_add_own_cert(), reading
+ *                 the chain and the key from files.
+ *
+ * \param creds    Credentials not yet attached to a configuration
+ * \param crt_path Certificate chain file
+ * \param key_path Private key file
+ * \param pwd      Password of the key, null-terminated, or NULL
+ *
+ * \return         0 if successful, MBEDTLS_ERR_SSL_BAD_INPUT_DATA if the
+ *                 credentials are already attached, or a parsing or
+ *                 file error.
+ */
+int mbedtls_ssl_credentials_add_own_cert_file( mbedtls_ssl_credentials *creds,
+                                               const char *crt_path,
+                                               const char *key_path,
+                                               const char *pwd );
+
+/**
+ * \brief          Same as mbedtls_ssl_credentials_add_ca(), reading the
+ *                 certificates from a file.
+ *
+ * \param creds    Credentials not yet attached to a configuration
+ * \param path     Certificate file
+ *
+ * \return         0 if successful, MBEDTLS_ERR_SSL_BAD_INPUT_DATA if the
+ *                 credentials are already attached, or a parsing or
+ *                 file error.
+ */
+int mbedtls_ssl_credentials_add_ca_file( mbedtls_ssl_credentials *creds,
+                                         const char *path );
+
+/**
+ * \brief          Same as mbedtls_ssl_credentials_add_ca(), reading the
+ *                 certificates from all the files of a directory, as
+ *                 mbedtls_x509_crt_parse_path() does.
+ *
+ * \param creds    Credentials not yet attached to a configuration
+ * \param path     Directory
+ *
+ * \return         0 if successful, MBEDTLS_ERR_SSL_BAD_INPUT_DATA if the
+ *                 credentials are already attached, or a parsing or
+ *                 file error.
+ */
+int mbedtls_ssl_credentials_add_ca_path( mbedtls_ssl_credentials *creds,
+                                         const char *path );
+
+#if defined(MBEDTLS_X509_CRL_PARSE_C)
+/**
+ * \brief          Same as mbedtls_ssl_credentials_add_crl(), reading the
+ *                 CRLs from a file.
+ *
+ * \param creds    Credentials not yet attached to a configuration
+ * \param path     CRL file
+ *
+ * \return         0 if successful, MBEDTLS_ERR_SSL_BAD_INPUT_DATA if the
+ *                 credentials are already attached, or a parsing or
+ *                 file error.
+ */
+int mbedtls_ssl_credentials_add_crl_file( mbedtls_ssl_credentials *creds,
+                                          const char *path );
+#endif /* MBEDTLS_X509_CRL_PARSE_C */
+#endif /* MBEDTLS_FS_IO */
+
+/**
+ * \brief          Attach credentials to a configuration, replacing the
+ *                 ones attached before, if any.
+ *
+ *                 The configuration takes its own reference, so the caller
+ *                 may release its reference afterwards, and drops the
+ *                 reference to the previous credentials. Handshakes that
+ *                 start afterwards use the new credentials, including
+ *                 those of contexts that were set up or reset before and
+ *                 have not started their handshake yet; handshakes in
+ *                 progress keep the ones they started with, which are freed
+ *                 when the last of them ends.
+ *
+ *                 The own certificates of the credentials, if any, are used
+ *                 in place of those given to mbedtls_ssl_conf_own_cert(),
+ *                 and their trusted CAs, if any, in place of those given to
+ *                 mbedtls_ssl_conf_ca_chain(). A CA callback set with
+ *                 mbedtls_ssl_conf_ca_cb() and certificates selected by the
+ *                 SNI callback still take precedence.
+ *
+ * \note           This may be called while the configuration is used by
+ *                 handshakes in other threads. The credentials can no
+ *                 longer be modified once attached.
+ *
+ * \param conf     SSL configuration
+ * \param creds    Credentials, or NULL to detach the current ones
+ *
+ * \return         0 if successful, or MBEDTLS_ERR_SSL_INTERNAL_ERROR if
+ *                 a mutex operation failed.
+ */
+int mbedtls_ssl_conf_credentials( mbedtls_ssl_config *conf,
+                                  mbedtls_ssl_credentials *creds );
+
+/**
+ * \brief          Return a new reference to the credentials attached to a
+ *                 configuration.
+ *
+ * \param conf     SSL configuration
+ *
+ * \return         The credentials, to be released with
+ *                 mbedtls_ssl_credentials_release(), or NULL if none are
+ *                 attached.
+ */
+mbedtls_ssl_credentials *mbedtls_ssl_conf_get_credentials( const mbedtls_ssl_config *conf );
+
+#endif /* MBEDTLS_SSL_CREDENTIALS_C && MBEDTLS_X509_CRT_PARSE_C */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ssl_credentials.h */
@@ -33,6 +33,10 @@
 #include "mbedtls/ssl.h"
 #include "mbedtls/cipher.h"
 
+#if defined(MBEDTLS_SSL_CREDENTIALS_C)
+#include "mbedtls/ssl_credentials.h"
+#endif
+
 #if defined(MBEDTLS_USE_PSA_CRYPTO)
 #include "psa/crypto.h"
 #endif
@@ -116,6 +120,17 @@
 #define MBEDTLS_SSL__ECP_RESTARTABLE
 #endif
 
+/* Shorthands for the PRFs computed with the HMAC state of ssl_tls.c */
+#if defined(MBEDTLS_SSL_PROTO_TLS1_2) && \
+    !defined(MBEDTLS_USE_PSA_CRYPTO) && \
+    ( defined(MBEDTLS_SHA256_C) || defined(MBEDTLS_SHA512_C) )
+#define MBEDTLS_SSL__PRF_HMAC_TLS1_2
+#endif
+#if defined(MBEDTLS_SSL_PROTO_TLS1) || defined(MBEDTLS_SSL_PROTO_TLS1_1) || \
+    defined(MBEDTLS_SSL__PRF_HMAC_TLS1_2)
+#define MBEDTLS_SSL__PRF_HMAC
+#endif
+
 #define MBEDTLS_SSL_INITIAL_HANDSHAKE           0
 #define MBEDTLS_SSL_RENEGOTIATION_IN_PROGRESS   1   /* In progress */
 #define MBEDTLS_SSL_RENEGOTIATION_DONE          2   /* Done or aborted */
@@ -134,6 +149,13 @@
 #define MBEDTLS_SSL_RETRANS_WAITING         2
 #define MBEDTLS_SSL_RETRANS_FINISHED        3
 
+/*
+ * Round-trip time measurement states of the current outgoing flight
+ */
+#define MBEDTLS_SSL_FLIGHT_TIMING_NONE      0
+#define MBEDTLS_SSL_FLIGHT_TIMING_PENDING   1
+#define MBEDTLS_SSL_FLIGHT_TIMING_RUNNING   2
+
 /*
  * Allow extra bytes for record, authentication and encryption overhead:
  * counter (8) + header (5) + IV(16) + MAC (16-48) + padding (0-256)
@@ -299,6 +321,44 @@ typedef int  mbedtls_ssl_tls_prf_cb( const unsigned char *secret, size_t slen,
                                      const char *label,
                                      const unsigned char *random, size_t rlen,
                                      unsigned char *dstbuf, size_t dlen );
+
+#if defined(MBEDTLS_SSL__PRF_HMAC)
+/*
+ * Digest state of one of the hashes used by the PRFs.
+ */
+typedef union
+{
+#if defined(MBEDTLS_MD5_C)
+    mbedtls_md5_context md5;
+#endif
+#if defined(MBEDTLS_SHA1_C)
+    mbedtls_sha1_context sha1;
+#endif
+#if defined(MBEDTLS_SHA256_C)
+    mbedtls_sha256_context sha256;
+#endif
+#if defined(MBEDTLS_SHA512_C)
+    mbedtls_sha512_context sha512;
+#endif
+}
+mbedtls_ssl_prf_digest;
+
+/*
+ * HMAC keyed with a PRF secret: the digest states after absorbing the
+ * inner and outer padded keys. Each HMAC computed with it starts from a
+ * copy of these states, so the key is processed once per secret and no
+ * memory is allocated.
+ */
+typedef struct
+{
+    mbedtls_md_type_t md_type;          /*!<  hash of the HMAC          */
+    size_t md_len;                      /*!<  output length of the hash */
+    mbedtls_ssl_prf_digest inner;       /*!<  state after K ^ ipad      */
+    mbedtls_ssl_prf_digest outer;       /*!<  state after K ^ opad      */
+}
+mbedtls_ssl_prf_hmac;
+#endif /* MBEDTLS_SSL__PRF_HMAC */
+
 /*
  * This structure contains the parameters only needed during handshake.
  */
@@ -349,9 +409,16 @@ struct mbedtls_ssl_handshake_params
 #if defined(MBEDTLS_SSL_SERVER_NAME_INDICATION)
     int sni_authmode;                   /*!< authmode from SNI callback     */
     mbedtls_ssl_key_cert *sni_key_cert; /*!< key/cert list from SNI         */
+    int sni_key_cert_shared;            /*!< sni_key_cert is not ours       */
+    void (*f_sni_release)(void *);      /*!< called when the handshake ends */
+    void *p_sni_release;                /*!< context for f_sni_release      */
     mbedtls_x509_crt *sni_ca_chain;     /*!< trusted CAs from SNI callback  */
     mbedtls_x509_crl *sni_ca_crl;       /*!< trusted CAs CRLs from SNI      */
 #endif /* MBEDTLS_SSL_SERVER_NAME_INDICATION */
+#if defined(MBEDTLS_SSL_CREDENTIALS_C)
+    mbedtls_ssl_credentials *credentials; /*!< credentials of the config
+                                               when the handshake started */
+#endif
 #endif /* MBEDTLS_X509_CRT_PARSE_C */
 #if defined(MBEDTLS_SSL__ECP_RESTARTABLE)
     int ecrs_enabled;                   /*!< Handshake supports EC restart? */
@@ -381,6 +448,13 @@ struct mbedtls_ssl_handshake_params
 
     uint32_t retransmit_timeout;        /*!<  Current value of timeout       */
     unsigned char retransmit_state;     /*!<  Retransmission state           */
+    unsigned char flight_timing;        /*!<  Round-trip time measurement
+                                              state of the current flight    */
+    unsigned char rtt_valid;            /*!<  srtt and rttvar are set        */
+    uint32_t flight_start;              /*!<  Clock at the first transmission
+                                              of the current flight          */
+    uint32_t srtt;                      /*!<  Smoothed round-trip time (ms)  */
+    uint32_t rttvar;                    /*!<  Round-trip time variation (ms) */
     mbedtls_ssl_flight_item *flight;    /*!<  Current outgoing flight        */
     mbedtls_ssl_flight_item *cur_msg;   /*!<  Current message in flight      */
     unsigned char *cur_msg_p;           /*!<  Position in current message    */
@@ -405,8 +479,12 @@ struct mbedtls_ssl_handshake_params
 
     struct
     {
-        size_t total_bytes_buffered; /*!< Cumulative size of heap allocated
-                                      *   buffers used for message buffering. */
+        unsigned char *pool;         /*!< Storage for all the buffers below,
+                                      *   of size MBEDTLS_SSL_DTLS_MAX_BUFFERING
+                                      *   and allocated on first use.       */
+        size_t total_bytes_buffered; /*!< Cumulative size of the buffers
+                                      *   taken from \c pool for message
+                                      *   buffering.                        */
 
         uint8_t seen_ccs;               /*!< Indicates if a CCS message has
                                          *   been seen in the current flight. */
@@ -461,6 +539,10 @@ struct mbedtls_ssl_handshake_params
     void (*calc_verify)(const mbedtls_ssl_context *, unsigned char *, size_t *);
     void (*calc_finished)(mbedtls_ssl_context *, unsigned char *, int);
     mbedtls_ssl_tls_prf_cb *tls_prf;
+#if defined(MBEDTLS_SSL__PRF_HMAC_TLS1_2)
+    mbedtls_ssl_prf_hmac prf_master;    /*!<  PRF keyed with the master */
+    int prf_master_ready;               /*!<  prf_master is keyed       */
+#endif
 
     mbedtls_ssl_ciphersuite_t const *ciphersuite_info;
 
@@ -474,6 +556,7 @@ struct mbedtls_ssl_handshake_params
     int max_major_ver;                  /*!< max. major version client*/
     int max_minor_ver;                  /*!< max. minor version client*/
     int cli_exts;                       /*!< client extension presence*/
+    size_t io_bytes;                    /*!< bytes sent and received  */
 
 #if defined(MBEDTLS_SSL_SESSION_TICKETS)
     int new_session_ticket;             /*!< use NewSessionTicket?    */
@@ -494,6 +577,12 @@ struct mbedtls_ssl_handshake_params
      * The library does not use it internally. */
     void *user_async_ctx;
 #endif /* MBEDTLS_SSL_ASYNC_PRIVATE */
+
+#if defined(MBEDTLS_SSL_ASYNC_VERIFY)
+    mbedtls_x509_crt *async_verify_chain;   /*!< peer chain being verified  */
+    void *async_verify_op;                  /*!< verifier operation context */
+    unsigned int async_verify_in_progress : 1; /*!< verification pending    */
+#endif /* MBEDTLS_SSL_ASYNC_VERIFY */
 };
 
 typedef struct mbedtls_ssl_hs_buffer mbedtls_ssl_hs_buffer;
@@ -728,6 +817,13 @@ struct mbedtls_ssl_key_cert
     mbedtls_x509_crt *cert;                 /*!< cert                       */
     mbedtls_pk_context *key;                /*!< private key                */
     mbedtls_ssl_key_cert *next;             /*!< next key/cert pair         */
+
+    unsigned char *chain_buf;               /*!< certificates of the
+                                                 Certificate message, each
+                                                 with its length, encoded
+                                                 when the pair is configured,
+                                                 or NULL                    */
+    size_t chain_len;                       /*!< length of chain_buf        */
 };
 #endif /* MBEDTLS_X509_CRT_PARSE_C */
 
@@ -916,6 +1012,43 @@ int mbedtls_ssl_check_sig_hash( const mbedtls_ssl_context *ssl,
 #endif
 
 #if defined(MBEDTLS_X509_CRT_PARSE_C)
+/*
+ * Own key/cert list and trusted CAs of the configuration, taken from the
+ * credentials the handshake started with, if any
+ */
+static inline mbedtls_ssl_key_cert *mbedtls_ssl_default_key_cert( const mbedtls_ssl_context *ssl )
+{
+#if defined(MBEDTLS_SSL_CREDENTIALS_C)
+    if( ssl->handshake != NULL && ssl->handshake->credentials != NULL &&
+        ssl->handshake->credentials->key_cert != NULL )
+        return( ssl->handshake->credentials->key_cert );
+#endif
+
+    return( ssl->conf->key_cert );
+}
+
+static inline mbedtls_x509_crt *mbedtls_ssl_default_ca_chain( const mbedtls_ssl_context *ssl,
+                                                              mbedtls_x509_crl **ca_crl )
+{
+#if defined(MBEDTLS_SSL_CREDENTIALS_C)
+    if( ssl->handshake != NULL && ssl->handshake->credentials != NULL &&
+        ssl->handshake->credentials->ca_chain.version != 0 )
+    {
+#if defined(MBEDTLS_X509_CRL_PARSE_C)
+        if( ssl->handshake->credentials->ca_crl.version != 0 )
+            *ca_crl = &ssl->handshake->credentials->ca_crl;
+        else
+#endif
+            *ca_crl = NULL;
+
+        return( &ssl->handshake->credentials->ca_chain );
+    }
+#endif
+
+    *ca_crl = ssl->conf->ca_crl;
+    return( ssl->conf->ca_chain );
+}
+
 static inline mbedtls_pk_context *mbedtls_ssl_own_key( mbedtls_ssl_context *ssl )
 {
     mbedtls_ssl_key_cert *key_cert;
@@ -923,11 +1056,19 @@ static inline mbedtls_pk_context *mbedtls_ssl_own_key( mbedtls_ssl_context *ssl
     if( ssl->handshake != NULL && ssl->handshake->key_cert != NULL )
         key_cert = ssl->handshake->key_cert;
     else
-        key_cert = ssl->conf->key_cert;
+        key_cert = mbedtls_ssl_default_key_cert( ssl );
 
     return( key_cert == NULL ? NULL : key_cert->key );
 }
 
+static inline mbedtls_ssl_key_cert *mbedtls_ssl_own_key_cert( mbedtls_ssl_context *ssl )
+{
+    if( ssl->handshake != NULL && ssl->handshake->key_cert != NULL )
+        return( ssl->handshake->key_cert );
+
+    return( mbedtls_ssl_default_key_cert( ssl ) );
+}
+
 static inline mbedtls_x509_crt *mbedtls_ssl_own_cert( mbedtls_ssl_context *ssl )
 {
     mbedtls_ssl_key_cert *key_cert;
@@ -935,7 +1076,7 @@ static inline mbedtls_x509_crt *mbedtls_ssl_own_cert( mbedtls_ssl_context *ssl )
     if( ssl->handshake != NULL && ssl->handshake->key_cert != NULL )
         key_cert = ssl->handshake->key_cert;
     else
-        key_cert = ssl->conf->key_cert;
+        key_cert = mbedtls_ssl_default_key_cert( ssl );
 
     return( key_cert == NULL ? NULL : key_cert->cert );
 }
@@ -953,6 +1094,35 @@ int mbedtls_ssl_check_cert_usage( const mbedtls_x509_crt *cert,
                           const mbedtls_ssl_ciphersuite_t *ciphersuite,
                           int cert_endpoint,
                           uint32_t *flags );
+
+/*
+ * Append a key/cert pair to a list, and free a list without freeing the
+ * certificates and keys it points to. The pairs appended with
+ * mbedtls_ssl_key_cert_append() carry the encoding of their chain for the
+ * Certificate message, so the list should outlive several handshakes.
+ */
+int mbedtls_ssl_key_cert_append( mbedtls_ssl_key_cert **head,
+                                 mbedtls_x509_crt *cert,
+                                 mbedtls_pk_context *key );
+void mbedtls_ssl_key_cert_free( mbedtls_ssl_key_cert *key_cert );
+
+#if defined(MBEDTLS_SSL_SERVER_NAME_INDICATION)
+/*
+ * Use a key/cert list owned by the caller for the current handshake, in
+ * place of the pairs given with mbedtls_ssl_set_hs_own_cert(). The list
+ * must outlive the handshake.
+ */
+void mbedtls_ssl_set_hs_key_cert_list( mbedtls_ssl_context *ssl,
+                                       mbedtls_ssl_key_cert *key_cert );
+
+/*
+ * Call f_release( p_release ) when the handshake ends, to let the SNI
+ * callback reclaim the certificates and keys it lent to the handshake.
+ */
+void mbedtls_ssl_set_hs_sni_release( mbedtls_ssl_context *ssl,
+                                     void (*f_release)(void *),
+                                     void *p_release );
+#endif /* MBEDTLS_SSL_SERVER_NAME_INDICATION */
 #endif /* MBEDTLS_X509_CRT_PARSE_C */
 
 void mbedtls_ssl_write_version( int major, int minor, int transport,
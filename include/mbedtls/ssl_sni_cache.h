@@ -0,0 +1,248 @@
+/**
+ * \file ssl_sni_cache.h
+ *
+ * \brief On-demand loading of the server certificates selected by SNI
+ */
+/*
+ *  Copyright (C) 2006-2019, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *  This file is part of mbed TLS (https://tls.mbed.org)
+ */
+#ifndef MBEDTLS_SSL_SNI_CACHE_H
+#define MBEDTLS_SSL_SNI_CACHE_H
+
+#if !defined(MBEDTLS_CONFIG_FILE)
+#include "mbedtls/config.h"
+#else
+#include MBEDTLS_CONFIG_FILE
+#endif
+
+#include "mbedtls/ssl.h"
+
+#if defined(MBEDTLS_THREADING_C)
+#include "mbedtls/threading.h"
+#endif
+
+/**
+ * \name SECTION: Module settings
+ *
+ * The configuration options you can set for this module are in this section.
+ * Either change them in config.h or define them on the compiler command line.
+ * \{
+ */
+
+#if !defined(MBEDTLS_SSL_SNI_CACHE_DEFAULT_MAX_ENTRIES)
+#define MBEDTLS_SSL_SNI_CACHE_DEFAULT_MAX_ENTRIES   1024   /*!< Maximum parsed hostnames kept */
+#endif
+
+/* \} name SECTION: Module settings */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * \brief          Encoded certificate chain and private key of a hostname,
+ *                 as returned by a provider.
+ */
+typedef struct mbedtls_ssl_sni_source
+{
+    const unsigned char *chain; /*!< DER certificates, concatenated, leaf
+                                     first. The buffer is referenced by the
+                                     parsed chain, not copied.              */
+    size_t chain_len;           /*!< length of chain                        */
+    const unsigned char *key;   /*!< private key, DER or PEM; PEM must be
+                                     null-terminated                        */
+    size_t key_len;             /*!< length of key, including the null
+                                     terminator for PEM                     */
+    void *handle;               /*!< opaque value for the provider          */
+}
+mbedtls_ssl_sni_source;
+
+/**
+ * \brief          Provider callback: find the certificate chain and key of
+ *                 a hostname.
+ *
+ * \param p_provider Context of the provider
+ * \param hostname Hostname sent by the client, not null-terminated
+ * \param len      Length of the hostname
+ * \param source   Structure to fill. The buffers must stay valid until
+ *                 the release callback is called for \p source.
+ *
+ * \return         0 if successful, or non-zero if the hostname is unknown
+ *                 or cannot be loaded.
+ */
+typedef int mbedtls_ssl_sni_lookup_t( void *p_provider,
+                                      const unsigned char *hostname,
+                                      size_t len,
+                                      mbedtls_ssl_sni_source *source );
+
+/**
+ * \brief          Provider callback: release the buffers of a source
+ *                 returned by the lookup callback.
+ *
+ * \param p_provider Context of the provider
+ * \param source   Source filled by the lookup callback
+ */
+typedef void mbedtls_ssl_sni_release_t( void *p_provider,
+                                        mbedtls_ssl_sni_source *source );
+
+typedef struct mbedtls_ssl_sni_cache_entry mbedtls_ssl_sni_cache_entry;
+
+/**
+ * \brief          Cache of the certificates and keys loaded on demand.
+ */
+typedef struct mbedtls_ssl_sni_cache
+{
+    mbedtls_ssl_sni_lookup_t *f_lookup;     /*!< provider lookup            */
+    mbedtls_ssl_sni_release_t *f_release;   /*!< provider release           */
+    void *p_provider;                       /*!< context of the provider    */
+
+    mbedtls_ssl_sni_cache_entry **buckets;  /*!< hash table of the entries  */
+    size_t size;                            /*!< number of buckets          */
+    mbedtls_ssl_sni_cache_entry *lru_head;  /*!< most recently used entry   */
+    mbedtls_ssl_sni_cache_entry *lru_tail;  /*!< least recently used entry  */
+    size_t entries;                         /*!< number of entries          */
+    size_t max_entries;                     /*!< entries kept when unused   */
+
+#if defined(MBEDTLS_THREADING_C)
+    mbedtls_threading_mutex_t mutex;        /*!< protects the fields above  */
+#endif
+}
+mbedtls_ssl_sni_cache;
+
+/**
+ * \brief          Initialize a cache.
+ *
+ * \param cache    Cache to initialize
+ */
+void mbedtls_ssl_sni_cache_init( mbedtls_ssl_sni_cache *cache );
+
+/**
+ * \brief          Set the provider of a cache and allocate its table.
+ *
+ *                 When a client sends a hostname that is not in the
+ *                 cache, \p f_lookup is called and the chain and key it
+ *                 returns are parsed and kept. When more than
+ *                 \p max_entries hostnames are cached, the least recently
+ *                 used ones that no handshake is using are dropped and
+ *                 their source released with \p f_release.
+ *
+ * \param cache    Cache
+ * \param f_lookup Lookup callback
+ * \param f_release Release callback, or NULL
+ * \param p_provider Context of the provider
+ * \param max_entries Maximum number of hostnames kept when no handshake
+ *                 uses them (0 means MBEDTLS_SSL_SNI_CACHE_DEFAULT_MAX_ENTRIES)
+ *
+ * \return         0 if successful, or MBEDTLS_ERR_SSL_ALLOC_FAILED.
+ */
+int mbedtls_ssl_sni_cache_setup( mbedtls_ssl_sni_cache *cache,
+                                 mbedtls_ssl_sni_lookup_t *f_lookup,
+                                 mbedtls_ssl_sni_release_t *f_release,
+                                 void *p_provider,
+                                 size_t max_entries );
+
+/**
+ * \brief          SNI callback using the certificates of the cache.
+ *
+ *                 Use it with mbedtls_ssl_conf_sni( conf,
+ *                 mbedtls_ssl_sni_cache_get, &cache ).
+ *
+ *                 The entry of the hostname is kept in the cache until the
+ *                 end of the handshake. The provider is called without
+ *                 holding the lock of the cache, so a slow lookup only
+ *                 delays the handshakes waiting for it.
+ *
+ * \note           When MBEDTLS_SSL_ASYNC_PRIVATE is used, the private key
+ *                 of a cancelled handshake may still be in use by the
+ *                 asynchronous callbacks when the entry is released.
+ *                 Cancelled operations must complete before their key is
+ *                 dropped, or the cache must be large enough to hold every
+ *                 hostname in use.
+ *
+ * \param p_cache  Cache
+ * \param ssl      SSL context in the handshake
+ * \param hostname Hostname sent by the client, not null-terminated
+ * \param len      Length of the hostname
+ *
+ * \return         0 if the hostname was found, or a non-zero value
+ *                 otherwise, which aborts the handshake with an
+ *                 unrecognized_name alert.
+ */
+int mbedtls_ssl_sni_cache_get( void *p_cache,
+                               mbedtls_ssl_context *ssl,
+                               const unsigned char *hostname,
+                               size_t len );
+
+/**
+ * \brief          Free a cache and release all its sources.
+ *
+ * \note           No handshake may be using the cache.
+ *
+ * \param cache    Cache to free
+ */
+void mbedtls_ssl_sni_cache_free( mbedtls_ssl_sni_cache *cache );
+
+#if defined(MBEDTLS_FS_IO)
+/**
+ * \brief          Provider reading the chain and key of each hostname
+ *                 from a directory.
+ *
+ *                 For the hostname "www.example.com", the chain is read
+ *                 from "<dir>/www.example.com.der" (DER certificates,
+ *                 concatenated, leaf first) and the key from
+ *                 "<dir>/www.example.com.key". Hostnames are lowercased,
+ *                 and names with characters other than letters, digits,
+ *                 '-' and '.', or starting with '.', are rejected without
+ *                 accessing the file system.
+ *
+ *                 On Unix systems the files are mapped into memory, so the
+ *                 parsed chain points into the page cache rather than into
+ *                 a copy.
+ *
+ *                 Use it with mbedtls_ssl_sni_cache_setup( cache,
+ *                 mbedtls_ssl_sni_file_lookup, mbedtls_ssl_sni_file_release,
+ *                 (void *) dir, max_entries ).
+ *
+ * \param p_dir    Directory name, null-terminated, without trailing '/'
+ * \param hostname Hostname sent by the client
+ * \param len      Length of the hostname
+ * \param source   Structure to fill
+ *
+ * \return         0 if successful, or MBEDTLS_ERR_SSL_BAD_INPUT_DATA if the
+ *                 hostname is invalid or its files cannot be read.
+ */
+int mbedtls_ssl_sni_file_lookup( void *p_dir,
+                                 const unsigned char *hostname,
+                                 size_t len,
+                                 mbedtls_ssl_sni_source *source );
+
+/**
+ * \brief          Release callback of mbedtls_ssl_sni_file_lookup().
+ *
+ * \param p_dir    Directory name
+ * \param source   Source filled by mbedtls_ssl_sni_file_lookup()
+ */
+void mbedtls_ssl_sni_file_release( void *p_dir,
+                                   mbedtls_ssl_sni_source *source );
+#endif /* MBEDTLS_FS_IO */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ssl_sni_cache.h */
@@ -0,0 +1,167 @@
+/**
+ * \file ssl_sni_registry.h
+ *
+ * \brief Selection of the server certificate by hostname
+ */
+/*
+ *  Copyright (C) 2006-2019, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *  This file is part of mbed TLS (https://tls.mbed.org)
+ */
+#ifndef MBEDTLS_SSL_SNI_REGISTRY_H
+#define MBEDTLS_SSL_SNI_REGISTRY_H
+
+#if !defined(MBEDTLS_CONFIG_FILE)
+#include "mbedtls/config.h"
+#else
+#include MBEDTLS_CONFIG_FILE
+#endif
+
+#include "mbedtls/ssl.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(MBEDTLS_SSL_SNI_REGISTRY_C) && defined(MBEDTLS_X509_CRT_PARSE_C)
+
+typedef struct mbedtls_ssl_sni_entry mbedtls_ssl_sni_entry;
+
+/**
+ * \brief          Hostname registry.
+ *
+ *                 Exact hostnames and wildcard names ("*.example.com") are
+ *                 kept in two hash tables, so that finding the certificates
+ *                 for the name sent by a client takes at most two lookups,
+ *                 whatever the number of hostnames served.
+ */
+typedef struct mbedtls_ssl_sni_registry
+{
+    mbedtls_ssl_sni_entry **exact;      /*!< buckets of exact hostnames     */
+    mbedtls_ssl_sni_entry **wildcard;   /*!< buckets of wildcard suffixes   */
+    size_t exact_size;                  /*!< number of exact buckets        */
+    size_t wildcard_size;               /*!< number of wildcard buckets     */
+    size_t exact_count;                 /*!< number of exact hostnames      */
+    size_t wildcard_count;              /*!< number of wildcard names       */
+}
+mbedtls_ssl_sni_registry;
+
+/**
+ * \brief          Initialize a registry.
+ *
+ * \param registry Registry to initialize
+ */
+void mbedtls_ssl_sni_registry_init( mbedtls_ssl_sni_registry *registry );
+
+/**
+ * \brief          Add a certificate and private key for a hostname.
+ *
+ *                 The hostname is matched without regard to case. A name
+ *                 starting with "*." matches any hostname with one more
+ *                 label, as in a certificate; exact names take precedence
+ *                 over wildcards.
+ *
+ *                 Adding several pairs for a hostname (for example an RSA
+ *                 and an ECDSA certificate) offers them all to the
+ *                 handshake, which picks one as with
+ *                 mbedtls_ssl_set_hs_own_cert().
+ *
+ * \note           The registry does not copy the certificate and the key,
+ *                 which must outlive it. Entries must not be added while
+ *                 the registry is used by handshakes.
+ *
+ * \param registry Registry
+ * \param hostname Hostname or wildcard name, null-terminated
+ * \param own_cert Certificate chain for the hostname
+ * \param pk_key   Private key of the first certificate of the chain
+ *
+ * \return         0 if successful,
+ *                 MBEDTLS_ERR_SSL_BAD_INPUT_DATA if the name is empty or
+ *                 longer than MBEDTLS_SSL_MAX_HOST_NAME_LEN,
+ *                 or MBEDTLS_ERR_SSL_ALLOC_FAILED.
+ */
+int mbedtls_ssl_sni_registry_add( mbedtls_ssl_sni_registry *registry,
+                                  const char *hostname,
+                                  mbedtls_x509_crt *own_cert,
+                                  mbedtls_pk_context *pk_key );
+
+/**
+ * \brief          Set the trusted CAs and the client authentication mode
+ *                 for a hostname already added to the registry.
+ *
+ * \note           Same as mbedtls_ssl_set_hs_ca_chain() and
+ *                 mbedtls_ssl_set_hs_authmode(), applied to the handshakes
+ *                 selecting this hostname.
+ *
+ * \param registry Registry
+ * \param hostname Hostname or wildcard name, as given to
+ *                 mbedtls_ssl_sni_registry_add()
+ * \param ca_chain Trusted CA chain, or NULL to keep the one of the
+ *                 configuration
+ * \param ca_crl   Trusted CA CRLs
+ * \param authmode MBEDTLS_SSL_VERIFY_NONE, MBEDTLS_SSL_VERIFY_OPTIONAL,
+ *                 MBEDTLS_SSL_VERIFY_REQUIRED, or
+ *                 MBEDTLS_SSL_VERIFY_UNSET to keep the one of the
+ *                 configuration
+ *
+ * \return         0 if successful, or MBEDTLS_ERR_SSL_BAD_INPUT_DATA if
+ *                 the hostname is not in the registry.
+ */
+int mbedtls_ssl_sni_registry_set_client_auth( mbedtls_ssl_sni_registry *registry,
+                                              const char *hostname,
+                                              mbedtls_x509_crt *ca_chain,
+                                              mbedtls_x509_crl *ca_crl,
+                                              int authmode );
+
+/**
+ * \brief          SNI callback selecting the certificates registered for
+ *                 the hostname sent by the client.
+ *
+ *                 Use it with mbedtls_ssl_conf_sni( conf,
+ *                 mbedtls_ssl_sni_registry_get, &registry ).
+ *
+ *                 The key/cert list of the hostname is used by the
+ *                 handshake in place, so the encoded certificate chain is
+ *                 only built once per hostname.
+ *
+ * \param p_registry Registry
+ * \param ssl      SSL context in the handshake
+ * \param hostname Hostname sent by the client, not null-terminated
+ * \param len      Length of the hostname
+ *
+ * \return         0 if the hostname was found, or -1 otherwise, which
+ *                 aborts the handshake with an unrecognized_name alert.
+ */
+int mbedtls_ssl_sni_registry_get( void *p_registry,
+                                  mbedtls_ssl_context *ssl,
+                                  const unsigned char *hostname,
+                                  size_t len );
+
+/**
+ * \brief          Free the resources of a registry. The certificates and
+ *                 keys are not freed.
+ *
+ * \param registry Registry to free
+ */
+void mbedtls_ssl_sni_registry_free( mbedtls_ssl_sni_registry *registry );
+
+#endif /* MBEDTLS_SSL_SNI_REGISTRY_C && MBEDTLS_X509_CRT_PARSE_C */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ssl_sni_registry.h */
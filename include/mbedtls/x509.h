@@ -30,6 +30,9 @@
 #include MBEDTLS_CONFIG_FILE
 #endif
 
+#if defined(MBEDTLS_ALLOC_PROFILE)
+#include "mbedtls/alloc_profile.h"
+#endif
 #include "mbedtls/asn1.h"
 #include "mbedtls/pk.h"
 
@@ -37,6 +40,10 @@
 #include "mbedtls/rsa.h"
 #endif
 
+#if defined(MBEDTLS_PEM_PARSE_C)
+#include "mbedtls/pem.h"
+#endif
+
 /**
  * \addtogroup x509_module
  * \{
@@ -228,6 +235,20 @@ typedef mbedtls_asn1_named_data mbedtls_x509_name;
  */
 typedef mbedtls_asn1_sequence mbedtls_x509_sequence;
 
+/**
+ * Canonical form of a Name, for fast comparison. Two names have the same
+ * encoding exactly when certificate chain building considers them equal:
+ * same attribute types in the same structure, and values that are
+ * identical or, for PrintableString and UTF8String, equal up to ASCII case.
+ */
+typedef struct mbedtls_x509_name_canon
+{
+    uint64_t hash;              /**< Hash of the encoding. */
+    size_t len;                 /**< Length of the encoding. */
+    unsigned char *p;           /**< Canonical encoding. */
+}
+mbedtls_x509_name_canon;
+
 /** Container for date and time (precision in seconds). */
 typedef struct mbedtls_x509_time
 {
@@ -308,8 +329,19 @@ int mbedtls_x509_self_test( int verbose );
  * Internal module functions. You probably do not want to use these unless you
  * know you do.
  */
+#if defined(MBEDTLS_PEM_PARSE_C)
+int mbedtls_x509_pem_read( mbedtls_pem_context *ctx, const char *header,
+                           const char *footer, const unsigned char *data,
+                           size_t *use_len );
+#endif
 int mbedtls_x509_get_name( unsigned char **p, const unsigned char *end,
                    mbedtls_x509_name *cur );
+size_t mbedtls_x509_name_canon_len( const mbedtls_x509_name *name );
+void mbedtls_x509_name_canon_write( mbedtls_x509_name_canon *canon,
+                                    const mbedtls_x509_name *name,
+                                    unsigned char *buf );
+int mbedtls_x509_name_canon_cmp( const mbedtls_x509_name_canon *a,
+                                 const mbedtls_x509_name_canon *b );
 int mbedtls_x509_get_alg_null( unsigned char **p, const unsigned char *end,
                        mbedtls_x509_buf *alg );
 int mbedtls_x509_get_alg( unsigned char **p, const unsigned char *end,
@@ -354,6 +386,17 @@ int mbedtls_x509_write_sig( unsigned char **p, unsigned char *start,
         p += (size_t) ret;                                  \
     } while( 0 )
 
+/* Allocations owned by parsed certificates, CRLs and CSRs */
+#if defined(MBEDTLS_ALLOC_PROFILE)
+#define MBEDTLS_X509_ALLOC( len )                                   \
+    MBEDTLS_ALLOC_PROFILE_CALLOC( NULL, MBEDTLS_ALLOC_PROFILE_X509, len )
+#define MBEDTLS_X509_FREE( p, len )                                 \
+    MBEDTLS_ALLOC_PROFILE_FREE( NULL, MBEDTLS_ALLOC_PROFILE_X509, p, len )
+#else
+#define MBEDTLS_X509_ALLOC( len )       mbedtls_calloc( 1, (len) )
+#define MBEDTLS_X509_FREE( p, len )     mbedtls_free( (p) )
+#endif /* MBEDTLS_ALLOC_PROFILE */
+
 #ifdef __cplusplus
 }
 #endif
@@ -78,6 +78,7 @@ typedef struct mbedtls_x509_crl
     mbedtls_x509_buf issuer_raw;    /**< The raw issuer data (DER). */
 
     mbedtls_x509_name issuer;       /**< The parsed issuer data (named information object). */
+    mbedtls_x509_name_canon issuer_canon;   /**< Canonical issuer, compared to the subject of the CA. */
 
     mbedtls_x509_time this_update;
     mbedtls_x509_time next_update;
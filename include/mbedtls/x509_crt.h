@@ -68,6 +68,9 @@ typedef struct mbedtls_x509_crt
     mbedtls_x509_name issuer;           /**< The parsed issuer data (named information object). */
     mbedtls_x509_name subject;          /**< The parsed subject data (named information object). */
 
+    mbedtls_x509_name_canon issuer_canon;   /**< Canonical issuer, compared when building chains. */
+    mbedtls_x509_name_canon subject_canon;  /**< Canonical subject, in the same allocation as issuer_canon. */
+
     mbedtls_x509_time valid_from;       /**< Start time of certificate validity. */
     mbedtls_x509_time valid_to;         /**< End time of certificate validity. */
 
@@ -96,6 +99,11 @@ typedef struct mbedtls_x509_crt
     mbedtls_pk_type_t sig_pk;           /**< Internal representation of the Public Key algorithm of the signature algorithm, e.g. MBEDTLS_PK_RSA */
     void *sig_opts;             /**< Signature options to be passed to mbedtls_pk_verify_ext(), e.g. for RSASSA-PSS */
 
+#if defined(MBEDTLS_X509_CRT_CONTIGUOUS)
+    unsigned char *alloc;       /**< Single block holding the lists, the canonical names and, if owned, the copy of \c raw. */
+    size_t alloc_len;           /**< Length of \c alloc. */
+#endif
+
     struct mbedtls_x509_crt *next;     /**< Next certificate in the CA-chain. */
 }
 mbedtls_x509_crt;
@@ -261,6 +269,24 @@ typedef void mbedtls_x509_crt_restart_ctx;
 
 #endif /* MBEDTLS_ECDSA_C && MBEDTLS_ECP_RESTARTABLE */
 
+/**
+ * Maximum length of a hostname prepared with mbedtls_x509_crt_hostname_set()
+ */
+#define MBEDTLS_X509_CRT_MAX_HOSTNAME_LEN   255
+
+/**
+ * \brief          Expected peer hostname, prepared once for matching against
+ *                 the names of many certificates.
+ */
+typedef struct mbedtls_x509_crt_hostname
+{
+    unsigned char name[MBEDTLS_X509_CRT_MAX_HOSTNAME_LEN]; /*!< hostname, in lowercase */
+    size_t len;         /*!< length of the hostname                             */
+    size_t suffix;      /*!< offset of the first '.', where a wildcard name
+                             match starts, or 0 if no wildcard can match        */
+}
+mbedtls_x509_crt_hostname;
+
 #if defined(MBEDTLS_X509_CRT_PARSE_C)
 /**
  * Default security profile. Should provide a good balance between security
@@ -397,7 +423,108 @@ int mbedtls_x509_crt_parse_file( mbedtls_x509_crt *chain, const char *path );
  */
 int mbedtls_x509_crt_parse_path( mbedtls_x509_crt *chain, const char *path );
 
+#if defined(MBEDTLS_X509_CRT_PARSE_PATH_PARALLEL)
+/**
+ * \brief          Load the certificate files of a directory on several
+ *                 threads and add them to the chained list, skipping
+ *                 certificates already present in the chain.
+ *
+ *                 The files are read and parsed concurrently, then the
+ *                 certificates are appended in directory order, as with
+ *                 mbedtls_x509_crt_parse_path(). A certificate whose DER
+ *                 encoding is identical to one already in \p chain,
+ *                 including one loaded earlier from the same directory,
+ *                 is dropped and not counted as a failure.
+ *
+ * \param chain    points to the start of the chain
+ * \param path     directory / folder to read the certificate files from
+ * \param threads  number of threads parsing the files, including the
+ *                 calling thread; 1 parses in the calling thread only
+ *
+ * \return         0 if all certificates parsed successfully, a positive number
+ *                 if partly successful or a specific X509 or PEM error code
+ */
+int mbedtls_x509_crt_parse_path_parallel( mbedtls_x509_crt *chain,
+                                          const char *path,
+                                          unsigned int threads );
+#endif /* MBEDTLS_X509_CRT_PARSE_PATH_PARALLEL */
+
 #endif /* MBEDTLS_FS_IO */
+
+#if defined(MBEDTLS_X509_CRT_SNAPSHOT)
+/**
+ * \brief          Write the DER encoding of the certificates of a chain to
+ *                 a trust store snapshot.
+ *
+ *                 A snapshot is an index followed by the concatenated DER
+ *                 certificates, so that it can be reloaded without any
+ *                 PEM decoding or file system traversal with
+ *                 mbedtls_x509_crt_parse_snapshot().
+ *
+ * \param chain    The chain to write.
+ * \param buf      The buffer to write to. May be \c NULL if \p size is 0.
+ * \param size     The size of \p buf in Bytes.
+ * \param olen     On success, the length of the snapshot. If \p buf is
+ *                 too small, the length it needs.
+ *
+ * \return         \c 0 if successful,
+ *                 #MBEDTLS_ERR_X509_BUFFER_TOO_SMALL if \p buf is too
+ *                 small, or #MBEDTLS_ERR_X509_BAD_INPUT_DATA if the chain
+ *                 is too large for the snapshot format.
+ */
+int mbedtls_x509_crt_write_snapshot( const mbedtls_x509_crt *chain,
+                                     unsigned char *buf, size_t size,
+                                     size_t *olen );
+
+/**
+ * \brief          Add the certificates of a trust store snapshot to the
+ *                 chained list, skipping certificates already present in
+ *                 the chain.
+ *
+ * \param chain    points to the start of the chain
+ * \param buf      The snapshot, as written by
+ *                 mbedtls_x509_crt_write_snapshot().
+ * \param buflen   The length of \p buf in Bytes.
+ * \param make_copy When zero, the certificates reference \p buf instead
+ *                 of copying it, as with mbedtls_x509_crt_parse_der_nocopy().
+ *                 This allows using a memory-mapped snapshot, which must
+ *                 then stay mapped and unmodified until \p chain is freed.
+ *
+ * \return         0 if all certificates parsed successfully, a positive
+ *                 number if partly successful,
+ *                 #MBEDTLS_ERR_X509_INVALID_FORMAT if the index is
+ *                 malformed, or a specific X509 error code.
+ */
+int mbedtls_x509_crt_parse_snapshot( mbedtls_x509_crt *chain,
+                                     const unsigned char *buf, size_t buflen,
+                                     int make_copy );
+
+#if defined(MBEDTLS_FS_IO)
+/**
+ * \brief          Write the certificates of a chain to a snapshot file.
+ *
+ * \param chain    The chain to write.
+ * \param path     The file to create or overwrite.
+ *
+ * \return         \c 0 if successful, or a specific X509 error code.
+ */
+int mbedtls_x509_crt_write_snapshot_file( const mbedtls_x509_crt *chain,
+                                          const char *path );
+
+/**
+ * \brief          Add the certificates of a snapshot file to the chained
+ *                 list, skipping certificates already present in the chain.
+ *
+ * \param chain    points to the start of the chain
+ * \param path     The snapshot file.
+ *
+ * \return         0 if all certificates parsed successfully, a positive
+ *                 number if partly successful, or a specific X509 error code.
+ */
+int mbedtls_x509_crt_parse_snapshot_file( mbedtls_x509_crt *chain,
+                                          const char *path );
+#endif /* MBEDTLS_FS_IO */
+#endif /* MBEDTLS_X509_CRT_SNAPSHOT */
 /**
  * \brief          This function parses an item in the SubjectAlternativeNames
  *                 extension.
@@ -671,6 +798,67 @@ int mbedtls_x509_crt_verify_with_ca_cb( mbedtls_x509_crt *crt,
 
 #endif /* MBEDTLS_X509_TRUSTED_CERTIFICATE_CALLBACK */
 
+/**
+ * \brief          Prepare a hostname for certificate verification.
+ *
+ *                 The hostname is lowercased and its first label located
+ *                 once, so that matching it against the subjectAltName
+ *                 entries or Common Names of a certificate only compares
+ *                 names of the right length, without rescanning the
+ *                 hostname for each of them.
+ *
+ * \param hostname The structure to fill.
+ * \param name     The expected hostname, null-terminated.
+ *
+ * \return         \c 0 if successful, or #MBEDTLS_ERR_X509_BAD_INPUT_DATA
+ *                 if \p name is longer than
+ *                 #MBEDTLS_X509_CRT_MAX_HOSTNAME_LEN.
+ */
+int mbedtls_x509_crt_hostname_set( mbedtls_x509_crt_hostname *hostname,
+                                   const char *name );
+
+/**
+ * \brief          Version of \c mbedtls_x509_crt_verify_restartable() that
+ *                 takes the expected hostname prepared with
+ *                 mbedtls_x509_crt_hostname_set().
+ *
+ * \param hostname The expected hostname, or \c NULL if the name need not
+ *                 be verified.
+ *
+ * \note           The other parameters and the return values are those of
+ *                 \c mbedtls_x509_crt_verify_restartable(). The name
+ *                 matching rules are the same as with a \p cn argument.
+ */
+int mbedtls_x509_crt_verify_hostname( mbedtls_x509_crt *crt,
+                     mbedtls_x509_crt *trust_ca,
+                     mbedtls_x509_crl *ca_crl,
+                     const mbedtls_x509_crt_profile *profile,
+                     const mbedtls_x509_crt_hostname *hostname, uint32_t *flags,
+                     int (*f_vrfy)(void *, mbedtls_x509_crt *, int, uint32_t *),
+                     void *p_vrfy,
+                     mbedtls_x509_crt_restart_ctx *rs_ctx );
+
+#if defined(MBEDTLS_X509_TRUSTED_CERTIFICATE_CALLBACK)
+/**
+ * \brief          Version of \c mbedtls_x509_crt_verify_with_ca_cb() that
+ *                 takes the expected hostname prepared with
+ *                 mbedtls_x509_crt_hostname_set().
+ *
+ * \param hostname The expected hostname, or \c NULL if the name need not
+ *                 be verified.
+ *
+ * \note           The other parameters and the return values are those of
+ *                 \c mbedtls_x509_crt_verify_with_ca_cb().
+ */
+int mbedtls_x509_crt_verify_hostname_with_ca_cb( mbedtls_x509_crt *crt,
+                     mbedtls_x509_crt_ca_cb_t f_ca_cb,
+                     void *p_ca_cb,
+                     const mbedtls_x509_crt_profile *profile,
+                     const mbedtls_x509_crt_hostname *hostname, uint32_t *flags,
+                     int (*f_vrfy)(void *, mbedtls_x509_crt *, int, uint32_t *),
+                     void *p_vrfy );
+#endif /* MBEDTLS_X509_TRUSTED_CERTIFICATE_CALLBACK */
+
 #if defined(MBEDTLS_X509_CHECK_KEY_USAGE)
 /**
  * \brief          Check usage of certificate against keyUsage extension.
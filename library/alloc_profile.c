@@ -0,0 +1,219 @@
+/*
+ *  Accounting of the memory used by the SSL and X.509 modules
+ *
+ *  Copyright (C) 2006-2019, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *  This file is part of mbed TLS (https://tls.mbed.org)
+ */
+
+#if !defined(MBEDTLS_CONFIG_FILE)
+#include "mbedtls/config.h"
+#else
+#include MBEDTLS_CONFIG_FILE
+#endif
+
+#if defined(MBEDTLS_ALLOC_PROFILE)
+
+#include "mbedtls/alloc_profile.h"
+
+#if defined(MBEDTLS_PLATFORM_C)
+#include "mbedtls/platform.h"
+#else
+#include <stdlib.h>
+#define mbedtls_calloc    calloc
+#define mbedtls_free      free
+#endif
+
+#if defined(MBEDTLS_THREADING_C)
+#include "mbedtls/threading.h"
+#endif
+
+#include <string.h>
+
+static mbedtls_alloc_profile_stats global_stats[MBEDTLS_ALLOC_PROFILE_CATEGORIES];
+static int global_enabled = 0;
+
+#if defined(MBEDTLS_THREADING_C)
+static mbedtls_threading_mutex_t global_mutex;
+#endif
+
+static const char *category_names[MBEDTLS_ALLOC_PROFILE_CATEGORIES] =
+{
+    "io",
+    "handshake",
+    "session",
+    "flight",
+    "x509",
+    "cache",
+};
+
+static void stats_add( mbedtls_alloc_profile_stats *stats, size_t len )
+{
+    stats->current += len;
+    stats->allocs++;
+    if( stats->current > stats->peak )
+        stats->peak = stats->current;
+}
+
+static void stats_sub( mbedtls_alloc_profile_stats *stats, size_t len )
+{
+    /* Not clamped: a release with the wrong length, or released twice,
+     * must show in the counters */
+    stats->current -= len;
+}
+
+/*
+ * Lock the global counters if they are enabled: return 0 if they are,
+ * with the mutex held, or -1 otherwise. The mutex is only valid between
+ * mbedtls_alloc_profile_init() and mbedtls_alloc_profile_free(), so a
+ * failure to lock it also means that the counters are off.
+ */
+static int global_lock( void )
+{
+#if defined(MBEDTLS_THREADING_C)
+    if( mbedtls_mutex_lock( &global_mutex ) != 0 )
+        return( -1 );
+#endif
+
+    if( global_enabled == 0 )
+    {
+#if defined(MBEDTLS_THREADING_C)
+        mbedtls_mutex_unlock( &global_mutex );
+#endif
+        return( -1 );
+    }
+
+    return( 0 );
+}
+
+static void global_unlock( void )
+{
+#if defined(MBEDTLS_THREADING_C)
+    mbedtls_mutex_unlock( &global_mutex );
+#endif
+}
+
+void mbedtls_alloc_profile_init( void )
+{
+    memset( global_stats, 0, sizeof( global_stats ) );
+#if defined(MBEDTLS_THREADING_C)
+    mbedtls_mutex_init( &global_mutex );
+    if( mbedtls_mutex_lock( &global_mutex ) != 0 )
+        return;
+#endif
+    global_enabled = 1;
+#if defined(MBEDTLS_THREADING_C)
+    mbedtls_mutex_unlock( &global_mutex );
+#endif
+}
+
+void mbedtls_alloc_profile_free( void )
+{
+    if( global_lock() != 0 )
+        return;
+
+    global_enabled = 0;
+    global_unlock();
+
+#if defined(MBEDTLS_THREADING_C)
+    mbedtls_mutex_free( &global_mutex );
+#endif
+}
+
+int mbedtls_alloc_profile_get( int category,
+                               mbedtls_alloc_profile_stats *stats )
+{
+    if( category < 0 || category >= MBEDTLS_ALLOC_PROFILE_CATEGORIES ||
+        stats == NULL )
+        return( -1 );
+
+    /* Once stopped, the counters keep their last values */
+    if( global_lock() != 0 )
+    {
+        *stats = global_stats[category];
+        return( 0 );
+    }
+
+    *stats = global_stats[category];
+    global_unlock();
+
+    return( 0 );
+}
+
+void mbedtls_alloc_profile_reset_peak( void )
+{
+    int i;
+
+    if( global_lock() != 0 )
+        return;
+
+    for( i = 0; i < MBEDTLS_ALLOC_PROFILE_CATEGORIES; i++ )
+        global_stats[i].peak = global_stats[i].current;
+
+    global_unlock();
+}
+
+const char *mbedtls_alloc_profile_category_name( int category )
+{
+    if( category < 0 || category >= MBEDTLS_ALLOC_PROFILE_CATEGORIES )
+        return( "unknown" );
+
+    return( category_names[category] );
+}
+
+void *mbedtls_alloc_profile_calloc( mbedtls_alloc_profile_stats *stats,
+                                    int category, size_t len )
+{
+    void *p = mbedtls_calloc( 1, len );
+
+    if( p == NULL ||
+        category < 0 || category >= MBEDTLS_ALLOC_PROFILE_CATEGORIES )
+        return( p );
+
+    if( stats != NULL )
+        stats_add( stats, len );
+
+    if( global_lock() == 0 )
+    {
+        stats_add( &global_stats[category], len );
+        global_unlock();
+    }
+
+    return( p );
+}
+
+void mbedtls_alloc_profile_release( mbedtls_alloc_profile_stats *stats,
+                                    int category, void *p, size_t len )
+{
+    if( p == NULL )
+        return;
+
+    mbedtls_free( p );
+
+    if( category < 0 || category >= MBEDTLS_ALLOC_PROFILE_CATEGORIES )
+        return;
+
+    if( stats != NULL )
+        stats_sub( stats, len );
+
+    if( global_lock() == 0 )
+    {
+        stats_sub( &global_stats[category], len );
+        global_unlock();
+    }
+}
+
+#endif /* MBEDTLS_ALLOC_PROFILE */
@@ -58,6 +58,423 @@ void mbedtls_debug_set_threshold( int threshold )
     debug_threshold = threshold;
 }
 
+/*
+ * Threshold for a given context, falling back to the global one
+ */
+static inline int debug_get_threshold( const mbedtls_ssl_context *ssl )
+{
+    return( ssl->dbg_threshold >= 0 ? ssl->dbg_threshold : debug_threshold );
+}
+
+#if defined(MBEDTLS_DEBUG_BINARY_TRACE)
+/*
+ * Binary trace records. In the ring, each record starts with:
+ *      uint16  length of the record, this header included
+ *      uint8   type
+ *      uint8   level
+ *      uint32  line
+ *      ssl, file and text pointers, in native form
+ * followed by a type-specific payload, with big-endian integers:
+ *      MSG: for each conversion of the format, a tag followed by
+ *           8 bytes for 'i', 'u', 'p' and 'f', or by a length byte and
+ *           the characters for 's'
+ *      RET: int32 return value
+ *      BUF: uint32 length of the buffer, followed by its first bytes
+ *
+ * The export starts with "MBTR", the uint32 version and the uint32 count
+ * of lost records. Each record is then written as:
+ *      uint8   type
+ *      uint8   level
+ *      uint32  line
+ *      uint64  ssl
+ *      uint16  length of the file name, file name
+ *      uint16  length of the text, text
+ *      uint32  length of the payload, payload
+ */
+#define DEBUG_TRACE_PTR_LEN     ( sizeof( void * ) )
+#define DEBUG_TRACE_HDR_LEN     ( 8 + 3 * DEBUG_TRACE_PTR_LEN )
+#define DEBUG_TRACE_MAX_BUF     4096
+#define DEBUG_TRACE_MAX_STR     255
+
+static void debug_trace_put_u64( unsigned char *p, uint64_t v )
+{
+    int i;
+
+    for( i = 7; i >= 0; i-- )
+    {
+        p[i] = (unsigned char) v;
+        v >>= 8;
+    }
+}
+
+static void debug_trace_put_u32( unsigned char *p, uint32_t v )
+{
+    p[0] = (unsigned char)( v >> 24 );
+    p[1] = (unsigned char)( v >> 16 );
+    p[2] = (unsigned char)( v >>  8 );
+    p[3] = (unsigned char)( v       );
+}
+
+static void debug_trace_read( const mbedtls_debug_trace *trace, size_t off,
+                              unsigned char *dst, size_t len )
+{
+    size_t n = trace->size - off;
+
+    if( n > len )
+        n = len;
+
+    memcpy( dst, trace->buf + off, n );
+    memcpy( dst + n, trace->buf, len - n );
+}
+
+static void debug_trace_write( mbedtls_debug_trace *trace,
+                               const unsigned char *src, size_t len )
+{
+    size_t n = trace->size - trace->head;
+
+    if( n > len )
+        n = len;
+
+    memcpy( trace->buf + trace->head, src, n );
+    memcpy( trace->buf, src + n, len - n );
+    trace->head = ( trace->head + len ) % trace->size;
+}
+
+static size_t debug_trace_rec_len( const mbedtls_debug_trace *trace,
+                                   size_t off )
+{
+    unsigned char len[2];
+
+    debug_trace_read( trace, off, len, 2 );
+
+    return( ( (size_t) len[0] << 8 ) | len[1] );
+}
+
+/*
+ * Append a record made of hdr (whose length field is filled here) and
+ * data, discarding the oldest records if needed.
+ */
+static void debug_trace_push( mbedtls_debug_trace *trace,
+                              unsigned char *hdr, size_t hdr_len,
+                              const unsigned char *data, size_t data_len )
+{
+    size_t n, len = hdr_len + data_len;
+
+    if( len > trace->size || len > 0xFFFF )
+    {
+        trace->lost++;
+        return;
+    }
+
+    while( trace->size - trace->used < len )
+    {
+        n = debug_trace_rec_len( trace, trace->tail );
+        trace->tail = ( trace->tail + n ) % trace->size;
+        trace->used -= n;
+        trace->lost++;
+    }
+
+    hdr[0] = (unsigned char)( len >> 8 );
+    hdr[1] = (unsigned char)( len      );
+
+    debug_trace_write( trace, hdr, hdr_len );
+    if( data_len != 0 )
+        debug_trace_write( trace, data, data_len );
+
+    trace->used += len;
+}
+
+static void debug_trace_header( unsigned char *hdr, int type, int level,
+                                const mbedtls_ssl_context *ssl,
+                                const char *file, int line,
+                                const char *text )
+{
+    hdr[2] = (unsigned char) type;
+    hdr[3] = (unsigned char) level;
+    debug_trace_put_u32( hdr + 4, (uint32_t) line );
+    memcpy( hdr + 8, &ssl, DEBUG_TRACE_PTR_LEN );
+    memcpy( hdr + 8 + DEBUG_TRACE_PTR_LEN, &file, DEBUG_TRACE_PTR_LEN );
+    memcpy( hdr + 8 + 2 * DEBUG_TRACE_PTR_LEN, &text, DEBUG_TRACE_PTR_LEN );
+}
+
+/*
+ * Return the ring to record into, or NULL for text output
+ */
+static mbedtls_debug_trace *debug_trace_get( const mbedtls_ssl_context *ssl,
+                                             int level )
+{
+    if( NULL == ssl                ||
+        NULL == ssl->conf          ||
+        NULL == ssl->conf->f_trace ||
+        level > debug_get_threshold( ssl ) )
+    {
+        return( NULL );
+    }
+
+    return( ssl->conf->f_trace( ssl->conf->p_trace, ssl ) );
+}
+
+/*
+ * Record the arguments of a message without formatting them. Only the
+ * conversions used in the library are understood; the arguments
+ * following an unknown one are not recorded, nor are those that don't
+ * fit in the record.
+ */
+static void debug_trace_msg( mbedtls_debug_trace *trace,
+                             const mbedtls_ssl_context *ssl, int level,
+                             const char *file, int line,
+                             const char *format, va_list argp )
+{
+    unsigned char rec[DEBUG_BUF_SIZE];
+    unsigned char *p = rec + DEBUG_TRACE_HDR_LEN;
+    const unsigned char *end = rec + sizeof( rec );
+    const char *f = format;
+
+    debug_trace_header( rec, MBEDTLS_DEBUG_TRACE_MSG, level,
+                        ssl, file, line, format );
+
+    while( ( f = strchr( f, '%' ) ) != NULL )
+    {
+        int longs = 0, sizet = 0;
+        uint64_t v;
+        double d;
+        const char *str;
+        size_t len;
+
+        if( *++f == '%' )
+        {
+            f++;
+            continue;
+        }
+
+        /* Flags, field width and precision */
+        for( ; *f != '\0' && strchr( "-+ #0123456789.*", *f ) != NULL; f++ )
+        {
+            if( *f != '*' )
+                continue;
+
+            if( end - p < 9 )
+                goto done;
+
+            *p++ = 'i';
+            debug_trace_put_u64( p, (uint64_t)(int64_t) va_arg( argp, int ) );
+            p += 8;
+        }
+
+        /* Length modifiers */
+        for( ; *f == 'h' || *f == 'l' || *f == 'z'; f++ )
+        {
+            if( *f == 'l' )
+                longs++;
+            else if( *f == 'z' )
+                sizet = 1;
+        }
+
+        if( end - p < 9 )
+            goto done;
+
+        switch( *f )
+        {
+            case 'd':
+            case 'i':
+            case 'c':
+                if( sizet )
+                    v = (uint64_t) va_arg( argp, size_t );
+                else if( longs == 0 )
+                    v = (uint64_t)(int64_t) va_arg( argp, int );
+                else if( longs == 1 )
+                    v = (uint64_t)(int64_t) va_arg( argp, long );
+                else
+                    v = (uint64_t)(int64_t) va_arg( argp, long long );
+                *p++ = 'i';
+                break;
+
+            case 'u':
+            case 'x':
+            case 'X':
+            case 'o':
+                if( sizet )
+                    v = (uint64_t) va_arg( argp, size_t );
+                else if( longs == 0 )
+                    v = (uint64_t) va_arg( argp, unsigned int );
+                else if( longs == 1 )
+                    v = (uint64_t) va_arg( argp, unsigned long );
+                else
+                    v = (uint64_t) va_arg( argp, unsigned long long );
+                *p++ = 'u';
+                break;
+
+            case 'p':
+                v = (uint64_t)(uintptr_t) va_arg( argp, void * );
+                *p++ = 'p';
+                break;
+
+            case 'e':
+            case 'E':
+            case 'f':
+            case 'g':
+            case 'G':
+                d = va_arg( argp, double );
+                memcpy( &v, &d, sizeof( v ) );
+                *p++ = 'f';
+                break;
+
+            case 's':
+                str = va_arg( argp, const char * );
+                if( str == NULL )
+                    str = "(null)";
+                len = strlen( str );
+                if( len > DEBUG_TRACE_MAX_STR )
+                    len = DEBUG_TRACE_MAX_STR;
+                if( len > (size_t)( end - p ) - 2 )
+                    len = (size_t)( end - p ) - 2;
+                *p++ = 's';
+                *p++ = (unsigned char) len;
+                memcpy( p, str, len );
+                p += len;
+                f++;
+                continue;
+
+            default:
+                goto done;
+        }
+
+        debug_trace_put_u64( p, v );
+        p += 8;
+        f++;
+    }
+
+done:
+    debug_trace_push( trace, rec, p - rec, NULL, 0 );
+}
+
+void mbedtls_debug_trace_init( mbedtls_debug_trace *trace,
+                               unsigned char *buf, size_t size )
+{
+    memset( trace, 0, sizeof( mbedtls_debug_trace ) );
+
+    trace->buf = buf;
+    trace->size = size;
+}
+
+/*
+ * Write the export form of the records (if out is not NULL) and return
+ * its length
+ */
+static size_t debug_trace_export_records( const mbedtls_debug_trace *trace,
+                                          unsigned char *out )
+{
+    unsigned char hdr[DEBUG_TRACE_HDR_LEN];
+    const mbedtls_ssl_context *ssl;
+    const char *file, *text;
+    size_t off = trace->tail, done = 0, total = 0;
+    size_t len, file_len, text_len, payload_len;
+
+    while( done < trace->used )
+    {
+        len = debug_trace_rec_len( trace, off );
+        debug_trace_read( trace, off, hdr, sizeof( hdr ) );
+
+        memcpy( &ssl, hdr + 8, DEBUG_TRACE_PTR_LEN );
+        memcpy( &file, hdr + 8 + DEBUG_TRACE_PTR_LEN, DEBUG_TRACE_PTR_LEN );
+        memcpy( &text, hdr + 8 + 2 * DEBUG_TRACE_PTR_LEN, DEBUG_TRACE_PTR_LEN );
+
+        file_len = strlen( file );
+        if( file_len > 0xFFFF )
+            file_len = 0xFFFF;
+        text_len = strlen( text );
+        if( text_len > 0xFFFF )
+            text_len = 0xFFFF;
+        payload_len = len - DEBUG_TRACE_HDR_LEN;
+
+        if( out != NULL )
+        {
+            unsigned char *p = out + total;
+
+            *p++ = hdr[2];
+            *p++ = hdr[3];
+            memcpy( p, hdr + 4, 4 );
+            p += 4;
+            debug_trace_put_u64( p, (uint64_t)(uintptr_t) ssl );
+            p += 8;
+            *p++ = (unsigned char)( file_len >> 8 );
+            *p++ = (unsigned char)( file_len      );
+            memcpy( p, file, file_len );
+            p += file_len;
+            *p++ = (unsigned char)( text_len >> 8 );
+            *p++ = (unsigned char)( text_len      );
+            memcpy( p, text, text_len );
+            p += text_len;
+            debug_trace_put_u32( p, (uint32_t) payload_len );
+            p += 4;
+            debug_trace_read( trace,
+                              ( off + DEBUG_TRACE_HDR_LEN ) % trace->size,
+                              p, payload_len );
+        }
+
+        total += 2 + 4 + 8 + 2 + file_len + 2 + text_len + 4 + payload_len;
+        off = ( off + len ) % trace->size;
+        done += len;
+    }
+
+    return( total );
+}
+
+int mbedtls_debug_trace_export( const mbedtls_debug_trace *trace,
+                                unsigned char *out, size_t out_size,
+                                size_t *olen )
+{
+    size_t len = 12 + debug_trace_export_records( trace, NULL );
+
+    *olen = len;
+
+    if( out == NULL || out_size < len )
+        return( MBEDTLS_ERR_SSL_BUFFER_TOO_SMALL );
+
+    memcpy( out, "MBTR", 4 );
+    debug_trace_put_u32( out + 4, MBEDTLS_DEBUG_TRACE_VERSION );
+    debug_trace_put_u32( out + 8, trace->lost );
+    debug_trace_export_records( trace, out + 12 );
+
+    return( 0 );
+}
+
+#if defined(MBEDTLS_FS_IO)
+int mbedtls_debug_trace_write_file( const mbedtls_debug_trace *trace,
+                                    const char *path )
+{
+    int ret;
+    FILE *f;
+    unsigned char *buf;
+    size_t len;
+
+    (void) mbedtls_debug_trace_export( trace, NULL, 0, &len );
+
+    if( ( buf = mbedtls_calloc( 1, len ) ) == NULL )
+        return( MBEDTLS_ERR_SSL_ALLOC_FAILED );
+
+    if( ( ret = mbedtls_debug_trace_export( trace, buf, len, &len ) ) != 0 )
+        goto cleanup;
+
+    if( ( f = fopen( path, "wb" ) ) == NULL )
+    {
+        ret = MBEDTLS_ERR_SSL_BAD_INPUT_DATA;
+        goto cleanup;
+    }
+
+    if( fwrite( buf, 1, len, f ) != len )
+        ret = MBEDTLS_ERR_SSL_BAD_INPUT_DATA;
+
+    fclose( f );
+
+cleanup:
+    mbedtls_free( buf );
+
+    return( ret );
+}
+#endif /* MBEDTLS_FS_IO */
+#endif /* MBEDTLS_DEBUG_BINARY_TRACE */
+
 /*
  * All calls to f_dbg must be made via this function
  */
@@ -86,11 +503,22 @@ void mbedtls_debug_print_msg( const mbedtls_ssl_context *ssl, int level,
     va_list argp;
     char str[DEBUG_BUF_SIZE];
     int ret;
+#if defined(MBEDTLS_DEBUG_BINARY_TRACE)
+    mbedtls_debug_trace *trace;
+
+    if( ( trace = debug_trace_get( ssl, level ) ) != NULL )
+    {
+        va_start( argp, format );
+        debug_trace_msg( trace, ssl, level, file, line, format, argp );
+        va_end( argp );
+        return;
+    }
+#endif
 
     if( NULL == ssl              ||
         NULL == ssl->conf        ||
         NULL == ssl->conf->f_dbg ||
-        level > debug_threshold )
+        level > debug_get_threshold( ssl ) )
     {
         return;
     }
@@ -113,11 +541,28 @@ void mbedtls_debug_print_ret( const mbedtls_ssl_context *ssl, int level,
                       const char *text, int ret )
 {
     char str[DEBUG_BUF_SIZE];
+#if defined(MBEDTLS_DEBUG_BINARY_TRACE)
+    mbedtls_debug_trace *trace;
+
+    if( ( trace = debug_trace_get( ssl, level ) ) != NULL )
+    {
+        unsigned char rec[DEBUG_TRACE_HDR_LEN + 4];
+
+        if( ret == MBEDTLS_ERR_SSL_WANT_READ )
+            return;
+
+        debug_trace_header( rec, MBEDTLS_DEBUG_TRACE_RET, level,
+                            ssl, file, line, text );
+        debug_trace_put_u32( rec + DEBUG_TRACE_HDR_LEN, (uint32_t) ret );
+        debug_trace_push( trace, rec, sizeof( rec ), NULL, 0 );
+        return;
+    }
+#endif
 
     if( NULL == ssl              ||
         NULL == ssl->conf        ||
         NULL == ssl->conf->f_dbg ||
-        level > debug_threshold )
+        level > debug_get_threshold( ssl ) )
     {
         return;
     }
@@ -143,11 +588,26 @@ void mbedtls_debug_print_buf( const mbedtls_ssl_context *ssl, int level,
     char str[DEBUG_BUF_SIZE];
     char txt[17];
     size_t i, idx = 0;
+#if defined(MBEDTLS_DEBUG_BINARY_TRACE)
+    mbedtls_debug_trace *trace;
+
+    if( ( trace = debug_trace_get( ssl, level ) ) != NULL )
+    {
+        unsigned char rec[DEBUG_TRACE_HDR_LEN + 4];
+
+        debug_trace_header( rec, MBEDTLS_DEBUG_TRACE_BUF, level,
+                            ssl, file, line, text );
+        debug_trace_put_u32( rec + DEBUG_TRACE_HDR_LEN, (uint32_t) len );
+        debug_trace_push( trace, rec, sizeof( rec ), buf,
+                          len > DEBUG_TRACE_MAX_BUF ? DEBUG_TRACE_MAX_BUF : len );
+        return;
+    }
+#endif
 
     if( NULL == ssl              ||
         NULL == ssl->conf        ||
         NULL == ssl->conf->f_dbg ||
-        level > debug_threshold )
+        level > debug_get_threshold( ssl ) )
     {
         return;
     }
@@ -205,7 +665,7 @@ void mbedtls_debug_print_ecp( const mbedtls_ssl_context *ssl, int level,
     if( NULL == ssl              ||
         NULL == ssl->conf        ||
         NULL == ssl->conf->f_dbg ||
-        level > debug_threshold )
+        level > debug_get_threshold( ssl ) )
     {
         return;
     }
@@ -231,7 +691,7 @@ void mbedtls_debug_print_mpi( const mbedtls_ssl_context *ssl, int level,
         NULL == ssl->conf        ||
         NULL == ssl->conf->f_dbg ||
         NULL == X                ||
-        level > debug_threshold )
+        level > debug_get_threshold( ssl ) )
     {
         return;
     }
@@ -363,7 +823,7 @@ void mbedtls_debug_print_crt( const mbedtls_ssl_context *ssl, int level,
         NULL == ssl->conf        ||
         NULL == ssl->conf->f_dbg ||
         NULL == crt              ||
-        level > debug_threshold )
+        level > debug_get_threshold( ssl ) )
     {
         return;
     }
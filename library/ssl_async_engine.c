@@ -0,0 +1,661 @@
+/*
+ *  Asynchronous private key operations on a pool of worker threads
+ *
+ *  Copyright (C) 2006-2019, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *  This file is part of mbed TLS (https://tls.mbed.org)
+ */
+/*
+ * The handshake hands each private key operation to a queue served by a
+ * fixed set of worker threads, and is resumed once the worker has posted
+ * the result. Completions are signalled on a descriptor so that the thread
+ * driving the connections can wait for them together with its sockets.
+ *
+ * A key context is not safe for concurrent use, so a worker only takes
+ * jobs whose key no other worker is using. The queue and the key of each
+ * worker are protected by the engine mutex. Idle workers block on a pipe
+ * that holds one byte per wakeup, as the threading layer has no condition
+ * variables.
+ */
+
+/* Enable definition of pipe() and fcntl() even when compiling with -std=c99.
+ * Must be set before config.h, which pulls in glibc's features.h indirectly.
+ * Harmless on other platforms. */
+#define _POSIX_C_SOURCE 200112L
+
+#if !defined(MBEDTLS_CONFIG_FILE)
+#include "mbedtls/config.h"
+#else
+#include MBEDTLS_CONFIG_FILE
+#endif
+
+#if defined(MBEDTLS_SSL_ASYNC_ENGINE_C)
+
+#if defined(MBEDTLS_PLATFORM_C)
+#include "mbedtls/platform.h"
+#else
+#include <stdlib.h>
+#define mbedtls_calloc    calloc
+#define mbedtls_free      free
+#endif
+
+#include "mbedtls/ssl_async_engine.h"
+#include "mbedtls/ssl_internal.h"
+#include "mbedtls/platform_util.h"
+#include "mbedtls/threading.h"
+
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <sys/eventfd.h>
+#endif
+
+#define ASYNC_OP_SIGN           0
+#define ASYNC_OP_DECRYPT        1
+
+#define ASYNC_JOB_QUEUED        0
+#define ASYNC_JOB_RUNNING       1
+#define ASYNC_JOB_DONE          2
+#define ASYNC_JOB_CANCELLED     3
+
+struct mbedtls_ssl_async_job
+{
+    mbedtls_ssl_async_engine *engine;
+    mbedtls_ssl_async_job *next;
+    int state;                  /* ASYNC_JOB_xxx, protected by the mutex */
+    int op;                     /* ASYNC_OP_xxx                          */
+    mbedtls_pk_context *pk;
+    mbedtls_md_type_t md_alg;
+    unsigned char input[MBEDTLS_MPI_MAX_SIZE];
+    size_t input_len;
+    unsigned char output[MBEDTLS_MPI_MAX_SIZE];
+    size_t output_len;
+    int ret;
+};
+
+static void async_job_free( mbedtls_ssl_async_job *job )
+{
+    mbedtls_platform_zeroize( job, sizeof( mbedtls_ssl_async_job ) );
+    mbedtls_free( job );
+}
+
+/*
+ * Wake up the event loop. The descriptor is non-blocking: if a pipe is
+ * full, it is readable already and the notification can be dropped.
+ */
+static void async_engine_notify( mbedtls_ssl_async_engine *engine )
+{
+#if defined(__linux__)
+    uint64_t one = 1;
+    ssize_t ret = write( engine->write_fd, &one, sizeof( one ) );
+#else
+    unsigned char one = 1;
+    ssize_t ret = write( engine->write_fd, &one, sizeof( one ) );
+#endif
+    (void) ret;
+}
+
+/*
+ * Wake up one worker. The write end is non-blocking: if the pipe is full,
+ * enough wakeups are pending already.
+ */
+static void async_engine_wake( mbedtls_ssl_async_engine *engine )
+{
+    unsigned char one = 1;
+    ssize_t ret = write( engine->wake_fds[1], &one, sizeof( one ) );
+    (void) ret;
+}
+
+static void async_job_run( mbedtls_ssl_async_engine *engine,
+                           mbedtls_ssl_async_job *job )
+{
+    if( job->op == ASYNC_OP_SIGN )
+    {
+        job->ret = mbedtls_pk_sign( job->pk, job->md_alg,
+                                    job->input, job->input_len,
+                                    job->output, &job->output_len,
+                                    engine->f_rng, engine->p_rng );
+    }
+    else
+    {
+        job->ret = mbedtls_pk_decrypt( job->pk,
+                                       job->input, job->input_len,
+                                       job->output, &job->output_len,
+                                       sizeof( job->output ),
+                                       engine->f_rng, engine->p_rng );
+    }
+}
+
+/*
+ * Take a batch of queued jobs on the oldest key that no other worker is
+ * using, and mark the key as used by this worker. Under load, one worker
+ * wakeup, one lock round-trip and one completion notification then serve
+ * several handshakes. The batch is bounded by the share of the queue each
+ * idle worker would get, so that batching never leaves workers without
+ * work. Must be called with the mutex held.
+ */
+static size_t async_engine_take_batch( mbedtls_ssl_async_engine *engine,
+                                       mbedtls_ssl_async_worker *worker,
+                                       mbedtls_ssl_async_job **batch )
+{
+    const mbedtls_pk_context *key;
+    mbedtls_ssl_async_job *job, *next, *prev = NULL;
+    size_t idle = 0, share, n = 0;
+    unsigned int i;
+
+    for( job = engine->head; job != NULL; prev = job, job = job->next )
+    {
+        for( i = 0; i < engine->worker_count; i++ )
+            if( engine->workers[i].key == job->pk )
+                break;
+
+        if( i == engine->worker_count )
+            break;
+    }
+
+    /* Nothing queued, or only jobs on keys that are busy: the workers
+     * using them wake up another one when they are done. */
+    if( job == NULL )
+        return( 0 );
+
+    for( i = 0; i < engine->worker_count; i++ )
+        if( &engine->workers[i] != worker && engine->workers[i].key == NULL )
+            idle++;
+
+    share = ( engine->queued + idle ) / ( idle + 1 );
+    if( share > engine->max_batch )
+        share = engine->max_batch;
+
+    key = job->pk;
+    worker->key = key;
+
+    /* Take the jobs on that key in queue order, leaving the others */
+    while( job != NULL && n < share )
+    {
+        next = job->next;
+
+        if( job->pk == key )
+        {
+            if( prev == NULL )
+                engine->head = next;
+            else
+                prev->next = next;
+
+            if( engine->tail == job )
+                engine->tail = prev;
+
+            job->next = NULL;
+            job->state = ASYNC_JOB_RUNNING;
+            engine->queued--;
+            batch[n++] = job;
+        }
+        else
+            prev = job;
+
+        job = next;
+    }
+
+    return( n );
+}
+
+static void *async_engine_worker( void *arg )
+{
+    mbedtls_ssl_async_worker *worker = (mbedtls_ssl_async_worker *) arg;
+    mbedtls_ssl_async_engine *engine = worker->engine;
+    mbedtls_ssl_async_job *batch[MBEDTLS_SSL_ASYNC_ENGINE_MAX_BATCH];
+    unsigned char token;
+    ssize_t len;
+    size_t n, i;
+
+    while( 1 )
+    {
+        len = read( engine->wake_fds[0], &token, sizeof( token ) );
+        if( len < 0 && errno == EINTR )
+            continue;
+        if( len != sizeof( token ) )
+            break;
+
+        if( mbedtls_mutex_lock( &engine->mutex ) != 0 )
+            break;
+
+        if( engine->shutdown != 0 )
+        {
+            mbedtls_mutex_unlock( &engine->mutex );
+            break;
+        }
+
+        n = async_engine_take_batch( engine, worker, batch );
+
+        mbedtls_mutex_unlock( &engine->mutex );
+
+        if( n == 0 )
+            continue;
+
+        for( i = 0; i < n; i++ )
+            async_job_run( engine, batch[i] );
+
+        if( mbedtls_mutex_lock( &engine->mutex ) != 0 )
+            break;
+
+        for( i = 0; i < n; i++ )
+        {
+            if( batch[i]->state == ASYNC_JOB_CANCELLED )
+            {
+                /* The connection went away while we were working */
+                async_job_free( batch[i] );
+            }
+            else
+                batch[i]->state = ASYNC_JOB_DONE;
+        }
+
+        /* Other workers may have passed over jobs on this key */
+        worker->key = NULL;
+        if( engine->queued > 0 )
+            async_engine_wake( engine );
+
+        async_engine_notify( engine );
+
+        mbedtls_mutex_unlock( &engine->mutex );
+    }
+
+    return( NULL );
+}
+
+static int async_engine_start( mbedtls_ssl_context *ssl, int op,
+                               mbedtls_md_type_t md_alg,
+                               const unsigned char *input, size_t input_len )
+{
+    mbedtls_ssl_async_engine *engine =
+        mbedtls_ssl_conf_get_async_config_data( ssl->conf );
+    mbedtls_pk_context *pk = mbedtls_ssl_own_key( ssl );
+    mbedtls_ssl_async_job *job;
+
+    /* Let the SSL stack deal with what we cannot offload */
+    if( pk == NULL || engine->worker_count == 0 ||
+        input_len > sizeof( job->input ) )
+    {
+        return( MBEDTLS_ERR_SSL_HW_ACCEL_FALLTHROUGH );
+    }
+
+    job = mbedtls_calloc( 1, sizeof( mbedtls_ssl_async_job ) );
+    if( job == NULL )
+        return( MBEDTLS_ERR_PK_ALLOC_FAILED );
+
+    job->engine = engine;
+    job->op = op;
+    job->pk = pk;
+    job->md_alg = md_alg;
+    memcpy( job->input, input, input_len );
+    job->input_len = input_len;
+    job->state = ASYNC_JOB_QUEUED;
+
+    if( mbedtls_mutex_lock( &engine->mutex ) != 0 )
+    {
+        async_job_free( job );
+        return( MBEDTLS_ERR_SSL_INTERNAL_ERROR );
+    }
+
+    if( engine->tail == NULL )
+        engine->head = job;
+    else
+        engine->tail->next = job;
+    engine->tail = job;
+    engine->queued++;
+    engine->pending++;
+
+    async_engine_wake( engine );
+    mbedtls_mutex_unlock( &engine->mutex );
+
+    mbedtls_ssl_set_async_operation_data( ssl, job );
+
+    return( MBEDTLS_ERR_SSL_ASYNC_IN_PROGRESS );
+}
+
+static int async_engine_sign( mbedtls_ssl_context *ssl,
+                              mbedtls_x509_crt *cert,
+                              mbedtls_md_type_t md_alg,
+                              const unsigned char *hash,
+                              size_t hash_len )
+{
+    (void) cert;
+    return( async_engine_start( ssl, ASYNC_OP_SIGN, md_alg,
+                                hash, hash_len ) );
+}
+
+static int async_engine_decrypt( mbedtls_ssl_context *ssl,
+                                 mbedtls_x509_crt *cert,
+                                 const unsigned char *input,
+                                 size_t input_len )
+{
+    (void) cert;
+    return( async_engine_start( ssl, ASYNC_OP_DECRYPT, MBEDTLS_MD_NONE,
+                                input, input_len ) );
+}
+
+static int async_engine_resume( mbedtls_ssl_context *ssl,
+                                unsigned char *output,
+                                size_t *output_len,
+                                size_t output_size )
+{
+    mbedtls_ssl_async_job *job = mbedtls_ssl_get_async_operation_data( ssl );
+    mbedtls_ssl_async_engine *engine = job->engine;
+    int ret;
+
+    if( mbedtls_mutex_lock( &engine->mutex ) != 0 )
+        return( MBEDTLS_ERR_SSL_INTERNAL_ERROR );
+    if( job->state != ASYNC_JOB_DONE )
+    {
+        mbedtls_mutex_unlock( &engine->mutex );
+        return( MBEDTLS_ERR_SSL_ASYNC_IN_PROGRESS );
+    }
+    engine->pending--;
+    mbedtls_mutex_unlock( &engine->mutex );
+
+    ret = job->ret;
+    if( ret == 0 )
+    {
+        if( job->output_len > output_size )
+            ret = MBEDTLS_ERR_PK_BAD_INPUT_DATA;
+        else
+        {
+            memcpy( output, job->output, job->output_len );
+            *output_len = job->output_len;
+        }
+    }
+
+    async_job_free( job );
+    mbedtls_ssl_set_async_operation_data( ssl, NULL );
+
+    return( ret );
+}
+
+static void async_engine_cancel( mbedtls_ssl_context *ssl )
+{
+    mbedtls_ssl_async_job *job = mbedtls_ssl_get_async_operation_data( ssl );
+    mbedtls_ssl_async_engine *engine;
+    mbedtls_ssl_async_job *cur, *prev = NULL;
+
+    if( job == NULL )
+        return;
+
+    engine = job->engine;
+
+    /* Cancel must not fail: leak the job rather than free it under a
+     * worker that may still be using it */
+    if( mbedtls_mutex_lock( &engine->mutex ) != 0 )
+    {
+        mbedtls_ssl_set_async_operation_data( ssl, NULL );
+        return;
+    }
+
+    engine->pending--;
+
+    if( job->state == ASYNC_JOB_RUNNING )
+    {
+        /* The worker frees the job when it is done with it */
+        job->state = ASYNC_JOB_CANCELLED;
+        job = NULL;
+    }
+    else if( job->state == ASYNC_JOB_QUEUED )
+    {
+        for( cur = engine->head; cur != job; cur = cur->next )
+            prev = cur;
+
+        if( prev == NULL )
+            engine->head = job->next;
+        else
+            prev->next = job->next;
+
+        if( engine->tail == job )
+            engine->tail = prev;
+
+        engine->queued--;
+    }
+
+    mbedtls_mutex_unlock( &engine->mutex );
+
+    if( job != NULL )
+        async_job_free( job );
+
+    mbedtls_ssl_set_async_operation_data( ssl, NULL );
+}
+
+void mbedtls_ssl_async_engine_init( mbedtls_ssl_async_engine *engine )
+{
+    memset( engine, 0, sizeof( mbedtls_ssl_async_engine ) );
+
+    engine->max_batch = MBEDTLS_SSL_ASYNC_ENGINE_MAX_BATCH;
+    engine->wake_fds[0] = -1;
+    engine->wake_fds[1] = -1;
+    engine->read_fd = -1;
+    engine->write_fd = -1;
+}
+
+int mbedtls_ssl_async_engine_set_batch( mbedtls_ssl_async_engine *engine,
+                                        size_t max_batch )
+{
+    if( max_batch == 0 || max_batch > MBEDTLS_SSL_ASYNC_ENGINE_MAX_BATCH ||
+        engine->worker_count != 0 )
+    {
+        return( MBEDTLS_ERR_SSL_BAD_INPUT_DATA );
+    }
+
+    engine->max_batch = max_batch;
+
+    return( 0 );
+}
+
+static void async_engine_close_fd( mbedtls_ssl_async_engine *engine )
+{
+    if( engine->wake_fds[0] >= 0 )
+        close( engine->wake_fds[0] );
+    if( engine->wake_fds[1] >= 0 )
+        close( engine->wake_fds[1] );
+    if( engine->write_fd >= 0 && engine->write_fd != engine->read_fd )
+        close( engine->write_fd );
+    if( engine->read_fd >= 0 )
+        close( engine->read_fd );
+
+    engine->wake_fds[0] = -1;
+    engine->wake_fds[1] = -1;
+    engine->read_fd = -1;
+    engine->write_fd = -1;
+}
+
+static int async_engine_open_fd( mbedtls_ssl_async_engine *engine )
+{
+#if !defined(__linux__)
+    int fds[2];
+#endif
+
+    /* Workers block on the read end of the wakeup pipe */
+    if( pipe( engine->wake_fds ) != 0 )
+    {
+        engine->wake_fds[0] = -1;
+        engine->wake_fds[1] = -1;
+        return( -1 );
+    }
+
+    if( fcntl( engine->wake_fds[1], F_SETFL,
+               fcntl( engine->wake_fds[1], F_GETFL ) | O_NONBLOCK ) < 0 )
+    {
+        async_engine_close_fd( engine );
+        return( -1 );
+    }
+
+#if defined(__linux__)
+    engine->read_fd = eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC );
+    if( engine->read_fd < 0 )
+    {
+        async_engine_close_fd( engine );
+        return( -1 );
+    }
+    engine->write_fd = engine->read_fd;
+#else
+    if( pipe( fds ) != 0 )
+    {
+        async_engine_close_fd( engine );
+        return( -1 );
+    }
+
+    if( fcntl( fds[0], F_SETFL, fcntl( fds[0], F_GETFL ) | O_NONBLOCK ) < 0 ||
+        fcntl( fds[1], F_SETFL, fcntl( fds[1], F_GETFL ) | O_NONBLOCK ) < 0 )
+    {
+        close( fds[0] );
+        close( fds[1] );
+        async_engine_close_fd( engine );
+        return( -1 );
+    }
+
+    engine->read_fd = fds[0];
+    engine->write_fd = fds[1];
+#endif
+
+    return( 0 );
+}
+
+int mbedtls_ssl_async_engine_setup( mbedtls_ssl_async_engine *engine,
+                                    unsigned int workers,
+                                    int (*f_rng)(void *, unsigned char *, size_t),
+                                    void *p_rng )
+{
+    if( workers == 0 || workers > MBEDTLS_SSL_ASYNC_ENGINE_MAX_WORKERS ||
+        engine->worker_count != 0 )
+    {
+        return( MBEDTLS_ERR_SSL_BAD_INPUT_DATA );
+    }
+
+    if( async_engine_open_fd( engine ) != 0 )
+        return( MBEDTLS_ERR_SSL_INTERNAL_ERROR );
+
+    engine->f_rng = f_rng;
+    engine->p_rng = p_rng;
+    engine->shutdown = 0;
+
+    mbedtls_mutex_init( &engine->mutex );
+
+    /* The threading layer does not create threads: these are the only
+     * direct calls to pthreads */
+    while( engine->worker_count < workers )
+    {
+        mbedtls_ssl_async_worker *worker =
+            &engine->workers[engine->worker_count];
+
+        worker->engine = engine;
+        worker->key = NULL;
+
+        if( pthread_create( &worker->thread, NULL,
+                            async_engine_worker, worker ) != 0 )
+        {
+            mbedtls_ssl_async_engine_free( engine );
+            return( MBEDTLS_ERR_SSL_INTERNAL_ERROR );
+        }
+
+        engine->worker_count++;
+    }
+
+    return( 0 );
+}
+
+void mbedtls_ssl_async_engine_conf( mbedtls_ssl_config *conf,
+                                    mbedtls_ssl_async_engine *engine )
+{
+    mbedtls_ssl_conf_async_private_cb( conf,
+                                       async_engine_sign,
+                                       async_engine_decrypt,
+                                       async_engine_resume,
+                                       async_engine_cancel,
+                                       engine );
+}
+
+int mbedtls_ssl_async_engine_get_fd( const mbedtls_ssl_async_engine *engine )
+{
+    return( engine->read_fd );
+}
+
+void mbedtls_ssl_async_engine_ack( mbedtls_ssl_async_engine *engine )
+{
+    unsigned char buf[64];
+
+    if( engine->read_fd < 0 )
+        return;
+
+    /* A single read resets an eventfd, a pipe may need several */
+    while( read( engine->read_fd, buf, sizeof( buf ) ) > 0 )
+        continue;
+}
+
+size_t mbedtls_ssl_async_engine_pending( mbedtls_ssl_async_engine *engine )
+{
+    size_t pending;
+
+    if( engine->worker_count == 0 )
+        return( 0 );
+
+    if( mbedtls_mutex_lock( &engine->mutex ) != 0 )
+        return( 0 );
+    pending = engine->pending;
+    mbedtls_mutex_unlock( &engine->mutex );
+
+    return( pending );
+}
+
+void mbedtls_ssl_async_engine_free( mbedtls_ssl_async_engine *engine )
+{
+    mbedtls_ssl_async_job *job;
+    unsigned int i;
+
+    if( engine == NULL )
+        return;
+
+    if( engine->read_fd >= 0 )
+    {
+        if( mbedtls_mutex_lock( &engine->mutex ) == 0 )
+        {
+            engine->shutdown = 1;
+            mbedtls_mutex_unlock( &engine->mutex );
+        }
+
+        /* End of file on the wakeup pipe stops every worker, however
+         * many wakeups are still pending */
+        close( engine->wake_fds[1] );
+        engine->wake_fds[1] = -1;
+
+        for( i = 0; i < engine->worker_count; i++ )
+            pthread_join( engine->workers[i].thread, NULL );
+
+        while( ( job = engine->head ) != NULL )
+        {
+            engine->head = job->next;
+            async_job_free( job );
+        }
+
+        mbedtls_mutex_free( &engine->mutex );
+        async_engine_close_fd( engine );
+    }
+
+    mbedtls_platform_zeroize( engine, sizeof( mbedtls_ssl_async_engine ) );
+    engine->wake_fds[0] = -1;
+    engine->wake_fds[1] = -1;
+    engine->read_fd = -1;
+    engine->write_fd = -1;
+}
+
+#endif /* MBEDTLS_SSL_ASYNC_ENGINE_C */
@@ -39,6 +39,7 @@
 #define mbedtls_free      free
 #endif
 
+#include "mbedtls/alloc_profile.h"
 #include "mbedtls/ssl_cache.h"
 #include "mbedtls/ssl_internal.h"
 
@@ -230,7 +231,8 @@ int mbedtls_ssl_cache_set( void *data, const mbedtls_ssl_session *session )
             /*
              * max_entries not reached, create new entry
              */
-            cur = mbedtls_calloc( 1, sizeof(mbedtls_ssl_cache_entry) );
+            cur = MBEDTLS_ALLOC_PROFILE_CALLOC( NULL, MBEDTLS_ALLOC_PROFILE_CACHE,
+                                        sizeof(mbedtls_ssl_cache_entry) );
             if( cur == NULL )
             {
                 ret = 1;
@@ -255,7 +257,8 @@ int mbedtls_ssl_cache_set( void *data, const mbedtls_ssl_session *session )
      */
     if( cur->peer_cert.p != NULL )
     {
-        mbedtls_free( cur->peer_cert.p );
+        MBEDTLS_ALLOC_PROFILE_FREE( NULL, MBEDTLS_ALLOC_PROFILE_CACHE,
+                                    cur->peer_cert.p, cur->peer_cert.len );
         memset( &cur->peer_cert, 0, sizeof(mbedtls_x509_buf) );
     }
 #endif /* MBEDTLS_X509_CRT_PARSE_C && MBEDTLS_SSL_KEEP_PEER_CERTIFICATE */
@@ -278,7 +281,8 @@ int mbedtls_ssl_cache_set( void *data, const mbedtls_ssl_session *session )
     if( cur->session.peer_cert != NULL )
     {
         cur->peer_cert.p =
-            mbedtls_calloc( 1, cur->session.peer_cert->raw.len );
+            MBEDTLS_ALLOC_PROFILE_CALLOC( NULL, MBEDTLS_ALLOC_PROFILE_CACHE,
+                                          cur->session.peer_cert->raw.len );
         if( cur->peer_cert.p == NULL )
         {
             ret = 1;
@@ -338,10 +342,12 @@ void mbedtls_ssl_cache_free( mbedtls_ssl_cache_context *cache )
 
 #if defined(MBEDTLS_X509_CRT_PARSE_C) && \
     defined(MBEDTLS_SSL_KEEP_PEER_CERTIFICATE)
-        mbedtls_free( prv->peer_cert.p );
+        MBEDTLS_ALLOC_PROFILE_FREE( NULL, MBEDTLS_ALLOC_PROFILE_CACHE,
+                                    prv->peer_cert.p, prv->peer_cert.len );
 #endif /* MBEDTLS_X509_CRT_PARSE_C && MBEDTLS_SSL_KEEP_PEER_CERTIFICATE */
 
-        mbedtls_free( prv );
+        MBEDTLS_ALLOC_PROFILE_FREE( NULL, MBEDTLS_ALLOC_PROFILE_CACHE,
+                                    prv, sizeof(mbedtls_ssl_cache_entry) );
     }
 
 #if defined(MBEDTLS_THREADING_C)
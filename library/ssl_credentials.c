@@ -0,0 +1,353 @@
+/*
+ *  Reference-counted certificates and keys shared between configurations
+ *
+ *  Copyright (C) 2006-2019, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *  This file is part of mbed TLS (https://tls.mbed.org)
+ */
+/*
+ * A configuration holds one reference to its credentials, and each
+ * handshake takes another one when it starts. Replacing the credentials of
+ * a configuration only swaps a pointer under the configuration's mutex;
+ * the old credentials are freed by whoever drops the last reference,
+ * usually the last handshake that was using them.
+ */
+
+#if !defined(MBEDTLS_CONFIG_FILE)
+#include "mbedtls/config.h"
+#else
+#include MBEDTLS_CONFIG_FILE
+#endif
+
+#if defined(MBEDTLS_SSL_CREDENTIALS_C)
+
+#if defined(MBEDTLS_PLATFORM_C)
+#include "mbedtls/platform.h"
+#else
+#include <stdlib.h>
+#define mbedtls_calloc    calloc
+#define mbedtls_free      free
+#endif
+
+#include "mbedtls/ssl_credentials.h"
+#include "mbedtls/ssl_internal.h"
+
+int mbedtls_ssl_credentials_new( mbedtls_ssl_credentials **creds )
+{
+    mbedtls_ssl_credentials *c;
+
+    c = mbedtls_calloc( 1, sizeof( mbedtls_ssl_credentials ) );
+    if( c == NULL )
+        return( MBEDTLS_ERR_SSL_ALLOC_FAILED );
+
+    mbedtls_x509_crt_init( &c->ca_chain );
+#if defined(MBEDTLS_X509_CRL_PARSE_C)
+    mbedtls_x509_crl_init( &c->ca_crl );
+#endif
+#if defined(MBEDTLS_THREADING_C)
+    mbedtls_mutex_init( &c->mutex );
+#endif
+    c->refs = 1;
+
+    *creds = c;
+
+    return( 0 );
+}
+
+static void ssl_credentials_free( mbedtls_ssl_credentials *creds )
+{
+    mbedtls_ssl_key_cert *cur;
+
+    for( cur = creds->key_cert; cur != NULL; cur = cur->next )
+    {
+        mbedtls_x509_crt_free( cur->cert );
+        mbedtls_free( cur->cert );
+        mbedtls_pk_free( cur->key );
+        mbedtls_free( cur->key );
+    }
+    mbedtls_ssl_key_cert_free( creds->key_cert );
+
+    mbedtls_x509_crt_free( &creds->ca_chain );
+#if defined(MBEDTLS_X509_CRL_PARSE_C)
+    mbedtls_x509_crl_free( &creds->ca_crl );
+#endif
+#if defined(MBEDTLS_THREADING_C)
+    mbedtls_mutex_free( &creds->mutex );
+#endif
+
+    mbedtls_free( creds );
+}
+
+void mbedtls_ssl_credentials_release( mbedtls_ssl_credentials *creds )
+{
+    unsigned int refs;
+
+    if( creds == NULL )
+        return;
+
+#if defined(MBEDTLS_THREADING_C)
+    if( mbedtls_mutex_lock( &creds->mutex ) != 0 )
+        return;
+#endif
+
+    refs = --creds->refs;
+
+#if defined(MBEDTLS_THREADING_C)
+    if( mbedtls_mutex_unlock( &creds->mutex ) != 0 )
+        return;
+#endif
+
+    if( refs == 0 )
+        ssl_credentials_free( creds );
+}
+
+/*
+ * Take a reference, and mark the credentials as immutable if attach is set
+ */
+static int ssl_credentials_ref( mbedtls_ssl_credentials *creds, int attach )
+{
+#if defined(MBEDTLS_THREADING_C)
+    if( mbedtls_mutex_lock( &creds->mutex ) != 0 )
+        return( MBEDTLS_ERR_SSL_INTERNAL_ERROR );
+#endif
+
+    creds->refs++;
+    if( attach )
+        creds->frozen = 1;
+
+#if defined(MBEDTLS_THREADING_C)
+    if( mbedtls_mutex_unlock( &creds->mutex ) != 0 )
+        return( MBEDTLS_ERR_SSL_INTERNAL_ERROR );
+#endif
+
+    return( 0 );
+}
+
+/*
+ * Credentials may only be filled before they are attached. Filling and
+ * attaching happen in the same thread, so the flag is read without the lock.
+ */
+static int ssl_credentials_check_mutable( const mbedtls_ssl_credentials *creds )
+{
+    if( creds == NULL || creds->frozen )
+        return( MBEDTLS_ERR_SSL_BAD_INPUT_DATA );
+
+    return( 0 );
+}
+
+static int ssl_credentials_alloc_pair( mbedtls_x509_crt **cert,
+                                       mbedtls_pk_context **key )
+{
+    *cert = mbedtls_calloc( 1, sizeof( mbedtls_x509_crt ) );
+    *key = mbedtls_calloc( 1, sizeof( mbedtls_pk_context ) );
+
+    if( *cert == NULL || *key == NULL )
+    {
+        mbedtls_free( *cert );
+        mbedtls_free( *key );
+        return( MBEDTLS_ERR_SSL_ALLOC_FAILED );
+    }
+
+    mbedtls_x509_crt_init( *cert );
+    mbedtls_pk_init( *key );
+
+    return( 0 );
+}
+
+static void ssl_credentials_free_pair( mbedtls_x509_crt *cert,
+                                       mbedtls_pk_context *key )
+{
+    mbedtls_x509_crt_free( cert );
+    mbedtls_free( cert );
+    mbedtls_pk_free( key );
+    mbedtls_free( key );
+}
+
+int mbedtls_ssl_credentials_add_own_cert( mbedtls_ssl_credentials *creds,
+                                          const unsigned char *crt,
+                                          size_t crt_len,
+                                          const unsigned char *key,
+                                          size_t key_len,
+                                          const unsigned char *pwd,
+                                          size_t pwd_len )
+{
+    int ret;
+    mbedtls_x509_crt *cert;
+    mbedtls_pk_context *pk;
+
+    if( ( ret = ssl_credentials_check_mutable( creds ) ) != 0 )
+        return( ret );
+
+    if( ( ret = ssl_credentials_alloc_pair( &cert, &pk ) ) != 0 )
+        return( ret );
+
+    if( ( ret = mbedtls_x509_crt_parse( cert, crt, crt_len ) ) != 0 ||
+        ( ret = mbedtls_pk_parse_key( pk, key, key_len, pwd, pwd_len ) ) != 0 ||
+        ( ret = mbedtls_ssl_key_cert_append( &creds->key_cert,
+                                             cert, pk ) ) != 0 )
+    {
+        ssl_credentials_free_pair( cert, pk );
+        return( ret );
+    }
+
+    return( 0 );
+}
+
+int mbedtls_ssl_credentials_add_ca( mbedtls_ssl_credentials *creds,
+                                    const unsigned char *buf, size_t len )
+{
+    int ret;
+
+    if( ( ret = ssl_credentials_check_mutable( creds ) ) != 0 )
+        return( ret );
+
+    return( mbedtls_x509_crt_parse( &creds->ca_chain, buf, len ) );
+}
+
+#if defined(MBEDTLS_X509_CRL_PARSE_C)
+int mbedtls_ssl_credentials_add_crl( mbedtls_ssl_credentials *creds,
+                                     const unsigned char *buf, size_t len )
+{
+    int ret;
+
+    if( ( ret = ssl_credentials_check_mutable( creds ) ) != 0 )
+        return( ret );
+
+    return( mbedtls_x509_crl_parse( &creds->ca_crl, buf, len ) );
+}
+#endif /* MBEDTLS_X509_CRL_PARSE_C */
+
+#if defined(MBEDTLS_FS_IO)
+int mbedtls_ssl_credentials_add_own_cert_file( mbedtls_ssl_credentials *creds,
+                                               const char *crt_path,
+                                               const char *key_path,
+                                               const char *pwd )
+{
+    int ret;
+    mbedtls_x509_crt *cert;
+    mbedtls_pk_context *pk;
+
+    if( ( ret = ssl_credentials_check_mutable( creds ) ) != 0 )
+        return( ret );
+
+    if( ( ret = ssl_credentials_alloc_pair( &cert, &pk ) ) != 0 )
+        return( ret );
+
+    if( ( ret = mbedtls_x509_crt_parse_file( cert, crt_path ) ) != 0 ||
+        ( ret = mbedtls_pk_parse_keyfile( pk, key_path, pwd ) ) != 0 ||
+        ( ret = mbedtls_ssl_key_cert_append( &creds->key_cert,
+                                             cert, pk ) ) != 0 )
+    {
+        ssl_credentials_free_pair( cert, pk );
+        return( ret );
+    }
+
+    return( 0 );
+}
+
+int mbedtls_ssl_credentials_add_ca_file( mbedtls_ssl_credentials *creds,
+                                         const char *path )
+{
+    int ret;
+
+    if( ( ret = ssl_credentials_check_mutable( creds ) ) != 0 )
+        return( ret );
+
+    return( mbedtls_x509_crt_parse_file( &creds->ca_chain, path ) );
+}
+
+int mbedtls_ssl_credentials_add_ca_path( mbedtls_ssl_credentials *creds,
+                                         const char *path )
+{
+    int ret;
+
+    if( ( ret = ssl_credentials_check_mutable( creds ) ) != 0 )
+        return( ret );
+
+    return( mbedtls_x509_crt_parse_path( &creds->ca_chain, path ) );
+}
+
+#if defined(MBEDTLS_X509_CRL_PARSE_C)
+int mbedtls_ssl_credentials_add_crl_file( mbedtls_ssl_credentials *creds,
+                                          const char *path )
+{
+    int ret;
+
+    if( ( ret = ssl_credentials_check_mutable( creds ) ) != 0 )
+        return( ret );
+
+    return( mbedtls_x509_crl_parse_file( &creds->ca_crl, path ) );
+}
+#endif /* MBEDTLS_X509_CRL_PARSE_C */
+#endif /* MBEDTLS_FS_IO */
+
+int mbedtls_ssl_conf_credentials( mbedtls_ssl_config *conf,
+                                  mbedtls_ssl_credentials *creds )
+{
+    int ret;
+    mbedtls_ssl_credentials *old;
+
+    if( creds != NULL && ( ret = ssl_credentials_ref( creds, 1 ) ) != 0 )
+        return( ret );
+
+#if defined(MBEDTLS_THREADING_C)
+    if( mbedtls_mutex_lock( &conf->credentials_mutex ) != 0 )
+    {
+        mbedtls_ssl_credentials_release( creds );
+        return( MBEDTLS_ERR_SSL_INTERNAL_ERROR );
+    }
+#endif
+
+    old = conf->credentials;
+    conf->credentials = creds;
+
+#if defined(MBEDTLS_THREADING_C)
+    if( mbedtls_mutex_unlock( &conf->credentials_mutex ) != 0 )
+        return( MBEDTLS_ERR_SSL_INTERNAL_ERROR );
+#endif
+
+    mbedtls_ssl_credentials_release( old );
+
+    return( 0 );
+}
+
+mbedtls_ssl_credentials *mbedtls_ssl_conf_get_credentials( const mbedtls_ssl_config *conf )
+{
+    mbedtls_ssl_credentials *creds;
+#if defined(MBEDTLS_THREADING_C)
+    mbedtls_threading_mutex_t *mutex =
+        (mbedtls_threading_mutex_t *) &conf->credentials_mutex;
+
+    if( mbedtls_mutex_lock( mutex ) != 0 )
+        return( NULL );
+#endif
+
+    creds = conf->credentials;
+    if( creds != NULL && ssl_credentials_ref( creds, 0 ) != 0 )
+        creds = NULL;
+
+#if defined(MBEDTLS_THREADING_C)
+    if( mbedtls_mutex_unlock( mutex ) != 0 )
+    {
+        mbedtls_ssl_credentials_release( creds );
+        return( NULL );
+    }
+#endif
+
+    return( creds );
+}
+
+#endif /* MBEDTLS_SSL_CREDENTIALS_C */
@@ -0,0 +1,676 @@
+/*
+ *  On-demand loading of the server certificates selected by SNI
+ *
+ *  Copyright (C) 2006-2019, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *  This file is part of mbed TLS (https://tls.mbed.org)
+ */
+/*
+ * Parsed hostnames are kept in a hash table and a list ordered by last use.
+ * Each handshake holds a reference on the entry it selected, released when
+ * the handshake ends; only entries without references are dropped, least
+ * recently used first, once the cache is over its size.
+ */
+
+/* Enable definition of mmap() and fstat() even when compiling with -std=c99.
+ * Must be set before config.h, which pulls in glibc's features.h indirectly.
+ * Harmless on other platforms. */
+#define _POSIX_C_SOURCE 200112L
+
+#if !defined(MBEDTLS_CONFIG_FILE)
+#include "mbedtls/config.h"
+#else
+#include MBEDTLS_CONFIG_FILE
+#endif
+
+#if defined(MBEDTLS_SSL_SNI_CACHE_C)
+
+#if defined(MBEDTLS_PLATFORM_C)
+#include "mbedtls/platform.h"
+#else
+#include <stdlib.h>
+#define mbedtls_calloc    calloc
+#define mbedtls_free      free
+#endif
+
+#include "mbedtls/ssl_sni_cache.h"
+#include "mbedtls/ssl_internal.h"
+#include "mbedtls/asn1.h"
+#include "mbedtls/platform_util.h"
+
+#include <string.h>
+
+#if defined(MBEDTLS_FS_IO)
+#include <stdio.h>
+#if defined(__unix__) || defined(__unix) || \
+    ( defined(__APPLE__) && defined(__MACH__) )
+#define SNI_FILE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#endif /* MBEDTLS_FS_IO */
+
+#define SNI_CACHE_MIN_BUCKETS   16
+
+struct mbedtls_ssl_sni_cache_entry
+{
+    mbedtls_ssl_sni_cache *cache;           /*!< cache of the entry         */
+    mbedtls_ssl_sni_cache_entry *next;      /*!< next entry in the bucket   */
+    mbedtls_ssl_sni_cache_entry *lru_prev;  /*!< more recently used entry   */
+    mbedtls_ssl_sni_cache_entry *lru_next;  /*!< less recently used entry   */
+    uint32_t hash;                          /*!< hash of the name           */
+    size_t refs;                            /*!< handshakes using the entry */
+
+    int loaded;                             /*!< source must be released    */
+    mbedtls_ssl_sni_source source;          /*!< buffers from the provider  */
+    mbedtls_x509_crt chain;                 /*!< parsed chain               */
+    mbedtls_pk_context key;                 /*!< parsed private key         */
+    mbedtls_ssl_key_cert *key_cert;         /*!< list given to handshakes   */
+
+    size_t len;                             /*!< length of the name         */
+    unsigned char *name;                    /*!< name in lowercase,
+                                                 following the structure    */
+};
+
+static unsigned char sni_cache_lower( unsigned char c )
+{
+    return( (unsigned char)( c >= 'A' && c <= 'Z' ? c + 32 : c ) );
+}
+
+/*
+ * 32-bit FNV-1a of the name in lowercase
+ */
+static uint32_t sni_cache_hash( const unsigned char *name, size_t len )
+{
+    uint32_t hash = 0x811C9DC5;
+    size_t i;
+
+    for( i = 0; i < len; i++ )
+    {
+        hash ^= sni_cache_lower( name[i] );
+        hash *= 0x01000193;
+    }
+
+    return( hash );
+}
+
+static mbedtls_ssl_sni_cache_entry *sni_cache_find( mbedtls_ssl_sni_cache *cache,
+                                                    const unsigned char *name,
+                                                    size_t len, uint32_t hash )
+{
+    mbedtls_ssl_sni_cache_entry *cur;
+    size_t i;
+
+    for( cur = cache->buckets[hash & ( cache->size - 1 )];
+         cur != NULL; cur = cur->next )
+    {
+        if( cur->hash != hash || cur->len != len )
+            continue;
+
+        for( i = 0; i < len; i++ )
+        {
+            if( sni_cache_lower( name[i] ) != cur->name[i] )
+                break;
+        }
+
+        if( i == len )
+            return( cur );
+    }
+
+    return( NULL );
+}
+
+/*
+ * Move an entry to the head of the LRU list, inserting it if needed
+ */
+static void sni_cache_touch( mbedtls_ssl_sni_cache *cache,
+                             mbedtls_ssl_sni_cache_entry *entry )
+{
+    if( cache->lru_head == entry )
+        return;
+
+    /* Unlink, if linked */
+    if( entry->lru_prev != NULL )
+        entry->lru_prev->lru_next = entry->lru_next;
+    if( entry->lru_next != NULL )
+        entry->lru_next->lru_prev = entry->lru_prev;
+    if( cache->lru_tail == entry )
+        cache->lru_tail = entry->lru_prev;
+
+    entry->lru_prev = NULL;
+    entry->lru_next = cache->lru_head;
+    if( cache->lru_head != NULL )
+        cache->lru_head->lru_prev = entry;
+    cache->lru_head = entry;
+    if( cache->lru_tail == NULL )
+        cache->lru_tail = entry;
+}
+
+static void sni_cache_unlink( mbedtls_ssl_sni_cache *cache,
+                              mbedtls_ssl_sni_cache_entry *entry )
+{
+    mbedtls_ssl_sni_cache_entry **cur;
+
+    for( cur = &cache->buckets[entry->hash & ( cache->size - 1 )];
+         *cur != entry; cur = &(*cur)->next )
+        continue;
+    *cur = entry->next;
+
+    if( entry->lru_prev != NULL )
+        entry->lru_prev->lru_next = entry->lru_next;
+    else
+        cache->lru_head = entry->lru_next;
+
+    if( entry->lru_next != NULL )
+        entry->lru_next->lru_prev = entry->lru_prev;
+    else
+        cache->lru_tail = entry->lru_prev;
+
+    entry->next = NULL;
+    cache->entries--;
+}
+
+/*
+ * Unlink the least recently used entries that no handshake uses until the
+ * cache is within its size, and return them as a list linked by next, to
+ * be freed once the lock is released.
+ */
+static mbedtls_ssl_sni_cache_entry *sni_cache_evict( mbedtls_ssl_sni_cache *cache )
+{
+    mbedtls_ssl_sni_cache_entry *cur, *prev, *evicted = NULL;
+
+    for( cur = cache->lru_tail;
+         cur != NULL && cache->entries > cache->max_entries;
+         cur = prev )
+    {
+        prev = cur->lru_prev;
+
+        if( cur->refs != 0 )
+            continue;
+
+        sni_cache_unlink( cache, cur );
+        cur->next = evicted;
+        evicted = cur;
+    }
+
+    return( evicted );
+}
+
+static void sni_cache_entry_free( mbedtls_ssl_sni_cache_entry *entry )
+{
+    mbedtls_ssl_sni_cache *cache = entry->cache;
+
+    mbedtls_ssl_key_cert_free( entry->key_cert );
+    mbedtls_x509_crt_free( &entry->chain );
+    mbedtls_pk_free( &entry->key );
+
+    /* The chain points into the source, release it last */
+    if( entry->loaded && cache->f_release != NULL )
+        cache->f_release( cache->p_provider, &entry->source );
+
+    mbedtls_free( entry );
+}
+
+static void sni_cache_list_free( mbedtls_ssl_sni_cache_entry *list )
+{
+    mbedtls_ssl_sni_cache_entry *next;
+
+    for( ; list != NULL; list = next )
+    {
+        next = list->next;
+        sni_cache_entry_free( list );
+    }
+}
+
+/*
+ * Parse concatenated DER certificates without copying them
+ */
+static int sni_cache_parse_chain( mbedtls_x509_crt *chain,
+                                  const unsigned char *buf, size_t buflen )
+{
+    int ret;
+    const unsigned char *end = buf + buflen;
+    unsigned char *p;
+    size_t len;
+
+    if( buflen == 0 )
+        return( MBEDTLS_ERR_X509_INVALID_FORMAT );
+
+    while( buf < end )
+    {
+        p = (unsigned char *) buf;
+        if( ( ret = mbedtls_asn1_get_tag( &p, end, &len,
+                MBEDTLS_ASN1_CONSTRUCTED | MBEDTLS_ASN1_SEQUENCE ) ) != 0 )
+        {
+            return( MBEDTLS_ERR_X509_INVALID_FORMAT + ret );
+        }
+
+        len += (size_t)( p - buf );
+        if( ( ret = mbedtls_x509_crt_parse_der_nocopy( chain, buf, len ) ) != 0 )
+            return( ret );
+
+        buf += len;
+    }
+
+    return( 0 );
+}
+
+/*
+ * Ask the provider for a hostname and parse the result into a new entry
+ */
+static int sni_cache_load( mbedtls_ssl_sni_cache *cache,
+                           const unsigned char *hostname, size_t len,
+                           uint32_t hash,
+                           mbedtls_ssl_sni_cache_entry **out )
+{
+    int ret;
+    size_t i;
+    mbedtls_ssl_sni_cache_entry *entry;
+
+    entry = mbedtls_calloc( 1, sizeof( mbedtls_ssl_sni_cache_entry ) + len );
+    if( entry == NULL )
+        return( MBEDTLS_ERR_SSL_ALLOC_FAILED );
+
+    entry->cache = cache;
+    entry->hash = hash;
+    entry->len = len;
+    entry->name = (unsigned char *)( entry + 1 );
+    for( i = 0; i < len; i++ )
+        entry->name[i] = sni_cache_lower( hostname[i] );
+
+    mbedtls_x509_crt_init( &entry->chain );
+    mbedtls_pk_init( &entry->key );
+
+    if( ( ret = cache->f_lookup( cache->p_provider, hostname, len,
+                                 &entry->source ) ) != 0 )
+    {
+        mbedtls_free( entry );
+        return( ret );
+    }
+    entry->loaded = 1;
+
+    if( ( ret = sni_cache_parse_chain( &entry->chain, entry->source.chain,
+                                       entry->source.chain_len ) ) != 0 ||
+        ( ret = mbedtls_pk_parse_key( &entry->key, entry->source.key,
+                                      entry->source.key_len, NULL, 0 ) ) != 0 ||
+        ( ret = mbedtls_ssl_key_cert_append( &entry->key_cert, &entry->chain,
+                                             &entry->key ) ) != 0 )
+    {
+        sni_cache_entry_free( entry );
+        return( ret );
+    }
+
+    *out = entry;
+
+    return( 0 );
+}
+
+/*
+ * Drop the reference of a handshake on its entry
+ */
+static void sni_cache_release( void *p_entry )
+{
+    mbedtls_ssl_sni_cache_entry *entry = (mbedtls_ssl_sni_cache_entry *) p_entry;
+    mbedtls_ssl_sni_cache *cache = entry->cache;
+    mbedtls_ssl_sni_cache_entry *evicted;
+
+#if defined(MBEDTLS_THREADING_C)
+    if( mbedtls_mutex_lock( &cache->mutex ) != 0 )
+        return;
+#endif
+
+    entry->refs--;
+    evicted = sni_cache_evict( cache );
+
+#if defined(MBEDTLS_THREADING_C)
+    if( mbedtls_mutex_unlock( &cache->mutex ) != 0 )
+        return;
+#endif
+
+    sni_cache_list_free( evicted );
+}
+
+void mbedtls_ssl_sni_cache_init( mbedtls_ssl_sni_cache *cache )
+{
+    memset( cache, 0, sizeof( mbedtls_ssl_sni_cache ) );
+
+#if defined(MBEDTLS_THREADING_C)
+    mbedtls_mutex_init( &cache->mutex );
+#endif
+}
+
+int mbedtls_ssl_sni_cache_setup( mbedtls_ssl_sni_cache *cache,
+                                 mbedtls_ssl_sni_lookup_t *f_lookup,
+                                 mbedtls_ssl_sni_release_t *f_release,
+                                 void *p_provider,
+                                 size_t max_entries )
+{
+    size_t size = SNI_CACHE_MIN_BUCKETS;
+
+    if( cache == NULL || f_lookup == NULL || cache->buckets != NULL )
+        return( MBEDTLS_ERR_SSL_BAD_INPUT_DATA );
+
+    if( max_entries == 0 )
+        max_entries = MBEDTLS_SSL_SNI_CACHE_DEFAULT_MAX_ENTRIES;
+
+    /* One bucket per entry kept, the table is never resized */
+    while( size < max_entries && size * 2 > size )
+        size *= 2;
+
+    cache->buckets = mbedtls_calloc( size,
+                                     sizeof( mbedtls_ssl_sni_cache_entry * ) );
+    if( cache->buckets == NULL )
+        return( MBEDTLS_ERR_SSL_ALLOC_FAILED );
+
+    cache->size = size;
+    cache->max_entries = max_entries;
+    cache->f_lookup = f_lookup;
+    cache->f_release = f_release;
+    cache->p_provider = p_provider;
+
+    return( 0 );
+}
+
+int mbedtls_ssl_sni_cache_get( void *p_cache,
+                               mbedtls_ssl_context *ssl,
+                               const unsigned char *hostname,
+                               size_t len )
+{
+    int ret;
+    mbedtls_ssl_sni_cache *cache = (mbedtls_ssl_sni_cache *) p_cache;
+    mbedtls_ssl_sni_cache_entry *entry, *loaded = NULL, *evicted = NULL;
+    uint32_t hash;
+
+    if( cache == NULL || cache->buckets == NULL ||
+        len == 0 || len > MBEDTLS_SSL_MAX_HOST_NAME_LEN )
+    {
+        return( MBEDTLS_ERR_SSL_BAD_INPUT_DATA );
+    }
+
+    hash = sni_cache_hash( hostname, len );
+
+#if defined(MBEDTLS_THREADING_C)
+    if( ( ret = mbedtls_mutex_lock( &cache->mutex ) ) != 0 )
+        return( ret );
+#endif
+
+    entry = sni_cache_find( cache, hostname, len, hash );
+    if( entry != NULL )
+    {
+        entry->refs++;
+        sni_cache_touch( cache, entry );
+    }
+
+#if defined(MBEDTLS_THREADING_C)
+    if( ( ret = mbedtls_mutex_unlock( &cache->mutex ) ) != 0 )
+        return( ret );
+#endif
+
+    if( entry == NULL )
+    {
+        /* Parse without the lock, other hostnames need not wait */
+        if( ( ret = sni_cache_load( cache, hostname, len, hash,
+                                    &loaded ) ) != 0 )
+            return( ret );
+
+#if defined(MBEDTLS_THREADING_C)
+        if( ( ret = mbedtls_mutex_lock( &cache->mutex ) ) != 0 )
+        {
+            sni_cache_entry_free( loaded );
+            return( ret );
+        }
+#endif
+
+        /* Another handshake may have loaded the same hostname meanwhile */
+        entry = sni_cache_find( cache, hostname, len, hash );
+        if( entry == NULL )
+        {
+            entry = loaded;
+            loaded = NULL;
+
+            entry->next = cache->buckets[hash & ( cache->size - 1 )];
+            cache->buckets[hash & ( cache->size - 1 )] = entry;
+            cache->entries++;
+        }
+
+        entry->refs++;
+        sni_cache_touch( cache, entry );
+        evicted = sni_cache_evict( cache );
+
+#if defined(MBEDTLS_THREADING_C)
+        if( ( ret = mbedtls_mutex_unlock( &cache->mutex ) ) != 0 )
+            return( ret );
+#endif
+
+        if( loaded != NULL )
+            sni_cache_entry_free( loaded );
+        sni_cache_list_free( evicted );
+    }
+
+    mbedtls_ssl_set_hs_key_cert_list( ssl, entry->key_cert );
+    mbedtls_ssl_set_hs_sni_release( ssl, sni_cache_release, entry );
+
+    return( 0 );
+}
+
+void mbedtls_ssl_sni_cache_free( mbedtls_ssl_sni_cache *cache )
+{
+    mbedtls_ssl_sni_cache_entry *cur, *next;
+
+    if( cache == NULL )
+        return;
+
+    for( cur = cache->lru_head; cur != NULL; cur = next )
+    {
+        next = cur->lru_next;
+        sni_cache_entry_free( cur );
+    }
+
+    mbedtls_free( cache->buckets );
+
+#if defined(MBEDTLS_THREADING_C)
+    mbedtls_mutex_free( &cache->mutex );
+#endif
+
+    mbedtls_platform_zeroize( cache, sizeof( mbedtls_ssl_sni_cache ) );
+}
+
+#if defined(MBEDTLS_FS_IO)
+/*
+ * Build "<dir>/<hostname><suffix>", accepting only hostnames that cannot
+ * escape the directory
+ */
+static char *sni_file_path( const char *dir, const unsigned char *hostname,
+                            size_t len, const char *suffix )
+{
+    size_t dir_len = strlen( dir ), suffix_len = strlen( suffix ), i;
+    unsigned char c;
+    char *path;
+
+    if( len == 0 || hostname[0] == '.' )
+        return( NULL );
+
+    for( i = 0; i < len; i++ )
+    {
+        c = sni_cache_lower( hostname[i] );
+        if( ! ( ( c >= 'a' && c <= 'z' ) || ( c >= '0' && c <= '9' ) ||
+                c == '-' || c == '.' ) )
+            return( NULL );
+    }
+
+    path = mbedtls_calloc( 1, dir_len + 1 + len + suffix_len + 1 );
+    if( path == NULL )
+        return( NULL );
+
+    memcpy( path, dir, dir_len );
+    path[dir_len] = '/';
+    for( i = 0; i < len; i++ )
+        path[dir_len + 1 + i] = (char) sni_cache_lower( hostname[i] );
+    memcpy( path + dir_len + 1 + len, suffix, suffix_len + 1 );
+
+    return( path );
+}
+
+/*
+ * Read a whole file into a null-terminated heap buffer
+ */
+static int sni_file_read( const char *path, unsigned char **buf, size_t *n )
+{
+    FILE *f;
+    long size;
+
+    if( ( f = fopen( path, "rb" ) ) == NULL )
+        return( MBEDTLS_ERR_SSL_BAD_INPUT_DATA );
+
+    fseek( f, 0, SEEK_END );
+    if( ( size = ftell( f ) ) <= 0 )
+    {
+        fclose( f );
+        return( MBEDTLS_ERR_SSL_BAD_INPUT_DATA );
+    }
+    fseek( f, 0, SEEK_SET );
+
+    *n = (size_t) size;
+    if( *n + 1 == 0 ||
+        ( *buf = mbedtls_calloc( 1, *n + 1 ) ) == NULL )
+    {
+        fclose( f );
+        return( MBEDTLS_ERR_SSL_ALLOC_FAILED );
+    }
+
+    if( fread( *buf, 1, *n, f ) != *n )
+    {
+        fclose( f );
+        mbedtls_platform_zeroize( *buf, *n );
+        mbedtls_free( *buf );
+        return( MBEDTLS_ERR_SSL_BAD_INPUT_DATA );
+    }
+
+    fclose( f );
+    (*buf)[*n] = '\0';
+
+    return( 0 );
+}
+
+#if defined(SNI_FILE_MMAP)
+static int sni_file_map( const char *path, unsigned char **buf, size_t *n )
+{
+    int fd;
+    struct stat st;
+    void *p;
+
+    if( ( fd = open( path, O_RDONLY ) ) < 0 )
+        return( MBEDTLS_ERR_SSL_BAD_INPUT_DATA );
+
+    if( fstat( fd, &st ) != 0 || st.st_size <= 0 )
+    {
+        close( fd );
+        return( MBEDTLS_ERR_SSL_BAD_INPUT_DATA );
+    }
+
+    p = mmap( NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    close( fd );
+    if( p == MAP_FAILED )
+        return( MBEDTLS_ERR_SSL_BAD_INPUT_DATA );
+
+    *buf = p;
+    *n = (size_t) st.st_size;
+
+    return( 0 );
+}
+#endif /* SNI_FILE_MMAP */
+
+int mbedtls_ssl_sni_file_lookup( void *p_dir,
+                                 const unsigned char *hostname,
+                                 size_t len,
+                                 mbedtls_ssl_sni_source *source )
+{
+    int ret;
+    const char *dir = (const char *) p_dir;
+    char *path;
+    unsigned char *chain = NULL, *key = NULL;
+    size_t chain_len = 0, key_len = 0;
+
+    if( dir == NULL || source == NULL )
+        return( MBEDTLS_ERR_SSL_BAD_INPUT_DATA );
+
+    /* The chain is used in place, map it where possible */
+    if( ( path = sni_file_path( dir, hostname, len, ".der" ) ) == NULL )
+        return( MBEDTLS_ERR_SSL_BAD_INPUT_DATA );
+#if defined(SNI_FILE_MMAP)
+    ret = sni_file_map( path, &chain, &chain_len );
+#else
+    ret = sni_file_read( path, &chain, &chain_len );
+#endif
+    mbedtls_free( path );
+    if( ret != 0 )
+        return( ret );
+
+    /* The key is parsed into a copy, and PEM needs a terminator */
+    if( ( path = sni_file_path( dir, hostname, len, ".key" ) ) == NULL )
+        ret = MBEDTLS_ERR_SSL_ALLOC_FAILED;
+    else
+        ret = sni_file_read( path, &key, &key_len );
+    mbedtls_free( path );
+
+    memset( source, 0, sizeof( mbedtls_ssl_sni_source ) );
+    source->chain = chain;
+    source->chain_len = chain_len;
+
+    if( ret != 0 )
+    {
+        mbedtls_ssl_sni_file_release( p_dir, source );
+        return( ret );
+    }
+
+    source->key = key;
+    /* Count the terminator of a PEM key, as mbedtls_pk_parse_key() wants */
+    source->key_len = strstr( (const char *) key, "-----BEGIN" ) != NULL ?
+                      key_len + 1 : key_len;
+
+    return( 0 );
+}
+
+void mbedtls_ssl_sni_file_release( void *p_dir,
+                                   mbedtls_ssl_sni_source *source )
+{
+    ((void) p_dir);
+
+    if( source == NULL )
+        return;
+
+    if( source->chain != NULL )
+    {
+#if defined(SNI_FILE_MMAP)
+        munmap( (void *) source->chain, source->chain_len );
+#else
+        mbedtls_free( (void *) source->chain );
+#endif
+    }
+
+    if( source->key != NULL )
+    {
+        mbedtls_platform_zeroize( (void *) source->key, source->key_len );
+        mbedtls_free( (void *) source->key );
+    }
+
+    memset( source, 0, sizeof( mbedtls_ssl_sni_source ) );
+}
+#endif /* MBEDTLS_FS_IO */
+
+#endif /* MBEDTLS_SSL_SNI_CACHE_C */
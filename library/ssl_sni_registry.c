@@ -0,0 +1,362 @@
+/*
+ *  Selection of the server certificate by hostname
+ *
+ *  Copyright (C) 2006-2019, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *  This file is part of mbed TLS (https://tls.mbed.org)
+ */
+/*
+ * The registry keeps two chained hash tables: one keyed by the full
+ * hostname, and one keyed by the part of wildcard names after "*.".
+ * Names are stored in lowercase and hashed with FNV-1a, folding the case
+ * of the name sent by the client on the fly.
+ */
+
+#if !defined(MBEDTLS_CONFIG_FILE)
+#include "mbedtls/config.h"
+#else
+#include MBEDTLS_CONFIG_FILE
+#endif
+
+#if defined(MBEDTLS_SSL_SNI_REGISTRY_C)
+
+#if defined(MBEDTLS_PLATFORM_C)
+#include "mbedtls/platform.h"
+#else
+#include <stdlib.h>
+#define mbedtls_calloc    calloc
+#define mbedtls_free      free
+#endif
+
+#include "mbedtls/ssl_sni_registry.h"
+#include "mbedtls/ssl_internal.h"
+
+#include <string.h>
+
+#define SNI_REGISTRY_MIN_BUCKETS    16
+
+struct mbedtls_ssl_sni_entry
+{
+    mbedtls_ssl_sni_entry *next;        /*!< next entry in the bucket       */
+    uint32_t hash;                      /*!< hash of the name               */
+    size_t len;                         /*!< length of the name             */
+    unsigned char *name;                /*!< name in lowercase, following
+                                             the structure                  */
+    mbedtls_ssl_key_cert *key_cert;     /*!< key/cert pairs of the name     */
+    mbedtls_x509_crt *ca_chain;         /*!< trusted CAs, or NULL           */
+    mbedtls_x509_crl *ca_crl;           /*!< CRLs of the trusted CAs        */
+    int authmode;                       /*!< authmode, or VERIFY_UNSET      */
+};
+
+static unsigned char sni_lower( unsigned char c )
+{
+    return( (unsigned char)( c >= 'A' && c <= 'Z' ? c + 32 : c ) );
+}
+
+/*
+ * 32-bit FNV-1a of the name in lowercase
+ */
+static uint32_t sni_hash( const unsigned char *name, size_t len )
+{
+    uint32_t hash = 0x811C9DC5;
+    size_t i;
+
+    for( i = 0; i < len; i++ )
+    {
+        hash ^= sni_lower( name[i] );
+        hash *= 0x01000193;
+    }
+
+    return( hash );
+}
+
+static mbedtls_ssl_sni_entry *sni_find( mbedtls_ssl_sni_entry **table,
+                                        size_t size,
+                                        const unsigned char *name,
+                                        size_t len, uint32_t hash )
+{
+    mbedtls_ssl_sni_entry *cur;
+    size_t i;
+
+    if( size == 0 )
+        return( NULL );
+
+    for( cur = table[hash & ( size - 1 )]; cur != NULL; cur = cur->next )
+    {
+        if( cur->hash != hash || cur->len != len )
+            continue;
+
+        for( i = 0; i < len; i++ )
+        {
+            if( sni_lower( name[i] ) != cur->name[i] )
+                break;
+        }
+
+        if( i == len )
+            return( cur );
+    }
+
+    return( NULL );
+}
+
+/*
+ * Make room for one more entry, keeping at most one entry per bucket on
+ * average. The size of the table is always a power of two.
+ */
+static int sni_grow( mbedtls_ssl_sni_entry ***table, size_t *size,
+                     size_t count )
+{
+    mbedtls_ssl_sni_entry **new_table, *cur, *next;
+    size_t new_size, i;
+
+    if( count < *size )
+        return( 0 );
+
+    new_size = *size == 0 ? SNI_REGISTRY_MIN_BUCKETS : *size * 2;
+    if( new_size < *size )
+        return( MBEDTLS_ERR_SSL_ALLOC_FAILED );
+
+    new_table = mbedtls_calloc( new_size, sizeof( mbedtls_ssl_sni_entry * ) );
+    if( new_table == NULL )
+        return( MBEDTLS_ERR_SSL_ALLOC_FAILED );
+
+    for( i = 0; i < *size; i++ )
+    {
+        for( cur = (*table)[i]; cur != NULL; cur = next )
+        {
+            next = cur->next;
+            cur->next = new_table[cur->hash & ( new_size - 1 )];
+            new_table[cur->hash & ( new_size - 1 )] = cur;
+        }
+    }
+
+    mbedtls_free( *table );
+    *table = new_table;
+    *size = new_size;
+
+    return( 0 );
+}
+
+/*
+ * Split a registered name into its table and key: "*.example.com" is
+ * stored as "example.com" in the wildcard table.
+ */
+static int sni_key( const char *hostname,
+                    const unsigned char **key, size_t *len, int *wildcard )
+{
+    size_t hostname_len = strlen( hostname );
+
+    if( hostname_len == 0 || hostname_len > MBEDTLS_SSL_MAX_HOST_NAME_LEN )
+        return( MBEDTLS_ERR_SSL_BAD_INPUT_DATA );
+
+    if( hostname_len >= 2 && hostname[0] == '*' && hostname[1] == '.' )
+    {
+        if( hostname_len == 2 )
+            return( MBEDTLS_ERR_SSL_BAD_INPUT_DATA );
+
+        *key = (const unsigned char *) hostname + 2;
+        *len = hostname_len - 2;
+        *wildcard = 1;
+    }
+    else
+    {
+        *key = (const unsigned char *) hostname;
+        *len = hostname_len;
+        *wildcard = 0;
+    }
+
+    return( 0 );
+}
+
+void mbedtls_ssl_sni_registry_init( mbedtls_ssl_sni_registry *registry )
+{
+    memset( registry, 0, sizeof( mbedtls_ssl_sni_registry ) );
+}
+
+int mbedtls_ssl_sni_registry_add( mbedtls_ssl_sni_registry *registry,
+                                  const char *hostname,
+                                  mbedtls_x509_crt *own_cert,
+                                  mbedtls_pk_context *pk_key )
+{
+    int ret;
+    int wildcard;
+    const unsigned char *key;
+    size_t len, i;
+    uint32_t hash;
+    mbedtls_ssl_sni_entry ***table, *entry;
+    size_t *size, *count;
+
+    if( registry == NULL || hostname == NULL )
+        return( MBEDTLS_ERR_SSL_BAD_INPUT_DATA );
+
+    if( ( ret = sni_key( hostname, &key, &len, &wildcard ) ) != 0 )
+        return( ret );
+
+    if( wildcard )
+    {
+        table = &registry->wildcard;
+        size = &registry->wildcard_size;
+        count = &registry->wildcard_count;
+    }
+    else
+    {
+        table = &registry->exact;
+        size = &registry->exact_size;
+        count = &registry->exact_count;
+    }
+
+    hash = sni_hash( key, len );
+
+    entry = sni_find( *table, *size, key, len, hash );
+    if( entry != NULL )
+        return( mbedtls_ssl_key_cert_append( &entry->key_cert,
+                                             own_cert, pk_key ) );
+
+    if( ( ret = sni_grow( table, size, *count ) ) != 0 )
+        return( ret );
+
+    entry = mbedtls_calloc( 1, sizeof( mbedtls_ssl_sni_entry ) + len );
+    if( entry == NULL )
+        return( MBEDTLS_ERR_SSL_ALLOC_FAILED );
+
+    if( ( ret = mbedtls_ssl_key_cert_append( &entry->key_cert,
+                                             own_cert, pk_key ) ) != 0 )
+    {
+        mbedtls_free( entry );
+        return( ret );
+    }
+
+    entry->hash = hash;
+    entry->len = len;
+    entry->name = (unsigned char *)( entry + 1 );
+    for( i = 0; i < len; i++ )
+        entry->name[i] = sni_lower( key[i] );
+    entry->authmode = MBEDTLS_SSL_VERIFY_UNSET;
+
+    entry->next = (*table)[hash & ( *size - 1 )];
+    (*table)[hash & ( *size - 1 )] = entry;
+    (*count)++;
+
+    return( 0 );
+}
+
+int mbedtls_ssl_sni_registry_set_client_auth( mbedtls_ssl_sni_registry *registry,
+                                              const char *hostname,
+                                              mbedtls_x509_crt *ca_chain,
+                                              mbedtls_x509_crl *ca_crl,
+                                              int authmode )
+{
+    int ret;
+    int wildcard;
+    const unsigned char *key;
+    size_t len;
+    mbedtls_ssl_sni_entry *entry;
+
+    if( registry == NULL || hostname == NULL )
+        return( MBEDTLS_ERR_SSL_BAD_INPUT_DATA );
+
+    if( ( ret = sni_key( hostname, &key, &len, &wildcard ) ) != 0 )
+        return( ret );
+
+    if( wildcard )
+        entry = sni_find( registry->wildcard, registry->wildcard_size,
+                          key, len, sni_hash( key, len ) );
+    else
+        entry = sni_find( registry->exact, registry->exact_size,
+                          key, len, sni_hash( key, len ) );
+
+    if( entry == NULL )
+        return( MBEDTLS_ERR_SSL_BAD_INPUT_DATA );
+
+    entry->ca_chain = ca_chain;
+    entry->ca_crl = ca_crl;
+    entry->authmode = authmode;
+
+    return( 0 );
+}
+
+int mbedtls_ssl_sni_registry_get( void *p_registry,
+                                  mbedtls_ssl_context *ssl,
+                                  const unsigned char *hostname,
+                                  size_t len )
+{
+    mbedtls_ssl_sni_registry *registry = (mbedtls_ssl_sni_registry *) p_registry;
+    mbedtls_ssl_sni_entry *entry;
+    const unsigned char *dot;
+
+    if( registry == NULL || len == 0 || len > MBEDTLS_SSL_MAX_HOST_NAME_LEN )
+        return( -1 );
+
+    entry = sni_find( registry->exact, registry->exact_size,
+                      hostname, len, sni_hash( hostname, len ) );
+
+    /* A wildcard stands for exactly one label, the first one */
+    if( entry == NULL && registry->wildcard_count != 0 &&
+        ( dot = memchr( hostname, '.', len ) ) != NULL && dot != hostname )
+    {
+        const unsigned char *suffix = dot + 1;
+        size_t suffix_len = len - (size_t)( suffix - hostname );
+
+        if( suffix_len != 0 )
+            entry = sni_find( registry->wildcard, registry->wildcard_size,
+                              suffix, suffix_len,
+                              sni_hash( suffix, suffix_len ) );
+    }
+
+    if( entry == NULL )
+        return( -1 );
+
+    if( entry->ca_chain != NULL )
+        mbedtls_ssl_set_hs_ca_chain( ssl, entry->ca_chain, entry->ca_crl );
+
+    if( entry->authmode != MBEDTLS_SSL_VERIFY_UNSET )
+        mbedtls_ssl_set_hs_authmode( ssl, entry->authmode );
+
+    mbedtls_ssl_set_hs_key_cert_list( ssl, entry->key_cert );
+
+    return( 0 );
+}
+
+static void sni_table_free( mbedtls_ssl_sni_entry **table, size_t size )
+{
+    mbedtls_ssl_sni_entry *cur, *next;
+    size_t i;
+
+    for( i = 0; i < size; i++ )
+    {
+        for( cur = table[i]; cur != NULL; cur = next )
+        {
+            next = cur->next;
+            mbedtls_ssl_key_cert_free( cur->key_cert );
+            mbedtls_free( cur );
+        }
+    }
+
+    mbedtls_free( table );
+}
+
+void mbedtls_ssl_sni_registry_free( mbedtls_ssl_sni_registry *registry )
+{
+    if( registry == NULL )
+        return;
+
+    sni_table_free( registry->exact, registry->exact_size );
+    sni_table_free( registry->wildcard, registry->wildcard_size );
+
+    memset( registry, 0, sizeof( mbedtls_ssl_sni_registry ) );
+}
+
+#endif /* MBEDTLS_SSL_SNI_REGISTRY_C */
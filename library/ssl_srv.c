@@ -824,7 +824,7 @@ static int ssl_pick_cert( mbedtls_ssl_context *ssl,
         list = ssl->handshake->sni_key_cert;
     else
 #endif
-        list = ssl->conf->key_cert;
+        list = mbedtls_ssl_default_key_cert( ssl );
 
     if( pk_alg == MBEDTLS_PK_NONE )
         return( 0 );
@@ -1027,6 +1027,40 @@ static int ssl_ciphersuite_match( mbedtls_ssl_context *ssl, int suite_id,
     return( 0 );
 }
 
+/*
+ * Once the ciphersuite is chosen, the rest of the handshake only needs the
+ * transcript digest of its PRF. The exception is TLS 1.2 with a possible
+ * CertificateRequest: the client may then sign its CertificateVerify with
+ * any of the hashes we advertise, so all digests are kept running.
+ */
+static void ssl_srv_select_checksum( mbedtls_ssl_context *ssl,
+                        const mbedtls_ssl_ciphersuite_t *ciphersuite_info )
+{
+#if defined(MBEDTLS_SSL_PROTO_TLS1_2) && \
+    defined(MBEDTLS_KEY_EXCHANGE__CERT_REQ_ALLOWED__ENABLED)
+    int authmode;
+
+#if defined(MBEDTLS_SSL_SERVER_NAME_INDICATION)
+    if( ssl->handshake->sni_authmode != MBEDTLS_SSL_VERIFY_UNSET )
+        authmode = ssl->handshake->sni_authmode;
+    else
+#endif
+        authmode = ssl->conf->authmode;
+
+    if( ssl->minor_ver == MBEDTLS_SSL_MINOR_VERSION_3 &&
+        authmode != MBEDTLS_SSL_VERIFY_NONE &&
+        mbedtls_ssl_ciphersuite_cert_req_allowed( ciphersuite_info ) )
+    {
+        MBEDTLS_SSL_DEBUG_MSG( 3, ( "keep all handshake digests" ) );
+        return;
+    }
+#endif /* MBEDTLS_SSL_PROTO_TLS1_2 &&
+          MBEDTLS_KEY_EXCHANGE__CERT_REQ_ALLOWED__ENABLED */
+
+    MBEDTLS_SSL_DEBUG_MSG( 3, ( "use a single handshake digest" ) );
+    mbedtls_ssl_optimize_checksum( ssl, ciphersuite_info );
+}
+
 #if defined(MBEDTLS_SSL_SRV_SUPPORT_SSLV2_CLIENT_HELLO)
 static int ssl_parse_client_hello_v2( mbedtls_ssl_context *ssl )
 {
@@ -1269,6 +1303,8 @@ have_ciphersuite_v2:
     ssl->session_negotiate->ciphersuite = ciphersuites[i];
     ssl->handshake->ciphersuite_info = ciphersuite_info;
 
+    ssl_srv_select_checksum( ssl, ciphersuite_info );
+
     /*
      * SSLv2 Client Hello relevant renegotiation security checks
      */
@@ -1460,7 +1496,9 @@ read_record_header:
 
     MBEDTLS_SSL_DEBUG_BUF( 4, "record contents", buf, msg_len );
 
-    ssl->handshake->update_checksum( ssl, buf, msg_len );
+    /* The message is added to the handshake digests once the ciphersuite
+     * is known, see have_ciphersuite below. It stays in the input buffer
+     * until then. */
 
     /*
      * Handshake layer:
@@ -2123,6 +2161,11 @@ have_ciphersuite:
     ssl->session_negotiate->ciphersuite = ciphersuites[i];
     ssl->handshake->ciphersuite_info = ciphersuite_info;
 
+    /* The whole message, including the handshake header skipped above */
+    ssl_srv_select_checksum( ssl, ciphersuite_info );
+    ssl->handshake->update_checksum( ssl, ssl->in_msg,
+                                     msg_len + mbedtls_ssl_hs_hdr_len( ssl ) );
+
     ssl->state++;
 
 #if defined(MBEDTLS_SSL_PROTO_DTLS)
@@ -2953,6 +2996,8 @@ static int ssl_write_certificate_request( mbedtls_ssl_context *ssl )
 
     if( ssl->conf->cert_req_ca_list ==  MBEDTLS_SSL_CERT_REQ_CA_LIST_ENABLED )
     {
+        mbedtls_x509_crl *ca_crl;
+
         /* NOTE: If trusted certificates are provisioned
          *       via a CA callback (configured through
          *       `mbedtls_ssl_conf_ca_cb()`, then the
@@ -2963,7 +3008,7 @@ static int ssl_write_certificate_request( mbedtls_ssl_context *ssl )
             crt = ssl->handshake->sni_ca_chain;
         else
 #endif
-            crt = ssl->conf->ca_chain;
+            crt = mbedtls_ssl_default_ca_chain( ssl, &ca_crl );
 
         while( crt != NULL && crt->version != 0 )
         {
@@ -43,6 +43,7 @@
 #define mbedtls_free      free
 #endif
 
+#include "mbedtls/alloc_profile.h"
 #include "mbedtls/debug.h"
 #include "mbedtls/ssl.h"
 #include "mbedtls/ssl_internal.h"
@@ -63,6 +64,12 @@
 static void ssl_reset_in_out_pointers( mbedtls_ssl_context *ssl );
 static uint32_t ssl_get_hs_total_len( mbedtls_ssl_context const *ssl );
 
+/* Allocations accounted to the context, see mbedtls_ssl_get_alloc_profile() */
+#define SSL_ALLOC( ssl, cat, len )                                      \
+    MBEDTLS_ALLOC_PROFILE_CALLOC( &(ssl)->alloc_profile[cat], cat, len )
+#define SSL_FREE( ssl, cat, p, len )                                    \
+    MBEDTLS_ALLOC_PROFILE_FREE( &(ssl)->alloc_profile[cat], cat, p, len )
+
 /* Length of the "epoch" field in the record header */
 static inline size_t ssl_ep_len( const mbedtls_ssl_context *ssl )
 {
@@ -277,6 +284,10 @@ static void ssl_buffering_free( mbedtls_ssl_context *ssl );
 static void ssl_buffering_free_slot( mbedtls_ssl_context *ssl,
                                      uint8_t slot );
 static void ssl_free_buffered_record( mbedtls_ssl_context *ssl );
+static unsigned char *ssl_buffering_alloc( mbedtls_ssl_context *ssl,
+                                           size_t len );
+static void ssl_buffering_release( mbedtls_ssl_context *ssl,
+                                   unsigned char *data, size_t len );
 static int ssl_load_buffered_message( mbedtls_ssl_context *ssl );
 static int ssl_load_buffered_record( mbedtls_ssl_context *ssl );
 static int ssl_buffer_message( mbedtls_ssl_context *ssl );
@@ -358,6 +369,59 @@ static int ssl_get_remaining_payload_in_datagram( mbedtls_ssl_context const *ssl
     return( (int) remaining );
 }
 
+/*
+ * Initial retransmit timeout for a flight: derived from the round-trip time
+ * estimate if there is one (RFC 6298 section 2), hs_timeout_min otherwise.
+ */
+static uint32_t ssl_initial_retransmit_timeout( const mbedtls_ssl_context *ssl )
+{
+    uint32_t rto, var;
+
+    if( ssl->conf->f_clock == NULL || ssl->handshake->rtt_valid == 0 )
+        return( ssl->conf->hs_timeout_min );
+
+    var = ssl->handshake->rttvar;
+    if( var > ssl->conf->hs_timeout_max / 4 )
+        return( ssl->conf->hs_timeout_max );
+
+    rto = ssl->handshake->srtt + ( var == 0 ? 1 : 4 * var );
+
+    if( rto < ssl->handshake->srtt || rto > ssl->conf->hs_timeout_max )
+        rto = ssl->conf->hs_timeout_max;
+    if( rto < ssl->conf->hs_rto_min )
+        rto = ssl->conf->hs_rto_min;
+
+    return( rto );
+}
+
+/*
+ * Update the round-trip time estimate with a new measurement,
+ * as in RFC 6298 section 2 with alpha = 1/8 and beta = 1/4.
+ */
+static void ssl_update_rtt( mbedtls_ssl_context *ssl, uint32_t rtt )
+{
+    mbedtls_ssl_handshake_params * const hs = ssl->handshake;
+
+    if( hs->rtt_valid == 0 )
+    {
+        hs->srtt = rtt;
+        hs->rttvar = rtt / 2;
+        hs->rtt_valid = 1;
+    }
+    else
+    {
+        uint32_t delta = hs->srtt > rtt ? hs->srtt - rtt : rtt - hs->srtt;
+
+        /* Computed in 64 bits so that no sample can overflow */
+        hs->rttvar = (uint32_t)( ( 3 * (uint64_t) hs->rttvar + delta ) / 4 );
+        hs->srtt   = (uint32_t)( ( 7 * (uint64_t) hs->srtt + rtt ) / 8 );
+    }
+
+    MBEDTLS_SSL_DEBUG_MSG( 3, ( "rtt sample %u ms, srtt %u ms, rttvar %u ms",
+                                (unsigned) rtt, (unsigned) hs->srtt,
+                                (unsigned) hs->rttvar ) );
+}
+
 /*
  * Double the retransmit timeout value, within the allowed range,
  * returning -1 if the maximum value has already been reached.
@@ -375,7 +439,8 @@ static int ssl_double_retransmit_timeout( mbedtls_ssl_context *ssl )
      * This value is guaranteed to be deliverable (if not guaranteed to be
      * delivered) of any compliant IPv4 (and IPv6) network, and should work
      * on most non-IP stacks too. */
-    if( ssl->handshake->retransmit_timeout != ssl->conf->hs_timeout_min )
+    if( ssl->handshake->retransmit_timeout !=
+        ssl_initial_retransmit_timeout( ssl ) )
     {
         ssl->handshake->mtu = 508;
         MBEDTLS_SSL_DEBUG_MSG( 2, ( "mtu autoreduction to %d bytes", ssl->handshake->mtu ) );
@@ -399,7 +464,7 @@ static int ssl_double_retransmit_timeout( mbedtls_ssl_context *ssl )
 
 static void ssl_reset_retransmit_timeout( mbedtls_ssl_context *ssl )
 {
-    ssl->handshake->retransmit_timeout = ssl->conf->hs_timeout_min;
+    ssl->handshake->retransmit_timeout = ssl_initial_retransmit_timeout( ssl );
     MBEDTLS_SSL_DEBUG_MSG( 3, ( "update timeout value to %d millisecs",
                         ssl->handshake->retransmit_timeout ) );
 }
@@ -571,118 +636,369 @@ exit:
 }
 #endif /* MBEDTLS_SSL_PROTO_SSL3 */
 
-#if defined(MBEDTLS_SSL_PROTO_TLS1) || defined(MBEDTLS_SSL_PROTO_TLS1_1)
-static int tls1_prf( const unsigned char *secret, size_t slen,
-                     const char *label,
-                     const unsigned char *random, size_t rlen,
-                     unsigned char *dstbuf, size_t dlen )
+#if defined(MBEDTLS_SSL__PRF_HMAC)
+/*
+ * Hash primitives of the PRF HMAC, dispatched on the hash type
+ */
+static int ssl_prf_digest_starts( mbedtls_md_type_t md_type,
+                                  mbedtls_ssl_prf_digest *d )
 {
-    size_t nb, hs;
-    size_t i, j, k;
-    const unsigned char *S1, *S2;
-    unsigned char *tmp;
-    size_t tmp_len = 0;
-    unsigned char h_i[20];
-    const mbedtls_md_info_t *md_info;
-    mbedtls_md_context_t md_ctx;
-    int ret;
+    switch( md_type )
+    {
+#if defined(MBEDTLS_MD5_C)
+        case MBEDTLS_MD_MD5:
+            mbedtls_md5_init( &d->md5 );
+            return( mbedtls_md5_starts_ret( &d->md5 ) );
+#endif
+#if defined(MBEDTLS_SHA1_C)
+        case MBEDTLS_MD_SHA1:
+            mbedtls_sha1_init( &d->sha1 );
+            return( mbedtls_sha1_starts_ret( &d->sha1 ) );
+#endif
+#if defined(MBEDTLS_SHA256_C)
+        case MBEDTLS_MD_SHA256:
+            mbedtls_sha256_init( &d->sha256 );
+            return( mbedtls_sha256_starts_ret( &d->sha256, 0 ) );
+#endif
+#if defined(MBEDTLS_SHA512_C)
+        case MBEDTLS_MD_SHA384:
+            mbedtls_sha512_init( &d->sha512 );
+            return( mbedtls_sha512_starts_ret( &d->sha512, 1 ) );
+#endif
+        default:
+            return( MBEDTLS_ERR_SSL_INTERNAL_ERROR );
+    }
+}
 
-    mbedtls_md_init( &md_ctx );
+static int ssl_prf_digest_update( mbedtls_md_type_t md_type,
+                                  mbedtls_ssl_prf_digest *d,
+                                  const unsigned char *buf, size_t len )
+{
+    switch( md_type )
+    {
+#if defined(MBEDTLS_MD5_C)
+        case MBEDTLS_MD_MD5:
+            return( mbedtls_md5_update_ret( &d->md5, buf, len ) );
+#endif
+#if defined(MBEDTLS_SHA1_C)
+        case MBEDTLS_MD_SHA1:
+            return( mbedtls_sha1_update_ret( &d->sha1, buf, len ) );
+#endif
+#if defined(MBEDTLS_SHA256_C)
+        case MBEDTLS_MD_SHA256:
+            return( mbedtls_sha256_update_ret( &d->sha256, buf, len ) );
+#endif
+#if defined(MBEDTLS_SHA512_C)
+        case MBEDTLS_MD_SHA384:
+            return( mbedtls_sha512_update_ret( &d->sha512, buf, len ) );
+#endif
+        default:
+            return( MBEDTLS_ERR_SSL_INTERNAL_ERROR );
+    }
+}
 
-    tmp_len = 20 + strlen( label ) + rlen;
-    tmp = mbedtls_calloc( 1, tmp_len );
-    if( tmp == NULL )
+static int ssl_prf_digest_finish( mbedtls_md_type_t md_type,
+                                  mbedtls_ssl_prf_digest *d,
+                                  unsigned char *output )
+{
+    switch( md_type )
     {
-        ret = MBEDTLS_ERR_SSL_ALLOC_FAILED;
-        goto exit;
+#if defined(MBEDTLS_MD5_C)
+        case MBEDTLS_MD_MD5:
+            return( mbedtls_md5_finish_ret( &d->md5, output ) );
+#endif
+#if defined(MBEDTLS_SHA1_C)
+        case MBEDTLS_MD_SHA1:
+            return( mbedtls_sha1_finish_ret( &d->sha1, output ) );
+#endif
+#if defined(MBEDTLS_SHA256_C)
+        case MBEDTLS_MD_SHA256:
+            return( mbedtls_sha256_finish_ret( &d->sha256, output ) );
+#endif
+#if defined(MBEDTLS_SHA512_C)
+        case MBEDTLS_MD_SHA384:
+            return( mbedtls_sha512_finish_ret( &d->sha512, output ) );
+#endif
+        default:
+            return( MBEDTLS_ERR_SSL_INTERNAL_ERROR );
     }
+}
 
-    hs = ( slen + 1 ) / 2;
-    S1 = secret;
-    S2 = secret + slen - hs;
+static void ssl_prf_digest_clone( mbedtls_md_type_t md_type,
+                                  mbedtls_ssl_prf_digest *dst,
+                                  const mbedtls_ssl_prf_digest *src )
+{
+    switch( md_type )
+    {
+#if defined(MBEDTLS_MD5_C)
+        case MBEDTLS_MD_MD5:
+            mbedtls_md5_init( &dst->md5 );
+            mbedtls_md5_clone( &dst->md5, &src->md5 );
+            break;
+#endif
+#if defined(MBEDTLS_SHA1_C)
+        case MBEDTLS_MD_SHA1:
+            mbedtls_sha1_init( &dst->sha1 );
+            mbedtls_sha1_clone( &dst->sha1, &src->sha1 );
+            break;
+#endif
+#if defined(MBEDTLS_SHA256_C)
+        case MBEDTLS_MD_SHA256:
+            mbedtls_sha256_init( &dst->sha256 );
+            mbedtls_sha256_clone( &dst->sha256, &src->sha256 );
+            break;
+#endif
+#if defined(MBEDTLS_SHA512_C)
+        case MBEDTLS_MD_SHA384:
+            mbedtls_sha512_init( &dst->sha512 );
+            mbedtls_sha512_clone( &dst->sha512, &src->sha512 );
+            break;
+#endif
+        default:
+            break;
+    }
+}
 
-    nb = strlen( label );
-    memcpy( tmp + 20, label, nb );
-    memcpy( tmp + 20 + nb, random, rlen );
-    nb += rlen;
+static void ssl_prf_digest_free( mbedtls_md_type_t md_type,
+                                 mbedtls_ssl_prf_digest *d )
+{
+    switch( md_type )
+    {
+#if defined(MBEDTLS_MD5_C)
+        case MBEDTLS_MD_MD5:
+            mbedtls_md5_free( &d->md5 );
+            break;
+#endif
+#if defined(MBEDTLS_SHA1_C)
+        case MBEDTLS_MD_SHA1:
+            mbedtls_sha1_free( &d->sha1 );
+            break;
+#endif
+#if defined(MBEDTLS_SHA256_C)
+        case MBEDTLS_MD_SHA256:
+            mbedtls_sha256_free( &d->sha256 );
+            break;
+#endif
+#if defined(MBEDTLS_SHA512_C)
+        case MBEDTLS_MD_SHA384:
+            mbedtls_sha512_free( &d->sha512 );
+            break;
+#endif
+        default:
+            break;
+    }
+}
 
-    /*
-     * First compute P_md5(secret,label+random)[0..dlen]
-     */
-    if( ( md_info = mbedtls_md_info_from_type( MBEDTLS_MD_MD5 ) ) == NULL )
+/*
+ * Key the HMAC: absorb K ^ ipad and K ^ opad once, RFC 2104
+ */
+static int ssl_prf_hmac_setup( mbedtls_ssl_prf_hmac *ctx,
+                               mbedtls_md_type_t md_type,
+                               const unsigned char *key, size_t keylen )
+{
+    int ret;
+    size_t i, block_len;
+    unsigned char pad[128];
+    unsigned char sum[MBEDTLS_MD_MAX_SIZE];
+
+    memset( ctx, 0, sizeof( mbedtls_ssl_prf_hmac ) );
+    ctx->md_type = md_type;
+
+    switch( md_type )
     {
-        ret = MBEDTLS_ERR_SSL_INTERNAL_ERROR;
-        goto exit;
+        case MBEDTLS_MD_MD5:    ctx->md_len = 16; block_len = 64;  break;
+        case MBEDTLS_MD_SHA1:   ctx->md_len = 20; block_len = 64;  break;
+        case MBEDTLS_MD_SHA256: ctx->md_len = 32; block_len = 64;  break;
+        case MBEDTLS_MD_SHA384: ctx->md_len = 48; block_len = 128; break;
+        default:
+            return( MBEDTLS_ERR_SSL_INTERNAL_ERROR );
     }
 
-    if( ( ret = mbedtls_md_setup( &md_ctx, md_info, 1 ) ) != 0 )
+    if( keylen > block_len )
+    {
+        if( ( ret = ssl_prf_digest_starts( md_type, &ctx->inner ) ) != 0 ||
+            ( ret = ssl_prf_digest_update( md_type, &ctx->inner,
+                                           key, keylen ) ) != 0 ||
+            ( ret = ssl_prf_digest_finish( md_type, &ctx->inner,
+                                           sum ) ) != 0 )
+        {
+            goto exit;
+        }
+        ssl_prf_digest_free( md_type, &ctx->inner );
+
+        key = sum;
+        keylen = ctx->md_len;
+    }
+
+    memset( pad, 0x36, block_len );
+    for( i = 0; i < keylen; i++ )
+        pad[i] = (unsigned char)( pad[i] ^ key[i] );
+
+    if( ( ret = ssl_prf_digest_starts( md_type, &ctx->inner ) ) != 0 ||
+        ( ret = ssl_prf_digest_update( md_type, &ctx->inner,
+                                       pad, block_len ) ) != 0 )
     {
         goto exit;
     }
 
-    mbedtls_md_hmac_starts( &md_ctx, S1, hs );
-    mbedtls_md_hmac_update( &md_ctx, tmp + 20, nb );
-    mbedtls_md_hmac_finish( &md_ctx, 4 + tmp );
+    memset( pad, 0x5C, block_len );
+    for( i = 0; i < keylen; i++ )
+        pad[i] = (unsigned char)( pad[i] ^ key[i] );
 
-    for( i = 0; i < dlen; i += 16 )
+    if( ( ret = ssl_prf_digest_starts( md_type, &ctx->outer ) ) != 0 ||
+        ( ret = ssl_prf_digest_update( md_type, &ctx->outer,
+                                       pad, block_len ) ) != 0 )
     {
-        mbedtls_md_hmac_reset ( &md_ctx );
-        mbedtls_md_hmac_update( &md_ctx, 4 + tmp, 16 + nb );
-        mbedtls_md_hmac_finish( &md_ctx, h_i );
+        goto exit;
+    }
 
-        mbedtls_md_hmac_reset ( &md_ctx );
-        mbedtls_md_hmac_update( &md_ctx, 4 + tmp, 16 );
-        mbedtls_md_hmac_finish( &md_ctx, 4 + tmp );
+exit:
+    mbedtls_platform_zeroize( pad, sizeof( pad ) );
+    mbedtls_platform_zeroize( sum, sizeof( sum ) );
 
-        k = ( i + 16 > dlen ) ? dlen % 16 : 16;
+    return( ret );
+}
 
-        for( j = 0; j < k; j++ )
-            dstbuf[i + j]  = h_i[j];
-    }
+static void ssl_prf_hmac_free( mbedtls_ssl_prf_hmac *ctx )
+{
+    ssl_prf_digest_free( ctx->md_type, &ctx->inner );
+    ssl_prf_digest_free( ctx->md_type, &ctx->outer );
+    mbedtls_platform_zeroize( ctx, sizeof( mbedtls_ssl_prf_hmac ) );
+}
 
-    mbedtls_md_free( &md_ctx );
+/*
+ * output = HMAC( K, in1 + in2 + in3 ), the inputs are not concatenated
+ */
+static int ssl_prf_hmac( const mbedtls_ssl_prf_hmac *ctx,
+                         const unsigned char *in1, size_t len1,
+                         const unsigned char *in2, size_t len2,
+                         const unsigned char *in3, size_t len3,
+                         unsigned char *output )
+{
+    int ret;
+    mbedtls_ssl_prf_digest d;
+    unsigned char sum[MBEDTLS_MD_MAX_SIZE];
 
-    /*
-     * XOR out with P_sha1(secret,label+random)[0..dlen]
-     */
-    if( ( md_info = mbedtls_md_info_from_type( MBEDTLS_MD_SHA1 ) ) == NULL )
+    ssl_prf_digest_clone( ctx->md_type, &d, &ctx->inner );
+    if( ( ret = ssl_prf_digest_update( ctx->md_type, &d, in1, len1 ) ) != 0 ||
+        ( ret = ssl_prf_digest_update( ctx->md_type, &d, in2, len2 ) ) != 0 ||
+        ( ret = ssl_prf_digest_update( ctx->md_type, &d, in3, len3 ) ) != 0 ||
+        ( ret = ssl_prf_digest_finish( ctx->md_type, &d, sum ) ) != 0 )
     {
-        ret = MBEDTLS_ERR_SSL_INTERNAL_ERROR;
         goto exit;
     }
+    ssl_prf_digest_free( ctx->md_type, &d );
 
-    if( ( ret = mbedtls_md_setup( &md_ctx, md_info, 1 ) ) != 0 )
+    ssl_prf_digest_clone( ctx->md_type, &d, &ctx->outer );
+    if( ( ret = ssl_prf_digest_update( ctx->md_type, &d,
+                                       sum, ctx->md_len ) ) != 0 ||
+        ( ret = ssl_prf_digest_finish( ctx->md_type, &d, output ) ) != 0 )
     {
         goto exit;
     }
 
-    mbedtls_md_hmac_starts( &md_ctx, S2, hs );
-    mbedtls_md_hmac_update( &md_ctx, tmp + 20, nb );
-    mbedtls_md_hmac_finish( &md_ctx, tmp );
+exit:
+    ssl_prf_digest_free( ctx->md_type, &d );
+    mbedtls_platform_zeroize( sum, sizeof( sum ) );
+
+    return( ret );
+}
 
-    for( i = 0; i < dlen; i += 20 )
+/*
+ * P_hash( secret, label + random )[0..dlen], RFC 5246 section 5,
+ * written to dstbuf or XORed into it
+ */
+static int ssl_prf_p_hash( const mbedtls_ssl_prf_hmac *ctx,
+                           const char *label,
+                           const unsigned char *random, size_t rlen,
+                           unsigned char *dstbuf, size_t dlen, int xor )
+{
+    int ret;
+    size_t i, j, k;
+    size_t nb = strlen( label );
+    unsigned char a[MBEDTLS_MD_MAX_SIZE];
+    unsigned char h_i[MBEDTLS_MD_MAX_SIZE];
+
+    /* A(1) = HMAC( secret, label + random ) */
+    ret = ssl_prf_hmac( ctx, (const unsigned char *) label, nb,
+                        random, rlen, NULL, 0, a );
+    if( ret != 0 )
+        goto exit;
+
+    for( i = 0; i < dlen; i += ctx->md_len )
     {
-        mbedtls_md_hmac_reset ( &md_ctx );
-        mbedtls_md_hmac_update( &md_ctx, tmp, 20 + nb );
-        mbedtls_md_hmac_finish( &md_ctx, h_i );
+        ret = ssl_prf_hmac( ctx, a, ctx->md_len,
+                            (const unsigned char *) label, nb,
+                            random, rlen, h_i );
+        if( ret != 0 )
+            goto exit;
 
-        mbedtls_md_hmac_reset ( &md_ctx );
-        mbedtls_md_hmac_update( &md_ctx, tmp, 20 );
-        mbedtls_md_hmac_finish( &md_ctx, tmp );
+        ret = ssl_prf_hmac( ctx, a, ctx->md_len, NULL, 0, NULL, 0, a );
+        if( ret != 0 )
+            goto exit;
 
-        k = ( i + 20 > dlen ) ? dlen % 20 : 20;
+        k = ( i + ctx->md_len > dlen ) ? dlen % ctx->md_len : ctx->md_len;
 
-        for( j = 0; j < k; j++ )
-            dstbuf[i + j] = (unsigned char)( dstbuf[i + j] ^ h_i[j] );
+        if( xor )
+        {
+            for( j = 0; j < k; j++ )
+                dstbuf[i + j] = (unsigned char)( dstbuf[i + j] ^ h_i[j] );
+        }
+        else
+        {
+            for( j = 0; j < k; j++ )
+                dstbuf[i + j] = h_i[j];
+        }
     }
 
 exit:
-    mbedtls_md_free( &md_ctx );
-
-    mbedtls_platform_zeroize( tmp, tmp_len );
+    mbedtls_platform_zeroize( a, sizeof( a ) );
     mbedtls_platform_zeroize( h_i, sizeof( h_i ) );
 
-    mbedtls_free( tmp );
+    return( ret );
+}
+#endif /* MBEDTLS_SSL__PRF_HMAC */
+
+#if defined(MBEDTLS_SSL_PROTO_TLS1) || defined(MBEDTLS_SSL_PROTO_TLS1_1)
+static int tls1_prf( const unsigned char *secret, size_t slen,
+                     const char *label,
+                     const unsigned char *random, size_t rlen,
+                     unsigned char *dstbuf, size_t dlen )
+{
+    size_t hs;
+    mbedtls_ssl_prf_hmac hmac;
+    int ret;
+
+    /* The two halves of the secret, overlapping by one byte if odd */
+    hs = ( slen + 1 ) / 2;
+
+    /*
+     * First compute P_md5(secret,label+random)[0..dlen]
+     */
+    if( ( ret = ssl_prf_hmac_setup( &hmac, MBEDTLS_MD_MD5,
+                                    secret, hs ) ) != 0 ||
+        ( ret = ssl_prf_p_hash( &hmac, label, random, rlen,
+                                dstbuf, dlen, 0 ) ) != 0 )
+    {
+        goto exit;
+    }
+
+    ssl_prf_hmac_free( &hmac );
+
+    /*
+     * XOR out with P_sha1(secret,label+random)[0..dlen]
+     */
+    if( ( ret = ssl_prf_hmac_setup( &hmac, MBEDTLS_MD_SHA1,
+                                    secret + slen - hs, hs ) ) != 0 ||
+        ( ret = ssl_prf_p_hash( &hmac, label, random, rlen,
+                                dstbuf, dlen, 1 ) ) != 0 )
+    {
+        goto exit;
+    }
+
+exit:
+    ssl_prf_hmac_free( &hmac );
+
     return( ret );
 }
 #endif /* MBEDTLS_SSL_PROTO_TLS1) || MBEDTLS_SSL_PROTO_TLS1_1 */
@@ -805,68 +1121,16 @@ static int tls_prf_generic( mbedtls_md_type_t md_type,
                             const unsigned char *random, size_t rlen,
                             unsigned char *dstbuf, size_t dlen )
 {
-    size_t nb;
-    size_t i, j, k, md_len;
-    unsigned char *tmp;
-    size_t tmp_len = 0;
-    unsigned char h_i[MBEDTLS_MD_MAX_SIZE];
-    const mbedtls_md_info_t *md_info;
-    mbedtls_md_context_t md_ctx;
+    mbedtls_ssl_prf_hmac hmac;
     int ret;
 
-    mbedtls_md_init( &md_ctx );
-
-    if( ( md_info = mbedtls_md_info_from_type( md_type ) ) == NULL )
-        return( MBEDTLS_ERR_SSL_INTERNAL_ERROR );
-
-    md_len = mbedtls_md_get_size( md_info );
-
-    tmp_len = md_len + strlen( label ) + rlen;
-    tmp = mbedtls_calloc( 1, tmp_len );
-    if( tmp == NULL )
-    {
-        ret = MBEDTLS_ERR_SSL_ALLOC_FAILED;
-        goto exit;
-    }
-
-    nb = strlen( label );
-    memcpy( tmp + md_len, label, nb );
-    memcpy( tmp + md_len + nb, random, rlen );
-    nb += rlen;
-
     /*
      * Compute P_<hash>(secret, label + random)[0..dlen]
      */
-    if ( ( ret = mbedtls_md_setup( &md_ctx, md_info, 1 ) ) != 0 )
-        goto exit;
-
-    mbedtls_md_hmac_starts( &md_ctx, secret, slen );
-    mbedtls_md_hmac_update( &md_ctx, tmp + md_len, nb );
-    mbedtls_md_hmac_finish( &md_ctx, tmp );
-
-    for( i = 0; i < dlen; i += md_len )
-    {
-        mbedtls_md_hmac_reset ( &md_ctx );
-        mbedtls_md_hmac_update( &md_ctx, tmp, md_len + nb );
-        mbedtls_md_hmac_finish( &md_ctx, h_i );
-
-        mbedtls_md_hmac_reset ( &md_ctx );
-        mbedtls_md_hmac_update( &md_ctx, tmp, md_len );
-        mbedtls_md_hmac_finish( &md_ctx, tmp );
-
-        k = ( i + md_len > dlen ) ? dlen % md_len : md_len;
-
-        for( j = 0; j < k; j++ )
-            dstbuf[i + j]  = h_i[j];
-    }
-
-exit:
-    mbedtls_md_free( &md_ctx );
-
-    mbedtls_platform_zeroize( tmp, tmp_len );
-    mbedtls_platform_zeroize( h_i, sizeof( h_i ) );
+    if( ( ret = ssl_prf_hmac_setup( &hmac, md_type, secret, slen ) ) == 0 )
+        ret = ssl_prf_p_hash( &hmac, label, random, rlen, dstbuf, dlen, 0 );
 
-    mbedtls_free( tmp );
+    ssl_prf_hmac_free( &hmac );
 
     return( ret );
 }
@@ -892,6 +1156,37 @@ static int tls_prf_sha384( const unsigned char *secret, size_t slen,
                              label, random, rlen, dstbuf, dlen ) );
 }
 #endif /* MBEDTLS_SHA512_C */
+
+#if defined(MBEDTLS_SSL__PRF_HMAC_TLS1_2)
+/*
+ * PRF keyed with the master secret of the current handshake. The keyed
+ * HMAC state is kept in the handshake parameters, so that the secret is
+ * processed once for both Finished messages.
+ */
+static int ssl_tls12_prf_master( mbedtls_ssl_context *ssl,
+                                 mbedtls_md_type_t md_type,
+                                 const unsigned char *master,
+                                 const char *label,
+                                 const unsigned char *random, size_t rlen,
+                                 unsigned char *dstbuf, size_t dlen )
+{
+    int ret;
+    mbedtls_ssl_handshake_params *handshake = ssl->handshake;
+
+    if( handshake->prf_master_ready == 0 )
+    {
+        ret = ssl_prf_hmac_setup( &handshake->prf_master, md_type,
+                                  master, 48 );
+        if( ret != 0 )
+            return( ret );
+
+        handshake->prf_master_ready = 1;
+    }
+
+    return( ssl_prf_p_hash( &handshake->prf_master, label, random, rlen,
+                            dstbuf, dlen, 0 ) );
+}
+#endif /* MBEDTLS_SSL__PRF_HMAC_TLS1_2 */
 #endif /* MBEDTLS_SSL_PROTO_TLS1_2 */
 
 static void ssl_update_checksum_start( mbedtls_ssl_context *, const unsigned char *, size_t );
@@ -1864,7 +2159,8 @@ int mbedtls_ssl_derive_keys( mbedtls_ssl_context *ssl )
         ssl->compress_buf == NULL )
     {
         MBEDTLS_SSL_DEBUG_MSG( 3, ( "Allocating compression buffer" ) );
-        ssl->compress_buf = mbedtls_calloc( 1, MBEDTLS_SSL_COMPRESS_BUFFER_LEN );
+        ssl->compress_buf = SSL_ALLOC( ssl, MBEDTLS_ALLOC_PROFILE_IO,
+                                       MBEDTLS_SSL_COMPRESS_BUFFER_LEN );
         if( ssl->compress_buf == NULL )
         {
             MBEDTLS_SSL_DEBUG_MSG( 1, ( "alloc(%d bytes) failed",
@@ -3744,6 +4040,9 @@ int mbedtls_ssl_fetch_input( mbedtls_ssl_context *ssl, size_t nb_want )
             return( ret );
 
         ssl->in_left = ret;
+
+        if( ssl->handshake != NULL )
+            ssl->handshake->io_bytes += ret;
     }
     else
 #endif
@@ -3791,6 +4090,9 @@ int mbedtls_ssl_fetch_input( mbedtls_ssl_context *ssl, size_t nb_want )
             }
 
             ssl->in_left += ret;
+
+            if( ssl->handshake != NULL )
+                ssl->handshake->io_bytes += ret;
         }
     }
 
@@ -3845,6 +4147,9 @@ int mbedtls_ssl_flush_output( mbedtls_ssl_context *ssl )
         }
 
         ssl->out_left -= ret;
+
+        if( ssl->handshake != NULL )
+            ssl->handshake->io_bytes += ret;
     }
 
 #if defined(MBEDTLS_SSL_PROTO_DTLS)
@@ -3878,22 +4183,19 @@ static int ssl_flight_append( mbedtls_ssl_context *ssl )
     MBEDTLS_SSL_DEBUG_BUF( 4, "message appended to flight",
                            ssl->out_msg, ssl->out_msglen );
 
-    /* Allocate space for current message */
-    if( ( msg = mbedtls_calloc( 1, sizeof(  mbedtls_ssl_flight_item ) ) ) == NULL )
+    /* Allocate space for current message, right after the item itself */
+    if( ( msg = SSL_ALLOC( ssl, MBEDTLS_ALLOC_PROFILE_FLIGHT,
+                           sizeof( mbedtls_ssl_flight_item ) +
+                           ssl->out_msglen ) ) == NULL )
     {
         MBEDTLS_SSL_DEBUG_MSG( 1, ( "alloc %d bytes failed",
-                            sizeof( mbedtls_ssl_flight_item ) ) );
-        return( MBEDTLS_ERR_SSL_ALLOC_FAILED );
-    }
-
-    if( ( msg->p = mbedtls_calloc( 1, ssl->out_msglen ) ) == NULL )
-    {
-        MBEDTLS_SSL_DEBUG_MSG( 1, ( "alloc %d bytes failed", ssl->out_msglen ) );
-        mbedtls_free( msg );
+                            sizeof( mbedtls_ssl_flight_item ) +
+                            ssl->out_msglen ) );
         return( MBEDTLS_ERR_SSL_ALLOC_FAILED );
     }
 
     /* Copy current handshake message with headers */
+    msg->p = (unsigned char *)( msg + 1 );
     memcpy( msg->p, ssl->out_msg, ssl->out_msglen );
     msg->len = ssl->out_msglen;
     msg->type = ssl->out_msgtype;
@@ -3917,7 +4219,8 @@ static int ssl_flight_append( mbedtls_ssl_context *ssl )
 /*
  * Free the current flight of handshake messages
  */
-static void ssl_flight_free( mbedtls_ssl_flight_item *flight )
+static void ssl_flight_free( mbedtls_ssl_context *ssl,
+                             mbedtls_ssl_flight_item *flight )
 {
     mbedtls_ssl_flight_item *cur = flight;
     mbedtls_ssl_flight_item *next;
@@ -3926,8 +4229,9 @@ static void ssl_flight_free( mbedtls_ssl_flight_item *flight )
     {
         next = cur->next;
 
-        mbedtls_free( cur->p );
-        mbedtls_free( cur );
+        /* The message is stored in the same allocation as the item */
+        SSL_FREE( ssl, MBEDTLS_ALLOC_PROFILE_FLIGHT, cur,
+                  sizeof( mbedtls_ssl_flight_item ) + cur->len );
 
         cur = next;
     }
@@ -3987,6 +4291,8 @@ int mbedtls_ssl_resend( mbedtls_ssl_context *ssl )
 
     MBEDTLS_SSL_DEBUG_MSG( 2, ( "=> mbedtls_ssl_resend" ) );
 
+    ssl->stats.retransmissions++;
+
     ret = mbedtls_ssl_flight_transmit( ssl );
 
     MBEDTLS_SSL_DEBUG_MSG( 2, ( "<= mbedtls_ssl_resend" ) );
@@ -4014,6 +4320,17 @@ int mbedtls_ssl_flight_transmit( mbedtls_ssl_context *ssl )
         ssl->handshake->cur_msg_p = ssl->handshake->flight->p + 12;
         ssl_swap_epochs( ssl );
 
+        /* Only time the first transmission of a flight: once it has been
+         * resent, the peer's answer can't be matched to a transmission. */
+        if( ssl->conf->f_clock != NULL &&
+            ssl->handshake->flight_timing == MBEDTLS_SSL_FLIGHT_TIMING_PENDING )
+        {
+            ssl->handshake->flight_start = ssl->conf->f_clock( ssl->conf->p_clock );
+            ssl->handshake->flight_timing = MBEDTLS_SSL_FLIGHT_TIMING_RUNNING;
+        }
+        else
+            ssl->handshake->flight_timing = MBEDTLS_SSL_FLIGHT_TIMING_NONE;
+
         ssl->handshake->retransmit_state = MBEDTLS_SSL_RETRANS_SENDING;
     }
 
@@ -4160,8 +4477,16 @@ int mbedtls_ssl_flight_transmit( mbedtls_ssl_context *ssl )
  */
 void mbedtls_ssl_recv_flight_completed( mbedtls_ssl_context *ssl )
 {
+    if( ssl->conf->f_clock != NULL &&
+        ssl->handshake->flight_timing == MBEDTLS_SSL_FLIGHT_TIMING_RUNNING )
+    {
+        ssl_update_rtt( ssl, ssl->conf->f_clock( ssl->conf->p_clock ) -
+                             ssl->handshake->flight_start );
+    }
+    ssl->handshake->flight_timing = MBEDTLS_SSL_FLIGHT_TIMING_NONE;
+
     /* We won't need to resend that one any more */
-    ssl_flight_free( ssl->handshake->flight );
+    ssl_flight_free( ssl, ssl->handshake->flight );
     ssl->handshake->flight = NULL;
     ssl->handshake->cur_msg = NULL;
 
@@ -4192,6 +4517,7 @@ void mbedtls_ssl_recv_flight_completed( mbedtls_ssl_context *ssl )
 void mbedtls_ssl_send_flight_completed( mbedtls_ssl_context *ssl )
 {
     ssl_reset_retransmit_timeout( ssl );
+    ssl->handshake->flight_timing = MBEDTLS_SSL_FLIGHT_TIMING_PENDING;
     ssl_set_timer( ssl, ssl->handshake->retransmit_timeout );
 
     if( ssl->in_msgtype == MBEDTLS_SSL_MSG_HANDSHAKE &&
@@ -4475,6 +4801,8 @@ int mbedtls_ssl_write_record( mbedtls_ssl_context *ssl, uint8_t force_flush )
                 return( MBEDTLS_ERR_SSL_INTERNAL_ERROR );
             }
 
+            ssl->stats.bytes_encrypted += len;
+
             /* Update the record content type and CID. */
             ssl->out_msgtype = rec.type;
 #if defined(MBEDTLS_SSL_DTLS_CONNECTION_ID )
@@ -4519,6 +4847,8 @@ int mbedtls_ssl_write_record( mbedtls_ssl_context *ssl, uint8_t force_flush )
         ssl->out_hdr  += protected_record_size;
         ssl_update_out_pointers( ssl, ssl->transform_out );
 
+        ssl->stats.records_out++;
+
         for( i = 8; i > ssl_ep_len( ssl ); i-- )
             if( ++ssl->cur_out_ctr[i - 1] != 0 )
                 break;
@@ -4836,18 +5166,33 @@ void mbedtls_ssl_update_handshake_status( mbedtls_ssl_context *ssl )
 /*
  * DTLS anti-replay: RFC 6347 4.1.2.6
  *
- * in_window is a field of bits numbered from 0 (lsb) to 63 (msb).
- * Bit n is set iff record number in_window_top - n has been seen.
+ * in_window is a ring of MBEDTLS_SSL_DTLS_REPLAY_WINDOW_WORDS 64-bit words.
+ * Record number n is tracked by bit (n % 64) of word (n / 64) % WORDS, and
+ * that bit is set iff record number n has been seen. Only record numbers
+ * from in_window_top - window + 1 to in_window_top are meaningful, where
+ * window is the configured anti_replay_window: the extra word in the ring
+ * ensures that these never share a bit, whatever the position of
+ * in_window_top within its word.
  *
- * Usually, in_window_top is the last record number seen and the lsb of
- * in_window is set. The only exception is the initial state (record number 0
- * not seen yet).
+ * Bits for record numbers greater than in_window_top are kept cleared:
+ * when in_window_top moves to a new word, the words it skips over (which
+ * hold stale data from a previous turn of the ring) are cleared first.
+ * Hence both checking and updating cost O(1).
+ *
+ * Usually, in_window_top is the last record number seen and its bit is
+ * set. The only exception is the initial state (record number 0 not seen
+ * yet).
  */
 #if defined(MBEDTLS_SSL_DTLS_ANTI_REPLAY)
+#define SSL_DTLS_REPLAY_WORD( seq )                                  \
+    ( (size_t)( ( seq ) >> 6 ) % MBEDTLS_SSL_DTLS_REPLAY_WINDOW_WORDS )
+#define SSL_DTLS_REPLAY_MASK( seq )                                  \
+    ( (uint64_t) 1 << ( ( seq ) & 63 ) )
+
 static void ssl_dtls_replay_reset( mbedtls_ssl_context *ssl )
 {
     ssl->in_window_top = 0;
-    ssl->in_window = 0;
+    memset( ssl->in_window, 0, sizeof( ssl->in_window ) );
 }
 
 static inline uint64_t ssl_load_six_bytes( unsigned char *buf )
@@ -4866,7 +5211,6 @@ static inline uint64_t ssl_load_six_bytes( unsigned char *buf )
 int mbedtls_ssl_dtls_replay_check( mbedtls_ssl_context const *ssl )
 {
     uint64_t rec_seqnum = ssl_load_six_bytes( ssl->in_ctr + 2 );
-    uint64_t bit;
 
     if( ssl->conf->anti_replay == MBEDTLS_SSL_ANTI_REPLAY_DISABLED )
         return( 0 );
@@ -4874,12 +5218,11 @@ int mbedtls_ssl_dtls_replay_check( mbedtls_ssl_context const *ssl )
     if( rec_seqnum > ssl->in_window_top )
         return( 0 );
 
-    bit = ssl->in_window_top - rec_seqnum;
-
-    if( bit >= 64 )
+    if( ssl->in_window_top - rec_seqnum >= ssl->conf->anti_replay_window )
         return( -1 );
 
-    if( ( ssl->in_window & ( (uint64_t) 1 << bit ) ) != 0 )
+    if( ( ssl->in_window[ SSL_DTLS_REPLAY_WORD( rec_seqnum ) ] &
+          SSL_DTLS_REPLAY_MASK( rec_seqnum ) ) != 0 )
         return( -1 );
 
     return( 0 );
@@ -4897,26 +5240,82 @@ void mbedtls_ssl_dtls_replay_update( mbedtls_ssl_context *ssl )
 
     if( rec_seqnum > ssl->in_window_top )
     {
-        /* Update window_top and the contents of the window */
-        uint64_t shift = rec_seqnum - ssl->in_window_top;
+        /* Clear the words skipped over by window_top, then update it */
+        uint64_t skipped = ( rec_seqnum >> 6 ) - ( ssl->in_window_top >> 6 );
 
-        if( shift >= 64 )
-            ssl->in_window = 1;
+        if( skipped >= MBEDTLS_SSL_DTLS_REPLAY_WINDOW_WORDS )
+            memset( ssl->in_window, 0, sizeof( ssl->in_window ) );
         else
         {
-            ssl->in_window <<= shift;
-            ssl->in_window |= 1;
+            uint64_t word = ssl->in_window_top >> 6;
+
+            while( skipped-- > 0 )
+                ssl->in_window[ ++word % MBEDTLS_SSL_DTLS_REPLAY_WINDOW_WORDS ] = 0;
         }
 
         ssl->in_window_top = rec_seqnum;
     }
-    else
+    else if( ssl->in_window_top - rec_seqnum >=
+             ssl->conf->anti_replay_window )
+    {
+        /* Out of the window: never the case for checked records */
+        return;
+    }
+
+    /* Mark that number as seen in the current window */
+    ssl->in_window[ SSL_DTLS_REPLAY_WORD( rec_seqnum ) ] |=
+        SSL_DTLS_REPLAY_MASK( rec_seqnum );
+}
+
+/*
+ * Export the state of the 64 most recent record numbers in the format
+ * used before the window size was configurable: bit n is set iff record
+ * number in_window_top - n has been seen.
+ */
+static uint64_t ssl_dtls_replay_get_bitmask( const mbedtls_ssl_context *ssl )
+{
+    uint64_t bitmask = 0;
+    uint64_t seq;
+    unsigned n;
+
+    for( n = 0; n < 64 && n <= ssl->in_window_top; n++ )
     {
-        /* Mark that number as seen in the current window */
-        uint64_t bit = ssl->in_window_top - rec_seqnum;
+        seq = ssl->in_window_top - n;
+        if( ( ssl->in_window[ SSL_DTLS_REPLAY_WORD( seq ) ] &
+              SSL_DTLS_REPLAY_MASK( seq ) ) != 0 )
+        {
+            bitmask |= (uint64_t) 1 << n;
+        }
+    }
+
+    return( bitmask );
+}
+
+/*
+ * Reverse of ssl_dtls_replay_get_bitmask(). Record numbers older than the
+ * 64 covered by the bitmask are conservatively marked as seen.
+ */
+static void ssl_dtls_replay_set_bitmask( mbedtls_ssl_context *ssl,
+                                         uint64_t bitmask )
+{
+    uint64_t seq;
+    unsigned n;
+
+    memset( ssl->in_window, 0xFF, sizeof( ssl->in_window ) );
 
-        if( bit < 64 ) /* Always true, but be extra sure */
-            ssl->in_window |= (uint64_t) 1 << bit;
+    /* Restore the invariant that bits above in_window_top are clear */
+    ssl->in_window[ SSL_DTLS_REPLAY_WORD( ssl->in_window_top ) ] &=
+        ( SSL_DTLS_REPLAY_MASK( ssl->in_window_top ) << 1 ) - 1;
+
+    for( n = 0; n < 64 && n <= ssl->in_window_top; n++ )
+    {
+        seq = ssl->in_window_top - n;
+        if( ( bitmask & ( (uint64_t) 1 << n ) ) != 0 )
+            ssl->in_window[ SSL_DTLS_REPLAY_WORD( seq ) ] |=
+                SSL_DTLS_REPLAY_MASK( seq );
+        else
+            ssl->in_window[ SSL_DTLS_REPLAY_WORD( seq ) ] &=
+                ~SSL_DTLS_REPLAY_MASK( seq );
     }
 }
 #endif /* MBEDTLS_SSL_DTLS_ANTI_REPLAY */
@@ -5463,6 +5862,8 @@ static int ssl_prepare_record_content( mbedtls_ssl_context *ssl,
         MBEDTLS_SSL_DEBUG_BUF( 4, "input payload after decrypt",
                                rec->buf + rec->data_offset, rec->data_len );
 
+        ssl->stats.bytes_decrypted += rec->data_len;
+
 #if defined(MBEDTLS_SSL_DTLS_CONNECTION_ID)
         /* We have already checked the record content type
          * in ssl_parse_record_header(), failing or silently
@@ -5924,7 +6325,7 @@ static int ssl_buffer_message( mbedtls_ssl_context *ssl )
                 MBEDTLS_SSL_DEBUG_MSG( 2, ( "initialize reassembly, total length = %d",
                                             msg_len ) );
 
-                hs_buf->data = mbedtls_calloc( 1, reassembly_buf_sz );
+                hs_buf->data = ssl_buffering_alloc( ssl, reassembly_buf_sz );
                 if( hs_buf->data == NULL )
                 {
                     ret = MBEDTLS_ERR_SSL_ALLOC_FAILED;
@@ -5939,8 +6340,6 @@ static int ssl_buffer_message( mbedtls_ssl_context *ssl )
                 memcpy( hs_buf->data + 9, hs_buf->data + 1, 3 );
 
                 hs_buf->is_valid = 1;
-
-                hs->buffering.total_bytes_buffered += reassembly_buf_sz;
             }
             else
             {
@@ -6107,10 +6506,8 @@ static void ssl_free_buffered_record( mbedtls_ssl_context *ssl )
 
     if( hs->buffering.future_record.data != NULL )
     {
-        hs->buffering.total_bytes_buffered -=
-            hs->buffering.future_record.len;
-
-        mbedtls_free( hs->buffering.future_record.data );
+        ssl_buffering_release( ssl, hs->buffering.future_record.data,
+                               hs->buffering.future_record.len );
         hs->buffering.future_record.data = NULL;
     }
 }
@@ -6208,7 +6605,7 @@ static int ssl_buffer_future_record( mbedtls_ssl_context *ssl,
     hs->buffering.future_record.len   = rec->buf_len;
 
     hs->buffering.future_record.data =
-        mbedtls_calloc( 1, hs->buffering.future_record.len );
+        ssl_buffering_alloc( ssl, hs->buffering.future_record.len );
     if( hs->buffering.future_record.data == NULL )
     {
         /* If we run out of RAM trying to buffer a
@@ -6217,8 +6614,8 @@ static int ssl_buffer_future_record( mbedtls_ssl_context *ssl,
     }
 
     memcpy( hs->buffering.future_record.data, rec->buf, rec->buf_len );
+    ssl->stats.buffered_records++;
 
-    hs->buffering.total_bytes_buffered += rec->buf_len;
     return( 0 );
 }
 
@@ -6346,6 +6743,9 @@ static int ssl_get_next_record( mbedtls_ssl_context *ssl )
 
     if( ( ret = ssl_prepare_record_content( ssl, &rec ) ) != 0 )
     {
+        if( ret == MBEDTLS_ERR_SSL_INVALID_MAC )
+            ssl->stats.bad_mac++;
+
 #if defined(MBEDTLS_SSL_PROTO_DTLS)
         if( ssl->conf->transport == MBEDTLS_SSL_TRANSPORT_DATAGRAM )
         {
@@ -6429,6 +6829,8 @@ static int ssl_get_next_record( mbedtls_ssl_context *ssl )
     ssl->in_len[0] = (unsigned char)( rec.data_len >> 8 );
     ssl->in_len[1] = (unsigned char)( rec.data_len      );
 
+    ssl->stats.records_in++;
+
     return( 0 );
 }
 
@@ -6679,6 +7081,7 @@ int mbedtls_ssl_write_certificate( mbedtls_ssl_context *ssl )
     int ret = MBEDTLS_ERR_SSL_FEATURE_UNAVAILABLE;
     size_t i, n;
     const mbedtls_x509_crt *crt;
+    const mbedtls_ssl_key_cert *key_cert;
     const mbedtls_ssl_ciphersuite_t *ciphersuite_info =
         ssl->handshake->ciphersuite_info;
 
@@ -6743,24 +7146,35 @@ int mbedtls_ssl_write_certificate( mbedtls_ssl_context *ssl )
      *    n+3 . ...   upper level cert, etc.
      */
     i = 7;
-    crt = mbedtls_ssl_own_cert( ssl );
+    key_cert = mbedtls_ssl_own_key_cert( ssl );
 
-    while( crt != NULL )
+    if( key_cert != NULL && key_cert->chain_buf != NULL )
     {
-        n = crt->raw.len;
-        if( n > MBEDTLS_SSL_OUT_CONTENT_LEN - 3 - i )
+        /* Encoded when the pair was configured, and known to fit */
+        memcpy( ssl->out_msg + i, key_cert->chain_buf, key_cert->chain_len );
+        i += key_cert->chain_len;
+    }
+    else
+    {
+        crt = mbedtls_ssl_own_cert( ssl );
+
+        while( crt != NULL )
         {
-            MBEDTLS_SSL_DEBUG_MSG( 1, ( "certificate too large, %d > %d",
-                           i + 3 + n, MBEDTLS_SSL_OUT_CONTENT_LEN ) );
-            return( MBEDTLS_ERR_SSL_CERTIFICATE_TOO_LARGE );
-        }
+            n = crt->raw.len;
+            if( n > MBEDTLS_SSL_OUT_CONTENT_LEN - 3 - i )
+            {
+                MBEDTLS_SSL_DEBUG_MSG( 1, ( "certificate too large, %d > %d",
+                               i + 3 + n, MBEDTLS_SSL_OUT_CONTENT_LEN ) );
+                return( MBEDTLS_ERR_SSL_CERTIFICATE_TOO_LARGE );
+            }
 
-        ssl->out_msg[i    ] = (unsigned char)( n >> 16 );
-        ssl->out_msg[i + 1] = (unsigned char)( n >>  8 );
-        ssl->out_msg[i + 2] = (unsigned char)( n       );
+            ssl->out_msg[i    ] = (unsigned char)( n >> 16 );
+            ssl->out_msg[i + 1] = (unsigned char)( n >>  8 );
+            ssl->out_msg[i + 2] = (unsigned char)( n       );
 
-        i += 3; memcpy( ssl->out_msg + i, crt->raw.p, n );
-        i += n; crt = crt->next;
+            i += 3; memcpy( ssl->out_msg + i, crt->raw.p, n );
+            i += n; crt = crt->next;
+        }
     }
 
     ssl->out_msg[4]  = (unsigned char)( ( i - 7 ) >> 16 );
@@ -7067,6 +7481,51 @@ static int ssl_parse_certificate_coordinate( mbedtls_ssl_context *ssl,
     return( SSL_CERTIFICATE_EXPECTED );
 }
 
+#if defined(MBEDTLS_SSL_ASYNC_VERIFY)
+/*
+ * Start or resume the verification of the peer chain by the callbacks set
+ * with mbedtls_ssl_conf_async_verify(). On completion, the flags reported by
+ * the verifier replace the verification result of the session.
+ */
+static int ssl_async_verify_chain( mbedtls_ssl_context *ssl,
+                                   mbedtls_x509_crt *chain )
+{
+    int ret;
+    const mbedtls_ssl_config *conf = ssl->conf;
+    mbedtls_ssl_handshake_params *handshake = ssl->handshake;
+    uint32_t flags = 0;
+
+    if( handshake->async_verify_in_progress == 0 )
+    {
+        MBEDTLS_SSL_DEBUG_MSG( 2, ( "start asynchronous chain verification" ) );
+
+        handshake->async_verify_op = NULL;
+        ret = conf->f_async_verify_start( conf->p_async_verify, ssl, chain,
+                                          ssl->hostname,
+                                          &handshake->async_verify_op );
+        if( ret != 0 && ret != MBEDTLS_ERR_SSL_ASYNC_IN_PROGRESS )
+            return( ret );
+
+        handshake->async_verify_in_progress = 1;
+        if( ret == MBEDTLS_ERR_SSL_ASYNC_IN_PROGRESS )
+            return( ret );
+    }
+
+    ret = conf->f_async_verify_resume( conf->p_async_verify, ssl,
+                                       handshake->async_verify_op, &flags );
+    if( ret == MBEDTLS_ERR_SSL_ASYNC_IN_PROGRESS )
+        return( ret );
+
+    handshake->async_verify_in_progress = 0;
+    handshake->async_verify_op = NULL;
+    ssl->session_negotiate->verify_result = flags;
+
+    MBEDTLS_SSL_DEBUG_RET( 2, "asynchronous chain verification", ret );
+
+    return( ret );
+}
+#endif /* MBEDTLS_SSL_ASYNC_VERIFY */
+
 static int ssl_parse_certificate_verify( mbedtls_ssl_context *ssl,
                                          int authmode,
                                          mbedtls_x509_crt *chain,
@@ -7099,6 +7558,26 @@ static int ssl_parse_certificate_verify( mbedtls_ssl_context *ssl,
     /*
      * Main check: verify certificate
      */
+#if defined(MBEDTLS_SSL_ASYNC_VERIFY)
+    if( ssl->conf->f_async_verify_start != NULL )
+        ret = ssl_async_verify_chain( ssl, chain );
+    else
+        ret = MBEDTLS_ERR_SSL_HW_ACCEL_FALLTHROUGH;
+
+    if( ret == MBEDTLS_ERR_SSL_ASYNC_IN_PROGRESS )
+    {
+        MBEDTLS_SSL_DEBUG_MSG( 2, ( "chain verification in progress" ) );
+        return( ret );
+    }
+
+    if( ret != MBEDTLS_ERR_SSL_HW_ACCEL_FALLTHROUGH )
+    {
+        /* The verifier applies its own trust policy */
+        ((void) rs_ctx);
+        have_ca_chain = 1;
+    }
+    else
+#endif /* MBEDTLS_SSL_ASYNC_VERIFY */
 #if defined(MBEDTLS_X509_TRUSTED_CERTIFICATE_CALLBACK)
     if( ssl->conf->f_ca_cb != NULL )
     {
@@ -7106,12 +7585,12 @@ static int ssl_parse_certificate_verify( mbedtls_ssl_context *ssl,
         have_ca_chain = 1;
 
         MBEDTLS_SSL_DEBUG_MSG( 3, ( "use CA callback for X.509 CRT verification" ) );
-        ret = mbedtls_x509_crt_verify_with_ca_cb(
+        ret = mbedtls_x509_crt_verify_hostname_with_ca_cb(
             chain,
             ssl->conf->f_ca_cb,
             ssl->conf->p_ca_cb,
             ssl->conf->cert_profile,
-            ssl->hostname,
+            ssl->hostname_match,
             &ssl->session_negotiate->verify_result,
             f_vrfy, p_vrfy );
     }
@@ -7129,19 +7608,16 @@ static int ssl_parse_certificate_verify( mbedtls_ssl_context *ssl,
         }
         else
 #endif
-        {
-            ca_chain = ssl->conf->ca_chain;
-            ca_crl   = ssl->conf->ca_crl;
-        }
+            ca_chain = mbedtls_ssl_default_ca_chain( ssl, &ca_crl );
 
         if( ca_chain != NULL )
             have_ca_chain = 1;
 
-        ret = mbedtls_x509_crt_verify_restartable(
+        ret = mbedtls_x509_crt_verify_hostname(
             chain,
             ca_chain, ca_crl,
             ssl->conf->cert_profile,
-            ssl->hostname,
+            ssl->hostname_match,
             &ssl->session_negotiate->verify_result,
             f_vrfy, p_vrfy, rs_ctx );
     }
@@ -7329,6 +7805,15 @@ int mbedtls_ssl_parse_certificate( mbedtls_ssl_context *ssl )
         goto exit;
     }
 
+#if defined(MBEDTLS_SSL_ASYNC_VERIFY)
+    if( ssl->handshake->async_verify_chain != NULL )
+    {
+        chain = ssl->handshake->async_verify_chain;
+        ssl->handshake->async_verify_chain = NULL;
+        goto crt_verify;
+    }
+#endif
+
 #if defined(MBEDTLS_SSL__ECP_RESTARTABLE)
     if( ssl->handshake->ecrs_enabled &&
         ssl->handshake->ecrs_state == ssl_ecrs_crt_verify )
@@ -7386,8 +7871,12 @@ int mbedtls_ssl_parse_certificate( mbedtls_ssl_context *ssl )
 #if defined(MBEDTLS_SSL__ECP_RESTARTABLE)
     if( ssl->handshake->ecrs_enabled)
         ssl->handshake->ecrs_state = ssl_ecrs_crt_verify;
+#endif
 
+#if defined(MBEDTLS_SSL__ECP_RESTARTABLE) || defined(MBEDTLS_SSL_ASYNC_VERIFY)
 crt_verify:
+#endif
+#if defined(MBEDTLS_SSL__ECP_RESTARTABLE)
     if( ssl->handshake->ecrs_enabled)
         rs_ctx = &ssl->handshake->ecrs_ctx;
 #endif
@@ -7448,6 +7937,15 @@ exit:
     }
 #endif
 
+#if defined(MBEDTLS_SSL_ASYNC_VERIFY)
+    /* The verifier keeps using the chain until it completes */
+    if( ret == MBEDTLS_ERR_SSL_ASYNC_IN_PROGRESS )
+    {
+        ssl->handshake->async_verify_chain = chain;
+        chain = NULL;
+    }
+#endif
+
     if( chain != NULL )
     {
         mbedtls_x509_crt_free( chain );
@@ -7882,8 +8380,13 @@ static void ssl_calc_finished_tls_sha256(
     mbedtls_sha256_free( &sha256 );
 #endif /* MBEDTLS_USE_PSA_CRYPTO */
 
+#if defined(MBEDTLS_SSL__PRF_HMAC_TLS1_2)
+    ssl_tls12_prf_master( ssl, MBEDTLS_MD_SHA256, session->master, sender,
+                          padbuf, 32, buf, len );
+#else
     ssl->handshake->tls_prf( session->master, 48, sender,
                              padbuf, 32, buf, len );
+#endif
 
     MBEDTLS_SSL_DEBUG_BUF( 3, "calc finished result", buf, len );
 
@@ -7957,8 +8460,13 @@ static void ssl_calc_finished_tls_sha384(
     mbedtls_sha512_free( &sha512 );
 #endif
 
+#if defined(MBEDTLS_SSL__PRF_HMAC_TLS1_2)
+    ssl_tls12_prf_master( ssl, MBEDTLS_MD_SHA384, session->master, sender,
+                          padbuf, 48, buf, len );
+#else
     ssl->handshake->tls_prf( session->master, 48, sender,
                              padbuf, 48, buf, len );
+#endif
 
     MBEDTLS_SSL_DEBUG_BUF( 3, "calc finished result", buf, len );
 
@@ -7977,7 +8485,8 @@ static void ssl_handshake_wrapup_free_hs_transform( mbedtls_ssl_context *ssl )
      * Free our handshake params
      */
     mbedtls_ssl_handshake_free( ssl );
-    mbedtls_free( ssl->handshake );
+    SSL_FREE( ssl, MBEDTLS_ALLOC_PROFILE_HANDSHAKE, ssl->handshake,
+              sizeof( mbedtls_ssl_handshake_params ) );
     ssl->handshake = NULL;
 
     /*
@@ -7986,7 +8495,8 @@ static void ssl_handshake_wrapup_free_hs_transform( mbedtls_ssl_context *ssl )
     if( ssl->transform )
     {
         mbedtls_ssl_transform_free( ssl->transform );
-        mbedtls_free( ssl->transform );
+        SSL_FREE( ssl, MBEDTLS_ALLOC_PROFILE_SESSION, ssl->transform,
+                  sizeof( mbedtls_ssl_transform ) );
     }
     ssl->transform = ssl->transform_negotiate;
     ssl->transform_negotiate = NULL;
@@ -8005,6 +8515,7 @@ void mbedtls_ssl_handshake_wrapup( mbedtls_ssl_context *ssl )
     {
         ssl->renego_status =  MBEDTLS_SSL_RENEGOTIATION_DONE;
         ssl->renego_records_seen = 0;
+        ssl->stats.renegotiations++;
     }
 #endif
 
@@ -8020,7 +8531,8 @@ void mbedtls_ssl_handshake_wrapup( mbedtls_ssl_context *ssl )
 #endif
 
         mbedtls_ssl_session_free( ssl->session );
-        mbedtls_free( ssl->session );
+        SSL_FREE( ssl, MBEDTLS_ALLOC_PROFILE_SESSION, ssl->session,
+                  sizeof( mbedtls_ssl_session ) );
     }
     ssl->session = ssl->session_negotiate;
     ssl->session_negotiate = NULL;
@@ -8360,17 +8872,20 @@ static int ssl_handshake_init( mbedtls_ssl_context *ssl )
      */
     if( ssl->transform_negotiate == NULL )
     {
-        ssl->transform_negotiate = mbedtls_calloc( 1, sizeof(mbedtls_ssl_transform) );
+        ssl->transform_negotiate = SSL_ALLOC( ssl, MBEDTLS_ALLOC_PROFILE_SESSION,
+                                    sizeof(mbedtls_ssl_transform) );
     }
 
     if( ssl->session_negotiate == NULL )
     {
-        ssl->session_negotiate = mbedtls_calloc( 1, sizeof(mbedtls_ssl_session) );
+        ssl->session_negotiate = SSL_ALLOC( ssl, MBEDTLS_ALLOC_PROFILE_SESSION,
+                                    sizeof(mbedtls_ssl_session) );
     }
 
     if( ssl->handshake == NULL )
     {
-        ssl->handshake = mbedtls_calloc( 1, sizeof(mbedtls_ssl_handshake_params) );
+        ssl->handshake = SSL_ALLOC( ssl, MBEDTLS_ALLOC_PROFILE_HANDSHAKE,
+                                    sizeof(mbedtls_ssl_handshake_params) );
     }
 
     /* All pointers should exist and can be directly freed without issue */
@@ -8380,9 +8895,12 @@ static int ssl_handshake_init( mbedtls_ssl_context *ssl )
     {
         MBEDTLS_SSL_DEBUG_MSG( 1, ( "alloc() of ssl sub-contexts failed" ) );
 
-        mbedtls_free( ssl->handshake );
-        mbedtls_free( ssl->transform_negotiate );
-        mbedtls_free( ssl->session_negotiate );
+        SSL_FREE( ssl, MBEDTLS_ALLOC_PROFILE_HANDSHAKE, ssl->handshake,
+                  sizeof(mbedtls_ssl_handshake_params) );
+        SSL_FREE( ssl, MBEDTLS_ALLOC_PROFILE_SESSION, ssl->transform_negotiate,
+                  sizeof(mbedtls_ssl_transform) );
+        SSL_FREE( ssl, MBEDTLS_ALLOC_PROFILE_SESSION, ssl->session_negotiate,
+                  sizeof(mbedtls_ssl_session) );
 
         ssl->handshake = NULL;
         ssl->transform_negotiate = NULL;
@@ -8539,12 +9057,51 @@ static void ssl_update_in_pointers( mbedtls_ssl_context *ssl )
     ssl->in_msg = ssl->in_iv;
 }
 
+/*
+ * Choose between the debug threshold of the configuration and the global
+ * one, according to the sampling rate
+ */
+static void ssl_select_dbg_threshold( mbedtls_ssl_context *ssl )
+{
+#if defined(MBEDTLS_DEBUG_C)
+    const mbedtls_ssl_config *conf = ssl->conf;
+    unsigned char r[4];
+
+    ssl->dbg_threshold = -1;
+
+    if( conf->dbg_threshold < 0 )
+        return;
+
+    if( conf->dbg_sample > 1 )
+    {
+        if( conf->f_rng == NULL ||
+            conf->f_rng( conf->p_rng, r, sizeof( r ) ) != 0 )
+        {
+            return;
+        }
+
+        if( ( ( (uint32_t) r[0] << 24 ) | ( (uint32_t) r[1] << 16 ) |
+              ( (uint32_t) r[2] <<  8 ) | ( (uint32_t) r[3]       ) ) %
+            conf->dbg_sample != 0 )
+        {
+            return;
+        }
+    }
+
+    ssl->dbg_threshold = conf->dbg_threshold;
+#else
+    ((void) ssl);
+#endif /* MBEDTLS_DEBUG_C */
+}
+
 /*
  * Initialize an SSL context
  */
 void mbedtls_ssl_init( mbedtls_ssl_context *ssl )
 {
     memset( ssl, 0, sizeof( mbedtls_ssl_context ) );
+
+    ssl->dbg_threshold = -1;
 }
 
 /*
@@ -8578,6 +9135,7 @@ int mbedtls_ssl_setup( mbedtls_ssl_context *ssl,
     int ret;
 
     ssl->conf = conf;
+    ssl_select_dbg_threshold( ssl );
 
     /*
      * Prepare base structures
@@ -8586,7 +9144,8 @@ int mbedtls_ssl_setup( mbedtls_ssl_context *ssl,
     /* Set to NULL in case of an error condition */
     ssl->out_buf = NULL;
 
-    ssl->in_buf = mbedtls_calloc( 1, MBEDTLS_SSL_IN_BUFFER_LEN );
+    ssl->in_buf = SSL_ALLOC( ssl, MBEDTLS_ALLOC_PROFILE_IO,
+                             MBEDTLS_SSL_IN_BUFFER_LEN );
     if( ssl->in_buf == NULL )
     {
         MBEDTLS_SSL_DEBUG_MSG( 1, ( "alloc(%d bytes) failed", MBEDTLS_SSL_IN_BUFFER_LEN) );
@@ -8594,7 +9153,8 @@ int mbedtls_ssl_setup( mbedtls_ssl_context *ssl,
         goto error;
     }
 
-    ssl->out_buf = mbedtls_calloc( 1, MBEDTLS_SSL_OUT_BUFFER_LEN );
+    ssl->out_buf = SSL_ALLOC( ssl, MBEDTLS_ALLOC_PROFILE_IO,
+                              MBEDTLS_SSL_OUT_BUFFER_LEN );
     if( ssl->out_buf == NULL )
     {
         MBEDTLS_SSL_DEBUG_MSG( 1, ( "alloc(%d bytes) failed", MBEDTLS_SSL_OUT_BUFFER_LEN) );
@@ -8610,8 +9170,10 @@ int mbedtls_ssl_setup( mbedtls_ssl_context *ssl,
     return( 0 );
 
 error:
-    mbedtls_free( ssl->in_buf );
-    mbedtls_free( ssl->out_buf );
+    SSL_FREE( ssl, MBEDTLS_ALLOC_PROFILE_IO, ssl->in_buf,
+              MBEDTLS_SSL_IN_BUFFER_LEN );
+    SSL_FREE( ssl, MBEDTLS_ALLOC_PROFILE_IO, ssl->out_buf,
+              MBEDTLS_SSL_OUT_BUFFER_LEN );
 
     ssl->conf = NULL;
 
@@ -8654,6 +9216,8 @@ static int ssl_session_reset_int( mbedtls_ssl_context *ssl, int partial )
     /* Cancel any possibly running timer */
     ssl_set_timer( ssl, 0 );
 
+    ssl_select_dbg_threshold( ssl );
+
 #if defined(MBEDTLS_SSL_RENEGOTIATION)
     ssl->renego_status = MBEDTLS_SSL_INITIAL_HANDSHAKE;
     ssl->renego_records_seen = 0;
@@ -8682,6 +9246,8 @@ static int ssl_session_reset_int( mbedtls_ssl_context *ssl, int partial )
 
     ssl->keep_current_message = 0;
 
+    memset( &ssl->stats, 0, sizeof( ssl->stats ) );
+
     ssl->out_msgtype = 0;
     ssl->out_msglen = 0;
     ssl->out_left = 0;
@@ -8723,14 +9289,16 @@ static int ssl_session_reset_int( mbedtls_ssl_context *ssl, int partial )
     if( ssl->transform )
     {
         mbedtls_ssl_transform_free( ssl->transform );
-        mbedtls_free( ssl->transform );
+        SSL_FREE( ssl, MBEDTLS_ALLOC_PROFILE_SESSION, ssl->transform,
+                  sizeof( mbedtls_ssl_transform ) );
         ssl->transform = NULL;
     }
 
     if( ssl->session )
     {
         mbedtls_ssl_session_free( ssl->session );
-        mbedtls_free( ssl->session );
+        SSL_FREE( ssl, MBEDTLS_ALLOC_PROFILE_SESSION, ssl->session,
+                  sizeof( mbedtls_ssl_session ) );
         ssl->session = NULL;
     }
 
@@ -8782,6 +9350,19 @@ void mbedtls_ssl_conf_dtls_anti_replay( mbedtls_ssl_config *conf, char mode )
 {
     conf->anti_replay = mode;
 }
+
+int mbedtls_ssl_conf_dtls_anti_replay_window( mbedtls_ssl_config *conf,
+                                              unsigned int window )
+{
+    if( window == 0 || window % 64 != 0 ||
+        window > MBEDTLS_SSL_DTLS_REPLAY_WINDOW )
+    {
+        return( MBEDTLS_ERR_SSL_BAD_INPUT_DATA );
+    }
+
+    conf->anti_replay_window = window;
+    return( 0 );
+}
 #endif
 
 #if defined(MBEDTLS_SSL_DTLS_BADMAC_LIMIT)
@@ -8805,6 +9386,16 @@ void mbedtls_ssl_conf_handshake_timeout( mbedtls_ssl_config *conf,
     conf->hs_timeout_min = min;
     conf->hs_timeout_max = max;
 }
+
+void mbedtls_ssl_conf_handshake_rtt( mbedtls_ssl_config *conf,
+                                     mbedtls_ssl_get_clock_t *f_clock,
+                                     void *p_clock,
+                                     uint32_t rto_min )
+{
+    conf->f_clock    = f_clock;
+    conf->p_clock    = p_clock;
+    conf->hs_rto_min = rto_min;
+}
 #endif
 
 void mbedtls_ssl_conf_authmode( mbedtls_ssl_config *conf, int authmode )
@@ -8838,6 +9429,39 @@ void mbedtls_ssl_conf_dbg( mbedtls_ssl_config *conf,
     conf->p_dbg      = p_dbg;
 }
 
+void mbedtls_ssl_conf_dbg_threshold( mbedtls_ssl_config *conf,
+                                     int threshold, uint32_t sample )
+{
+    conf->dbg_threshold = threshold < 0 ? -1 : threshold;
+    conf->dbg_sample    = sample;
+}
+
+void mbedtls_ssl_set_dbg_threshold( mbedtls_ssl_context *ssl,
+                                    int threshold )
+{
+    ssl->dbg_threshold = threshold < 0 ? -1 : threshold;
+}
+
+#if defined(MBEDTLS_DEBUG_BINARY_TRACE)
+void mbedtls_ssl_conf_dbg_trace( mbedtls_ssl_config *conf,
+        mbedtls_debug_trace *(*f_trace)(void *, const mbedtls_ssl_context *),
+        void *p_trace )
+{
+    conf->f_trace    = f_trace;
+    conf->p_trace    = p_trace;
+}
+#endif
+
+void mbedtls_ssl_conf_handshake_timing( mbedtls_ssl_config *conf,
+                                        mbedtls_ssl_get_time_ns_t *f_time,
+                                        mbedtls_ssl_hs_timing_t *f_timing,
+                                        void *p_timing )
+{
+    conf->f_time_ns   = f_time;
+    conf->f_hs_timing = f_timing;
+    conf->p_hs_timing = p_timing;
+}
+
 void mbedtls_ssl_set_bio( mbedtls_ssl_context *ssl,
         void *p_bio,
         mbedtls_ssl_send_t *f_send,
@@ -8939,10 +9563,51 @@ void mbedtls_ssl_conf_cert_profile( mbedtls_ssl_config *conf,
     conf->cert_profile = profile;
 }
 
+/*
+ * Encode the chain of a key/cert entry as written in the Certificate message,
+ * each certificate preceded by its 3-byte length, so that handshakes copy it
+ * in one go. Chains that cannot fit in a message are left to the handshake,
+ * which reports the error.
+ */
+static int ssl_key_cert_encode_chain( mbedtls_ssl_key_cert *key_cert )
+{
+    size_t len = 0;
+    unsigned char *p;
+    const mbedtls_x509_crt *crt;
+
+    for( crt = key_cert->cert; crt != NULL; crt = crt->next )
+    {
+        if( crt->raw.len > MBEDTLS_SSL_OUT_CONTENT_LEN - 7 - 3 - len )
+            return( 0 );
+        len += 3 + crt->raw.len;
+    }
+
+    if( len == 0 )
+        return( 0 );
+
+    if( ( p = mbedtls_calloc( 1, len ) ) == NULL )
+        return( MBEDTLS_ERR_SSL_ALLOC_FAILED );
+
+    key_cert->chain_buf = p;
+    key_cert->chain_len = len;
+
+    for( crt = key_cert->cert; crt != NULL; crt = crt->next )
+    {
+        *p++ = (unsigned char)( crt->raw.len >> 16 );
+        *p++ = (unsigned char)( crt->raw.len >>  8 );
+        *p++ = (unsigned char)( crt->raw.len       );
+        memcpy( p, crt->raw.p, crt->raw.len );
+        p += crt->raw.len;
+    }
+
+    return( 0 );
+}
+
 /* Append a new keycert entry to a (possibly empty) list */
 static int ssl_append_key_cert( mbedtls_ssl_key_cert **head,
                                 mbedtls_x509_crt *cert,
-                                mbedtls_pk_context *key )
+                                mbedtls_pk_context *key,
+                                int encode_chain )
 {
     mbedtls_ssl_key_cert *new_cert;
 
@@ -8954,6 +9619,12 @@ static int ssl_append_key_cert( mbedtls_ssl_key_cert **head,
     new_cert->key  = key;
     new_cert->next = NULL;
 
+    if( encode_chain && ssl_key_cert_encode_chain( new_cert ) != 0 )
+    {
+        mbedtls_free( new_cert );
+        return( MBEDTLS_ERR_SSL_ALLOC_FAILED );
+    }
+
     /* Update head is the list was null, else add to the end */
     if( *head == NULL )
     {
@@ -8970,11 +9641,18 @@ static int ssl_append_key_cert( mbedtls_ssl_key_cert **head,
     return( 0 );
 }
 
+int mbedtls_ssl_key_cert_append( mbedtls_ssl_key_cert **head,
+                                 mbedtls_x509_crt *cert,
+                                 mbedtls_pk_context *key )
+{
+    return( ssl_append_key_cert( head, cert, key, 1 ) );
+}
+
 int mbedtls_ssl_conf_own_cert( mbedtls_ssl_config *conf,
                               mbedtls_x509_crt *own_cert,
                               mbedtls_pk_context *pk_key )
 {
-    return( ssl_append_key_cert( &conf->key_cert, own_cert, pk_key ) );
+    return( ssl_append_key_cert( &conf->key_cert, own_cert, pk_key, 1 ) );
 }
 
 void mbedtls_ssl_conf_ca_chain( mbedtls_ssl_config *conf,
@@ -9013,8 +9691,38 @@ int mbedtls_ssl_set_hs_own_cert( mbedtls_ssl_context *ssl,
                                  mbedtls_x509_crt *own_cert,
                                  mbedtls_pk_context *pk_key )
 {
+    /* Start a list of our own rather than extend a shared one */
+    if( ssl->handshake->sni_key_cert_shared )
+    {
+        ssl->handshake->sni_key_cert = NULL;
+        ssl->handshake->sni_key_cert_shared = 0;
+    }
+
+    /* The list only lives for this handshake: the chain is written
+     * directly from the certificates */
     return( ssl_append_key_cert( &ssl->handshake->sni_key_cert,
-                                 own_cert, pk_key ) );
+                                 own_cert, pk_key, 0 ) );
+}
+
+void mbedtls_ssl_set_hs_key_cert_list( mbedtls_ssl_context *ssl,
+                                       mbedtls_ssl_key_cert *key_cert )
+{
+    if( ssl->handshake->sni_key_cert_shared == 0 )
+        mbedtls_ssl_key_cert_free( ssl->handshake->sni_key_cert );
+
+    ssl->handshake->sni_key_cert = key_cert;
+    ssl->handshake->sni_key_cert_shared = 1;
+}
+
+void mbedtls_ssl_set_hs_sni_release( mbedtls_ssl_context *ssl,
+                                     void (*f_release)(void *),
+                                     void *p_release )
+{
+    if( ssl->handshake->f_sni_release != NULL )
+        ssl->handshake->f_sni_release( ssl->handshake->p_sni_release );
+
+    ssl->handshake->f_sni_release = f_release;
+    ssl->handshake->p_sni_release = p_release;
 }
 
 void mbedtls_ssl_set_hs_ca_chain( mbedtls_ssl_context *ssl,
@@ -9348,13 +10056,19 @@ int mbedtls_ssl_set_hostname( mbedtls_ssl_context *ssl, const char *hostname )
         mbedtls_free( ssl->hostname );
     }
 
-    /* Passing NULL as hostname shall clear the old one */
-
-    if( hostname == NULL )
+    if( ssl->hostname_match != NULL )
     {
-        ssl->hostname = NULL;
+        mbedtls_platform_zeroize( ssl->hostname_match,
+                                  sizeof( mbedtls_x509_crt_hostname ) );
+        mbedtls_free( ssl->hostname_match );
     }
-    else
+
+    /* Passing NULL as hostname shall clear the old one */
+
+    ssl->hostname = NULL;
+    ssl->hostname_match = NULL;
+
+    if( hostname != NULL )
     {
         ssl->hostname = mbedtls_calloc( 1, hostname_len + 1 );
         if( ssl->hostname == NULL )
@@ -9363,6 +10077,21 @@ int mbedtls_ssl_set_hostname( mbedtls_ssl_context *ssl, const char *hostname )
         memcpy( ssl->hostname, hostname, hostname_len );
 
         ssl->hostname[hostname_len] = '\0';
+
+        /* Lowercase and split the name once, rather than for every
+         * certificate name it is compared with */
+        ssl->hostname_match = mbedtls_calloc( 1,
+                                      sizeof( mbedtls_x509_crt_hostname ) );
+        if( ssl->hostname_match == NULL ||
+            mbedtls_x509_crt_hostname_set( ssl->hostname_match,
+                                           ssl->hostname ) != 0 )
+        {
+            mbedtls_free( ssl->hostname_match );
+            ssl->hostname_match = NULL;
+            mbedtls_free( ssl->hostname );
+            ssl->hostname = NULL;
+            return( MBEDTLS_ERR_SSL_ALLOC_FAILED );
+        }
     }
 
     return( 0 );
@@ -9588,6 +10317,25 @@ void mbedtls_ssl_set_async_operation_data( mbedtls_ssl_context *ssl,
 }
 #endif /* MBEDTLS_SSL_ASYNC_PRIVATE */
 
+#if defined(MBEDTLS_SSL_ASYNC_VERIFY)
+int mbedtls_ssl_conf_async_verify( mbedtls_ssl_config *conf,
+                                   mbedtls_ssl_async_verify_start_t *f_start,
+                                   mbedtls_ssl_async_verify_resume_t *f_resume,
+                                   mbedtls_ssl_async_verify_cancel_t *f_cancel,
+                                   void *p_verify )
+{
+    if( f_start != NULL && f_resume == NULL )
+        return( MBEDTLS_ERR_SSL_BAD_INPUT_DATA );
+
+    conf->f_async_verify_start = f_start;
+    conf->f_async_verify_resume = f_resume;
+    conf->f_async_verify_cancel = f_cancel;
+    conf->p_async_verify = p_verify;
+
+    return( 0 );
+}
+#endif /* MBEDTLS_SSL_ASYNC_VERIFY */
+
 /*
  * SSL get accessors
  */
@@ -9708,6 +10456,32 @@ const char *mbedtls_ssl_get_version( const mbedtls_ssl_context *ssl )
     }
 }
 
+int mbedtls_ssl_get_stats( const mbedtls_ssl_context *ssl,
+                           mbedtls_ssl_stats *stats )
+{
+    if( ssl == NULL || stats == NULL )
+        return( MBEDTLS_ERR_SSL_BAD_INPUT_DATA );
+
+    *stats = ssl->stats;
+
+    return( 0 );
+}
+
+#if defined(MBEDTLS_ALLOC_PROFILE)
+int mbedtls_ssl_get_alloc_profile( const mbedtls_ssl_context *ssl,
+                                   int category,
+                                   mbedtls_alloc_profile_stats *stats )
+{
+    if( ssl == NULL || stats == NULL ||
+        category < 0 || category >= MBEDTLS_ALLOC_PROFILE_CATEGORIES )
+        return( MBEDTLS_ERR_SSL_BAD_INPUT_DATA );
+
+    *stats = ssl->alloc_profile[category];
+
+    return( 0 );
+}
+#endif /* MBEDTLS_ALLOC_PROFILE */
+
 int mbedtls_ssl_get_record_expansion( const mbedtls_ssl_context *ssl )
 {
     size_t transform_expansion = 0;
@@ -10464,10 +11238,36 @@ int mbedtls_ssl_session_load( mbedtls_ssl_session *session,
 int mbedtls_ssl_handshake_step( mbedtls_ssl_context *ssl )
 {
     int ret = MBEDTLS_ERR_SSL_FEATURE_UNAVAILABLE;
+    int timed, state = 0;
+    uint64_t start = 0;
+    size_t io_start = 0;
 
     if( ssl == NULL || ssl->conf == NULL )
         return( MBEDTLS_ERR_SSL_BAD_INPUT_DATA );
 
+    timed = ssl->conf->f_time_ns != NULL && ssl->conf->f_hs_timing != NULL;
+    if( timed )
+    {
+        state = ssl->state;
+        if( ssl->handshake != NULL )
+            io_start = ssl->handshake->io_bytes;
+        start = ssl->conf->f_time_ns( ssl->conf->p_hs_timing );
+    }
+
+#if defined(MBEDTLS_SSL_CREDENTIALS_C)
+    /* Take the credentials of the configuration when the handshake starts
+     * rather than when the context is set up or reset, as a server context
+     * may wait for a connection meanwhile, and keep them for the whole
+     * handshake even if they are replaced in the meantime */
+    if( ssl->handshake != NULL && ssl->handshake->credentials == NULL &&
+        ( ssl->state == MBEDTLS_SSL_HELLO_REQUEST ||
+          ssl->state == MBEDTLS_SSL_CLIENT_HELLO ) )
+    {
+        ssl->handshake->credentials =
+            mbedtls_ssl_conf_get_credentials( ssl->conf );
+    }
+#endif
+
 #if defined(MBEDTLS_SSL_CLI_C)
     if( ssl->conf->endpoint == MBEDTLS_SSL_IS_CLIENT )
         ret = mbedtls_ssl_handshake_client_step( ssl );
@@ -10477,6 +11277,18 @@ int mbedtls_ssl_handshake_step( mbedtls_ssl_context *ssl )
         ret = mbedtls_ssl_handshake_server_step( ssl );
 #endif
 
+    if( timed )
+    {
+        uint64_t end = ssl->conf->f_time_ns( ssl->conf->p_hs_timing );
+
+        /* The handshake parameters are gone after the wrapup step, which
+         * doesn't perform any I/O. */
+        ssl->conf->f_hs_timing( ssl->conf->p_hs_timing, ssl, state,
+                                start, end,
+                                ssl->handshake != NULL ?
+                                ssl->handshake->io_bytes - io_start : 0 );
+    }
+
     return( ret );
 }
 
@@ -11174,13 +11986,14 @@ void mbedtls_ssl_transform_free( mbedtls_ssl_transform *transform )
 }
 
 #if defined(MBEDTLS_X509_CRT_PARSE_C)
-static void ssl_key_cert_free( mbedtls_ssl_key_cert *key_cert )
+void mbedtls_ssl_key_cert_free( mbedtls_ssl_key_cert *key_cert )
 {
     mbedtls_ssl_key_cert *cur = key_cert, *next;
 
     while( cur != NULL )
     {
         next = cur->next;
+        mbedtls_free( cur->chain_buf );
         mbedtls_free( cur );
         cur = next;
     }
@@ -11214,13 +12027,85 @@ static void ssl_buffering_free_slot( mbedtls_ssl_context *ssl,
 
     if( hs_buf->is_valid == 1 )
     {
-        hs->buffering.total_bytes_buffered -= hs_buf->data_len;
-        mbedtls_platform_zeroize( hs_buf->data, hs_buf->data_len );
-        mbedtls_free( hs_buf->data );
+        ssl_buffering_release( ssl, hs_buf->data, hs_buf->data_len );
         memset( hs_buf, 0, sizeof( mbedtls_ssl_hs_buffer ) );
     }
 }
 
+/*
+ * Buffers for handshake message reassembly and future records are carved
+ * out of a single pool of MBEDTLS_SSL_DTLS_MAX_BUFFERING bytes, allocated
+ * on first use and kept until the end of the handshake. Buffers are kept
+ * contiguous at the start of the pool, in allocation order, so that
+ * total_bytes_buffered is also the offset of the first free byte: this
+ * way, any request within the MBEDTLS_SSL_DTLS_MAX_BUFFERING budget can
+ * be served, and reassembly and buffering never call the heap again
+ * during the handshake, however many records are lost or reordered.
+ */
+static unsigned char *ssl_buffering_alloc( mbedtls_ssl_context *ssl,
+                                           size_t len )
+{
+    mbedtls_ssl_handshake_params * const hs = ssl->handshake;
+    unsigned char *data;
+
+    if( len > MBEDTLS_SSL_DTLS_MAX_BUFFERING -
+              hs->buffering.total_bytes_buffered )
+    {
+        return( NULL );
+    }
+
+    if( hs->buffering.pool == NULL )
+    {
+        hs->buffering.pool = SSL_ALLOC( ssl, MBEDTLS_ALLOC_PROFILE_FLIGHT,
+                                        MBEDTLS_SSL_DTLS_MAX_BUFFERING );
+        if( hs->buffering.pool == NULL )
+        {
+            MBEDTLS_SSL_DEBUG_MSG( 1, ( "alloc %d bytes failed",
+                                        MBEDTLS_SSL_DTLS_MAX_BUFFERING ) );
+            return( NULL );
+        }
+    }
+
+    data = hs->buffering.pool + hs->buffering.total_bytes_buffered;
+    memset( data, 0, len );
+    hs->buffering.total_bytes_buffered += len;
+
+    return( data );
+}
+
+/*
+ * Return a buffer to the pool: move the buffers located after it
+ * down to keep the pool contiguous, and update their owners.
+ */
+static void ssl_buffering_release( mbedtls_ssl_context *ssl,
+                                   unsigned char *data, size_t len )
+{
+    mbedtls_ssl_handshake_params * const hs = ssl->handshake;
+    unsigned char * const end = hs->buffering.pool +
+                                hs->buffering.total_bytes_buffered;
+    unsigned offset;
+
+    memmove( data, data + len, (size_t)( end - ( data + len ) ) );
+
+    for( offset = 0; offset < MBEDTLS_SSL_MAX_BUFFERED_HS; offset++ )
+    {
+        mbedtls_ssl_hs_buffer * const hs_buf = &hs->buffering.hs[offset];
+        if( hs_buf->is_valid == 1 && hs_buf->data > data )
+            hs_buf->data -= len;
+    }
+
+    if( hs->buffering.future_record.data != NULL &&
+        hs->buffering.future_record.data > data )
+    {
+        hs->buffering.future_record.data -= len;
+    }
+
+    /* The bytes now past the last buffer are either stale copies of moved
+     * data or the released data itself. */
+    mbedtls_platform_zeroize( end - len, len );
+    hs->buffering.total_bytes_buffered -= len;
+}
+
 #endif /* MBEDTLS_SSL_PROTO_DTLS */
 
 void mbedtls_ssl_handshake_free( mbedtls_ssl_context *ssl )
@@ -11238,6 +12123,24 @@ void mbedtls_ssl_handshake_free( mbedtls_ssl_context *ssl )
     }
 #endif /* MBEDTLS_SSL_ASYNC_PRIVATE */
 
+#if defined(MBEDTLS_SSL_ASYNC_VERIFY)
+    if( handshake->async_verify_in_progress != 0 )
+    {
+        if( ssl->conf->f_async_verify_cancel != NULL )
+        {
+            ssl->conf->f_async_verify_cancel( ssl->conf->p_async_verify, ssl,
+                                              handshake->async_verify_op );
+        }
+        handshake->async_verify_in_progress = 0;
+    }
+    if( handshake->async_verify_chain != NULL )
+    {
+        mbedtls_x509_crt_free( handshake->async_verify_chain );
+        mbedtls_free( handshake->async_verify_chain );
+        handshake->async_verify_chain = NULL;
+    }
+#endif /* MBEDTLS_SSL_ASYNC_VERIFY */
+
 #if defined(MBEDTLS_SSL_PROTO_SSL3) || defined(MBEDTLS_SSL_PROTO_TLS1) || \
     defined(MBEDTLS_SSL_PROTO_TLS1_1)
     mbedtls_md5_free(    &handshake->fin_md5  );
@@ -11260,6 +12163,11 @@ void mbedtls_ssl_handshake_free( mbedtls_ssl_context *ssl )
 #endif
 #endif /* MBEDTLS_SSL_PROTO_TLS1_2 */
 
+#if defined(MBEDTLS_SSL__PRF_HMAC_TLS1_2)
+    if( handshake->prf_master_ready != 0 )
+        ssl_prf_hmac_free( &handshake->prf_master );
+#endif
+
 #if defined(MBEDTLS_DHM_C)
     mbedtls_dhm_free( &handshake->dhm_ctx );
 #endif
@@ -11293,21 +12201,20 @@ void mbedtls_ssl_handshake_free( mbedtls_ssl_context *ssl )
     defined(MBEDTLS_SSL_SERVER_NAME_INDICATION)
     /*
      * Free only the linked list wrapper, not the keys themselves
-     * since the belong to the SNI callback
+     * since the belong to the SNI callback, and not at all if the
+     * list is shared
      */
-    if( handshake->sni_key_cert != NULL )
-    {
-        mbedtls_ssl_key_cert *cur = handshake->sni_key_cert, *next;
+    if( handshake->sni_key_cert_shared == 0 )
+        mbedtls_ssl_key_cert_free( handshake->sni_key_cert );
 
-        while( cur != NULL )
-        {
-            next = cur->next;
-            mbedtls_free( cur );
-            cur = next;
-        }
-    }
+    if( handshake->f_sni_release != NULL )
+        handshake->f_sni_release( handshake->p_sni_release );
 #endif /* MBEDTLS_X509_CRT_PARSE_C && MBEDTLS_SSL_SERVER_NAME_INDICATION */
 
+#if defined(MBEDTLS_SSL_CREDENTIALS_C)
+    mbedtls_ssl_credentials_release( handshake->credentials );
+#endif
+
 #if defined(MBEDTLS_SSL__ECP_RESTARTABLE)
     mbedtls_x509_crt_restart_free( &handshake->ecrs_ctx );
     if( handshake->ecrs_peer_cert != NULL )
@@ -11324,8 +12231,10 @@ void mbedtls_ssl_handshake_free( mbedtls_ssl_context *ssl )
 
 #if defined(MBEDTLS_SSL_PROTO_DTLS)
     mbedtls_free( handshake->verify_cookie );
-    ssl_flight_free( handshake->flight );
+    ssl_flight_free( ssl, handshake->flight );
     ssl_buffering_free( ssl );
+    SSL_FREE( ssl, MBEDTLS_ALLOC_PROFILE_FLIGHT, handshake->buffering.pool,
+              MBEDTLS_SSL_DTLS_MAX_BUFFERING );
 #endif
 
 #if defined(MBEDTLS_ECDH_C) &&                  \
@@ -11427,6 +12336,7 @@ static unsigned char ssl_serialized_context_header[] = {
  *  uint32 badmac_seen;         // DTLS: number of records with failing MAC
  *  uint64 in_window_top;       // DTLS: last validated record seq_num
  *  uint64 in_window;           // DTLS: bitmask for replay protection
+ *                              // (64 most recent records only)
  *  uint8 disable_datagram_packing; // DTLS: only one record per datagram
  *  uint64 cur_out_ctr;         // Record layer: outgoing sequence number
  *  uint16 mtu;                 // DTLS: path mtu (max outgoing fragment size)
@@ -11597,6 +12507,8 @@ int mbedtls_ssl_context_save( mbedtls_ssl_context *ssl,
     used += 16;
     if( used <= buf_len )
     {
+        uint64_t in_window = ssl_dtls_replay_get_bitmask( ssl );
+
         *p++ = (unsigned char)( ( ssl->in_window_top >> 56 ) & 0xFF );
         *p++ = (unsigned char)( ( ssl->in_window_top >> 48 ) & 0xFF );
         *p++ = (unsigned char)( ( ssl->in_window_top >> 40 ) & 0xFF );
@@ -11606,14 +12518,14 @@ int mbedtls_ssl_context_save( mbedtls_ssl_context *ssl,
         *p++ = (unsigned char)( ( ssl->in_window_top >>  8 ) & 0xFF );
         *p++ = (unsigned char)( ( ssl->in_window_top       ) & 0xFF );
 
-        *p++ = (unsigned char)( ( ssl->in_window >> 56 ) & 0xFF );
-        *p++ = (unsigned char)( ( ssl->in_window >> 48 ) & 0xFF );
-        *p++ = (unsigned char)( ( ssl->in_window >> 40 ) & 0xFF );
-        *p++ = (unsigned char)( ( ssl->in_window >> 32 ) & 0xFF );
-        *p++ = (unsigned char)( ( ssl->in_window >> 24 ) & 0xFF );
-        *p++ = (unsigned char)( ( ssl->in_window >> 16 ) & 0xFF );
-        *p++ = (unsigned char)( ( ssl->in_window >>  8 ) & 0xFF );
-        *p++ = (unsigned char)( ( ssl->in_window       ) & 0xFF );
+        *p++ = (unsigned char)( ( in_window >> 56 ) & 0xFF );
+        *p++ = (unsigned char)( ( in_window >> 48 ) & 0xFF );
+        *p++ = (unsigned char)( ( in_window >> 40 ) & 0xFF );
+        *p++ = (unsigned char)( ( in_window >> 32 ) & 0xFF );
+        *p++ = (unsigned char)( ( in_window >> 24 ) & 0xFF );
+        *p++ = (unsigned char)( ( in_window >> 16 ) & 0xFF );
+        *p++ = (unsigned char)( ( in_window >>  8 ) & 0xFF );
+        *p++ = (unsigned char)( ( in_window       ) & 0xFF );
     }
 #endif /* MBEDTLS_SSL_DTLS_ANTI_REPLAY */
 
@@ -11875,14 +12787,14 @@ static int ssl_context_load( mbedtls_ssl_context *ssl,
                          ( (uint64_t) p[7]       );
     p += 8;
 
-    ssl->in_window = ( (uint64_t) p[0] << 56 ) |
-                     ( (uint64_t) p[1] << 48 ) |
-                     ( (uint64_t) p[2] << 40 ) |
-                     ( (uint64_t) p[3] << 32 ) |
-                     ( (uint64_t) p[4] << 24 ) |
-                     ( (uint64_t) p[5] << 16 ) |
-                     ( (uint64_t) p[6] <<  8 ) |
-                     ( (uint64_t) p[7]       );
+    ssl_dtls_replay_set_bitmask( ssl, ( (uint64_t) p[0] << 56 ) |
+                                      ( (uint64_t) p[1] << 48 ) |
+                                      ( (uint64_t) p[2] << 40 ) |
+                                      ( (uint64_t) p[3] << 32 ) |
+                                      ( (uint64_t) p[4] << 24 ) |
+                                      ( (uint64_t) p[5] << 16 ) |
+                                      ( (uint64_t) p[6] <<  8 ) |
+                                      ( (uint64_t) p[7]       ) );
     p += 8;
 #endif /* MBEDTLS_SSL_DTLS_ANTI_REPLAY */
 
@@ -11964,7 +12876,8 @@ static int ssl_context_load( mbedtls_ssl_context *ssl,
     if( ssl->handshake != NULL )
     {
         mbedtls_ssl_handshake_free( ssl );
-        mbedtls_free( ssl->handshake );
+        SSL_FREE( ssl, MBEDTLS_ALLOC_PROFILE_HANDSHAKE, ssl->handshake,
+                  sizeof( mbedtls_ssl_handshake_params ) );
         ssl->handshake = NULL;
     }
 
@@ -12006,27 +12919,31 @@ void mbedtls_ssl_free( mbedtls_ssl_context *ssl )
     if( ssl->out_buf != NULL )
     {
         mbedtls_platform_zeroize( ssl->out_buf, MBEDTLS_SSL_OUT_BUFFER_LEN );
-        mbedtls_free( ssl->out_buf );
+        SSL_FREE( ssl, MBEDTLS_ALLOC_PROFILE_IO, ssl->out_buf,
+                  MBEDTLS_SSL_OUT_BUFFER_LEN );
     }
 
     if( ssl->in_buf != NULL )
     {
         mbedtls_platform_zeroize( ssl->in_buf, MBEDTLS_SSL_IN_BUFFER_LEN );
-        mbedtls_free( ssl->in_buf );
+        SSL_FREE( ssl, MBEDTLS_ALLOC_PROFILE_IO, ssl->in_buf,
+                  MBEDTLS_SSL_IN_BUFFER_LEN );
     }
 
 #if defined(MBEDTLS_ZLIB_SUPPORT)
     if( ssl->compress_buf != NULL )
     {
         mbedtls_platform_zeroize( ssl->compress_buf, MBEDTLS_SSL_COMPRESS_BUFFER_LEN );
-        mbedtls_free( ssl->compress_buf );
+        SSL_FREE( ssl, MBEDTLS_ALLOC_PROFILE_IO, ssl->compress_buf,
+                  MBEDTLS_SSL_COMPRESS_BUFFER_LEN );
     }
 #endif
 
     if( ssl->transform )
     {
         mbedtls_ssl_transform_free( ssl->transform );
-        mbedtls_free( ssl->transform );
+        SSL_FREE( ssl, MBEDTLS_ALLOC_PROFILE_SESSION, ssl->transform,
+                  sizeof( mbedtls_ssl_transform ) );
     }
 
     if( ssl->handshake )
@@ -12035,15 +12952,19 @@ void mbedtls_ssl_free( mbedtls_ssl_context *ssl )
         mbedtls_ssl_transform_free( ssl->transform_negotiate );
         mbedtls_ssl_session_free( ssl->session_negotiate );
 
-        mbedtls_free( ssl->handshake );
-        mbedtls_free( ssl->transform_negotiate );
-        mbedtls_free( ssl->session_negotiate );
+        SSL_FREE( ssl, MBEDTLS_ALLOC_PROFILE_HANDSHAKE, ssl->handshake,
+                  sizeof( mbedtls_ssl_handshake_params ) );
+        SSL_FREE( ssl, MBEDTLS_ALLOC_PROFILE_SESSION, ssl->transform_negotiate,
+                  sizeof( mbedtls_ssl_transform ) );
+        SSL_FREE( ssl, MBEDTLS_ALLOC_PROFILE_SESSION, ssl->session_negotiate,
+                  sizeof( mbedtls_ssl_session ) );
     }
 
     if( ssl->session )
     {
         mbedtls_ssl_session_free( ssl->session );
-        mbedtls_free( ssl->session );
+        SSL_FREE( ssl, MBEDTLS_ALLOC_PROFILE_SESSION, ssl->session,
+                  sizeof( mbedtls_ssl_session ) );
     }
 
 #if defined(MBEDTLS_X509_CRT_PARSE_C)
@@ -12052,6 +12973,13 @@ void mbedtls_ssl_free( mbedtls_ssl_context *ssl )
         mbedtls_platform_zeroize( ssl->hostname, strlen( ssl->hostname ) );
         mbedtls_free( ssl->hostname );
     }
+
+    if( ssl->hostname_match != NULL )
+    {
+        mbedtls_platform_zeroize( ssl->hostname_match,
+                                  sizeof( mbedtls_x509_crt_hostname ) );
+        mbedtls_free( ssl->hostname_match );
+    }
 #endif
 
 #if defined(MBEDTLS_SSL_HW_RECORD_ACCEL)
@@ -12078,6 +13006,12 @@ void mbedtls_ssl_free( mbedtls_ssl_context *ssl )
 void mbedtls_ssl_config_init( mbedtls_ssl_config *conf )
 {
     memset( conf, 0, sizeof( mbedtls_ssl_config ) );
+
+    conf->dbg_threshold = -1;
+
+#if defined(MBEDTLS_SSL_CREDENTIALS_C) && defined(MBEDTLS_THREADING_C)
+    mbedtls_mutex_init( &conf->credentials_mutex );
+#endif
 }
 
 #if defined(MBEDTLS_KEY_EXCHANGE__WITH_CERT__ENABLED)
@@ -12174,6 +13108,7 @@ int mbedtls_ssl_config_defaults( mbedtls_ssl_config *conf,
 
 #if defined(MBEDTLS_SSL_DTLS_ANTI_REPLAY)
     conf->anti_replay = MBEDTLS_SSL_ANTI_REPLAY_ENABLED;
+    conf->anti_replay_window = MBEDTLS_SSL_DTLS_REPLAY_WINDOW;
 #endif
 
 #if defined(MBEDTLS_SSL_SRV_C)
@@ -12316,7 +13251,14 @@ void mbedtls_ssl_config_free( mbedtls_ssl_config *conf )
 #endif
 
 #if defined(MBEDTLS_X509_CRT_PARSE_C)
-    ssl_key_cert_free( conf->key_cert );
+    mbedtls_ssl_key_cert_free( conf->key_cert );
+#endif
+
+#if defined(MBEDTLS_SSL_CREDENTIALS_C)
+    mbedtls_ssl_credentials_release( conf->credentials );
+#if defined(MBEDTLS_THREADING_C)
+    mbedtls_mutex_free( &conf->credentials_mutex );
+#endif
 #endif
 
     mbedtls_platform_zeroize( conf, sizeof( mbedtls_ssl_config ) );
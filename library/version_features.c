@@ -459,12 +459,21 @@ static const char * const features[] = {
 #if defined(MBEDTLS_SSL_ASYNC_PRIVATE)
     "MBEDTLS_SSL_ASYNC_PRIVATE",
 #endif /* MBEDTLS_SSL_ASYNC_PRIVATE */
+#if defined(MBEDTLS_SSL_ASYNC_VERIFY)
+    "MBEDTLS_SSL_ASYNC_VERIFY",
+#endif /* MBEDTLS_SSL_ASYNC_VERIFY */
 #if defined(MBEDTLS_SSL_CONTEXT_SERIALIZATION)
     "MBEDTLS_SSL_CONTEXT_SERIALIZATION",
 #endif /* MBEDTLS_SSL_CONTEXT_SERIALIZATION */
 #if defined(MBEDTLS_SSL_DEBUG_ALL)
     "MBEDTLS_SSL_DEBUG_ALL",
 #endif /* MBEDTLS_SSL_DEBUG_ALL */
+#if defined(MBEDTLS_DEBUG_BINARY_TRACE)
+    "MBEDTLS_DEBUG_BINARY_TRACE",
+#endif /* MBEDTLS_DEBUG_BINARY_TRACE */
+#if defined(MBEDTLS_ALLOC_PROFILE)
+    "MBEDTLS_ALLOC_PROFILE",
+#endif /* MBEDTLS_ALLOC_PROFILE */
 #if defined(MBEDTLS_SSL_ENCRYPT_THEN_MAC)
     "MBEDTLS_SSL_ENCRYPT_THEN_MAC",
 #endif /* MBEDTLS_SSL_ENCRYPT_THEN_MAC */
@@ -561,6 +570,18 @@ static const char * const features[] = {
 #if defined(MBEDTLS_X509_TRUSTED_CERTIFICATE_CALLBACK)
     "MBEDTLS_X509_TRUSTED_CERTIFICATE_CALLBACK",
 #endif /* MBEDTLS_X509_TRUSTED_CERTIFICATE_CALLBACK */
+#if defined(MBEDTLS_X509_CRT_PARSE_PATH_PARALLEL)
+    "MBEDTLS_X509_CRT_PARSE_PATH_PARALLEL",
+#endif /* MBEDTLS_X509_CRT_PARSE_PATH_PARALLEL */
+#if defined(MBEDTLS_X509_CRT_SNAPSHOT)
+    "MBEDTLS_X509_CRT_SNAPSHOT",
+#endif /* MBEDTLS_X509_CRT_SNAPSHOT */
+#if defined(MBEDTLS_X509_CRT_CONTIGUOUS)
+    "MBEDTLS_X509_CRT_CONTIGUOUS",
+#endif /* MBEDTLS_X509_CRT_CONTIGUOUS */
+#if defined(MBEDTLS_X509_PEM_FAST_DECODE)
+    "MBEDTLS_X509_PEM_FAST_DECODE",
+#endif /* MBEDTLS_X509_PEM_FAST_DECODE */
 #if defined(MBEDTLS_X509_CHECK_KEY_USAGE)
     "MBEDTLS_X509_CHECK_KEY_USAGE",
 #endif /* MBEDTLS_X509_CHECK_KEY_USAGE */
@@ -744,12 +765,24 @@ static const char * const features[] = {
 #if defined(MBEDTLS_SHA512_C)
     "MBEDTLS_SHA512_C",
 #endif /* MBEDTLS_SHA512_C */
+#if defined(MBEDTLS_SSL_ASYNC_ENGINE_C)
+    "MBEDTLS_SSL_ASYNC_ENGINE_C",
+#endif /* MBEDTLS_SSL_ASYNC_ENGINE_C */
 #if defined(MBEDTLS_SSL_CACHE_C)
     "MBEDTLS_SSL_CACHE_C",
 #endif /* MBEDTLS_SSL_CACHE_C */
 #if defined(MBEDTLS_SSL_COOKIE_C)
     "MBEDTLS_SSL_COOKIE_C",
 #endif /* MBEDTLS_SSL_COOKIE_C */
+#if defined(MBEDTLS_SSL_CREDENTIALS_C)
+    "MBEDTLS_SSL_CREDENTIALS_C",
+#endif /* MBEDTLS_SSL_CREDENTIALS_C */
+#if defined(MBEDTLS_SSL_SNI_REGISTRY_C)
+    "MBEDTLS_SSL_SNI_REGISTRY_C",
+#endif /* MBEDTLS_SSL_SNI_REGISTRY_C */
+#if defined(MBEDTLS_SSL_SNI_CACHE_C)
+    "MBEDTLS_SSL_SNI_CACHE_C",
+#endif /* MBEDTLS_SSL_SNI_CACHE_C */
 #if defined(MBEDTLS_SSL_TICKET_C)
     "MBEDTLS_SSL_TICKET_C",
 #endif /* MBEDTLS_SSL_TICKET_C */
@@ -460,7 +460,7 @@ int mbedtls_x509_get_name( unsigned char **p, const unsigned char *end,
             /* Mark this item as being no the only one in a set */
             cur->next_merged = 1;
 
-            cur->next = mbedtls_calloc( 1, sizeof( mbedtls_x509_name ) );
+            cur->next = MBEDTLS_X509_ALLOC( sizeof( mbedtls_x509_name ) );
 
             if( cur->next == NULL )
                 return( MBEDTLS_ERR_X509_ALLOC_FAILED );
@@ -474,7 +474,7 @@ int mbedtls_x509_get_name( unsigned char **p, const unsigned char *end,
         if( *p == end )
             return( 0 );
 
-        cur->next = mbedtls_calloc( 1, sizeof( mbedtls_x509_name ) );
+        cur->next = MBEDTLS_X509_ALLOC( sizeof( mbedtls_x509_name ) );
 
         if( cur->next == NULL )
             return( MBEDTLS_ERR_X509_ALLOC_FAILED );
@@ -483,6 +483,131 @@ int mbedtls_x509_get_name( unsigned char **p, const unsigned char *end,
     }
 }
 
+/*
+ * Canonical encoding of a name. Each AttributeTypeAndValue is written as
+ *
+ *   oid tag | oid length | oid | value tag | value length | value | merged
+ *
+ * with lengths on one byte below 0x80, and otherwise as 0x80 + n followed
+ * by n big-endian bytes. PrintableString and UTF8String values are written
+ * with the UTF8String tag and in ASCII lowercase, since chain building
+ * treats them as equal up to case; other values are written as they are.
+ */
+static size_t x509_canon_len_size( size_t len )
+{
+    size_t n = 1;
+
+    if( len < 0x80 )
+        return( 1 );
+
+    while( len != 0 )
+    {
+        n++;
+        len >>= 8;
+    }
+
+    return( n );
+}
+
+static unsigned char *x509_canon_write_len( unsigned char *p, size_t len )
+{
+    size_t n = x509_canon_len_size( len ) - 1;
+
+    if( n == 0 )
+    {
+        *p++ = (unsigned char) len;
+        return( p );
+    }
+
+    *p++ = (unsigned char)( 0x80 + n );
+    while( n-- > 0 )
+        *p++ = (unsigned char)( len >> ( 8 * n ) );
+
+    return( p );
+}
+
+static int x509_canon_folded( int tag )
+{
+    return( tag == MBEDTLS_ASN1_UTF8_STRING ||
+            tag == MBEDTLS_ASN1_PRINTABLE_STRING );
+}
+
+size_t mbedtls_x509_name_canon_len( const mbedtls_x509_name *name )
+{
+    size_t len = 0;
+
+    for( ; name != NULL; name = name->next )
+    {
+        len += 1 + x509_canon_len_size( name->oid.len ) + name->oid.len;
+        len += 1 + x509_canon_len_size( name->val.len ) + name->val.len;
+        len += 1;
+    }
+
+    return( len );
+}
+
+void mbedtls_x509_name_canon_write( mbedtls_x509_name_canon *canon,
+                                    const mbedtls_x509_name *name,
+                                    unsigned char *buf )
+{
+    unsigned char *p = buf;
+    uint64_t hash = 0xCBF29CE484222325;
+    size_t i;
+
+    for( ; name != NULL; name = name->next )
+    {
+        *p++ = (unsigned char) name->oid.tag;
+        p = x509_canon_write_len( p, name->oid.len );
+        if( name->oid.len != 0 )
+            memcpy( p, name->oid.p, name->oid.len );
+        p += name->oid.len;
+
+        if( x509_canon_folded( name->val.tag ) )
+        {
+            *p++ = MBEDTLS_ASN1_UTF8_STRING;
+            p = x509_canon_write_len( p, name->val.len );
+            for( i = 0; i < name->val.len; i++ )
+            {
+                unsigned char c = name->val.p[i];
+                *p++ = (unsigned char)( c >= 'A' && c <= 'Z' ? c + 32 : c );
+            }
+        }
+        else
+        {
+            *p++ = (unsigned char) name->val.tag;
+            p = x509_canon_write_len( p, name->val.len );
+            if( name->val.len != 0 )
+                memcpy( p, name->val.p, name->val.len );
+            p += name->val.len;
+        }
+
+        *p++ = (unsigned char) name->next_merged;
+    }
+
+    canon->p = buf;
+    canon->len = (size_t)( p - buf );
+
+    /* 64-bit FNV-1a */
+    for( i = 0; i < canon->len; i++ )
+    {
+        hash ^= buf[i];
+        hash *= 0x100000001B3;
+    }
+    canon->hash = hash;
+}
+
+int mbedtls_x509_name_canon_cmp( const mbedtls_x509_name_canon *a,
+                                 const mbedtls_x509_name_canon *b )
+{
+    if( a->hash != b->hash || a->len != b->len ||
+        memcmp( a->p, b->p, a->len ) != 0 )
+    {
+        return( -1 );
+    }
+
+    return( 0 );
+}
+
 static int x509_parse_int( unsigned char **p, size_t n, int *res )
 {
     *res = 0;
@@ -1001,6 +1126,312 @@ int mbedtls_x509_time_is_future( const mbedtls_x509_time *from )
 }
 #endif /* MBEDTLS_HAVE_TIME_DATE */
 
+#if defined(MBEDTLS_PEM_PARSE_C)
+#if defined(MBEDTLS_X509_PEM_FAST_DECODE)
+
+#if defined(MBEDTLS_HAVE_ASM) && defined(__GNUC__) &&  \
+    defined(__amd64__) && !defined(MBEDTLS_HAVE_X86_64)
+#define MBEDTLS_HAVE_X86_64
+#endif
+
+/*
+ * The SSSE3 decoder is selected at run time, so it is built with a function
+ * attribute rather than by raising the target of the whole library.
+ */
+#if defined(MBEDTLS_HAVE_X86_64) &&                                      \
+    ( defined(__clang__) ||                                              \
+      ( defined(__GNUC__) &&                                             \
+        ( __GNUC__ > 4 || ( __GNUC__ == 4 && __GNUC_MINOR__ >= 9 ) ) ) )
+#define X509_PEM_SSSE3
+#include <tmmintrin.h>
+#endif
+
+#define X509_PEM_EQ     0x40    /* '='                                  */
+#define X509_PEM_BAD    0x80    /* anything else, including newlines    */
+
+/*
+ * Base64 character to 6-bit value
+ */
+static const unsigned char x509_pem_dec_map[256] =
+{
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x3E, 0x80, 0x80, 0x80, 0x3F,
+    0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x3B,
+    0x3C, 0x3D, 0x80, 0x80, 0x80, 0x40, 0x80, 0x80,
+    0x80, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06,
+    0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E,
+    0x0F, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16,
+    0x17, 0x18, 0x19, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x1A, 0x1B, 0x1C, 0x1D, 0x1E, 0x1F, 0x20,
+    0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28,
+    0x29, 0x2A, 0x2B, 0x2C, 0x2D, 0x2E, 0x2F, 0x30,
+    0x31, 0x32, 0x33, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80
+};
+
+#if defined(X509_PEM_SSSE3)
+/*
+ * SSSE3 support, checked once with CPUID like the AES-NI module does
+ */
+static int x509_pem_has_ssse3( void )
+{
+    static int done = 0;
+    static unsigned int c = 0;
+
+    if( ! done )
+    {
+        __asm__( "movl  $1, %%eax   \n\t"
+                 "cpuid             \n\t"
+                 : "=c" (c)
+                 :
+                 : "eax", "ebx", "edx" );
+        done = 1;
+    }
+
+    return( ( c & 0x00000200u ) != 0 );
+}
+
+/*
+ * Decode 16 base64 characters into 12 bytes, or return 0 without writing
+ * anything if one of them is not a base64 digit (padding, newline, ...).
+ *
+ * The characters are classified by a table lookup on each nibble; the
+ * offsets mapping them to their values depend only on the high nibble,
+ * except for '/' which shares its high nibble with '+'. The 6-bit values
+ * are then packed with two multiply-add steps and a final shuffle.
+ */
+__attribute__((target("ssse3")))
+static int x509_pem_decode_ssse3( const unsigned char *src,
+                                  unsigned char *dst )
+{
+    const __m128i lut_lo = _mm_setr_epi8(
+        0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+        0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A );
+    const __m128i lut_hi = _mm_setr_epi8(
+        0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+        0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10 );
+    const __m128i lut_roll = _mm_setr_epi8(
+        0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0 );
+    const __m128i mask_2f = _mm_set1_epi8( 0x2F );
+    __m128i in, hi_nibbles, lo_nibbles, roll, out;
+
+    in = _mm_loadu_si128( (const __m128i *) src );
+
+    hi_nibbles = _mm_and_si128( _mm_srli_epi32( in, 4 ), mask_2f );
+    lo_nibbles = _mm_and_si128( in, mask_2f );
+
+    if( _mm_movemask_epi8( _mm_cmpgt_epi8(
+            _mm_and_si128( _mm_shuffle_epi8( lut_lo, lo_nibbles ),
+                           _mm_shuffle_epi8( lut_hi, hi_nibbles ) ),
+            _mm_setzero_si128() ) ) != 0 )
+    {
+        return( 0 );
+    }
+
+    roll = _mm_shuffle_epi8( lut_roll,
+               _mm_add_epi8( _mm_cmpeq_epi8( in, mask_2f ), hi_nibbles ) );
+    in = _mm_add_epi8( in, roll );
+
+    /* 00aaaaaa 00bbbbbb 00cccccc 00dddddd -> aaaaaabb bbbbcccc ccdddddd */
+    out = _mm_maddubs_epi16( in, _mm_set1_epi32( 0x01400140 ) );
+    out = _mm_madd_epi16( out, _mm_set1_epi32( 0x00011000 ) );
+    out = _mm_shuffle_epi8( out, _mm_setr_epi8(
+        2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1 ) );
+
+    _mm_storeu_si128( (__m128i *) dst, out );
+
+    return( 1 );
+}
+#endif /* X509_PEM_SSSE3 */
+
+/*
+ * Decode the base64 body of a PEM block in a single pass.
+ *
+ * Only the layout produced by common tools is handled: base64 digits, lines
+ * ending with LF or CRLF, and padding in the last group. Return 0 and the
+ * decoded length on success, or -1 for anything else, in which case the
+ * caller leaves the block to mbedtls_pem_read_buffer() for full validation
+ * and error reporting. dst must hold at least ( slen / 4 ) * 3 bytes.
+ */
+static int x509_pem_decode( const unsigned char *src, size_t slen,
+                            unsigned char *dst, size_t dlen, size_t *olen )
+{
+    const unsigned char *end = src + slen;
+    unsigned char *p = dst;
+    unsigned char q[4];
+    uint32_t x;
+    size_t n;
+#if defined(X509_PEM_SSSE3)
+    int simd = x509_pem_has_ssse3();
+#endif
+
+    for( ;; )
+    {
+#if defined(X509_PEM_SSSE3)
+        /* Whole lines but the last are consumed here; the store is 16 bytes */
+        while( simd && end - src >= 16 && dst + dlen - p >= 16 &&
+               x509_pem_decode_ssse3( src, p ) )
+        {
+            src += 16;
+            p += 12;
+        }
+#endif
+
+        /* Fast scalar path: four digits, no newline, no padding */
+        if( end - src >= 4 &&
+            ( ( x509_pem_dec_map[src[0]] | x509_pem_dec_map[src[1]] |
+                x509_pem_dec_map[src[2]] | x509_pem_dec_map[src[3]] ) &
+              ( X509_PEM_EQ | X509_PEM_BAD ) ) == 0 )
+        {
+            x = ( (uint32_t) x509_pem_dec_map[src[0]] << 18 ) |
+                ( (uint32_t) x509_pem_dec_map[src[1]] << 12 ) |
+                ( (uint32_t) x509_pem_dec_map[src[2]] <<  6 ) |
+                ( (uint32_t) x509_pem_dec_map[src[3]]       );
+            src += 4;
+
+            p[0] = (unsigned char)( x >> 16 );
+            p[1] = (unsigned char)( x >>  8 );
+            p[2] = (unsigned char)( x       );
+            p += 3;
+            continue;
+        }
+
+        /* Slow path: gather the next group across line breaks */
+        for( n = 0; n < 4 && src < end; )
+        {
+            if( *src == '\n' )
+                src++;
+            else if( *src == '\r' && end - src >= 2 && src[1] == '\n' )
+                src += 2;
+            else
+                q[n++] = x509_pem_dec_map[*src++];
+        }
+
+        if( n == 0 )
+            break;
+
+        if( n != 4 || ( ( q[0] | q[1] ) & ( X509_PEM_EQ | X509_PEM_BAD ) ) ||
+            ( ( q[2] | q[3] ) & X509_PEM_BAD ) ||
+            ( q[2] == X509_PEM_EQ && q[3] != X509_PEM_EQ ) )
+        {
+            return( -1 );
+        }
+
+        x = ( (uint32_t) q[0] << 18 ) | ( (uint32_t) q[1] << 12 ) |
+            ( (uint32_t) ( q[2] & 0x3F ) << 6 ) | ( q[3] & 0x3F );
+
+        if( q[3] == X509_PEM_EQ )
+        {
+            *p++ = (unsigned char)( x >> 16 );
+            if( q[2] != X509_PEM_EQ )
+                *p++ = (unsigned char)( x >> 8 );
+
+            /* Padding ends the data: only line breaks may follow */
+            for( ; src < end; src++ )
+            {
+                if( *src != '\n' &&
+                    ( *src != '\r' || end - src < 2 || src[1] != '\n' ) )
+                    return( -1 );
+            }
+            break;
+        }
+
+        p[0] = (unsigned char)( x >> 16 );
+        p[1] = (unsigned char)( x >>  8 );
+        p[2] = (unsigned char)( x       );
+        p += 3;
+    }
+
+    if( p == dst )
+        return( -1 );
+
+    *olen = p - dst;
+
+    return( 0 );
+}
+#endif /* MBEDTLS_X509_PEM_FAST_DECODE */
+
+/*
+ * Read a PEM block of an unencrypted X.509 object, with the same framing and
+ * results as mbedtls_pem_read_buffer() without a password
+ */
+int mbedtls_x509_pem_read( mbedtls_pem_context *ctx, const char *header,
+                           const char *footer, const unsigned char *data,
+                           size_t *use_len )
+{
+#if defined(MBEDTLS_X509_PEM_FAST_DECODE)
+    const unsigned char *s1, *s2, *end;
+    unsigned char *buf;
+    size_t blen, len;
+
+    if( ctx == NULL )
+        return( MBEDTLS_ERR_PEM_BAD_INPUT_DATA );
+
+    s1 = (const unsigned char *) strstr( (const char *) data, header );
+    if( s1 == NULL )
+        return( MBEDTLS_ERR_PEM_NO_HEADER_FOOTER_PRESENT );
+
+    s2 = (const unsigned char *) strstr( (const char *) data, footer );
+    if( s2 == NULL || s2 <= s1 )
+        return( MBEDTLS_ERR_PEM_NO_HEADER_FOOTER_PRESENT );
+
+    s1 += strlen( header );
+    if( *s1 == ' '  ) s1++;
+    if( *s1 == '\r' ) s1++;
+    if( *s1 != '\n' || ++s1 >= s2 )
+        goto fallback;
+
+    end = s2 + strlen( footer );
+    if( *end == ' '  ) end++;
+    if( *end == '\r' ) end++;
+    if( *end == '\n' ) end++;
+
+    /* Room for the digits; the line breaks make it a slight overestimate */
+    if( ( blen = ( ( s2 - s1 ) / 4 ) * 3 ) == 0 )
+        goto fallback;
+
+    if( ( buf = mbedtls_calloc( 1, blen ) ) == NULL )
+        return( MBEDTLS_ERR_PEM_ALLOC_FAILED );
+
+    /* Encapsulated headers, as in encrypted PEM, are not base64 digits */
+    if( x509_pem_decode( s1, s2 - s1, buf, blen, &len ) != 0 )
+    {
+        mbedtls_free( buf );
+        goto fallback;
+    }
+
+    ctx->buf = buf;
+    ctx->buflen = len;
+    *use_len = end - data;
+
+    return( 0 );
+
+fallback:
+#endif /* MBEDTLS_X509_PEM_FAST_DECODE */
+    return( mbedtls_pem_read_buffer( ctx, header, footer, data,
+                                     NULL, 0, use_len ) );
+}
+#endif /* MBEDTLS_PEM_PARSE_C */
+
 #if defined(MBEDTLS_SELF_TEST)
 
 #include "mbedtls/x509_crt.h"
@@ -437,6 +437,15 @@ int mbedtls_x509_crl_parse_der( mbedtls_x509_crl *chain,
 
     crl->issuer_raw.len = p - crl->issuer_raw.p;
 
+    len = mbedtls_x509_name_canon_len( &crl->issuer );
+    if( ( crl->issuer_canon.p = MBEDTLS_X509_ALLOC( len ) ) == NULL )
+    {
+        mbedtls_x509_crl_free( crl );
+        return( MBEDTLS_ERR_X509_ALLOC_FAILED );
+    }
+    mbedtls_x509_name_canon_write( &crl->issuer_canon, &crl->issuer,
+                                   crl->issuer_canon.p );
+
     /*
      * thisUpdate          Time
      * nextUpdate          Time OPTIONAL
@@ -551,15 +560,15 @@ int mbedtls_x509_crl_parse( mbedtls_x509_crl *chain, const unsigned char *buf, s
     {
         mbedtls_pem_init( &pem );
 
-        // Avoid calling mbedtls_pem_read_buffer() on non-null-terminated
+        // Avoid calling mbedtls_x509_pem_read() on non-null-terminated
         // string
         if( buflen == 0 || buf[buflen - 1] != '\0' )
             ret = MBEDTLS_ERR_PEM_NO_HEADER_FOOTER_PRESENT;
         else
-            ret = mbedtls_pem_read_buffer( &pem,
-                                           "-----BEGIN X509 CRL-----",
-                                           "-----END X509 CRL-----",
-                                            buf, NULL, 0, &use_len );
+            ret = mbedtls_x509_pem_read( &pem,
+                                         "-----BEGIN X509 CRL-----",
+                                         "-----END X509 CRL-----",
+                                         buf, &use_len );
 
         if( ret == 0 )
         {
@@ -734,7 +743,13 @@ void mbedtls_x509_crl_free( mbedtls_x509_crl *crl )
             name_prv = name_cur;
             name_cur = name_cur->next;
             mbedtls_platform_zeroize( name_prv, sizeof( mbedtls_x509_name ) );
-            mbedtls_free( name_prv );
+            MBEDTLS_X509_FREE( name_prv, sizeof( mbedtls_x509_name ) );
+        }
+
+        if( crl_cur->issuer_canon.p != NULL )
+        {
+            MBEDTLS_X509_FREE( crl_cur->issuer_canon.p,
+                               crl_cur->issuer_canon.len );
         }
 
         entry_cur = crl_cur->entry.next;
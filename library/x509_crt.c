@@ -83,6 +83,10 @@
 #endif /* !_WIN32 || EFIX64 || EFI32 */
 #endif
 
+#if defined(MBEDTLS_X509_CRT_PARSE_PATH_PARALLEL)
+#include <pthread.h>
+#endif
+
 /*
  * Item in a verification chain: cert and flags for it
  */
@@ -295,71 +299,20 @@ static int x509_check_wildcard( const char *cn, const mbedtls_x509_buf *name )
 }
 
 /*
- * Compare two X.509 strings, case-insensitive, and allowing for some encoding
- * variations (but not all).
- *
- * Return 0 if equal, -1 otherwise.
- */
-static int x509_string_cmp( const mbedtls_x509_buf *a, const mbedtls_x509_buf *b )
-{
-    if( a->tag == b->tag &&
-        a->len == b->len &&
-        memcmp( a->p, b->p, b->len ) == 0 )
-    {
-        return( 0 );
-    }
-
-    if( ( a->tag == MBEDTLS_ASN1_UTF8_STRING || a->tag == MBEDTLS_ASN1_PRINTABLE_STRING ) &&
-        ( b->tag == MBEDTLS_ASN1_UTF8_STRING || b->tag == MBEDTLS_ASN1_PRINTABLE_STRING ) &&
-        a->len == b->len &&
-        x509_memcasecmp( a->p, b->p, b->len ) == 0 )
-    {
-        return( 0 );
-    }
-
-    return( -1 );
-}
-
-/*
- * Compare two X.509 Names (aka rdnSequence).
+ * Compare two X.509 Names (aka rdnSequence) through their canonical forms.
  *
  * See RFC 5280 section 7.1, though we don't implement the whole algorithm:
  * we sometimes return unequal when the full algorithm would return equal,
  * but never the other way. (In particular, we don't do Unicode normalisation
- * or space folding.)
+ * or space folding.) PrintableString and UTF8String values are compared
+ * without regard to ASCII case, other values must be identical.
  *
  * Return 0 if equal, -1 otherwise.
  */
-static int x509_name_cmp( const mbedtls_x509_name *a, const mbedtls_x509_name *b )
+static int x509_name_cmp( const mbedtls_x509_name_canon *a,
+                          const mbedtls_x509_name_canon *b )
 {
-    /* Avoid recursion, it might not be optimised by the compiler */
-    while( a != NULL || b != NULL )
-    {
-        if( a == NULL || b == NULL )
-            return( -1 );
-
-        /* type */
-        if( a->oid.tag != b->oid.tag ||
-            a->oid.len != b->oid.len ||
-            memcmp( a->oid.p, b->oid.p, b->oid.len ) != 0 )
-        {
-            return( -1 );
-        }
-
-        /* value */
-        if( x509_string_cmp( &a->val, &b->val ) != 0 )
-            return( -1 );
-
-        /* structure of the list of sets */
-        if( a->next_merged != b->next_merged )
-            return( -1 );
-
-        a = a->next;
-        b = b->next;
-    }
-
-    /* a == NULL == b */
-    return( 0 );
+    return( mbedtls_x509_name_canon_cmp( a, b ) );
 }
 
 /*
@@ -1048,6 +1001,200 @@ static int x509_get_crt_ext( unsigned char **p,
     return( 0 );
 }
 
+/*
+ * Build the canonical issuer and subject, in a single allocation
+ */
+static int x509_crt_canon_names( mbedtls_x509_crt *crt )
+{
+    size_t issuer_len = mbedtls_x509_name_canon_len( &crt->issuer );
+    size_t subject_len = mbedtls_x509_name_canon_len( &crt->subject );
+    unsigned char *buf;
+
+    buf = MBEDTLS_X509_ALLOC( issuer_len + subject_len );
+    if( buf == NULL )
+        return( MBEDTLS_ERR_X509_ALLOC_FAILED );
+
+    mbedtls_x509_name_canon_write( &crt->issuer_canon, &crt->issuer, buf );
+    mbedtls_x509_name_canon_write( &crt->subject_canon, &crt->subject,
+                                   buf + issuer_len );
+
+    return( 0 );
+}
+
+#if defined(MBEDTLS_X509_CRT_CONTIGUOUS)
+static size_t x509_crt_count_names( const mbedtls_x509_name *cur )
+{
+    size_t n = 0;
+
+    for( ; cur != NULL; cur = cur->next )
+        n++;
+
+    return( n );
+}
+
+static size_t x509_crt_count_seq( const mbedtls_x509_sequence *cur )
+{
+    size_t n = 0;
+
+    for( ; cur != NULL; cur = cur->next )
+        n++;
+
+    return( n );
+}
+
+/*
+ * Move the nodes following head into consecutive slots starting at p, and
+ * return the first slot after them.
+ */
+static unsigned char *x509_crt_move_names( mbedtls_x509_name *head,
+                                           unsigned char *p )
+{
+    mbedtls_x509_name *cur, *old;
+
+    for( cur = head; cur->next != NULL; cur = cur->next )
+    {
+        old = cur->next;
+        memcpy( p, old, sizeof( mbedtls_x509_name ) );
+        cur->next = (mbedtls_x509_name *) p;
+        p += sizeof( mbedtls_x509_name );
+
+        mbedtls_platform_zeroize( old, sizeof( mbedtls_x509_name ) );
+        MBEDTLS_X509_FREE( old, sizeof( mbedtls_x509_name ) );
+    }
+
+    return( p );
+}
+
+static unsigned char *x509_crt_move_seq( mbedtls_x509_sequence *head,
+                                         unsigned char *p )
+{
+    mbedtls_x509_sequence *cur, *old;
+
+    for( cur = head; cur->next != NULL; cur = cur->next )
+    {
+        old = cur->next;
+        memcpy( p, old, sizeof( mbedtls_x509_sequence ) );
+        cur->next = (mbedtls_x509_sequence *) p;
+        p += sizeof( mbedtls_x509_sequence );
+
+        mbedtls_platform_zeroize( old, sizeof( mbedtls_x509_sequence ) );
+        mbedtls_free( old );
+    }
+
+    return( p );
+}
+
+/*
+ * Make a buffer that pointed into the DER data at from point to the same
+ * place in its copy at to
+ */
+static void x509_crt_rebase_buf( mbedtls_x509_buf *buf,
+                                 const unsigned char *from, unsigned char *to )
+{
+    if( buf->p != NULL )
+        buf->p = to + ( buf->p - from );
+}
+
+static void x509_crt_rebase_names( mbedtls_x509_name *cur,
+                                   const unsigned char *from,
+                                   unsigned char *to )
+{
+    for( ; cur != NULL; cur = cur->next )
+    {
+        x509_crt_rebase_buf( &cur->oid, from, to );
+        x509_crt_rebase_buf( &cur->val, from, to );
+    }
+}
+
+static void x509_crt_rebase_seq( mbedtls_x509_sequence *cur,
+                                 const unsigned char *from,
+                                 unsigned char *to )
+{
+    for( ; cur != NULL; cur = cur->next )
+        x509_crt_rebase_buf( &cur->buf, from, to );
+}
+
+/*
+ * Move everything a parsed certificate allocated, except its public key
+ * and signature options, into one block laid out as
+ *
+ *   name nodes | sequence nodes | canonical names | copy of raw
+ *
+ * The nodes come first so that they are suitably aligned. If copy_raw is
+ * set, the DER data, which the certificate still points to in the
+ * caller's buffer, is copied last and all the buffers are moved to it.
+ */
+static int x509_crt_make_contiguous( mbedtls_x509_crt *crt, int copy_raw )
+{
+    size_t names, seqs, canon_len, raw_len;
+    unsigned char *block, *p;
+    const unsigned char *from;
+
+    names = x509_crt_count_names( crt->issuer.next ) +
+            x509_crt_count_names( crt->subject.next );
+    seqs = x509_crt_count_seq( crt->ext_key_usage.next ) +
+           x509_crt_count_seq( crt->subject_alt_names.next ) +
+           x509_crt_count_seq( crt->certificate_policies.next );
+    canon_len = crt->issuer_canon.len + crt->subject_canon.len;
+    raw_len = copy_raw ? crt->raw.len : 0;
+
+    crt->alloc_len = names * sizeof( mbedtls_x509_name ) +
+                     seqs * sizeof( mbedtls_x509_sequence ) +
+                     canon_len + raw_len;
+
+    if( crt->alloc_len == 0 )
+        return( 0 );
+
+    block = MBEDTLS_X509_ALLOC( crt->alloc_len );
+    if( block == NULL )
+    {
+        crt->alloc_len = 0;
+        return( MBEDTLS_ERR_X509_ALLOC_FAILED );
+    }
+
+    p = x509_crt_move_names( &crt->issuer, block );
+    p = x509_crt_move_names( &crt->subject, p );
+    p = x509_crt_move_seq( &crt->ext_key_usage, p );
+    p = x509_crt_move_seq( &crt->subject_alt_names, p );
+    p = x509_crt_move_seq( &crt->certificate_policies, p );
+
+    memcpy( p, crt->issuer_canon.p, canon_len );
+    MBEDTLS_X509_FREE( crt->issuer_canon.p, canon_len );
+    crt->issuer_canon.p = p;
+    crt->subject_canon.p = p + crt->issuer_canon.len;
+    p += canon_len;
+
+    crt->alloc = block;
+
+    if( copy_raw == 0 )
+        return( 0 );
+
+    from = crt->raw.p;
+    memcpy( p, from, raw_len );
+
+    x509_crt_rebase_buf( &crt->raw, from, p );
+    x509_crt_rebase_buf( &crt->tbs, from, p );
+    x509_crt_rebase_buf( &crt->serial, from, p );
+    x509_crt_rebase_buf( &crt->sig_oid, from, p );
+    x509_crt_rebase_buf( &crt->issuer_raw, from, p );
+    x509_crt_rebase_buf( &crt->subject_raw, from, p );
+    x509_crt_rebase_names( &crt->issuer, from, p );
+    x509_crt_rebase_names( &crt->subject, from, p );
+    x509_crt_rebase_buf( &crt->pk_raw, from, p );
+    x509_crt_rebase_buf( &crt->issuer_id, from, p );
+    x509_crt_rebase_buf( &crt->subject_id, from, p );
+    x509_crt_rebase_buf( &crt->v3_ext, from, p );
+    x509_crt_rebase_seq( &crt->subject_alt_names, from, p );
+    x509_crt_rebase_seq( &crt->certificate_policies, from, p );
+    x509_crt_rebase_seq( &crt->ext_key_usage, from, p );
+    x509_crt_rebase_buf( &crt->sig, from, p );
+
+    crt->own_buffer = 1;
+
+    return( 0 );
+}
+#endif /* MBEDTLS_X509_CRT_CONTIGUOUS */
+
 /*
  * Parse and fill a single X.509 certificate in DER format
  */
@@ -1057,6 +1204,7 @@ static int x509_crt_parse_der_core( mbedtls_x509_crt *crt,
                                     int make_copy )
 {
     int ret;
+    int copy_first = make_copy;
     size_t len;
     unsigned char *p, *end, *crt_end;
     mbedtls_x509_buf sig_params1, sig_params2, sig_oid2;
@@ -1091,10 +1239,17 @@ static int x509_crt_parse_der_core( mbedtls_x509_crt *crt,
 
     end = crt_end = p + len;
     crt->raw.len = crt_end - buf;
-    if( make_copy != 0 )
+
+#if defined(MBEDTLS_X509_CRT_CONTIGUOUS)
+    /* Parse from the caller's buffer, the copy is made with the rest of
+     * the certificate once its size is known */
+    copy_first = 0;
+#endif
+
+    if( copy_first != 0 )
     {
         /* Create and populate a new buffer for the raw field. */
-        crt->raw.p = p = mbedtls_calloc( 1, crt->raw.len );
+        crt->raw.p = p = MBEDTLS_X509_ALLOC( crt->raw.len );
         if( crt->raw.p == NULL )
             return( MBEDTLS_ERR_X509_ALLOC_FAILED );
 
@@ -1210,6 +1365,12 @@ static int x509_crt_parse_der_core( mbedtls_x509_crt *crt,
 
     crt->subject_raw.len = p - crt->subject_raw.p;
 
+    if( ( ret = x509_crt_canon_names( crt ) ) != 0 )
+    {
+        mbedtls_x509_crt_free( crt );
+        return( ret );
+    }
+
     /*
      * SubjectPublicKeyInfo
      */
@@ -1306,6 +1467,14 @@ static int x509_crt_parse_der_core( mbedtls_x509_crt *crt,
                 MBEDTLS_ERR_ASN1_LENGTH_MISMATCH );
     }
 
+#if defined(MBEDTLS_X509_CRT_CONTIGUOUS)
+    if( ( ret = x509_crt_make_contiguous( crt, make_copy ) ) != 0 )
+    {
+        mbedtls_x509_crt_free( crt );
+        return( ret );
+    }
+#endif
+
     return( 0 );
 }
 
@@ -1338,7 +1507,7 @@ static int mbedtls_x509_crt_parse_der_internal( mbedtls_x509_crt *chain,
      */
     if( crt->version != 0 && crt->next == NULL )
     {
-        crt->next = mbedtls_calloc( 1, sizeof( mbedtls_x509_crt ) );
+        crt->next = MBEDTLS_X509_ALLOC( sizeof( mbedtls_x509_crt ) );
 
         if( crt->next == NULL )
             return( MBEDTLS_ERR_X509_ALLOC_FAILED );
@@ -1354,7 +1523,7 @@ static int mbedtls_x509_crt_parse_der_internal( mbedtls_x509_crt *chain,
             prev->next = NULL;
 
         if( crt != chain )
-            mbedtls_free( crt );
+            MBEDTLS_X509_FREE( crt, sizeof( mbedtls_x509_crt ) );
 
         return( ret );
     }
@@ -1369,6 +1538,165 @@ int mbedtls_x509_crt_parse_der_nocopy( mbedtls_x509_crt *chain,
     return( mbedtls_x509_crt_parse_der_internal( chain, buf, buflen, 0 ) );
 }
 
+#if defined(MBEDTLS_X509_CRT_PARSE_PATH_PARALLEL) || \
+    defined(MBEDTLS_X509_CRT_SNAPSHOT)
+/*
+ * Check whether a chain already holds a certificate with the given encoding.
+ * Trust stores hold a few hundred certificates at most, and the lengths
+ * rarely match, so a linear scan is good enough.
+ */
+static int x509_crt_chain_contains( const mbedtls_x509_crt *chain,
+                                    const unsigned char *raw, size_t len )
+{
+    for( ; chain != NULL && chain->version != 0; chain = chain->next )
+    {
+        if( chain->raw.len == len && memcmp( chain->raw.p, raw, len ) == 0 )
+            return( 1 );
+    }
+
+    return( 0 );
+}
+#endif /* MBEDTLS_X509_CRT_PARSE_PATH_PARALLEL || MBEDTLS_X509_CRT_SNAPSHOT */
+
+#if defined(MBEDTLS_X509_CRT_SNAPSHOT)
+/*
+ * Trust store snapshot, all integers big-endian:
+ *
+ *      0 ..  7     magic "X509SNAP"
+ *      8 .. 11     format version (1)
+ *     12 .. 15     number of certificates N
+ *     16 .. 16+8N  N times: offset (4 bytes) and length (4 bytes) of a
+ *                  certificate, relative to the start of the snapshot
+ *      ...         the DER certificates, in chain order
+ */
+#define X509_CRT_SNAPSHOT_MAGIC         "X509SNAP"
+#define X509_CRT_SNAPSHOT_VERSION       1
+#define X509_CRT_SNAPSHOT_HEADER_LEN    16
+#define X509_CRT_SNAPSHOT_ENTRY_LEN     8
+
+static void x509_crt_snapshot_put_u32( unsigned char *p, uint32_t n )
+{
+    p[0] = (unsigned char)( n >> 24 );
+    p[1] = (unsigned char)( n >> 16 );
+    p[2] = (unsigned char)( n >>  8 );
+    p[3] = (unsigned char)( n       );
+}
+
+static uint32_t x509_crt_snapshot_get_u32( const unsigned char *p )
+{
+    return( ( (uint32_t) p[0] << 24 ) | ( (uint32_t) p[1] << 16 ) |
+            ( (uint32_t) p[2] <<  8 ) | ( (uint32_t) p[3]       ) );
+}
+
+int mbedtls_x509_crt_write_snapshot( const mbedtls_x509_crt *chain,
+                                     unsigned char *buf, size_t size,
+                                     size_t *olen )
+{
+    const mbedtls_x509_crt *cur;
+    size_t count = 0, total = X509_CRT_SNAPSHOT_HEADER_LEN;
+    unsigned char *index, *der;
+
+    if( chain == NULL || olen == NULL )
+        return( MBEDTLS_ERR_X509_BAD_INPUT_DATA );
+
+    for( cur = chain; cur != NULL && cur->version != 0; cur = cur->next )
+    {
+        total += X509_CRT_SNAPSHOT_ENTRY_LEN + cur->raw.len;
+        if( total > 0xFFFFFFFF )
+            return( MBEDTLS_ERR_X509_BAD_INPUT_DATA );
+        count++;
+    }
+
+    *olen = total;
+    if( buf == NULL || size < total )
+        return( MBEDTLS_ERR_X509_BUFFER_TOO_SMALL );
+
+    memcpy( buf, X509_CRT_SNAPSHOT_MAGIC, 8 );
+    x509_crt_snapshot_put_u32( buf + 8, X509_CRT_SNAPSHOT_VERSION );
+    x509_crt_snapshot_put_u32( buf + 12, (uint32_t) count );
+
+    index = buf + X509_CRT_SNAPSHOT_HEADER_LEN;
+    der = index + count * X509_CRT_SNAPSHOT_ENTRY_LEN;
+
+    for( cur = chain; cur != NULL && cur->version != 0; cur = cur->next )
+    {
+        x509_crt_snapshot_put_u32( index, (uint32_t)( der - buf ) );
+        x509_crt_snapshot_put_u32( index + 4, (uint32_t) cur->raw.len );
+        index += X509_CRT_SNAPSHOT_ENTRY_LEN;
+
+        memcpy( der, cur->raw.p, cur->raw.len );
+        der += cur->raw.len;
+    }
+
+    return( 0 );
+}
+
+int mbedtls_x509_crt_parse_snapshot( mbedtls_x509_crt *chain,
+                                     const unsigned char *buf, size_t buflen,
+                                     int make_copy )
+{
+    int ret, first_error = 0;
+    size_t i, count, data_start, failures = 0;
+    uint32_t offset, len;
+    const unsigned char *index;
+
+    if( chain == NULL || buf == NULL )
+        return( MBEDTLS_ERR_X509_BAD_INPUT_DATA );
+
+    if( buflen < X509_CRT_SNAPSHOT_HEADER_LEN ||
+        memcmp( buf, X509_CRT_SNAPSHOT_MAGIC, 8 ) != 0 ||
+        x509_crt_snapshot_get_u32( buf + 8 ) != X509_CRT_SNAPSHOT_VERSION )
+    {
+        return( MBEDTLS_ERR_X509_INVALID_FORMAT );
+    }
+
+    count = x509_crt_snapshot_get_u32( buf + 12 );
+    if( count > ( buflen - X509_CRT_SNAPSHOT_HEADER_LEN ) /
+                X509_CRT_SNAPSHOT_ENTRY_LEN )
+        return( MBEDTLS_ERR_X509_INVALID_FORMAT );
+
+    index = buf + X509_CRT_SNAPSHOT_HEADER_LEN;
+    data_start = X509_CRT_SNAPSHOT_HEADER_LEN +
+                 count * X509_CRT_SNAPSHOT_ENTRY_LEN;
+
+    /* Validate the whole index before touching the chain */
+    for( i = 0; i < count; i++ )
+    {
+        offset = x509_crt_snapshot_get_u32( index + i * X509_CRT_SNAPSHOT_ENTRY_LEN );
+        len = x509_crt_snapshot_get_u32( index + i * X509_CRT_SNAPSHOT_ENTRY_LEN + 4 );
+
+        if( offset < data_start || offset > buflen || len > buflen - offset )
+            return( MBEDTLS_ERR_X509_INVALID_FORMAT );
+    }
+
+    for( i = 0; i < count; i++ )
+    {
+        offset = x509_crt_snapshot_get_u32( index + i * X509_CRT_SNAPSHOT_ENTRY_LEN );
+        len = x509_crt_snapshot_get_u32( index + i * X509_CRT_SNAPSHOT_ENTRY_LEN + 4 );
+
+        if( x509_crt_chain_contains( chain, buf + offset, len ) )
+            continue;
+
+        ret = mbedtls_x509_crt_parse_der_internal( chain, buf + offset, len,
+                                                   make_copy );
+        if( ret == MBEDTLS_ERR_X509_ALLOC_FAILED )
+            return( ret );
+
+        if( ret != 0 )
+        {
+            if( first_error == 0 )
+                first_error = ret;
+            failures++;
+        }
+    }
+
+    if( failures != 0 && failures == count )
+        return( first_error );
+
+    return( (int) failures );
+}
+#endif /* MBEDTLS_X509_CRT_SNAPSHOT */
+
 int mbedtls_x509_crt_parse_der( mbedtls_x509_crt *chain,
                                 const unsigned char *buf,
                                 size_t buflen )
@@ -1425,10 +1753,10 @@ int mbedtls_x509_crt_parse( mbedtls_x509_crt *chain,
             mbedtls_pem_init( &pem );
 
             /* If we get there, we know the string is null-terminated */
-            ret = mbedtls_pem_read_buffer( &pem,
+            ret = mbedtls_x509_pem_read( &pem,
                            "-----BEGIN CERTIFICATE-----",
                            "-----END CERTIFICATE-----",
-                           buf, NULL, 0, &use_len );
+                           buf, &use_len );
 
             if( ret == 0 )
             {
@@ -1636,6 +1964,330 @@ cleanup:
 
     return( ret );
 }
+
+#if defined(MBEDTLS_X509_CRT_PARSE_PATH_PARALLEL)
+/*
+ * Files of a directory, parsed by a pool of threads into one chain each
+ */
+typedef struct
+{
+    pthread_mutex_t mutex;          /* protects next                        */
+    size_t next;                    /* index of the next file to parse      */
+    size_t count;                   /* number of files                      */
+    char **names;                   /* paths of the files                   */
+    mbedtls_x509_crt **chains;      /* chain parsed from each file          */
+    int *rets;                      /* result of parsing each file          */
+} x509_crt_path_job;
+
+static void *x509_crt_path_worker( void *arg )
+{
+    x509_crt_path_job *job = (x509_crt_path_job *) arg;
+    mbedtls_x509_crt *crt;
+    size_t i;
+
+    for( ;; )
+    {
+        if( pthread_mutex_lock( &job->mutex ) != 0 )
+            break;
+        i = job->next;
+        if( i < job->count )
+            job->next++;
+        pthread_mutex_unlock( &job->mutex );
+
+        if( i >= job->count )
+            break;
+
+        crt = MBEDTLS_X509_ALLOC( sizeof( mbedtls_x509_crt ) );
+        if( crt == NULL )
+        {
+            job->rets[i] = MBEDTLS_ERR_X509_ALLOC_FAILED;
+            continue;
+        }
+
+        mbedtls_x509_crt_init( crt );
+        job->rets[i] = mbedtls_x509_crt_parse_file( crt, job->names[i] );
+        job->chains[i] = crt;
+    }
+
+    return( NULL );
+}
+
+/*
+ * Move the certificates of src, whose nodes are all allocated, to the end of
+ * chain, dropping those the chain already holds. src is consumed.
+ */
+static void x509_crt_path_merge( mbedtls_x509_crt *chain,
+                                 mbedtls_x509_crt *src )
+{
+    mbedtls_x509_crt *tail = chain, *cur, *next;
+
+    while( tail->next != NULL )
+        tail = tail->next;
+
+    for( cur = src; cur != NULL; cur = next )
+    {
+        next = cur->next;
+        cur->next = NULL;
+
+        if( cur->version == 0 ||
+            x509_crt_chain_contains( chain, cur->raw.p, cur->raw.len ) )
+        {
+            mbedtls_x509_crt_free( cur );
+            MBEDTLS_X509_FREE( cur, sizeof( mbedtls_x509_crt ) );
+            continue;
+        }
+
+        if( tail->version == 0 )
+        {
+            /* Empty head of the caller's chain: move the certificate in */
+            *tail = *cur;
+            MBEDTLS_X509_FREE( cur, sizeof( mbedtls_x509_crt ) );
+        }
+        else
+        {
+            tail->next = cur;
+            tail = cur;
+        }
+    }
+}
+
+/*
+ * List the regular files of a directory
+ */
+static int x509_crt_path_list( const char *path, char ***names,
+                               size_t *count )
+{
+    int ret = 0;
+    int snp_ret;
+    struct stat sb;
+    struct dirent *entry;
+    char entry_name[MBEDTLS_X509_MAX_FILE_PATH_LEN];
+    char **list = NULL, **grown;
+    size_t n = 0, size = 0;
+    DIR *dir = opendir( path );
+
+    if( dir == NULL )
+        return( MBEDTLS_ERR_X509_FILE_IO_ERROR );
+
+#if defined(MBEDTLS_THREADING_C)
+    if( ( ret = mbedtls_mutex_lock( &mbedtls_threading_readdir_mutex ) ) != 0 )
+    {
+        closedir( dir );
+        return( ret );
+    }
+#endif /* MBEDTLS_THREADING_C */
+
+    while( ( entry = readdir( dir ) ) != NULL )
+    {
+        snp_ret = mbedtls_snprintf( entry_name, sizeof entry_name,
+                                    "%s/%s", path, entry->d_name );
+
+        if( snp_ret < 0 || (size_t)snp_ret >= sizeof entry_name )
+        {
+            ret = MBEDTLS_ERR_X509_BUFFER_TOO_SMALL;
+            goto cleanup;
+        }
+        else if( stat( entry_name, &sb ) == -1 )
+        {
+            ret = MBEDTLS_ERR_X509_FILE_IO_ERROR;
+            goto cleanup;
+        }
+
+        if( !S_ISREG( sb.st_mode ) )
+            continue;
+
+        if( n == size )
+        {
+            size = size == 0 ? 64 : 2 * size;
+            grown = mbedtls_calloc( size, sizeof( char * ) );
+            if( grown == NULL )
+            {
+                ret = MBEDTLS_ERR_X509_ALLOC_FAILED;
+                goto cleanup;
+            }
+            if( list != NULL )
+            {
+                memcpy( grown, list, n * sizeof( char * ) );
+                mbedtls_free( list );
+            }
+            list = grown;
+        }
+
+        list[n] = mbedtls_calloc( 1, (size_t) snp_ret + 1 );
+        if( list[n] == NULL )
+        {
+            ret = MBEDTLS_ERR_X509_ALLOC_FAILED;
+            goto cleanup;
+        }
+        memcpy( list[n++], entry_name, (size_t) snp_ret + 1 );
+    }
+
+cleanup:
+    closedir( dir );
+
+#if defined(MBEDTLS_THREADING_C)
+    if( mbedtls_mutex_unlock( &mbedtls_threading_readdir_mutex ) != 0 )
+        ret = MBEDTLS_ERR_THREADING_MUTEX_ERROR;
+#endif /* MBEDTLS_THREADING_C */
+
+    if( ret != 0 )
+    {
+        while( n > 0 )
+            mbedtls_free( list[--n] );
+        mbedtls_free( list );
+        return( ret );
+    }
+
+    *names = list;
+    *count = n;
+
+    return( 0 );
+}
+
+int mbedtls_x509_crt_parse_path_parallel( mbedtls_x509_crt *chain,
+                                          const char *path,
+                                          unsigned int threads )
+{
+    int ret;
+    size_t i, started = 0;
+    pthread_t *tids = NULL;
+    x509_crt_path_job job;
+
+    if( chain == NULL || path == NULL || threads == 0 )
+        return( MBEDTLS_ERR_X509_BAD_INPUT_DATA );
+
+    memset( &job, 0, sizeof( job ) );
+
+    if( ( ret = x509_crt_path_list( path, &job.names, &job.count ) ) != 0 )
+        return( ret );
+
+    if( job.count == 0 )
+        return( 0 );
+
+    job.chains = mbedtls_calloc( job.count, sizeof( mbedtls_x509_crt * ) );
+    job.rets = mbedtls_calloc( job.count, sizeof( int ) );
+    if( job.chains == NULL || job.rets == NULL )
+    {
+        ret = MBEDTLS_ERR_X509_ALLOC_FAILED;
+        goto cleanup;
+    }
+
+    if( pthread_mutex_init( &job.mutex, NULL ) != 0 )
+    {
+        ret = MBEDTLS_ERR_THREADING_MUTEX_ERROR;
+        goto cleanup;
+    }
+
+    /* The calling thread is one of the workers */
+    if( threads > job.count )
+        threads = (unsigned int) job.count;
+
+    if( threads > 1 )
+        tids = mbedtls_calloc( threads - 1, sizeof( pthread_t ) );
+
+    /* Threads that fail to start leave more files to the others */
+    for( i = 0; tids != NULL && i < threads - 1; i++ )
+    {
+        if( pthread_create( &tids[started], NULL,
+                            x509_crt_path_worker, &job ) == 0 )
+            started++;
+    }
+
+    x509_crt_path_worker( &job );
+
+    for( i = 0; i < started; i++ )
+        pthread_join( tids[i], NULL );
+
+    pthread_mutex_destroy( &job.mutex );
+
+    /* Merge in directory order, as the serial loader would */
+    for( i = 0; i < job.count; i++ )
+    {
+        if( job.rets[i] < 0 )
+            ret++;
+        else
+            ret += job.rets[i];
+
+        if( job.chains[i] != NULL )
+        {
+            x509_crt_path_merge( chain, job.chains[i] );
+            job.chains[i] = NULL;
+        }
+    }
+
+cleanup:
+    for( i = 0; i < job.count; i++ )
+    {
+        if( job.chains != NULL && job.chains[i] != NULL )
+        {
+            mbedtls_x509_crt_free( job.chains[i] );
+            MBEDTLS_X509_FREE( job.chains[i], sizeof( mbedtls_x509_crt ) );
+        }
+        mbedtls_free( job.names[i] );
+    }
+    mbedtls_free( job.names );
+    mbedtls_free( job.chains );
+    mbedtls_free( job.rets );
+    mbedtls_free( tids );
+
+    return( ret );
+}
+#endif /* MBEDTLS_X509_CRT_PARSE_PATH_PARALLEL */
+
+#if defined(MBEDTLS_X509_CRT_SNAPSHOT)
+int mbedtls_x509_crt_write_snapshot_file( const mbedtls_x509_crt *chain,
+                                          const char *path )
+{
+    int ret;
+    size_t len;
+    unsigned char *buf;
+    FILE *f;
+
+    ret = mbedtls_x509_crt_write_snapshot( chain, NULL, 0, &len );
+    if( ret != MBEDTLS_ERR_X509_BUFFER_TOO_SMALL )
+        return( ret == 0 ? MBEDTLS_ERR_X509_BAD_INPUT_DATA : ret );
+
+    if( ( buf = mbedtls_calloc( 1, len ) ) == NULL )
+        return( MBEDTLS_ERR_X509_ALLOC_FAILED );
+
+    if( ( ret = mbedtls_x509_crt_write_snapshot( chain, buf, len, &len ) ) != 0 )
+        goto cleanup;
+
+    if( ( f = fopen( path, "wb" ) ) == NULL )
+    {
+        ret = MBEDTLS_ERR_X509_FILE_IO_ERROR;
+        goto cleanup;
+    }
+
+    if( fwrite( buf, 1, len, f ) != len )
+        ret = MBEDTLS_ERR_X509_FILE_IO_ERROR;
+
+    if( fclose( f ) != 0 )
+        ret = MBEDTLS_ERR_X509_FILE_IO_ERROR;
+
+cleanup:
+    mbedtls_free( buf );
+
+    return( ret );
+}
+
+int mbedtls_x509_crt_parse_snapshot_file( mbedtls_x509_crt *chain,
+                                          const char *path )
+{
+    int ret;
+    size_t n;
+    unsigned char *buf;
+
+    if( ( ret = mbedtls_pk_load_file( path, &buf, &n ) ) != 0 )
+        return( ret );
+
+    ret = mbedtls_x509_crt_parse_snapshot( chain, buf, n, 1 );
+
+    mbedtls_free( buf );
+
+    return( ret );
+}
+#endif /* MBEDTLS_X509_CRT_SNAPSHOT */
 #endif /* MBEDTLS_FS_IO */
 
 /*
@@ -2318,7 +2970,7 @@ static int x509_crt_verifycrl( mbedtls_x509_crt *crt, mbedtls_x509_crt *ca,
     while( crl_list != NULL )
     {
         if( crl_list->version == 0 ||
-            x509_name_cmp( &crl_list->issuer, &ca->subject ) != 0 )
+            x509_name_cmp( &crl_list->issuer_canon, &ca->subject_canon ) != 0 )
         {
             crl_list = crl_list->next;
             continue;
@@ -2458,7 +3110,7 @@ static int x509_crt_check_parent( const mbedtls_x509_crt *child,
     int need_ca_bit;
 
     /* Parent must be the issuer */
-    if( x509_name_cmp( &child->issuer, &parent->subject ) != 0 )
+    if( x509_name_cmp( &child->issuer_canon, &parent->subject_canon ) != 0 )
         return( -1 );
 
     /* Parent must have the basicConstraints CA bit set as a general rule */
@@ -2722,7 +3374,7 @@ static int x509_crt_check_ee_locally_trusted(
     mbedtls_x509_crt *cur;
 
     /* must be self-issued */
-    if( x509_name_cmp( &crt->issuer, &crt->subject ) != 0 )
+    if( x509_name_cmp( &crt->issuer_canon, &crt->subject_canon ) != 0 )
         return( -1 );
 
     /* look for an exact match with trusted cert */
@@ -2914,7 +3566,7 @@ find_parent:
          * These can occur with some strategies for key rollover, see [SIRO],
          * and should be excluded from max_pathlen checks. */
         if( ver_chain->len != 1 &&
-            x509_name_cmp( &child->issuer, &child->subject ) == 0 )
+            x509_name_cmp( &child->issuer_canon, &child->subject_canon ) == 0 )
         {
             self_cnt++;
         }
@@ -2973,6 +3625,119 @@ static int x509_crt_check_cn( const mbedtls_x509_buf *name,
     return( -1 );
 }
 
+/*
+ * ASCII lowercase, the only case folding applied to names
+ */
+static unsigned char x509_tolower( unsigned char c )
+{
+    return( (unsigned char)( c >= 'A' && c <= 'Z' ? c + 32 : c ) );
+}
+
+/*
+ * Like x509_memcasecmp, with the second argument already in lowercase
+ */
+static int x509_memcmp_lower( const unsigned char *name,
+                              const unsigned char *lower, size_t len )
+{
+    size_t i;
+
+    for( i = 0; i < len; i++ )
+    {
+        if( x509_tolower( name[i] ) != lower[i] )
+            return( -1 );
+    }
+
+    return( 0 );
+}
+
+int mbedtls_x509_crt_hostname_set( mbedtls_x509_crt_hostname *hostname,
+                                   const char *name )
+{
+    size_t i, len;
+    const char *dot;
+
+    if( hostname == NULL || name == NULL )
+        return( MBEDTLS_ERR_X509_BAD_INPUT_DATA );
+
+    len = strlen( name );
+    if( len > MBEDTLS_X509_CRT_MAX_HOSTNAME_LEN )
+        return( MBEDTLS_ERR_X509_BAD_INPUT_DATA );
+
+    for( i = 0; i < len; i++ )
+        hostname->name[i] = x509_tolower( (unsigned char) name[i] );
+
+    /* A leading dot leaves no first label for a wildcard to replace */
+    dot = memchr( name, '.', len );
+    hostname->suffix = dot == NULL ? 0 : (size_t)( dot - name );
+    hostname->len = len;
+
+    return( 0 );
+}
+
+/*
+ * Check a name against a prepared hostname: same rules as x509_crt_check_cn,
+ * but most names are rejected on their length alone
+ */
+static int x509_crt_check_hostname( const mbedtls_x509_buf *name,
+                                    const mbedtls_x509_crt_hostname *hostname )
+{
+    /* try exact match */
+    if( name->len == hostname->len &&
+        x509_memcmp_lower( name->p, hostname->name, name->len ) == 0 )
+    {
+        return( 0 );
+    }
+
+    /* try wildcard match: "*" standing for the first label */
+    if( hostname->suffix != 0 &&
+        name->len == hostname->len - hostname->suffix + 1 &&
+        name->len >= 3 && name->p[0] == '*' && name->p[1] == '.' &&
+        x509_memcmp_lower( name->p + 2, hostname->name + hostname->suffix + 1,
+                           name->len - 2 ) == 0 )
+    {
+        return( 0 );
+    }
+
+    return( -1 );
+}
+
+/*
+ * Verify the requested hostname
+ */
+static void x509_crt_verify_hostname( const mbedtls_x509_crt *crt,
+                                      const mbedtls_x509_crt_hostname *hostname,
+                                      uint32_t *flags )
+{
+    const mbedtls_x509_name *name;
+    const mbedtls_x509_sequence *cur;
+
+    if( crt->ext_types & MBEDTLS_X509_EXT_SUBJECT_ALT_NAME )
+    {
+        for( cur = &crt->subject_alt_names; cur != NULL; cur = cur->next )
+        {
+            if( x509_crt_check_hostname( &cur->buf, hostname ) == 0 )
+                break;
+        }
+
+        if( cur == NULL )
+            *flags |= MBEDTLS_X509_BADCERT_CN_MISMATCH;
+    }
+    else
+    {
+        for( name = &crt->subject; name != NULL; name = name->next )
+        {
+            if( MBEDTLS_OID_CMP( MBEDTLS_OID_AT_CN, &name->oid ) == 0 &&
+                x509_crt_check_hostname( &name->val, hostname ) == 0 )
+            {
+                break;
+            }
+        }
+
+        if( name == NULL )
+            *flags |= MBEDTLS_X509_BADCERT_CN_MISMATCH;
+    }
+}
+
 /*
  * Verify the requested CN - only call this if cn is not NULL!
  */
@@ -2982,7 +3747,17 @@ static void x509_crt_verify_name( const mbedtls_x509_crt *crt,
 {
     const mbedtls_x509_name *name;
     const mbedtls_x509_sequence *cur;
-    size_t cn_len = strlen( cn );
+    mbedtls_x509_crt_hostname hostname;
+    size_t cn_len;
+
+    if( mbedtls_x509_crt_hostname_set( &hostname, cn ) == 0 )
+    {
+        x509_crt_verify_hostname( crt, &hostname, flags );
+        return;
+    }
+
+    /* Longer than any hostname: compare the names as they are */
+    cn_len = strlen( cn );
 
     if( crt->ext_types & MBEDTLS_X509_EXT_SUBJECT_ALT_NAME )
     {
@@ -3063,7 +3838,9 @@ static int x509_crt_verify_restartable_ca_cb( mbedtls_x509_crt *crt,
                      mbedtls_x509_crt_ca_cb_t f_ca_cb,
                      void *p_ca_cb,
                      const mbedtls_x509_crt_profile *profile,
-                     const char *cn, uint32_t *flags,
+                     const char *cn,
+                     const mbedtls_x509_crt_hostname *hostname,
+                     uint32_t *flags,
                      int (*f_vrfy)(void *, mbedtls_x509_crt *, int, uint32_t *),
                      void *p_vrfy,
                      mbedtls_x509_crt_restart_ctx *rs_ctx )
@@ -3084,7 +3861,9 @@ static int x509_crt_verify_restartable_ca_cb( mbedtls_x509_crt *crt,
     }
 
     /* check name if requested */
-    if( cn != NULL )
+    if( hostname != NULL )
+        x509_crt_verify_hostname( crt, hostname, &ee_flags );
+    else if( cn != NULL )
         x509_crt_verify_name( crt, cn, &ee_flags );
 
     /* Check the type and size of the key */
@@ -3155,7 +3934,7 @@ int mbedtls_x509_crt_verify( mbedtls_x509_crt *crt,
     return( x509_crt_verify_restartable_ca_cb( crt, trust_ca, ca_crl,
                                          NULL, NULL,
                                          &mbedtls_x509_crt_profile_default,
-                                         cn, flags,
+                                         cn, NULL, flags,
                                          f_vrfy, p_vrfy, NULL ) );
 }
 
@@ -3172,7 +3951,7 @@ int mbedtls_x509_crt_verify_with_profile( mbedtls_x509_crt *crt,
 {
     return( x509_crt_verify_restartable_ca_cb( crt, trust_ca, ca_crl,
                                                  NULL, NULL,
-                                                 profile, cn, flags,
+                                                 profile, cn, NULL, flags,
                                                  f_vrfy, p_vrfy, NULL ) );
 }
 
@@ -3191,7 +3970,7 @@ int mbedtls_x509_crt_verify_with_ca_cb( mbedtls_x509_crt *crt,
 {
     return( x509_crt_verify_restartable_ca_cb( crt, NULL, NULL,
                                                  f_ca_cb, p_ca_cb,
-                                                 profile, cn, flags,
+                                                 profile, cn, NULL, flags,
                                                  f_vrfy, p_vrfy, NULL ) );
 }
 #endif /* MBEDTLS_X509_TRUSTED_CERTIFICATE_CALLBACK */
@@ -3207,10 +3986,41 @@ int mbedtls_x509_crt_verify_restartable( mbedtls_x509_crt *crt,
 {
     return( x509_crt_verify_restartable_ca_cb( crt, trust_ca, ca_crl,
                                                  NULL, NULL,
-                                                 profile, cn, flags,
+                                                 profile, cn, NULL, flags,
+                                                 f_vrfy, p_vrfy, rs_ctx ) );
+}
+
+int mbedtls_x509_crt_verify_hostname( mbedtls_x509_crt *crt,
+                     mbedtls_x509_crt *trust_ca,
+                     mbedtls_x509_crl *ca_crl,
+                     const mbedtls_x509_crt_profile *profile,
+                     const mbedtls_x509_crt_hostname *hostname, uint32_t *flags,
+                     int (*f_vrfy)(void *, mbedtls_x509_crt *, int, uint32_t *),
+                     void *p_vrfy,
+                     mbedtls_x509_crt_restart_ctx *rs_ctx )
+{
+    return( x509_crt_verify_restartable_ca_cb( crt, trust_ca, ca_crl,
+                                                 NULL, NULL,
+                                                 profile, NULL, hostname, flags,
                                                  f_vrfy, p_vrfy, rs_ctx ) );
 }
 
+#if defined(MBEDTLS_X509_TRUSTED_CERTIFICATE_CALLBACK)
+int mbedtls_x509_crt_verify_hostname_with_ca_cb( mbedtls_x509_crt *crt,
+                     mbedtls_x509_crt_ca_cb_t f_ca_cb,
+                     void *p_ca_cb,
+                     const mbedtls_x509_crt_profile *profile,
+                     const mbedtls_x509_crt_hostname *hostname, uint32_t *flags,
+                     int (*f_vrfy)(void *, mbedtls_x509_crt *, int, uint32_t *),
+                     void *p_vrfy )
+{
+    return( x509_crt_verify_restartable_ca_cb( crt, NULL, NULL,
+                                                 f_ca_cb, p_ca_cb,
+                                                 profile, NULL, hostname, flags,
+                                                 f_vrfy, p_vrfy, NULL ) );
+}
+#endif /* MBEDTLS_X509_TRUSTED_CERTIFICATE_CALLBACK */
+
 
 /*
  * Initialize a certificate chain
@@ -3243,13 +4053,24 @@ void mbedtls_x509_crt_free( mbedtls_x509_crt *crt )
         mbedtls_free( cert_cur->sig_opts );
 #endif
 
+#if defined(MBEDTLS_X509_CRT_CONTIGUOUS)
+        if( cert_cur->alloc != NULL )
+        {
+            /* Everything else is in the block */
+            mbedtls_platform_zeroize( cert_cur->alloc, cert_cur->alloc_len );
+            MBEDTLS_X509_FREE( cert_cur->alloc, cert_cur->alloc_len );
+            cert_cur = cert_cur->next;
+            continue;
+        }
+#endif
+
         name_cur = cert_cur->issuer.next;
         while( name_cur != NULL )
         {
             name_prv = name_cur;
             name_cur = name_cur->next;
             mbedtls_platform_zeroize( name_prv, sizeof( mbedtls_x509_name ) );
-            mbedtls_free( name_prv );
+            MBEDTLS_X509_FREE( name_prv, sizeof( mbedtls_x509_name ) );
         }
 
         name_cur = cert_cur->subject.next;
@@ -3258,7 +4079,14 @@ void mbedtls_x509_crt_free( mbedtls_x509_crt *crt )
             name_prv = name_cur;
             name_cur = name_cur->next;
             mbedtls_platform_zeroize( name_prv, sizeof( mbedtls_x509_name ) );
-            mbedtls_free( name_prv );
+            MBEDTLS_X509_FREE( name_prv, sizeof( mbedtls_x509_name ) );
+        }
+
+        if( cert_cur->issuer_canon.p != NULL )
+        {
+            MBEDTLS_X509_FREE( cert_cur->issuer_canon.p,
+                               cert_cur->issuer_canon.len +
+                               cert_cur->subject_canon.len );
         }
 
         seq_cur = cert_cur->ext_key_usage.next;
@@ -3294,7 +4122,7 @@ void mbedtls_x509_crt_free( mbedtls_x509_crt *crt )
         if( cert_cur->raw.p != NULL && cert_cur->own_buffer )
         {
             mbedtls_platform_zeroize( cert_cur->raw.p, cert_cur->raw.len );
-            mbedtls_free( cert_cur->raw.p );
+            MBEDTLS_X509_FREE( cert_cur->raw.p, cert_cur->raw.len );
         }
 
         cert_cur = cert_cur->next;
@@ -3309,7 +4137,7 @@ void mbedtls_x509_crt_free( mbedtls_x509_crt *crt )
 
         mbedtls_platform_zeroize( cert_prv, sizeof( mbedtls_x509_crt ) );
         if( cert_prv != crt )
-            mbedtls_free( cert_prv );
+            MBEDTLS_X509_FREE( cert_prv, sizeof( mbedtls_x509_crt ) );
     }
     while( cert_cur != NULL );
 }
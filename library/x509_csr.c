@@ -274,20 +274,20 @@ int mbedtls_x509_csr_parse( mbedtls_x509_csr *csr, const unsigned char *buf, siz
         return( MBEDTLS_ERR_X509_BAD_INPUT_DATA );
 
 #if defined(MBEDTLS_PEM_PARSE_C)
-    /* Avoid calling mbedtls_pem_read_buffer() on non-null-terminated string */
+    /* Avoid calling mbedtls_x509_pem_read() on non-null-terminated string */
     if( buf[buflen - 1] == '\0' )
     {
         mbedtls_pem_init( &pem );
-        ret = mbedtls_pem_read_buffer( &pem,
-                                       "-----BEGIN CERTIFICATE REQUEST-----",
-                                       "-----END CERTIFICATE REQUEST-----",
-                                       buf, NULL, 0, &use_len );
+        ret = mbedtls_x509_pem_read( &pem,
+                                     "-----BEGIN CERTIFICATE REQUEST-----",
+                                     "-----END CERTIFICATE REQUEST-----",
+                                     buf, &use_len );
         if( ret == MBEDTLS_ERR_PEM_NO_HEADER_FOOTER_PRESENT )
         {
-            ret = mbedtls_pem_read_buffer( &pem,
-                                           "-----BEGIN NEW CERTIFICATE REQUEST-----",
-                                           "-----END NEW CERTIFICATE REQUEST-----",
-                                           buf, NULL, 0, &use_len );
+            ret = mbedtls_x509_pem_read( &pem,
+                                         "-----BEGIN NEW CERTIFICATE REQUEST-----",
+                                         "-----END NEW CERTIFICATE REQUEST-----",
+                                         buf, &use_len );
         }
 
         if( ret == 0 )
@@ -404,7 +404,7 @@ void mbedtls_x509_csr_free( mbedtls_x509_csr *csr )
         name_prv = name_cur;
         name_cur = name_cur->next;
         mbedtls_platform_zeroize( name_prv, sizeof( mbedtls_x509_name ) );
-        mbedtls_free( name_prv );
+        MBEDTLS_X509_FREE( name_prv, sizeof( mbedtls_x509_name ) );
     }
 
     if( csr->raw.p != NULL )
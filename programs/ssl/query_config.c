@@ -1266,6 +1266,14 @@ int query_config( const char *config )
     }
 #endif /* MBEDTLS_SSL_ASYNC_PRIVATE */
 
+#if defined(MBEDTLS_SSL_ASYNC_VERIFY)
+    if( strcmp( "MBEDTLS_SSL_ASYNC_VERIFY", config ) == 0 )
+    {
+        MACRO_EXPANSION_TO_STR( MBEDTLS_SSL_ASYNC_VERIFY );
+        return( 0 );
+    }
+#endif /* MBEDTLS_SSL_ASYNC_VERIFY */
+
 #if defined(MBEDTLS_SSL_CONTEXT_SERIALIZATION)
     if( strcmp( "MBEDTLS_SSL_CONTEXT_SERIALIZATION", config ) == 0 )
     {
@@ -1282,6 +1290,22 @@ int query_config( const char *config )
     }
 #endif /* MBEDTLS_SSL_DEBUG_ALL */
 
+#if defined(MBEDTLS_DEBUG_BINARY_TRACE)
+    if( strcmp( "MBEDTLS_DEBUG_BINARY_TRACE", config ) == 0 )
+    {
+        MACRO_EXPANSION_TO_STR( MBEDTLS_DEBUG_BINARY_TRACE );
+        return( 0 );
+    }
+#endif /* MBEDTLS_DEBUG_BINARY_TRACE */
+
+#if defined(MBEDTLS_ALLOC_PROFILE)
+    if( strcmp( "MBEDTLS_ALLOC_PROFILE", config ) == 0 )
+    {
+        MACRO_EXPANSION_TO_STR( MBEDTLS_ALLOC_PROFILE );
+        return( 0 );
+    }
+#endif /* MBEDTLS_ALLOC_PROFILE */
+
 #if defined(MBEDTLS_SSL_ENCRYPT_THEN_MAC)
     if( strcmp( "MBEDTLS_SSL_ENCRYPT_THEN_MAC", config ) == 0 )
     {
@@ -1538,6 +1562,38 @@ int query_config( const char *config )
     }
 #endif /* MBEDTLS_X509_TRUSTED_CERTIFICATE_CALLBACK */
 
+#if defined(MBEDTLS_X509_CRT_PARSE_PATH_PARALLEL)
+    if( strcmp( "MBEDTLS_X509_CRT_PARSE_PATH_PARALLEL", config ) == 0 )
+    {
+        MACRO_EXPANSION_TO_STR( MBEDTLS_X509_CRT_PARSE_PATH_PARALLEL );
+        return( 0 );
+    }
+#endif /* MBEDTLS_X509_CRT_PARSE_PATH_PARALLEL */
+
+#if defined(MBEDTLS_X509_CRT_SNAPSHOT)
+    if( strcmp( "MBEDTLS_X509_CRT_SNAPSHOT", config ) == 0 )
+    {
+        MACRO_EXPANSION_TO_STR( MBEDTLS_X509_CRT_SNAPSHOT );
+        return( 0 );
+    }
+#endif /* MBEDTLS_X509_CRT_SNAPSHOT */
+
+#if defined(MBEDTLS_X509_CRT_CONTIGUOUS)
+    if( strcmp( "MBEDTLS_X509_CRT_CONTIGUOUS", config ) == 0 )
+    {
+        MACRO_EXPANSION_TO_STR( MBEDTLS_X509_CRT_CONTIGUOUS );
+        return( 0 );
+    }
+#endif /* MBEDTLS_X509_CRT_CONTIGUOUS */
+
+#if defined(MBEDTLS_X509_PEM_FAST_DECODE)
+    if( strcmp( "MBEDTLS_X509_PEM_FAST_DECODE", config ) == 0 )
+    {
+        MACRO_EXPANSION_TO_STR( MBEDTLS_X509_PEM_FAST_DECODE );
+        return( 0 );
+    }
+#endif /* MBEDTLS_X509_PEM_FAST_DECODE */
+
 #if defined(MBEDTLS_X509_CHECK_KEY_USAGE)
     if( strcmp( "MBEDTLS_X509_CHECK_KEY_USAGE", config ) == 0 )
     {
@@ -2026,6 +2082,14 @@ int query_config( const char *config )
     }
 #endif /* MBEDTLS_SHA512_C */
 
+#if defined(MBEDTLS_SSL_ASYNC_ENGINE_C)
+    if( strcmp( "MBEDTLS_SSL_ASYNC_ENGINE_C", config ) == 0 )
+    {
+        MACRO_EXPANSION_TO_STR( MBEDTLS_SSL_ASYNC_ENGINE_C );
+        return( 0 );
+    }
+#endif /* MBEDTLS_SSL_ASYNC_ENGINE_C */
+
 #if defined(MBEDTLS_SSL_CACHE_C)
     if( strcmp( "MBEDTLS_SSL_CACHE_C", config ) == 0 )
     {
@@ -2042,6 +2106,30 @@ int query_config( const char *config )
     }
 #endif /* MBEDTLS_SSL_COOKIE_C */
 
+#if defined(MBEDTLS_SSL_CREDENTIALS_C)
+    if( strcmp( "MBEDTLS_SSL_CREDENTIALS_C", config ) == 0 )
+    {
+        MACRO_EXPANSION_TO_STR( MBEDTLS_SSL_CREDENTIALS_C );
+        return( 0 );
+    }
+#endif /* MBEDTLS_SSL_CREDENTIALS_C */
+
+#if defined(MBEDTLS_SSL_SNI_REGISTRY_C)
+    if( strcmp( "MBEDTLS_SSL_SNI_REGISTRY_C", config ) == 0 )
+    {
+        MACRO_EXPANSION_TO_STR( MBEDTLS_SSL_SNI_REGISTRY_C );
+        return( 0 );
+    }
+#endif /* MBEDTLS_SSL_SNI_REGISTRY_C */
+
+#if defined(MBEDTLS_SSL_SNI_CACHE_C)
+    if( strcmp( "MBEDTLS_SSL_SNI_CACHE_C", config ) == 0 )
+    {
+        MACRO_EXPANSION_TO_STR( MBEDTLS_SSL_SNI_CACHE_C );
+        return( 0 );
+    }
+#endif /* MBEDTLS_SSL_SNI_CACHE_C */
+
 #if defined(MBEDTLS_SSL_TICKET_C)
     if( strcmp( "MBEDTLS_SSL_TICKET_C", config ) == 0 )
     {
@@ -2506,6 +2594,30 @@ int query_config( const char *config )
     }
 #endif /* MBEDTLS_PLATFORM_NV_SEED_WRITE_MACRO */
 
+#if defined(MBEDTLS_SSL_ASYNC_ENGINE_MAX_WORKERS)
+    if( strcmp( "MBEDTLS_SSL_ASYNC_ENGINE_MAX_WORKERS", config ) == 0 )
+    {
+        MACRO_EXPANSION_TO_STR( MBEDTLS_SSL_ASYNC_ENGINE_MAX_WORKERS );
+        return( 0 );
+    }
+#endif /* MBEDTLS_SSL_ASYNC_ENGINE_MAX_WORKERS */
+
+#if defined(MBEDTLS_SSL_ASYNC_ENGINE_MAX_BATCH)
+    if( strcmp( "MBEDTLS_SSL_ASYNC_ENGINE_MAX_BATCH", config ) == 0 )
+    {
+        MACRO_EXPANSION_TO_STR( MBEDTLS_SSL_ASYNC_ENGINE_MAX_BATCH );
+        return( 0 );
+    }
+#endif /* MBEDTLS_SSL_ASYNC_ENGINE_MAX_BATCH */
+
+#if defined(MBEDTLS_SSL_SNI_CACHE_DEFAULT_MAX_ENTRIES)
+    if( strcmp( "MBEDTLS_SSL_SNI_CACHE_DEFAULT_MAX_ENTRIES", config ) == 0 )
+    {
+        MACRO_EXPANSION_TO_STR( MBEDTLS_SSL_SNI_CACHE_DEFAULT_MAX_ENTRIES );
+        return( 0 );
+    }
+#endif /* MBEDTLS_SSL_SNI_CACHE_DEFAULT_MAX_ENTRIES */
+
 #if defined(MBEDTLS_SSL_CACHE_DEFAULT_TIMEOUT)
     if( strcmp( "MBEDTLS_SSL_CACHE_DEFAULT_TIMEOUT", config ) == 0 )
     {
@@ -2578,6 +2690,14 @@ int query_config( const char *config )
     }
 #endif /* MBEDTLS_SSL_DTLS_MAX_BUFFERING */
 
+#if defined(MBEDTLS_SSL_DTLS_REPLAY_WINDOW)
+    if( strcmp( "MBEDTLS_SSL_DTLS_REPLAY_WINDOW", config ) == 0 )
+    {
+        MACRO_EXPANSION_TO_STR( MBEDTLS_SSL_DTLS_REPLAY_WINDOW );
+        return( 0 );
+    }
+#endif /* MBEDTLS_SSL_DTLS_REPLAY_WINDOW */
+
 #if defined(MBEDTLS_SSL_DEFAULT_TICKET_LIFETIME)
     if( strcmp( "MBEDTLS_SSL_DEFAULT_TICKET_LIFETIME", config ) == 0 )
     {
@@ -125,6 +125,7 @@ int main( void )
 #define DFL_TRANSPORT           MBEDTLS_SSL_TRANSPORT_STREAM
 #define DFL_HS_TO_MIN           0
 #define DFL_HS_TO_MAX           0
+#define DFL_HS_RTO_MIN          -1
 #define DFL_DTLS_MTU            -1
 #define DFL_DGRAM_PACKING        1
 #define DFL_FALLBACK            -1
@@ -133,8 +134,10 @@ int main( void )
 #define DFL_SERIALIZE           0
 #define DFL_EXTENDED_MS_ENFORCE -1
 #define DFL_CA_CALLBACK         0
+#define DFL_ASYNC_VERIFY        -1
 #define DFL_EAP_TLS             0
 #define DFL_REPRODUCIBLE        0
+#define DFL_STATS               0
 
 #define GET_REQUEST "GET %s HTTP/1.0\r\nExtra-header: "
 #define GET_REQUEST_END "\r\n\r\n"
@@ -221,6 +224,15 @@ int main( void )
 #define USAGE_CA_CALLBACK ""
 #endif /* MBEDTLS_X509_TRUSTED_CERTIFICATE_CALLBACK */
 
+#if defined(MBEDTLS_SSL_ASYNC_VERIFY)
+#define USAGE_ASYNC_VERIFY                                  \
+    "   async_verify=%%d      default: -1 (disabled)\n"      \
+    "                        Verify the server chain asynchronously, completing\n" \
+    "                        after the given number of in-progress returns\n"
+#else
+#define USAGE_ASYNC_VERIFY ""
+#endif /* MBEDTLS_SSL_ASYNC_VERIFY */
+
 #if defined(MBEDTLS_SSL_SESSION_TICKETS)
 #define USAGE_TICKETS                                       \
     "    tickets=%%d          default: 1 (enabled)\n"
@@ -288,6 +300,9 @@ int main( void )
     "    dtls=%%d             default: 0 (TLS)\n"                           \
     "    hs_timeout=%%d-%%d    default: (library default: 1000-60000)\n"    \
     "                        range of DTLS handshake timeouts in millisecs\n" \
+    "    hs_rto_min=%%d       default: -1 (fixed initial handshake timeout)\n" \
+    "                        enable RTT-based handshake timeouts, with this\n" \
+    "                        lower bound in millisecs\n"                  \
     "    mtu=%%d              default: (library default: unlimited)\n"  \
     "    dgram_packing=%%d    default: 1 (allowed)\n"                   \
     "                        allow or forbid packing of multiple\n" \
@@ -380,6 +395,7 @@ int main( void )
     USAGE_IO                                                \
     USAGE_KEY_OPAQUE                                        \
     USAGE_CA_CALLBACK                                       \
+    USAGE_ASYNC_VERIFY                                      \
     "\n"                                                    \
     USAGE_PSK                                               \
     USAGE_ECJPAKE                                           \
@@ -388,6 +404,8 @@ int main( void )
     "    allow_legacy=%%d     default: (library default: no)\n"   \
     USAGE_RENEGO                                            \
     "    exchanges=%%d        default: 1\n"                 \
+    "    stats=%%d            print the record layer counters before closing\n" \
+    "                        default: 0 (disabled)\n"      \
     "    reconnect=%%d        number of reconnections using session resumption\n" \
     "                        default: 0 (disabled)\n"      \
     "    reco_delay=%%d       default: 0 seconds\n"         \
@@ -452,6 +470,9 @@ struct options
 #endif
 #if defined(MBEDTLS_X509_TRUSTED_CERTIFICATE_CALLBACK)
     int ca_callback;            /* Use callback for trusted certificate list */
+#endif
+#if defined(MBEDTLS_SSL_ASYNC_VERIFY)
+    int async_verify;           /* in-progress returns of the chain verifier */
 #endif
     const char *psk;            /* the pre-shared key                       */
     const char *psk_identity;   /* the pre-shared key identity              */
@@ -482,6 +503,7 @@ struct options
     int transport;              /* TLS or DTLS?                             */
     uint32_t hs_to_min;         /* Initial value of DTLS handshake timer    */
     uint32_t hs_to_max;         /* Max value of DTLS handshake timer        */
+    int hs_rto_min;             /* Min RTT-based DTLS timeout, -1: disabled */
     int dtls_mtu;               /* UDP Maximum tranport unit for DTLS       */
     int fallback;               /* is this a fallback connection?           */
     int dgram_packing;          /* allow/forbid datagram packing            */
@@ -497,6 +519,7 @@ struct options
     const char *cid_val_renego; /* the CID to use for incoming messages
                                  * after renegotiation                      */
     int reproducible;           /* make communication reproducible          */
+    int stats;                  /* print the record layer counters?         */
 } opt;
 
 int query_config( const char *config );
@@ -631,6 +654,84 @@ exit:
 }
 #endif /* MBEDTLS_X509_TRUSTED_CERTIFICATE_CALLBACK */
 
+#if defined(MBEDTLS_SSL_ASYNC_VERIFY)
+/*
+ * Test-only asynchronous chain verifier: it verifies the chain against the
+ * trusted CAs with mbedtls_x509_crt_verify(), after reporting that the
+ * operation is in progress a configurable number of times. A real verifier
+ * would run the verification on another thread or service.
+ */
+typedef struct
+{
+    mbedtls_x509_crt *chain;
+    const char *hostname;
+    int remaining;
+} async_verify_op_t;
+
+static int async_verify_delay;
+
+static int async_verify_start( void *p_verify, mbedtls_ssl_context *ssl,
+                               mbedtls_x509_crt *chain, const char *hostname,
+                               void **op )
+{
+    async_verify_op_t *ctx;
+
+    ((void) p_verify);
+    ((void) ssl);
+
+    ctx = mbedtls_calloc( 1, sizeof( async_verify_op_t ) );
+    if( ctx == NULL )
+        return( MBEDTLS_ERR_SSL_ALLOC_FAILED );
+
+    ctx->chain = chain;
+    ctx->hostname = hostname;
+    ctx->remaining = async_verify_delay;
+    *op = ctx;
+
+    mbedtls_printf( "Async verify callback: started, delay=%d\n",
+                    ctx->remaining );
+
+    return( ctx->remaining > 0 ? MBEDTLS_ERR_SSL_ASYNC_IN_PROGRESS : 0 );
+}
+
+static int async_verify_resume( void *p_verify, mbedtls_ssl_context *ssl,
+                                void *op, uint32_t *flags )
+{
+    int ret;
+    async_verify_op_t *ctx = (async_verify_op_t *) op;
+    mbedtls_x509_crt *ca = (mbedtls_x509_crt *) p_verify;
+
+    ((void) ssl);
+
+    if( ctx->remaining > 0 )
+    {
+        --ctx->remaining;
+        mbedtls_printf( "Async verify callback: call %d more times.\n",
+                        ctx->remaining );
+        if( ctx->remaining > 0 )
+            return( MBEDTLS_ERR_SSL_ASYNC_IN_PROGRESS );
+    }
+
+    ret = mbedtls_x509_crt_verify( ctx->chain, ca, NULL, ctx->hostname,
+                                   flags, NULL, NULL );
+    mbedtls_printf( "Async verify callback: done, flags=0x%08x\n",
+                    (unsigned int) *flags );
+
+    mbedtls_free( ctx );
+    return( ret );
+}
+
+static void async_verify_cancel( void *p_verify, mbedtls_ssl_context *ssl,
+                                 void *op )
+{
+    ((void) p_verify);
+    ((void) ssl);
+
+    mbedtls_printf( "Async verify callback: cancelled\n" );
+    mbedtls_free( op );
+}
+#endif /* MBEDTLS_SSL_ASYNC_VERIFY */
+
 /*
  * Test recv/send functions that make sure each try returns
  * WANT_READ/WANT_WRITE at least once before sucesseding
@@ -801,6 +902,17 @@ static int send_cb( void *ctx, unsigned char const *buf, size_t len )
     return( mbedtls_net_send( io_ctx->net, buf, len ) );
 }
 
+#if defined(MBEDTLS_SSL_PROTO_DTLS) && defined(MBEDTLS_TIMING_C)
+/*
+ * Millisecond clock for RTT-based handshake timeouts
+ */
+static uint32_t get_clock_ms( void *ctx )
+{
+    return( (uint32_t) mbedtls_timing_get_timer(
+                (struct mbedtls_timing_hr_time *) ctx, 0 ) );
+}
+#endif
+
 #if defined(MBEDTLS_X509_CRT_PARSE_C)
 static unsigned char peer_crt_info[1024];
 
@@ -1065,10 +1177,14 @@ int main( int argc, char *argv[] )
     mbedtls_ssl_context ssl;
     mbedtls_ssl_config conf;
     mbedtls_ssl_session saved_session;
+    mbedtls_ssl_stats stats;
     unsigned char *session_data = NULL;
     size_t session_data_len = 0;
 #if defined(MBEDTLS_TIMING_C)
     mbedtls_timing_delay_context timer;
+#if defined(MBEDTLS_SSL_PROTO_DTLS)
+    struct mbedtls_timing_hr_time hs_clock;
+#endif
 #endif
 #if defined(MBEDTLS_X509_CRT_PARSE_C)
     uint32_t flags;
@@ -1172,6 +1288,9 @@ int main( int argc, char *argv[] )
     opt.psk_identity        = DFL_PSK_IDENTITY;
     opt.ecjpake_pw          = DFL_ECJPAKE_PW;
     opt.ec_max_ops          = DFL_EC_MAX_OPS;
+#if defined(MBEDTLS_SSL_ASYNC_VERIFY)
+    opt.async_verify        = DFL_ASYNC_VERIFY;
+#endif
     opt.force_ciphersuite[0]= DFL_FORCE_CIPHER;
     opt.renegotiation       = DFL_RENEGOTIATION;
     opt.allow_legacy        = DFL_ALLOW_LEGACY;
@@ -1196,6 +1315,7 @@ int main( int argc, char *argv[] )
     opt.transport           = DFL_TRANSPORT;
     opt.hs_to_min           = DFL_HS_TO_MIN;
     opt.hs_to_max           = DFL_HS_TO_MAX;
+    opt.hs_rto_min          = DFL_HS_RTO_MIN;
     opt.dtls_mtu            = DFL_DTLS_MTU;
     opt.fallback            = DFL_FALLBACK;
     opt.extended_ms         = DFL_EXTENDED_MS;
@@ -1204,6 +1324,7 @@ int main( int argc, char *argv[] )
     opt.serialize           = DFL_SERIALIZE;
     opt.eap_tls             = DFL_EAP_TLS;
     opt.reproducible        = DFL_REPRODUCIBLE;
+    opt.stats               = DFL_STATS;
 
     for( i = 1; i < argc; i++ )
     {
@@ -1312,6 +1433,14 @@ int main( int argc, char *argv[] )
 #if defined(MBEDTLS_X509_TRUSTED_CERTIFICATE_CALLBACK)
         else if( strcmp( p, "ca_callback" ) == 0)
             opt.ca_callback = atoi( q );
+#endif
+#if defined(MBEDTLS_SSL_ASYNC_VERIFY)
+        else if( strcmp( p, "async_verify" ) == 0 )
+        {
+            opt.async_verify = atoi( q );
+            if( opt.async_verify < -1 )
+                goto usage;
+        }
 #endif
         else if( strcmp( p, "psk_identity" ) == 0 )
             opt.psk_identity = q;
@@ -1364,6 +1493,12 @@ int main( int argc, char *argv[] )
             if( opt.exchanges < 1 )
                 goto usage;
         }
+        else if( strcmp( p, "stats" ) == 0 )
+        {
+            opt.stats = atoi( q );
+            if( opt.stats < 0 || opt.stats > 1 )
+                goto usage;
+        }
         else if( strcmp( p, "reconnect" ) == 0 )
         {
             opt.reconnect = atoi( q );
@@ -1559,6 +1694,12 @@ int main( int argc, char *argv[] )
             if( opt.hs_to_min == 0 || opt.hs_to_max < opt.hs_to_min )
                 goto usage;
         }
+        else if( strcmp( p, "hs_rto_min" ) == 0 )
+        {
+            opt.hs_rto_min = atoi( q );
+            if( opt.hs_rto_min < -1 )
+                goto usage;
+        }
         else if( strcmp( p, "mtu" ) == 0 )
         {
             opt.dtls_mtu = atoi( q );
@@ -2115,6 +2256,15 @@ int main( int argc, char *argv[] )
         mbedtls_ssl_conf_handshake_timeout( &conf, opt.hs_to_min,
                                             opt.hs_to_max );
 
+#if defined(MBEDTLS_TIMING_C)
+    if( opt.hs_rto_min != DFL_HS_RTO_MIN )
+    {
+        (void) mbedtls_timing_get_timer( &hs_clock, 1 );
+        mbedtls_ssl_conf_handshake_rtt( &conf, get_clock_ms, &hs_clock,
+                                        (uint32_t) opt.hs_rto_min );
+    }
+#endif
+
     if( opt.dgram_packing != DFL_DGRAM_PACKING )
         mbedtls_ssl_set_datagram_packing( &ssl, opt.dgram_packing );
 #endif /* MBEDTLS_SSL_PROTO_DTLS */
@@ -2215,6 +2365,23 @@ int main( int argc, char *argv[] )
 #endif
             mbedtls_ssl_conf_ca_chain( &conf, &cacert, NULL );
     }
+
+#if defined(MBEDTLS_SSL_ASYNC_VERIFY)
+    if( opt.async_verify != DFL_ASYNC_VERIFY )
+    {
+        async_verify_delay = opt.async_verify;
+        if( ( ret = mbedtls_ssl_conf_async_verify( &conf,
+                                                   async_verify_start,
+                                                   async_verify_resume,
+                                                   async_verify_cancel,
+                                                   &cacert ) ) != 0 )
+        {
+            mbedtls_printf( " failed\n  ! mbedtls_ssl_conf_async_verify returned %d\n\n",
+                            ret );
+            goto exit;
+        }
+    }
+#endif /* MBEDTLS_SSL_ASYNC_VERIFY */
     if( strcmp( opt.crt_file, "none" ) != 0 &&
         strcmp( opt.key_file, "none" ) != 0 )
     {
@@ -2365,6 +2532,7 @@ int main( int argc, char *argv[] )
     {
         if( ret != MBEDTLS_ERR_SSL_WANT_READ &&
             ret != MBEDTLS_ERR_SSL_WANT_WRITE &&
+            ret != MBEDTLS_ERR_SSL_ASYNC_IN_PROGRESS &&
             ret != MBEDTLS_ERR_SSL_CRYPTO_IN_PROGRESS )
         {
             mbedtls_printf( " failed\n  ! mbedtls_ssl_handshake returned -0x%x\n",
@@ -2386,6 +2554,11 @@ int main( int argc, char *argv[] )
             continue;
 #endif
 
+#if defined(MBEDTLS_SSL_ASYNC_VERIFY)
+        if( ret == MBEDTLS_ERR_SSL_ASYNC_IN_PROGRESS )
+            continue;
+#endif
+
         /* For event-driven IO, wait for socket to become available */
         if( opt.event == 1 /* level triggered IO */ )
         {
@@ -2584,6 +2757,7 @@ int main( int argc, char *argv[] )
         {
             if( ret != MBEDTLS_ERR_SSL_WANT_READ &&
                 ret != MBEDTLS_ERR_SSL_WANT_WRITE &&
+                ret != MBEDTLS_ERR_SSL_ASYNC_IN_PROGRESS &&
                 ret != MBEDTLS_ERR_SSL_CRYPTO_IN_PROGRESS )
             {
                 mbedtls_printf( " failed\n  ! mbedtls_ssl_renegotiate returned %d\n\n",
@@ -2596,6 +2770,11 @@ int main( int argc, char *argv[] )
                 continue;
 #endif
 
+#if defined(MBEDTLS_SSL_ASYNC_VERIFY)
+            if( ret == MBEDTLS_ERR_SSL_ASYNC_IN_PROGRESS )
+                continue;
+#endif
+
             /* For event-driven IO, wait for socket to become available */
             if( opt.event == 1 /* level triggered IO */ )
             {
@@ -3023,6 +3202,21 @@ send_request:
      * 8. Done, cleanly close the connection
      */
 close_notify:
+    if( opt.stats != 0 && mbedtls_ssl_get_stats( &ssl, &stats ) == 0 )
+    {
+        mbedtls_printf( "  . Record stats: in %lu, out %lu, "
+                        "encrypted %lu, decrypted %lu, bad MAC %lu, "
+                        "resent %lu, buffered %lu, renegotiations %lu\n",
+                        (unsigned long) stats.records_in,
+                        (unsigned long) stats.records_out,
+                        (unsigned long) stats.bytes_encrypted,
+                        (unsigned long) stats.bytes_decrypted,
+                        (unsigned long) stats.bad_mac,
+                        (unsigned long) stats.retransmissions,
+                        (unsigned long) stats.buffered_records,
+                        (unsigned long) stats.renegotiations );
+    }
+
     mbedtls_printf( "  . Closing the connection..." );
     fflush( stdout );
 
@@ -0,0 +1,785 @@
+/*
+ *  Multi-threaded SSL/TLS handshake benchmark
+ *
+ *  Copyright (C) 2006-2019, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *  This file is part of mbed TLS (https://tls.mbed.org)
+ */
+
+/* Enable definition of clock_gettime() even when compiling with -std=c99.
+ * Must be set before config.h, which pulls in glibc's features.h indirectly.
+ * Harmless on other platforms. */
+#define _POSIX_C_SOURCE 200112L
+
+#if !defined(MBEDTLS_CONFIG_FILE)
+#include "mbedtls/config.h"
+#else
+#include MBEDTLS_CONFIG_FILE
+#endif
+
+#if defined(MBEDTLS_PLATFORM_C)
+#include "mbedtls/platform.h"
+#else
+#include <stdio.h>
+#include <stdlib.h>
+#define mbedtls_calloc          calloc
+#define mbedtls_free            free
+#define mbedtls_printf          printf
+#define mbedtls_exit            exit
+#define MBEDTLS_EXIT_SUCCESS    EXIT_SUCCESS
+#define MBEDTLS_EXIT_FAILURE    EXIT_FAILURE
+#endif
+
+#if !defined(MBEDTLS_ENTROPY_C) || !defined(MBEDTLS_CTR_DRBG_C) ||        \
+    !defined(MBEDTLS_CERTS_C) || !defined(MBEDTLS_SSL_TLS_C) ||           \
+    !defined(MBEDTLS_SSL_CLI_C) || !defined(MBEDTLS_SSL_SRV_C) ||         \
+    !defined(MBEDTLS_X509_CRT_PARSE_C) || !defined(MBEDTLS_PK_PARSE_C) || \
+    !defined(MBEDTLS_TIMING_C) || !defined(MBEDTLS_THREADING_C) ||        \
+    !defined(MBEDTLS_THREADING_PTHREAD)
+int main( void )
+{
+    mbedtls_printf("MBEDTLS_ENTROPY_C and/or MBEDTLS_CTR_DRBG_C and/or "
+           "MBEDTLS_CERTS_C and/or MBEDTLS_SSL_TLS_C and/or "
+           "MBEDTLS_SSL_CLI_C and/or MBEDTLS_SSL_SRV_C and/or "
+           "MBEDTLS_X509_CRT_PARSE_C and/or MBEDTLS_PK_PARSE_C and/or "
+           "MBEDTLS_TIMING_C and/or MBEDTLS_THREADING_C and/or "
+           "MBEDTLS_THREADING_PTHREAD not defined.\n");
+    return( 0 );
+}
+#else
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "mbedtls/entropy.h"
+#include "mbedtls/ctr_drbg.h"
+#include "mbedtls/certs.h"
+#include "mbedtls/ssl.h"
+#include "mbedtls/timing.h"
+#include "mbedtls/error.h"
+
+#if defined(MBEDTLS_SSL_CACHE_C)
+#include "mbedtls/ssl_cache.h"
+#endif
+
+#if defined(MBEDTLS_SSL_TICKET_C)
+#include "mbedtls/ssl_ticket.h"
+#endif
+
+#if defined(MBEDTLS_SSL_COOKIE_C)
+#include "mbedtls/ssl_cookie.h"
+#endif
+
+#define DFL_THREADS             4
+#define DFL_DURATION            3
+#define DFL_RESUME              0
+#define DFL_DTLS                0
+
+#define MAX_THREADS             64
+
+#define USAGE \
+    "\n usage: ssl_pthread_bench param=<>...\n"                             \
+    "\n acceptable parameters:\n"                                           \
+    "    threads=%%d          default: 4 (1 to 64)\n"                       \
+    "    duration=%%d         default: 3 (seconds)\n"                       \
+    "    resume=%%d           default: 0 (full handshakes)\n"               \
+    "                        1: resume from the server's session cache\n"   \
+    "                        2: resume with session tickets\n"              \
+    "    dtls=%%d             default: 0 (TLS)\n"                           \
+    "                        1: DTLS with HelloVerifyRequest cookies\n"     \
+    "\n"
+
+/*
+ * global options
+ */
+struct options
+{
+    int threads;                /* number of client/server pairs            */
+    int duration;               /* length of the measurement, in seconds    */
+    int resume;                 /* 0: full, 1: cache, 2: ticket             */
+    int dtls;                   /* use DTLS (and cookies)?                  */
+} opt;
+
+/*
+ * Shared objects whose mutexes are timed separately
+ */
+enum
+{
+    RES_RNG = 0,
+    RES_CACHE,
+    RES_TICKET,
+    RES_COOKIE,
+    RES_OTHER,
+    RES_COUNT
+};
+
+static const char * const res_names[RES_COUNT] =
+    { "rng", "cache", "ticket", "cookie", "other" };
+
+/*
+ * In-memory transport: one pipe per direction. In datagram mode each
+ * message is prefixed with its 2-byte length, and is read as a whole.
+ */
+#define PIPE_SIZE   ( 4 * MBEDTLS_SSL_MAX_CONTENT_LEN )
+
+typedef struct
+{
+    unsigned char buf[PIPE_SIZE];
+    size_t start, end;
+} bench_pipe;
+
+typedef struct
+{
+    bench_pipe *in;
+    bench_pipe *out;
+} bench_bio;
+
+static int pipe_send( void *ctx, const unsigned char *data, size_t len )
+{
+    bench_pipe *out = ( (bench_bio *) ctx )->out;
+    size_t hdr = opt.dtls ? 2 : 0;
+
+    if( out->start != 0 && PIPE_SIZE - out->end < hdr + len )
+    {
+        memmove( out->buf, out->buf + out->start, out->end - out->start );
+        out->end -= out->start;
+        out->start = 0;
+    }
+
+    if( PIPE_SIZE - out->end <= hdr )
+        return( MBEDTLS_ERR_SSL_WANT_WRITE );
+
+    if( len > PIPE_SIZE - out->end - hdr )
+    {
+        if( opt.dtls )
+            return( MBEDTLS_ERR_SSL_WANT_WRITE );
+        len = PIPE_SIZE - out->end;
+    }
+
+    if( opt.dtls )
+    {
+        out->buf[out->end++] = (unsigned char)( len >> 8 );
+        out->buf[out->end++] = (unsigned char)( len      );
+    }
+
+    memcpy( out->buf + out->end, data, len );
+    out->end += len;
+
+    return( (int) len );
+}
+
+static int pipe_recv( void *ctx, unsigned char *data, size_t len )
+{
+    bench_pipe *in = ( (bench_bio *) ctx )->in;
+    size_t avail;
+
+    if( in->start == in->end )
+    {
+        in->start = in->end = 0;
+        return( MBEDTLS_ERR_SSL_WANT_READ );
+    }
+
+    if( opt.dtls )
+    {
+        avail = ( (size_t) in->buf[in->start] << 8 ) | in->buf[in->start + 1];
+        in->start += 2;
+
+        /* As with UDP, what doesn't fit in the caller's buffer is lost */
+        memcpy( data, in->buf + in->start, avail < len ? avail : len );
+        in->start += avail;
+
+        return( (int)( avail < len ? avail : len ) );
+    }
+
+    avail = in->end - in->start;
+    if( len > avail )
+        len = avail;
+
+    memcpy( data, in->buf + in->start, len );
+    in->start += len;
+
+    return( (int) len );
+}
+
+/*
+ * Server state shared by all threads
+ */
+static struct
+{
+    mbedtls_entropy_context entropy;
+    mbedtls_ctr_drbg_context drbg;
+    mbedtls_x509_crt cacert;
+    mbedtls_x509_crt srvcert;
+    mbedtls_pk_context pkey;
+    mbedtls_ssl_config conf;
+#if defined(MBEDTLS_SSL_CACHE_C)
+    mbedtls_ssl_cache_context cache;
+#endif
+#if defined(MBEDTLS_SSL_TICKET_C)
+    mbedtls_ssl_ticket_context ticket;
+#endif
+#if defined(MBEDTLS_SSL_COOKIE_C)
+    mbedtls_ssl_cookie_ctx cookie;
+#endif
+} srv;
+
+/*
+ * Per-thread state: a client and a server context, and their statistics
+ */
+typedef struct
+{
+    int id;
+    pthread_t thread;
+    int ret;
+
+    mbedtls_ctr_drbg_context drbg;      /* client RNG, not shared           */
+    mbedtls_ssl_config cli_conf;
+    mbedtls_ssl_context cli;
+    mbedtls_ssl_context srv;
+    mbedtls_ssl_session session;
+    mbedtls_timing_delay_context cli_timer;
+    mbedtls_timing_delay_context srv_timer;
+    bench_pipe to_srv, to_cli;
+    bench_bio cli_bio, srv_bio;
+
+    unsigned long handshakes;
+    uint64_t elapsed_ns;
+    unsigned long locks[RES_COUNT];
+    uint64_t wait_ns[RES_COUNT];
+} thread_ctx;
+
+static thread_ctx *threads;
+
+static uint64_t now_ns( void )
+{
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+
+    return( (uint64_t) ts.tv_sec * 1000000000u + (uint64_t) ts.tv_nsec );
+}
+
+/*
+ * Mutex lock wrapper that accounts the time spent acquiring each lock
+ * to the calling benchmark thread
+ */
+static pthread_key_t stats_key;
+static int (*real_mutex_lock)( mbedtls_threading_mutex_t * );
+
+static int resource_of( const mbedtls_threading_mutex_t *mutex )
+{
+    if( mutex == &srv.drbg.mutex )
+        return( RES_RNG );
+#if defined(MBEDTLS_SSL_CACHE_C)
+    if( mutex == &srv.cache.mutex )
+        return( RES_CACHE );
+#endif
+#if defined(MBEDTLS_SSL_TICKET_C)
+    if( mutex == &srv.ticket.mutex )
+        return( RES_TICKET );
+#endif
+#if defined(MBEDTLS_SSL_COOKIE_C)
+    if( mutex == &srv.cookie.mutex )
+        return( RES_COOKIE );
+#endif
+    return( RES_OTHER );
+}
+
+static int timed_mutex_lock( mbedtls_threading_mutex_t *mutex )
+{
+    thread_ctx *t = (thread_ctx *) pthread_getspecific( stats_key );
+    uint64_t start;
+    int ret, res;
+
+    if( t == NULL )
+        return( real_mutex_lock( mutex ) );
+
+    start = now_ns();
+    ret = real_mutex_lock( mutex );
+
+    res = resource_of( mutex );
+    t->wait_ns[res] += now_ns() - start;
+    t->locks[res]++;
+
+    return( ret );
+}
+
+/*
+ * Run one connection to the end of the handshake
+ */
+static int bench_connection( thread_ctx *t, int resume )
+{
+    int ret, cli_done = 0, srv_done = 0, rounds;
+    unsigned char cli_id[4];
+
+    t->to_srv.start = t->to_srv.end = 0;
+    t->to_cli.start = t->to_cli.end = 0;
+
+    if( ( ret = mbedtls_ssl_session_reset( &t->cli ) ) != 0 ||
+        ( ret = mbedtls_ssl_session_reset( &t->srv ) ) != 0 )
+        return( ret );
+
+    cli_id[0] = (unsigned char)( t->id >> 24 );
+    cli_id[1] = (unsigned char)( t->id >> 16 );
+    cli_id[2] = (unsigned char)( t->id >>  8 );
+    cli_id[3] = (unsigned char)( t->id       );
+
+#if defined(MBEDTLS_SSL_DTLS_HELLO_VERIFY)
+    if( opt.dtls && ( ret = mbedtls_ssl_set_client_transport_id( &t->srv,
+                                        cli_id, sizeof( cli_id ) ) ) != 0 )
+        return( ret );
+#endif
+
+    if( resume && ( ret = mbedtls_ssl_set_session( &t->cli,
+                                                   &t->session ) ) != 0 )
+        return( ret );
+
+    for( rounds = 0; rounds < 1000 && ! ( cli_done && srv_done ); rounds++ )
+    {
+        if( ! cli_done )
+        {
+            ret = mbedtls_ssl_handshake( &t->cli );
+            if( ret == 0 )
+                cli_done = 1;
+            else if( ret != MBEDTLS_ERR_SSL_WANT_READ &&
+                     ret != MBEDTLS_ERR_SSL_WANT_WRITE )
+                return( ret );
+        }
+
+        if( ! srv_done )
+        {
+            ret = mbedtls_ssl_handshake( &t->srv );
+            if( ret == 0 )
+                srv_done = 1;
+#if defined(MBEDTLS_SSL_DTLS_HELLO_VERIFY)
+            else if( ret == MBEDTLS_ERR_SSL_HELLO_VERIFY_REQUIRED )
+            {
+                /* Start over, now expecting a ClientHello with a cookie */
+                if( ( ret = mbedtls_ssl_session_reset( &t->srv ) ) != 0 ||
+                    ( ret = mbedtls_ssl_set_client_transport_id( &t->srv,
+                                        cli_id, sizeof( cli_id ) ) ) != 0 )
+                    return( ret );
+            }
+#endif
+            else if( ret != MBEDTLS_ERR_SSL_WANT_READ &&
+                     ret != MBEDTLS_ERR_SSL_WANT_WRITE )
+                return( ret );
+        }
+    }
+
+    return( cli_done && srv_done ? 0 : MBEDTLS_ERR_SSL_INTERNAL_ERROR );
+}
+
+static void *bench_thread( void *arg )
+{
+    thread_ctx *t = (thread_ctx *) arg;
+    uint64_t start;
+    int ret;
+
+    /* The first full handshake provides the session to resume */
+    if( ( ret = bench_connection( t, 0 ) ) != 0 ||
+        ( ret = mbedtls_ssl_get_session( &t->cli, &t->session ) ) != 0 )
+    {
+        t->ret = ret;
+        return( NULL );
+    }
+
+    pthread_setspecific( stats_key, t );
+    start = now_ns();
+
+    while( ! mbedtls_timing_alarmed )
+    {
+        if( ( ret = bench_connection( t, opt.resume ) ) != 0 )
+        {
+            t->ret = ret;
+            break;
+        }
+        t->handshakes++;
+    }
+
+    t->elapsed_ns = now_ns() - start;
+    pthread_setspecific( stats_key, NULL );
+
+    return( NULL );
+}
+
+static int setup_server( void )
+{
+    int ret;
+    const char *pers = "ssl_pthread_bench";
+
+    if( ( ret = mbedtls_ctr_drbg_seed( &srv.drbg, mbedtls_entropy_func,
+                                       &srv.entropy,
+                                       (const unsigned char *) pers,
+                                       strlen( pers ) ) ) != 0 )
+        return( ret );
+
+    if( ( ret = mbedtls_x509_crt_parse( &srv.cacert,
+                    (const unsigned char *) mbedtls_test_cas_pem,
+                    mbedtls_test_cas_pem_len ) ) != 0 ||
+        ( ret = mbedtls_x509_crt_parse( &srv.srvcert,
+                    (const unsigned char *) mbedtls_test_srv_crt,
+                    mbedtls_test_srv_crt_len ) ) != 0 ||
+        ( ret = mbedtls_pk_parse_key( &srv.pkey,
+                    (const unsigned char *) mbedtls_test_srv_key,
+                    mbedtls_test_srv_key_len, NULL, 0 ) ) != 0 )
+        return( ret );
+
+    if( ( ret = mbedtls_ssl_config_defaults( &srv.conf, MBEDTLS_SSL_IS_SERVER,
+                    opt.dtls ? MBEDTLS_SSL_TRANSPORT_DATAGRAM :
+                               MBEDTLS_SSL_TRANSPORT_STREAM,
+                    MBEDTLS_SSL_PRESET_DEFAULT ) ) != 0 )
+        return( ret );
+
+    mbedtls_ssl_conf_rng( &srv.conf, mbedtls_ctr_drbg_random, &srv.drbg );
+
+    if( ( ret = mbedtls_ssl_conf_own_cert( &srv.conf, &srv.srvcert,
+                                           &srv.pkey ) ) != 0 )
+        return( ret );
+
+#if defined(MBEDTLS_SSL_CACHE_C)
+    mbedtls_ssl_conf_session_cache( &srv.conf, &srv.cache,
+                                    mbedtls_ssl_cache_get,
+                                    mbedtls_ssl_cache_set );
+#else
+    if( opt.resume == 1 )
+        return( MBEDTLS_ERR_SSL_FEATURE_UNAVAILABLE );
+#endif
+
+#if defined(MBEDTLS_SSL_TICKET_C) && defined(MBEDTLS_GCM_C)
+    if( ( ret = mbedtls_ssl_ticket_setup( &srv.ticket,
+                    mbedtls_ctr_drbg_random, &srv.drbg,
+                    MBEDTLS_CIPHER_AES_256_GCM, 86400 ) ) != 0 )
+        return( ret );
+
+    mbedtls_ssl_conf_session_tickets_cb( &srv.conf,
+                                         mbedtls_ssl_ticket_write,
+                                         mbedtls_ssl_ticket_parse,
+                                         &srv.ticket );
+#else
+    if( opt.resume == 2 )
+        return( MBEDTLS_ERR_SSL_FEATURE_UNAVAILABLE );
+#endif
+
+    if( opt.dtls )
+    {
+#if defined(MBEDTLS_SSL_COOKIE_C) && defined(MBEDTLS_SSL_DTLS_HELLO_VERIFY)
+        if( ( ret = mbedtls_ssl_cookie_setup( &srv.cookie,
+                        mbedtls_ctr_drbg_random, &srv.drbg ) ) != 0 )
+            return( ret );
+
+        mbedtls_ssl_conf_dtls_cookies( &srv.conf, mbedtls_ssl_cookie_write,
+                                       mbedtls_ssl_cookie_check, &srv.cookie );
+#else
+        return( MBEDTLS_ERR_SSL_FEATURE_UNAVAILABLE );
+#endif
+    }
+
+    return( 0 );
+}
+
+static int setup_thread( thread_ctx *t, int id )
+{
+    int ret;
+
+    t->id = id;
+
+    if( ( ret = mbedtls_ctr_drbg_seed( &t->drbg, mbedtls_entropy_func,
+                                       &srv.entropy,
+                                       (const unsigned char *) &id,
+                                       sizeof( id ) ) ) != 0 )
+        return( ret );
+
+    if( ( ret = mbedtls_ssl_config_defaults( &t->cli_conf,
+                    MBEDTLS_SSL_IS_CLIENT,
+                    opt.dtls ? MBEDTLS_SSL_TRANSPORT_DATAGRAM :
+                               MBEDTLS_SSL_TRANSPORT_STREAM,
+                    MBEDTLS_SSL_PRESET_DEFAULT ) ) != 0 )
+        return( ret );
+
+    mbedtls_ssl_conf_rng( &t->cli_conf, mbedtls_ctr_drbg_random, &t->drbg );
+
+    /* The test certificates may have expired: verify, but don't fail */
+    mbedtls_ssl_conf_authmode( &t->cli_conf, MBEDTLS_SSL_VERIFY_OPTIONAL );
+    mbedtls_ssl_conf_ca_chain( &t->cli_conf, &srv.cacert, NULL );
+
+#if defined(MBEDTLS_SSL_SESSION_TICKETS)
+    mbedtls_ssl_conf_session_tickets( &t->cli_conf, opt.resume == 2 ?
+                                      MBEDTLS_SSL_SESSION_TICKETS_ENABLED :
+                                      MBEDTLS_SSL_SESSION_TICKETS_DISABLED );
+#endif
+
+    if( ( ret = mbedtls_ssl_setup( &t->cli, &t->cli_conf ) ) != 0 ||
+        ( ret = mbedtls_ssl_setup( &t->srv, &srv.conf ) ) != 0 )
+        return( ret );
+
+    if( ( ret = mbedtls_ssl_set_hostname( &t->cli, "localhost" ) ) != 0 )
+        return( ret );
+
+    t->cli_bio.in  = &t->to_cli;
+    t->cli_bio.out = &t->to_srv;
+    t->srv_bio.in  = &t->to_srv;
+    t->srv_bio.out = &t->to_cli;
+    mbedtls_ssl_set_bio( &t->cli, &t->cli_bio, pipe_send, pipe_recv, NULL );
+    mbedtls_ssl_set_bio( &t->srv, &t->srv_bio, pipe_send, pipe_recv, NULL );
+
+    mbedtls_ssl_set_timer_cb( &t->cli, &t->cli_timer, mbedtls_timing_set_delay,
+                                                      mbedtls_timing_get_delay );
+    mbedtls_ssl_set_timer_cb( &t->srv, &t->srv_timer, mbedtls_timing_set_delay,
+                                                      mbedtls_timing_get_delay );
+
+    return( 0 );
+}
+
+static void print_error( const char *what, int ret )
+{
+#if defined(MBEDTLS_ERROR_C)
+    char error_buf[100];
+    mbedtls_strerror( ret, error_buf, sizeof( error_buf ) );
+    mbedtls_printf( "  ! %s returned -0x%04x: %s\n", what, -ret, error_buf );
+#else
+    mbedtls_printf( "  ! %s returned -0x%04x\n", what, -ret );
+#endif
+}
+
+int main( int argc, char *argv[] )
+{
+    int ret = 0, i, r;
+    int exit_code = MBEDTLS_EXIT_FAILURE;
+    char *p, *q;
+    double total_rate = 0, secs;
+    unsigned long locks[RES_COUNT] = { 0 };
+    uint64_t wait_ns[RES_COUNT] = { 0 };
+
+    opt.threads             = DFL_THREADS;
+    opt.duration            = DFL_DURATION;
+    opt.resume              = DFL_RESUME;
+    opt.dtls                = DFL_DTLS;
+
+    for( i = 1; i < argc; i++ )
+    {
+        p = argv[i];
+        if( ( q = strchr( p, '=' ) ) == NULL )
+            goto usage;
+        *q++ = '\0';
+
+        if( strcmp( p, "threads" ) == 0 )
+        {
+            opt.threads = atoi( q );
+            if( opt.threads < 1 || opt.threads > MAX_THREADS )
+                goto usage;
+        }
+        else if( strcmp( p, "duration" ) == 0 )
+        {
+            opt.duration = atoi( q );
+            if( opt.duration < 1 )
+                goto usage;
+        }
+        else if( strcmp( p, "resume" ) == 0 )
+        {
+            opt.resume = atoi( q );
+            if( opt.resume < 0 || opt.resume > 2 )
+                goto usage;
+        }
+        else if( strcmp( p, "dtls" ) == 0 )
+        {
+            opt.dtls = atoi( q );
+            if( opt.dtls < 0 || opt.dtls > 1 )
+                goto usage;
+        }
+        else
+            goto usage;
+    }
+
+    mbedtls_entropy_init( &srv.entropy );
+    mbedtls_ctr_drbg_init( &srv.drbg );
+    mbedtls_x509_crt_init( &srv.cacert );
+    mbedtls_x509_crt_init( &srv.srvcert );
+    mbedtls_pk_init( &srv.pkey );
+    mbedtls_ssl_config_init( &srv.conf );
+#if defined(MBEDTLS_SSL_CACHE_C)
+    mbedtls_ssl_cache_init( &srv.cache );
+#endif
+#if defined(MBEDTLS_SSL_TICKET_C)
+    mbedtls_ssl_ticket_init( &srv.ticket );
+#endif
+#if defined(MBEDTLS_SSL_COOKIE_C)
+    mbedtls_ssl_cookie_init( &srv.cookie );
+#endif
+
+    threads = mbedtls_calloc( opt.threads, sizeof( thread_ctx ) );
+    if( threads == NULL )
+    {
+        mbedtls_printf( "  ! allocation of the thread contexts failed\n" );
+        goto exit;
+    }
+
+    for( i = 0; i < opt.threads; i++ )
+    {
+        mbedtls_ctr_drbg_init( &threads[i].drbg );
+        mbedtls_ssl_config_init( &threads[i].cli_conf );
+        mbedtls_ssl_init( &threads[i].cli );
+        mbedtls_ssl_init( &threads[i].srv );
+        mbedtls_ssl_session_init( &threads[i].session );
+    }
+
+    if( ( ret = setup_server() ) != 0 )
+    {
+        print_error( "server setup", ret );
+        goto exit;
+    }
+
+    for( i = 0; i < opt.threads; i++ )
+    {
+        if( ( ret = setup_thread( &threads[i], i ) ) != 0 )
+        {
+            print_error( "thread setup", ret );
+            goto exit;
+        }
+    }
+
+    mbedtls_printf( "\n  %d thread(s), %s, %s, %d second(s)\n\n",
+                    opt.threads, opt.dtls ? "DTLS" : "TLS",
+                    opt.resume == 0 ? "full handshakes" :
+                    opt.resume == 1 ? "resumed from cache" :
+                                      "resumed with tickets",
+                    opt.duration );
+
+    if( pthread_key_create( &stats_key, NULL ) != 0 )
+    {
+        mbedtls_printf( "  ! pthread_key_create failed\n" );
+        goto exit;
+    }
+
+    real_mutex_lock = mbedtls_mutex_lock;
+    mbedtls_mutex_lock = timed_mutex_lock;
+
+    mbedtls_set_alarm( opt.duration );
+
+    for( i = 0; i < opt.threads; i++ )
+    {
+        if( pthread_create( &threads[i].thread, NULL, bench_thread,
+                            &threads[i] ) != 0 )
+        {
+            mbedtls_printf( "  ! pthread_create failed\n" );
+            mbedtls_exit( MBEDTLS_EXIT_FAILURE );
+        }
+    }
+
+    for( i = 0; i < opt.threads; i++ )
+        pthread_join( threads[i].thread, NULL );
+
+    mbedtls_mutex_lock = real_mutex_lock;
+    pthread_key_delete( stats_key );
+
+    /*
+     * Report
+     */
+    for( i = 0; i < opt.threads; i++ )
+    {
+        thread_ctx *t = &threads[i];
+        unsigned long t_locks = 0;
+        uint64_t t_wait = 0;
+
+        if( t->ret != 0 )
+        {
+            print_error( "handshake", t->ret );
+            goto exit;
+        }
+
+        for( r = 0; r < RES_COUNT; r++ )
+        {
+            t_locks += t->locks[r];
+            t_wait += t->wait_ns[r];
+            locks[r] += t->locks[r];
+            wait_ns[r] += t->wait_ns[r];
+        }
+
+        secs = (double) t->elapsed_ns / 1e9;
+        total_rate += secs > 0 ? t->handshakes / secs : 0;
+
+        mbedtls_printf( "  thread %2d : %9.1f handshakes/s, %9lu locks, "
+                        "%9.3f ms waiting\n",
+                        i, secs > 0 ? t->handshakes / secs : 0,
+                        t_locks, (double) t_wait / 1e6 );
+    }
+
+    mbedtls_printf( "  %-9s : %9.1f handshakes/s\n\n", "total", total_rate );
+
+    for( r = 0; r < RES_COUNT; r++ )
+    {
+        if( locks[r] == 0 )
+            continue;
+
+        mbedtls_printf( "  %-9s : %9lu locks, %9.3f ms waiting, "
+                        "%7.1f ns/lock\n", res_names[r], locks[r],
+                        (double) wait_ns[r] / 1e6,
+                        (double) wait_ns[r] / locks[r] );
+    }
+
+    mbedtls_printf( "\n" );
+
+    exit_code = MBEDTLS_EXIT_SUCCESS;
+    goto exit;
+
+usage:
+    mbedtls_printf( USAGE );
+    mbedtls_exit( MBEDTLS_EXIT_FAILURE );
+
+exit:
+    if( threads != NULL )
+    {
+        for( i = 0; i < opt.threads; i++ )
+        {
+            mbedtls_ssl_free( &threads[i].cli );
+            mbedtls_ssl_free( &threads[i].srv );
+            mbedtls_ssl_config_free( &threads[i].cli_conf );
+            mbedtls_ssl_session_free( &threads[i].session );
+            mbedtls_ctr_drbg_free( &threads[i].drbg );
+        }
+        mbedtls_free( threads );
+    }
+
+#if defined(MBEDTLS_SSL_COOKIE_C)
+    mbedtls_ssl_cookie_free( &srv.cookie );
+#endif
+#if defined(MBEDTLS_SSL_TICKET_C)
+    mbedtls_ssl_ticket_free( &srv.ticket );
+#endif
+#if defined(MBEDTLS_SSL_CACHE_C)
+    mbedtls_ssl_cache_free( &srv.cache );
+#endif
+    mbedtls_ssl_config_free( &srv.conf );
+    mbedtls_pk_free( &srv.pkey );
+    mbedtls_x509_crt_free( &srv.srvcert );
+    mbedtls_x509_crt_free( &srv.cacert );
+    mbedtls_ctr_drbg_free( &srv.drbg );
+    mbedtls_entropy_free( &srv.entropy );
+
+#if defined(_WIN32)
+    mbedtls_printf( "  Press Enter to exit this program.\n" );
+    fflush( stdout ); getchar();
+#endif
+
+    return( exit_code );
+}
+#endif /* MBEDTLS_ENTROPY_C && MBEDTLS_CTR_DRBG_C && MBEDTLS_CERTS_C &&
+          MBEDTLS_SSL_TLS_C && MBEDTLS_SSL_CLI_C && MBEDTLS_SSL_SRV_C &&
+          MBEDTLS_X509_CRT_PARSE_C && MBEDTLS_PK_PARSE_C && MBEDTLS_TIMING_C &&
+          MBEDTLS_THREADING_C && MBEDTLS_THREADING_PTHREAD */
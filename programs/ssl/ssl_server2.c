@@ -90,6 +90,18 @@ int main( void )
 #include "mbedtls/ssl_ticket.h"
 #endif
 
+#if defined(MBEDTLS_SSL_ASYNC_ENGINE_C)
+#include "mbedtls/ssl_async_engine.h"
+#endif
+
+#if defined(MBEDTLS_SSL_SNI_REGISTRY_C)
+#include "mbedtls/ssl_sni_registry.h"
+#endif
+
+#if defined(MBEDTLS_SSL_SNI_CACHE_C)
+#include "mbedtls/ssl_sni_cache.h"
+#endif
+
 #if defined(MBEDTLS_SSL_COOKIE_C)
 #include "mbedtls/ssl_cookie.h"
 #endif
@@ -127,6 +139,8 @@ int main( void )
 #define DFL_ASYNC_PRIVATE_DELAY1 ( -1 )
 #define DFL_ASYNC_PRIVATE_DELAY2 ( -1 )
 #define DFL_ASYNC_PRIVATE_ERROR  ( 0 )
+#define DFL_ASYNC_ENGINE        0
+#define DFL_ASYNC_BATCH         0
 #define DFL_PSK                 ""
 #define DFL_PSK_OPAQUE          0
 #define DFL_PSK_LIST_OPAQUE     0
@@ -158,14 +172,18 @@ int main( void )
 #define DFL_CACHE_MAX           -1
 #define DFL_CACHE_TIMEOUT       -1
 #define DFL_SNI                 NULL
+#define DFL_SNI_DIR             NULL
+#define DFL_SNI_CACHE_MAX       0
 #define DFL_ALPN_STRING         NULL
 #define DFL_CURVES              NULL
 #define DFL_DHM_FILE            NULL
 #define DFL_TRANSPORT           MBEDTLS_SSL_TRANSPORT_STREAM
 #define DFL_COOKIES             1
 #define DFL_ANTI_REPLAY         -1
+#define DFL_ANTI_REPLAY_WINDOW  0
 #define DFL_HS_TO_MIN           0
 #define DFL_HS_TO_MAX           0
+#define DFL_HS_RTO_MIN          -1
 #define DFL_DTLS_MTU            -1
 #define DFL_BADMAC_LIMIT        -1
 #define DFL_DGRAM_PACKING        1
@@ -176,6 +194,9 @@ int main( void )
 #define DFL_CA_CALLBACK         0
 #define DFL_EAP_TLS             0
 #define DFL_REPRODUCIBLE        0
+#define DFL_TRACE_FILE          ""
+
+#define TRACE_BUF_SIZE          ( 1 << 20 )
 
 #define LONG_RESPONSE "<p>01-blah-blah-blah-blah-blah-blah-blah-blah-blah\r\n" \
     "02-blah-blah-blah-blah-blah-blah-blah-blah-blah-blah-blah-blah-blah\r\n"  \
@@ -229,6 +250,16 @@ int main( void )
 #define USAGE_IO ""
 #endif /* MBEDTLS_X509_CRT_PARSE_C */
 
+#if defined(MBEDTLS_SSL_ASYNC_ENGINE_C)
+#define USAGE_SSL_ASYNC_ENGINE \
+    "    async_engine=%%d          Run async_operations on this many worker\n" \
+    "                              threads (default: 0=use the test callbacks)\n" \
+    "    async_batch=%%d           Operations a worker takes at once\n" \
+    "                              (default: 0=engine default)\n"
+#else
+#define USAGE_SSL_ASYNC_ENGINE ""
+#endif /* MBEDTLS_SSL_ASYNC_ENGINE_C */
+
 #if defined(MBEDTLS_SSL_ASYNC_PRIVATE)
 #define USAGE_SSL_ASYNC \
     "    async_operations=%%c...   d=decrypt, s=sign (default: -=off)\n" \
@@ -236,7 +267,8 @@ int main( void )
     "    async_private_delay2=%%d  Asynchronous delay for key_file2 and sni\n" \
     "                              default: -1 (not asynchronous)\n" \
     "    async_private_error=%%d   Async callback error injection (default=0=none,\n" \
-    "                              1=start, 2=cancel, 3=resume, negative=first time only)"
+    "                              1=start, 2=cancel, 3=resume, negative=first time only)\n" \
+    USAGE_SSL_ASYNC_ENGINE
 #else
 #define USAGE_SSL_ASYNC ""
 #endif /* MBEDTLS_SSL_ASYNC_PRIVATE */
@@ -327,9 +359,20 @@ int main( void )
 #define SNI_CRL              ""
 #endif
 
+#if defined(MBEDTLS_SSL_SNI_CACHE_C)
+#define USAGE_SNI_DIR                                                       \
+    "    sni_dir=%%s          directory of <name>.der chains and <name>.key\n" \
+    "                        keys, loaded on demand (overrides sni)\n"      \
+    "                        default: disabled\n"                           \
+    "    sni_cache_max=%%d    default: cache default (1024)\n"
+#else
+#define USAGE_SNI_DIR ""
+#endif /* MBEDTLS_SSL_SNI_CACHE_C */
+
 #define USAGE_SNI                                                           \
     "    sni=%%s              name1,cert1,key1,ca1"SNI_CRL",auth1[,...]\n"  \
-    "                        default: disabled\n"
+    "                        default: disabled\n"                           \
+    USAGE_SNI_DIR
 #else
 #define USAGE_SNI ""
 #endif /* SNI_OPTION */
@@ -367,7 +410,8 @@ int main( void )
 
 #if defined(MBEDTLS_SSL_DTLS_ANTI_REPLAY)
 #define USAGE_ANTI_REPLAY \
-    "    anti_replay=0/1     default: (library default: enabled)\n"
+    "    anti_replay=0/1     default: (library default: enabled)\n"  \
+    "    anti_replay_window=%%d default: (library default: MBEDTLS_SSL_DTLS_REPLAY_WINDOW)\n"
 #else
 #define USAGE_ANTI_REPLAY ""
 #endif
@@ -384,6 +428,9 @@ int main( void )
     "    dtls=%%d             default: 0 (TLS)\n"                           \
     "    hs_timeout=%%d-%%d    default: (library default: 1000-60000)\n"    \
     "                        range of DTLS handshake timeouts in millisecs\n" \
+    "    hs_rto_min=%%d       default: -1 (fixed initial handshake timeout)\n" \
+    "                        enable RTT-based handshake timeouts, with this\n" \
+    "                        lower bound in millisecs\n"                  \
     "    mtu=%%d              default: (library default: unlimited)\n"  \
     "    dgram_packing=%%d    default: 1 (allowed)\n"                   \
     "                        allow or forbid packing of multiple\n" \
@@ -437,6 +484,15 @@ int main( void )
 #define USAGE_CURVES ""
 #endif
 
+#if defined(MBEDTLS_DEBUG_BINARY_TRACE) && defined(MBEDTLS_FS_IO)
+#define USAGE_TRACE \
+    "    trace_file=%%s       default: \"\" (text debug output)\n"    \
+    "                        record debug messages in binary and\n"  \
+    "                        write them to this file on exit\n"
+#else
+#define USAGE_TRACE ""
+#endif
+
 #if defined(MBEDTLS_SSL_CONTEXT_SERIALIZATION)
 #define USAGE_SERIALIZATION \
     "    serialize=%%d        default: 0 (do not serialize/deserialize)\n" \
@@ -452,6 +508,7 @@ int main( void )
     "    server_addr=%%s      default: (all interfaces)\n"  \
     "    server_port=%%d      default: 4433\n"              \
     "    debug_level=%%d      default: 0 (disabled)\n"      \
+    USAGE_TRACE                                             \
     "    buffer_size=%%d      default: 200 \n" \
     "                         (minimum: 1, max: 16385)\n" \
     "    response_size=%%d    default: about 152 (basic response)\n" \
@@ -552,6 +609,8 @@ struct options
     int async_private_delay1;   /* number of times f_async_resume needs to be called for key 1, or -1 for no async */
     int async_private_delay2;   /* number of times f_async_resume needs to be called for key 2, or -1 for no async */
     int async_private_error;    /* inject error in async private callback */
+    int async_engine;           /* worker threads for async operations    */
+    int async_batch;            /* operations a worker takes at once      */
 #if defined(MBEDTLS_USE_PSA_CRYPTO)
     int psk_opaque;
     int psk_list_opaque;
@@ -584,6 +643,8 @@ struct options
     int cache_max;              /* max number of session cache entries      */
     int cache_timeout;          /* expiration delay of session cache entries */
     char *sni;                  /* string describing sni information        */
+    const char *sni_dir;        /* directory of certificates loaded by SNI  */
+    int sni_cache_max;          /* max number of parsed SNI certificates    */
     const char *curves;         /* list of supported elliptic curves        */
     const char *alpn_string;    /* ALPN supported protocols                 */
     const char *dhm_file;       /* the file with the DH parameters          */
@@ -592,8 +653,10 @@ struct options
     int transport;              /* TLS or DTLS?                             */
     int cookies;                /* Use cookies for DTLS? -1 to break them   */
     int anti_replay;            /* Use anti-replay for DTLS? -1 for default */
+    unsigned int anti_replay_window; /* Size of the DTLS anti-replay window */
     uint32_t hs_to_min;         /* Initial value of DTLS handshake timer    */
     uint32_t hs_to_max;         /* Max value of DTLS handshake timer        */
+    int hs_rto_min;             /* Min RTT-based DTLS timeout, -1: disabled */
     int dtls_mtu;               /* UDP Maximum tranport unit for DTLS       */
     int dgram_packing;          /* allow/forbid datagram packing            */
     int badmac_limit;           /* Limit of records with bad MAC            */
@@ -606,6 +669,7 @@ struct options
     const char *cid_val_renego; /* the CID to use for incoming messages
                                  * after renegotiation                      */
     int reproducible;           /* make communication reproducible          */
+    const char *trace_file;     /* file for the binary debug trace          */
 } opt;
 
 int query_config( const char *config );
@@ -646,6 +710,18 @@ static int eap_tls_key_derivation ( void *p_expkey,
 }
 #endif
 
+#if defined(MBEDTLS_DEBUG_BINARY_TRACE) && defined(MBEDTLS_FS_IO)
+/*
+ * This program is single-threaded, so a single ring is enough
+ */
+static mbedtls_debug_trace *my_trace( void *ctx,
+                                      const mbedtls_ssl_context *ssl )
+{
+    ((void) ssl);
+    return( (mbedtls_debug_trace *) ctx );
+}
+#endif
+
 static void my_debug( void *ctx, int level,
                       const char *file, int line,
                       const char *str )
@@ -908,6 +984,17 @@ static int send_cb( void *ctx, unsigned char const *buf, size_t len )
     return( mbedtls_net_send( io_ctx->net, buf, len ) );
 }
 
+#if defined(MBEDTLS_SSL_PROTO_DTLS) && defined(MBEDTLS_TIMING_C)
+/*
+ * Millisecond clock for RTT-based handshake timeouts
+ */
+static uint32_t get_clock_ms( void *ctx )
+{
+    return( (uint32_t) mbedtls_timing_get_timer(
+                (struct mbedtls_timing_hr_time *) ctx, 0 ) );
+}
+#endif
+
 /*
  * Return authmode from string, or -1 on error
  */
@@ -1094,6 +1181,35 @@ int sni_callback( void *p_info, mbedtls_ssl_context *ssl,
     return( -1 );
 }
 
+#if defined(MBEDTLS_SSL_SNI_REGISTRY_C)
+/*
+ * Register the parsed entries, to select them with the registry rather
+ * than with sni_callback()
+ */
+int sni_register( mbedtls_ssl_sni_registry *registry, const sni_entry *head )
+{
+    int ret;
+    const sni_entry *cur;
+
+    for( cur = head; cur != NULL; cur = cur->next )
+    {
+        ret = mbedtls_ssl_sni_registry_add( registry, cur->name,
+                                            cur->cert, cur->key );
+        if( ret != 0 )
+            return( ret );
+
+        ret = mbedtls_ssl_sni_registry_set_client_auth( registry, cur->name,
+                    cur->ca, cur->crl,
+                    cur->authmode != DFL_AUTH_MODE ? cur->authmode :
+                                                     MBEDTLS_SSL_VERIFY_UNSET );
+        if( ret != 0 )
+            return( ret );
+    }
+
+    return( 0 );
+}
+#endif /* MBEDTLS_SSL_SNI_REGISTRY_C */
+
 #endif /* SNI_OPTION */
 
 #if defined(MBEDTLS_KEY_EXCHANGE__SOME__PSK_ENABLED) || \
@@ -1682,6 +1798,9 @@ int main( int argc, char *argv[] )
     mbedtls_ssl_config conf;
 #if defined(MBEDTLS_TIMING_C)
     mbedtls_timing_delay_context timer;
+#if defined(MBEDTLS_SSL_PROTO_DTLS)
+    struct mbedtls_timing_hr_time hs_clock;
+#endif
 #endif
 #if defined(MBEDTLS_SSL_RENEGOTIATION)
     unsigned char renego_period[8] = { 0 };
@@ -1697,10 +1816,17 @@ int main( int argc, char *argv[] )
 #if defined(MBEDTLS_SSL_ASYNC_PRIVATE)
     ssl_async_key_context_t ssl_async_keys;
 #endif /* MBEDTLS_SSL_ASYNC_PRIVATE */
+#if defined(MBEDTLS_SSL_ASYNC_ENGINE_C)
+    mbedtls_ssl_async_engine async_engine;
+#endif
 #endif /* MBEDTLS_X509_CRT_PARSE_C */
 #if defined(MBEDTLS_DHM_C) && defined(MBEDTLS_FS_IO)
     mbedtls_dhm_context dhm;
 #endif
+#if defined(MBEDTLS_DEBUG_BINARY_TRACE) && defined(MBEDTLS_FS_IO)
+    mbedtls_debug_trace trace;
+    unsigned char *trace_buf = NULL;
+#endif
 #if defined(MBEDTLS_SSL_CACHE_C)
     mbedtls_ssl_cache_context cache;
 #endif
@@ -1709,6 +1835,12 @@ int main( int argc, char *argv[] )
 #endif
 #if defined(SNI_OPTION)
     sni_entry *sni_info = NULL;
+#if defined(MBEDTLS_SSL_SNI_REGISTRY_C)
+    mbedtls_ssl_sni_registry sni_registry;
+#endif
+#if defined(MBEDTLS_SSL_SNI_CACHE_C)
+    mbedtls_ssl_sni_cache sni_cache;
+#endif
 #endif
 #if defined(MBEDTLS_ECP_C)
     mbedtls_ecp_group_id curve_list[CURVE_LIST_SIZE];
@@ -1766,6 +1898,9 @@ int main( int argc, char *argv[] )
 #if defined(MBEDTLS_SSL_ASYNC_PRIVATE)
     memset( &ssl_async_keys, 0, sizeof( ssl_async_keys ) );
 #endif
+#if defined(MBEDTLS_SSL_ASYNC_ENGINE_C)
+    mbedtls_ssl_async_engine_init( &async_engine );
+#endif
 #endif
 #if defined(MBEDTLS_DHM_C) && defined(MBEDTLS_FS_IO)
     mbedtls_dhm_init( &dhm );
@@ -1782,6 +1917,12 @@ int main( int argc, char *argv[] )
 #if defined(MBEDTLS_SSL_COOKIE_C)
     mbedtls_ssl_cookie_init( &cookie_ctx );
 #endif
+#if defined(SNI_OPTION) && defined(MBEDTLS_SSL_SNI_REGISTRY_C)
+    mbedtls_ssl_sni_registry_init( &sni_registry );
+#endif
+#if defined(SNI_OPTION) && defined(MBEDTLS_SSL_SNI_CACHE_C)
+    mbedtls_ssl_sni_cache_init( &sni_cache );
+#endif
 
 #if defined(MBEDTLS_USE_PSA_CRYPTO)
     status = psa_crypto_init();
@@ -1844,6 +1985,8 @@ int main( int argc, char *argv[] )
     opt.async_private_delay1 = DFL_ASYNC_PRIVATE_DELAY1;
     opt.async_private_delay2 = DFL_ASYNC_PRIVATE_DELAY2;
     opt.async_private_error = DFL_ASYNC_PRIVATE_ERROR;
+    opt.async_engine        = DFL_ASYNC_ENGINE;
+    opt.async_batch         = DFL_ASYNC_BATCH;
     opt.psk                 = DFL_PSK;
 #if defined(MBEDTLS_USE_PSA_CRYPTO)
     opt.psk_opaque          = DFL_PSK_OPAQUE;
@@ -1876,14 +2019,18 @@ int main( int argc, char *argv[] )
     opt.cache_max           = DFL_CACHE_MAX;
     opt.cache_timeout       = DFL_CACHE_TIMEOUT;
     opt.sni                 = DFL_SNI;
+    opt.sni_dir             = DFL_SNI_DIR;
+    opt.sni_cache_max       = DFL_SNI_CACHE_MAX;
     opt.alpn_string         = DFL_ALPN_STRING;
     opt.curves              = DFL_CURVES;
     opt.dhm_file            = DFL_DHM_FILE;
     opt.transport           = DFL_TRANSPORT;
     opt.cookies             = DFL_COOKIES;
     opt.anti_replay         = DFL_ANTI_REPLAY;
+    opt.anti_replay_window  = DFL_ANTI_REPLAY_WINDOW;
     opt.hs_to_min           = DFL_HS_TO_MIN;
     opt.hs_to_max           = DFL_HS_TO_MAX;
+    opt.hs_rto_min          = DFL_HS_RTO_MIN;
     opt.dtls_mtu            = DFL_DTLS_MTU;
     opt.dgram_packing       = DFL_DGRAM_PACKING;
     opt.badmac_limit        = DFL_BADMAC_LIMIT;
@@ -1892,6 +2039,7 @@ int main( int argc, char *argv[] )
     opt.serialize           = DFL_SERIALIZE;
     opt.eap_tls             = DFL_EAP_TLS;
     opt.reproducible        = DFL_REPRODUCIBLE;
+    opt.trace_file          = DFL_TRACE_FILE;
 
     for( i = 1; i < argc; i++ )
     {
@@ -1980,6 +2128,22 @@ int main( int argc, char *argv[] )
             }
             opt.async_private_error = n;
         }
+#if defined(MBEDTLS_SSL_ASYNC_ENGINE_C)
+        else if( strcmp( p, "async_engine" ) == 0 )
+        {
+            opt.async_engine = atoi( q );
+            if( opt.async_engine < 0 ||
+                opt.async_engine > MBEDTLS_SSL_ASYNC_ENGINE_MAX_WORKERS )
+                goto usage;
+        }
+        else if( strcmp( p, "async_batch" ) == 0 )
+        {
+            opt.async_batch = atoi( q );
+            if( opt.async_batch < 0 ||
+                opt.async_batch > MBEDTLS_SSL_ASYNC_ENGINE_MAX_BATCH )
+                goto usage;
+        }
+#endif /* MBEDTLS_SSL_ASYNC_ENGINE_C */
 #endif /* MBEDTLS_SSL_ASYNC_PRIVATE */
 #if defined(MBEDTLS_SSL_DTLS_CONNECTION_ID)
         else if( strcmp( p, "cid" ) == 0 )
@@ -2265,6 +2429,12 @@ int main( int argc, char *argv[] )
             if( opt.anti_replay < 0 || opt.anti_replay > 1)
                 goto usage;
         }
+        else if( strcmp( p, "anti_replay_window" ) == 0 )
+        {
+            opt.anti_replay_window = atoi( q );
+            if( opt.anti_replay_window == 0 )
+                goto usage;
+        }
         else if( strcmp( p, "badmac_limit" ) == 0 )
         {
             opt.badmac_limit = atoi( q );
@@ -2281,6 +2451,12 @@ int main( int argc, char *argv[] )
             if( opt.hs_to_min == 0 || opt.hs_to_max < opt.hs_to_min )
                 goto usage;
         }
+        else if( strcmp( p, "hs_rto_min" ) == 0 )
+        {
+            opt.hs_rto_min = atoi( q );
+            if( opt.hs_rto_min < -1 )
+                goto usage;
+        }
         else if( strcmp( p, "mtu" ) == 0 )
         {
             opt.dtls_mtu = atoi( q );
@@ -2300,6 +2476,16 @@ int main( int argc, char *argv[] )
         {
             opt.sni = q;
         }
+        else if( strcmp( p, "sni_dir" ) == 0 )
+        {
+            opt.sni_dir = q;
+        }
+        else if( strcmp( p, "sni_cache_max" ) == 0 )
+        {
+            opt.sni_cache_max = atoi( q );
+            if( opt.sni_cache_max < 0 )
+                goto usage;
+        }
         else if( strcmp( p, "query_config" ) == 0 )
         {
             return query_config( q );
@@ -2310,6 +2496,8 @@ int main( int argc, char *argv[] )
             if( opt.serialize < 0 || opt.serialize > 2)
                 goto usage;
         }
+        else if( strcmp( p, "trace_file" ) == 0 )
+            opt.trace_file = q;
         else if( strcmp( p, "eap_tls" ) == 0 )
         {
             opt.eap_tls = atoi( q );
@@ -2904,6 +3092,15 @@ int main( int argc, char *argv[] )
     if( opt.hs_to_min != DFL_HS_TO_MIN || opt.hs_to_max != DFL_HS_TO_MAX )
         mbedtls_ssl_conf_handshake_timeout( &conf, opt.hs_to_min, opt.hs_to_max );
 
+#if defined(MBEDTLS_TIMING_C)
+    if( opt.hs_rto_min != DFL_HS_RTO_MIN )
+    {
+        (void) mbedtls_timing_get_timer( &hs_clock, 1 );
+        mbedtls_ssl_conf_handshake_rtt( &conf, get_clock_ms, &hs_clock,
+                                        (uint32_t) opt.hs_rto_min );
+    }
+#endif
+
     if( opt.dgram_packing != DFL_DGRAM_PACKING )
         mbedtls_ssl_set_datagram_packing( &ssl, opt.dgram_packing );
 #endif /* MBEDTLS_SSL_PROTO_DTLS */
@@ -2986,6 +3183,21 @@ int main( int argc, char *argv[] )
     mbedtls_ssl_conf_rng( &conf, mbedtls_ctr_drbg_random, &ctr_drbg );
     mbedtls_ssl_conf_dbg( &conf, my_debug, stdout );
 
+#if defined(MBEDTLS_DEBUG_BINARY_TRACE) && defined(MBEDTLS_FS_IO)
+    if( strlen( opt.trace_file ) > 0 )
+    {
+        if( ( trace_buf = mbedtls_calloc( 1, TRACE_BUF_SIZE ) ) == NULL )
+        {
+            mbedtls_printf( " failed\n  ! Could not allocate the trace buffer\n" );
+            ret = MBEDTLS_ERR_SSL_ALLOC_FAILED;
+            goto exit;
+        }
+
+        mbedtls_debug_trace_init( &trace, trace_buf, TRACE_BUF_SIZE );
+        mbedtls_ssl_conf_dbg_trace( &conf, my_trace, &trace );
+    }
+#endif
+
 #if defined(MBEDTLS_SSL_CACHE_C)
     if( opt.cache_max != -1 )
         mbedtls_ssl_cache_set_max_entries( &cache, opt.cache_max );
@@ -3049,6 +3261,14 @@ int main( int argc, char *argv[] )
 #if defined(MBEDTLS_SSL_DTLS_ANTI_REPLAY)
         if( opt.anti_replay != DFL_ANTI_REPLAY )
             mbedtls_ssl_conf_dtls_anti_replay( &conf, opt.anti_replay );
+
+        if( opt.anti_replay_window != DFL_ANTI_REPLAY_WINDOW &&
+            ( ret = mbedtls_ssl_conf_dtls_anti_replay_window( &conf,
+                                        opt.anti_replay_window ) ) != 0 )
+        {
+            mbedtls_printf( " failed\n  ! mbedtls_ssl_conf_dtls_anti_replay_window returned -0x%x\n\n", -ret );
+            goto exit;
+        }
 #endif
 
 #if defined(MBEDTLS_SSL_DTLS_BADMAC_LIMIT)
@@ -3184,6 +3404,28 @@ int main( int argc, char *argv[] )
                                            ssl_async_resume,
                                            ssl_async_cancel,
                                            &ssl_async_keys );
+#if defined(MBEDTLS_SSL_ASYNC_ENGINE_C)
+        if( opt.async_engine > 0 )
+        {
+            if( opt.async_batch > 0 &&
+                ( ret = mbedtls_ssl_async_engine_set_batch( &async_engine,
+                                                    opt.async_batch ) ) != 0 )
+            {
+                mbedtls_printf( " failed\n  ! mbedtls_ssl_async_engine_set_batch returned -0x%x\n\n", -ret );
+                goto exit;
+            }
+            ret = mbedtls_ssl_async_engine_setup( &async_engine,
+                                                  opt.async_engine,
+                                                  mbedtls_ctr_drbg_random,
+                                                  &ctr_drbg );
+            if( ret != 0 )
+            {
+                mbedtls_printf( " failed\n  ! mbedtls_ssl_async_engine_setup returned -0x%x\n\n", -ret );
+                goto exit;
+            }
+            mbedtls_ssl_async_engine_conf( &conf, &async_engine );
+        }
+#endif /* MBEDTLS_SSL_ASYNC_ENGINE_C */
     }
 #endif /* MBEDTLS_SSL_ASYNC_PRIVATE */
 #endif /* MBEDTLS_X509_CRT_PARSE_C */
@@ -3191,7 +3433,6 @@ int main( int argc, char *argv[] )
 #if defined(SNI_OPTION)
     if( opt.sni != NULL )
     {
-        mbedtls_ssl_conf_sni( &conf, sni_callback, sni_info );
 #if defined(MBEDTLS_SSL_ASYNC_PRIVATE)
         if( opt.async_private_delay2 >= 0 )
         {
@@ -3211,7 +3452,39 @@ int main( int argc, char *argv[] )
             }
         }
 #endif /* MBEDTLS_SSL_ASYNC_PRIVATE */
+
+#if defined(MBEDTLS_SSL_SNI_REGISTRY_C)
+        if( ( ret = sni_register( &sni_registry, sni_info ) ) != 0 )
+        {
+            mbedtls_printf( " failed\n  ! sni_register returned -0x%x\n\n",
+                            -ret );
+            goto exit;
+        }
+
+        mbedtls_ssl_conf_sni( &conf, mbedtls_ssl_sni_registry_get,
+                              &sni_registry );
+#else
+        mbedtls_ssl_conf_sni( &conf, sni_callback, sni_info );
+#endif
+    }
+
+#if defined(MBEDTLS_SSL_SNI_CACHE_C)
+    if( opt.sni_dir != NULL )
+    {
+        if( ( ret = mbedtls_ssl_sni_cache_setup( &sni_cache,
+                                mbedtls_ssl_sni_file_lookup,
+                                mbedtls_ssl_sni_file_release,
+                                (void *) opt.sni_dir,
+                                (size_t) opt.sni_cache_max ) ) != 0 )
+        {
+            mbedtls_printf( " failed\n  ! mbedtls_ssl_sni_cache_setup returned -0x%x\n\n",
+                            -ret );
+            goto exit;
+        }
+
+        mbedtls_ssl_conf_sni( &conf, mbedtls_ssl_sni_cache_get, &sni_cache );
     }
+#endif /* MBEDTLS_SSL_SNI_CACHE_C */
 #endif
 
 #if defined(MBEDTLS_ECP_C)
@@ -3455,6 +3728,21 @@ handshake:
         if( ! mbedtls_status_is_ssl_in_progress( ret ) )
             break;
 
+#if defined(MBEDTLS_SSL_ASYNC_ENGINE_C)
+        /* Wait for a worker to complete the private key operation */
+        if( ret == MBEDTLS_ERR_SSL_ASYNC_IN_PROGRESS && opt.async_engine > 0 )
+        {
+            mbedtls_net_context engine_fd;
+
+            engine_fd.fd = mbedtls_ssl_async_engine_get_fd( &async_engine );
+            ret = mbedtls_net_poll( &engine_fd, MBEDTLS_NET_POLL_READ, 1000 );
+            if( ret < 0 )
+                goto reset;
+            mbedtls_ssl_async_engine_ack( &async_engine );
+            continue;
+        }
+#endif /* MBEDTLS_SSL_ASYNC_ENGINE_C */
+
         /* For event-driven IO, wait for socket to become available */
         if( opt.event == 1 /* level triggered IO */ )
         {
@@ -4084,6 +4372,15 @@ exit:
     mbedtls_printf( "  . Cleaning up..." );
     fflush( stdout );
 
+#if defined(MBEDTLS_DEBUG_BINARY_TRACE) && defined(MBEDTLS_FS_IO)
+    if( trace_buf != NULL )
+    {
+        if( mbedtls_debug_trace_write_file( &trace, opt.trace_file ) != 0 )
+            mbedtls_printf( " failed to write %s...", opt.trace_file );
+        mbedtls_free( trace_buf );
+    }
+#endif
+
     mbedtls_net_free( &client_fd );
     mbedtls_net_free( &listen_fd );
 
@@ -4109,6 +4406,9 @@ exit:
     }
 #endif
 #if defined(SNI_OPTION)
+#if defined(MBEDTLS_SSL_SNI_REGISTRY_C)
+    mbedtls_ssl_sni_registry_free( &sni_registry );
+#endif
     sni_free( sni_info );
 #endif
 #if defined(MBEDTLS_KEY_EXCHANGE__SOME__PSK_ENABLED)
@@ -4138,6 +4438,9 @@ exit:
           MBEDTLS_USE_PSA_CRYPTO */
 
     mbedtls_ssl_free( &ssl );
+#if defined(MBEDTLS_SSL_ASYNC_ENGINE_C)
+    mbedtls_ssl_async_engine_free( &async_engine );
+#endif
     mbedtls_ssl_config_free( &conf );
     mbedtls_ctr_drbg_free( &ctr_drbg );
     mbedtls_entropy_free( &entropy );
@@ -4145,6 +4448,10 @@ exit:
 #if defined(MBEDTLS_SSL_CACHE_C)
     mbedtls_ssl_cache_free( &cache );
 #endif
+#if defined(SNI_OPTION) && defined(MBEDTLS_SSL_SNI_CACHE_C)
+    /* After mbedtls_ssl_free(), which releases the entry of the handshake */
+    mbedtls_ssl_sni_cache_free( &sni_cache );
+#endif
 #if defined(MBEDTLS_SSL_SESSION_TICKETS)
     mbedtls_ssl_ticket_free( &ticket_ctx );
 #endif
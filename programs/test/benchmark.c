@@ -78,6 +78,28 @@ int main( void )
 
 #include "mbedtls/error.h"
 
+#if defined(MBEDTLS_SSL_CLI_C) && defined(MBEDTLS_SSL_SRV_C) &&     \
+    defined(MBEDTLS_CERTS_C) && defined(MBEDTLS_X509_CRT_PARSE_C) && \
+    defined(MBEDTLS_PK_PARSE_C)
+#define BENCHMARK_TLS
+#include "mbedtls/ssl.h"
+#include "mbedtls/certs.h"
+#if defined(MBEDTLS_SSL_CACHE_C)
+#include "mbedtls/ssl_cache.h"
+#endif
+#if defined(MBEDTLS_SSL_TICKET_C)
+#include "mbedtls/ssl_ticket.h"
+#endif
+#endif
+
+#if defined(MBEDTLS_X509_CRT_PARSE_C) && defined(MBEDTLS_PEM_PARSE_C) && \
+    defined(MBEDTLS_CERTS_C)
+#define BENCHMARK_X509
+#include "mbedtls/x509_crt.h"
+#include "mbedtls/pem.h"
+#include "mbedtls/certs.h"
+#endif
+
 #if defined(MBEDTLS_MEMORY_BUFFER_ALLOC_C)
 #include "mbedtls/memory_buffer_alloc.h"
 #endif
@@ -104,7 +126,7 @@ int main( void )
     "aes_cbc, aes_gcm, aes_ccm, aes_ctx, chachapoly,\n"                 \
     "aes_cmac, des3_cmac, poly1305\n"                                   \
     "havege, ctr_drbg, hmac_drbg\n"                                     \
-    "rsa, dhm, ecdsa, ecdh.\n"
+    "rsa, dhm, ecdsa, ecdh, tls, x509.\n"
 
 #if defined(MBEDTLS_ERROR_C)
 #define PRINT_ERROR                                                     \
@@ -257,6 +279,377 @@ void ecp_clear_precomputed( mbedtls_ecp_group *grp )
 #define ecp_clear_precomputed( g )
 #endif
 
+#if defined(BENCHMARK_TLS)
+/*
+ * In-memory transport between a client and a server context: one pipe
+ * per direction, large enough to hold a full handshake flight.
+ */
+#define TLS_PIPE_SIZE   ( 4 * MBEDTLS_SSL_MAX_CONTENT_LEN )
+
+typedef struct
+{
+    unsigned char buf[TLS_PIPE_SIZE];
+    size_t start, end;
+} tls_pipe;
+
+typedef struct
+{
+    tls_pipe *in;
+    tls_pipe *out;
+} tls_bio;
+
+static int tls_pipe_send( void *ctx, const unsigned char *data, size_t len )
+{
+    tls_pipe *out = ( (tls_bio *) ctx )->out;
+
+    if( out->start != 0 && TLS_PIPE_SIZE - out->end < len )
+    {
+        memmove( out->buf, out->buf + out->start, out->end - out->start );
+        out->end -= out->start;
+        out->start = 0;
+    }
+
+    if( len > TLS_PIPE_SIZE - out->end )
+        len = TLS_PIPE_SIZE - out->end;
+    if( len == 0 )
+        return( MBEDTLS_ERR_SSL_WANT_WRITE );
+
+    memcpy( out->buf + out->end, data, len );
+    out->end += len;
+
+    return( (int) len );
+}
+
+static int tls_pipe_recv( void *ctx, unsigned char *data, size_t len )
+{
+    tls_pipe *in = ( (tls_bio *) ctx )->in;
+
+    if( in->start == in->end )
+    {
+        in->start = in->end = 0;
+        return( MBEDTLS_ERR_SSL_WANT_READ );
+    }
+
+    if( len > in->end - in->start )
+        len = in->end - in->start;
+
+    memcpy( data, in->buf + in->start, len );
+    in->start += len;
+
+    return( (int) len );
+}
+
+typedef struct
+{
+    mbedtls_x509_crt cacert;
+    mbedtls_x509_crt srvcert;
+    mbedtls_pk_context pkey;
+    mbedtls_ssl_config cli_conf;
+    mbedtls_ssl_config srv_conf;
+    mbedtls_ssl_context cli;
+    mbedtls_ssl_context srv;
+    mbedtls_ssl_session session;
+#if defined(MBEDTLS_SSL_CACHE_C)
+    mbedtls_ssl_cache_context cache;
+#endif
+#if defined(MBEDTLS_SSL_TICKET_C)
+    mbedtls_ssl_ticket_context ticket;
+#endif
+    tls_pipe to_srv, to_cli;
+    tls_bio cli_bio, srv_bio;
+} tls_bench;
+
+static tls_bench tls;
+static unsigned char tls_data[MBEDTLS_SSL_MAX_CONTENT_LEN];
+
+/*
+ * Run the handshake of both sides to completion
+ */
+static int tls_handshake_pair( void )
+{
+    int ret, cli_done = 0, srv_done = 0, rounds;
+
+    for( rounds = 0; rounds < 1000 && ! ( cli_done && srv_done ); rounds++ )
+    {
+        if( ! cli_done )
+        {
+            ret = mbedtls_ssl_handshake( &tls.cli );
+            if( ret == 0 )
+                cli_done = 1;
+            else if( ret != MBEDTLS_ERR_SSL_WANT_READ &&
+                     ret != MBEDTLS_ERR_SSL_WANT_WRITE )
+                return( ret );
+        }
+
+        if( ! srv_done )
+        {
+            ret = mbedtls_ssl_handshake( &tls.srv );
+            if( ret == 0 )
+                srv_done = 1;
+            else if( ret != MBEDTLS_ERR_SSL_WANT_READ &&
+                     ret != MBEDTLS_ERR_SSL_WANT_WRITE )
+                return( ret );
+        }
+    }
+
+    return( cli_done && srv_done ? 0 : MBEDTLS_ERR_SSL_INTERNAL_ERROR );
+}
+
+/*
+ * Start a new connection on both sides, resuming the saved session if asked
+ */
+static int tls_new_connection( int resume )
+{
+    int ret;
+
+    tls.to_srv.start = tls.to_srv.end = 0;
+    tls.to_cli.start = tls.to_cli.end = 0;
+
+    if( ( ret = mbedtls_ssl_session_reset( &tls.cli ) ) != 0 ||
+        ( ret = mbedtls_ssl_session_reset( &tls.srv ) ) != 0 )
+        return( ret );
+
+    if( resume && ( ret = mbedtls_ssl_set_session( &tls.cli,
+                                                   &tls.session ) ) != 0 )
+        return( ret );
+
+    return( tls_handshake_pair() );
+}
+
+/*
+ * Do a full handshake and save the session for later resumption
+ */
+static int tls_save_session( void )
+{
+    int ret;
+
+    if( ( ret = tls_new_connection( 0 ) ) != 0 )
+        return( ret );
+
+    mbedtls_ssl_session_free( &tls.session );
+    mbedtls_ssl_session_init( &tls.session );
+
+    return( mbedtls_ssl_get_session( &tls.cli, &tls.session ) );
+}
+
+/*
+ * Send len bytes of application data from the client to the server
+ */
+static int tls_transfer( size_t len )
+{
+    int ret;
+    size_t written = 0, received = 0;
+
+    while( received < len )
+    {
+        if( written < len )
+        {
+            ret = mbedtls_ssl_write( &tls.cli, tls_data + written,
+                                     len - written );
+            if( ret > 0 )
+                written += ret;
+            else if( ret != MBEDTLS_ERR_SSL_WANT_WRITE )
+                return( ret );
+        }
+
+        ret = mbedtls_ssl_read( &tls.srv, tls_data, len - received );
+        if( ret > 0 )
+            received += ret;
+        else if( ret != MBEDTLS_ERR_SSL_WANT_READ )
+            return( ret == 0 ? MBEDTLS_ERR_SSL_CONN_EOF : ret );
+    }
+
+    return( 0 );
+}
+
+static int tls_setup( void )
+{
+    int ret;
+
+    mbedtls_x509_crt_init( &tls.cacert );
+    mbedtls_x509_crt_init( &tls.srvcert );
+    mbedtls_pk_init( &tls.pkey );
+    mbedtls_ssl_config_init( &tls.cli_conf );
+    mbedtls_ssl_config_init( &tls.srv_conf );
+    mbedtls_ssl_init( &tls.cli );
+    mbedtls_ssl_init( &tls.srv );
+    mbedtls_ssl_session_init( &tls.session );
+#if defined(MBEDTLS_SSL_CACHE_C)
+    mbedtls_ssl_cache_init( &tls.cache );
+#endif
+#if defined(MBEDTLS_SSL_TICKET_C)
+    mbedtls_ssl_ticket_init( &tls.ticket );
+#endif
+
+    if( ( ret = mbedtls_x509_crt_parse( &tls.cacert,
+                    (const unsigned char *) mbedtls_test_cas_pem,
+                    mbedtls_test_cas_pem_len ) ) != 0 ||
+        ( ret = mbedtls_x509_crt_parse( &tls.srvcert,
+                    (const unsigned char *) mbedtls_test_srv_crt,
+                    mbedtls_test_srv_crt_len ) ) != 0 ||
+        ( ret = mbedtls_pk_parse_key( &tls.pkey,
+                    (const unsigned char *) mbedtls_test_srv_key,
+                    mbedtls_test_srv_key_len, NULL, 0 ) ) != 0 )
+        return( ret );
+
+    if( ( ret = mbedtls_ssl_config_defaults( &tls.cli_conf,
+                    MBEDTLS_SSL_IS_CLIENT, MBEDTLS_SSL_TRANSPORT_STREAM,
+                    MBEDTLS_SSL_PRESET_DEFAULT ) ) != 0 ||
+        ( ret = mbedtls_ssl_config_defaults( &tls.srv_conf,
+                    MBEDTLS_SSL_IS_SERVER, MBEDTLS_SSL_TRANSPORT_STREAM,
+                    MBEDTLS_SSL_PRESET_DEFAULT ) ) != 0 )
+        return( ret );
+
+    mbedtls_ssl_conf_rng( &tls.cli_conf, myrand, NULL );
+    mbedtls_ssl_conf_rng( &tls.srv_conf, myrand, NULL );
+
+    /* The test certificates may have expired: verify, but don't fail */
+    mbedtls_ssl_conf_authmode( &tls.cli_conf, MBEDTLS_SSL_VERIFY_OPTIONAL );
+    mbedtls_ssl_conf_ca_chain( &tls.cli_conf, &tls.cacert, NULL );
+
+    if( ( ret = mbedtls_ssl_conf_own_cert( &tls.srv_conf, &tls.srvcert,
+                                           &tls.pkey ) ) != 0 )
+        return( ret );
+
+#if defined(MBEDTLS_SSL_CACHE_C)
+    mbedtls_ssl_conf_session_cache( &tls.srv_conf, &tls.cache,
+                                    mbedtls_ssl_cache_get,
+                                    mbedtls_ssl_cache_set );
+#endif
+
+#if defined(MBEDTLS_SSL_TICKET_C) && defined(MBEDTLS_GCM_C) && \
+    defined(MBEDTLS_SSL_SESSION_TICKETS)
+    if( ( ret = mbedtls_ssl_ticket_setup( &tls.ticket, myrand, NULL,
+                    MBEDTLS_CIPHER_AES_256_GCM, 86400 ) ) != 0 )
+        return( ret );
+
+    mbedtls_ssl_conf_session_tickets_cb( &tls.srv_conf,
+                                         mbedtls_ssl_ticket_write,
+                                         mbedtls_ssl_ticket_parse,
+                                         &tls.ticket );
+#endif
+
+    if( ( ret = mbedtls_ssl_setup( &tls.cli, &tls.cli_conf ) ) != 0 ||
+        ( ret = mbedtls_ssl_setup( &tls.srv, &tls.srv_conf ) ) != 0 )
+        return( ret );
+
+    if( ( ret = mbedtls_ssl_set_hostname( &tls.cli, "localhost" ) ) != 0 )
+        return( ret );
+
+    tls.cli_bio.in  = &tls.to_cli;
+    tls.cli_bio.out = &tls.to_srv;
+    tls.srv_bio.in  = &tls.to_srv;
+    tls.srv_bio.out = &tls.to_cli;
+    mbedtls_ssl_set_bio( &tls.cli, &tls.cli_bio,
+                         tls_pipe_send, tls_pipe_recv, NULL );
+    mbedtls_ssl_set_bio( &tls.srv, &tls.srv_bio,
+                         tls_pipe_send, tls_pipe_recv, NULL );
+
+    return( 0 );
+}
+
+static void tls_free( void )
+{
+    mbedtls_ssl_free( &tls.cli );
+    mbedtls_ssl_free( &tls.srv );
+    mbedtls_ssl_config_free( &tls.cli_conf );
+    mbedtls_ssl_config_free( &tls.srv_conf );
+    mbedtls_ssl_session_free( &tls.session );
+    mbedtls_x509_crt_free( &tls.cacert );
+    mbedtls_x509_crt_free( &tls.srvcert );
+    mbedtls_pk_free( &tls.pkey );
+#if defined(MBEDTLS_SSL_CACHE_C)
+    mbedtls_ssl_cache_free( &tls.cache );
+#endif
+#if defined(MBEDTLS_SSL_TICKET_C)
+    mbedtls_ssl_ticket_free( &tls.ticket );
+#endif
+}
+
+/*
+ * Ciphersuites for the record layer throughput measurements. Those that
+ * are not enabled, or don't match the test server key, are skipped.
+ */
+static const int tls_bench_ciphersuites[] =
+{
+    MBEDTLS_TLS_ECDHE_RSA_WITH_AES_128_GCM_SHA256,
+    MBEDTLS_TLS_ECDHE_RSA_WITH_AES_256_GCM_SHA384,
+    MBEDTLS_TLS_ECDHE_RSA_WITH_CHACHA20_POLY1305_SHA256,
+    MBEDTLS_TLS_ECDHE_RSA_WITH_AES_128_CBC_SHA256,
+    MBEDTLS_TLS_ECDHE_ECDSA_WITH_AES_128_GCM_SHA256,
+    MBEDTLS_TLS_ECDHE_ECDSA_WITH_AES_256_GCM_SHA384,
+    MBEDTLS_TLS_ECDHE_ECDSA_WITH_CHACHA20_POLY1305_SHA256,
+    MBEDTLS_TLS_ECDHE_ECDSA_WITH_AES_128_CBC_SHA256,
+    MBEDTLS_TLS_ECDHE_ECDSA_WITH_AES_128_CCM,
+    0
+};
+
+static const size_t tls_bench_record_sizes[] = { 64, 1024, 16384, 0 };
+
+#if defined(MBEDTLS_PLATFORM_MEMORY) &&          \
+    !defined(MBEDTLS_PLATFORM_CALLOC_MACRO) &&   \
+    !defined(MBEDTLS_PLATFORM_FREE_MACRO) &&     \
+    !defined(MBEDTLS_MEMORY_BUFFER_ALLOC_C)
+#define BENCHMARK_COUNT_ALLOC
+/*
+ * Count the allocations made by the library
+ */
+static size_t alloc_count, alloc_bytes;
+
+static void *counting_calloc( size_t n, size_t size )
+{
+    alloc_count++;
+    alloc_bytes += n * size;
+    return( calloc( n, size ) );
+}
+#endif /* MBEDTLS_PLATFORM_MEMORY && ... */
+#endif /* BENCHMARK_TLS */
+
+#if defined(BENCHMARK_X509)
+/*
+ * Decode every PEM block of the test CA bundle, with the generic PEM reader
+ * or with the one used by the X.509 parsers
+ */
+static int x509_bench_pem( int x509 )
+{
+    int ret = 0;
+    size_t use_len = 0;
+    const unsigned char *p = (const unsigned char *) mbedtls_test_cas_pem;
+    mbedtls_pem_context pem;
+
+    while( ret == 0 )
+    {
+        mbedtls_pem_init( &pem );
+        if( x509 )
+            ret = mbedtls_x509_pem_read( &pem, "-----BEGIN CERTIFICATE-----",
+                                         "-----END CERTIFICATE-----",
+                                         p, &use_len );
+        else
+            ret = mbedtls_pem_read_buffer( &pem, "-----BEGIN CERTIFICATE-----",
+                                           "-----END CERTIFICATE-----",
+                                           p, NULL, 0, &use_len );
+        mbedtls_pem_free( &pem );
+        p += use_len;
+    }
+
+    return( ret == MBEDTLS_ERR_PEM_NO_HEADER_FOOTER_PRESENT ? 0 : ret );
+}
+
+static int x509_bench_parse( void )
+{
+    int ret;
+    mbedtls_x509_crt crt;
+
+    mbedtls_x509_crt_init( &crt );
+    ret = mbedtls_x509_crt_parse( &crt,
+                                  (const unsigned char *) mbedtls_test_cas_pem,
+                                  mbedtls_test_cas_pem_len );
+    mbedtls_x509_crt_free( &crt );
+
+    return( ret );
+}
+#endif /* BENCHMARK_X509 */
+
 unsigned char buf[BUFSIZE];
 
 typedef struct {
@@ -267,7 +660,7 @@ typedef struct {
          aria, camellia, blowfish, chacha20,
          poly1305,
          havege, ctr_drbg, hmac_drbg,
-         rsa, dhm, ecdsa, ecdh;
+         rsa, dhm, ecdsa, ecdh, tls, x509;
 } todo_list;
 
 
@@ -347,6 +740,10 @@ int main( int argc, char *argv[] )
                 todo.ecdsa = 1;
             else if( strcmp( argv[i], "ecdh" ) == 0 )
                 todo.ecdh = 1;
+            else if( strcmp( argv[i], "tls" ) == 0 )
+                todo.tls = 1;
+            else if( strcmp( argv[i], "x509" ) == 0 )
+                todo.x509 = 1;
             else
             {
                 mbedtls_printf( "Unrecognized option: %s\n", argv[i] );
@@ -1042,6 +1439,155 @@ int main( int argc, char *argv[] )
     }
 #endif
 
+#if defined(BENCHMARK_TLS)
+    if( todo.tls )
+    {
+        const int *id;
+        const size_t *size;
+        const mbedtls_ssl_ciphersuite_t *info;
+        int suite[2] = { 0, 0 };
+#if defined(MBEDTLS_SSL_CACHE_C) ||                                 \
+    ( defined(MBEDTLS_SSL_TICKET_C) && defined(MBEDTLS_GCM_C) &&    \
+      defined(MBEDTLS_SSL_SESSION_TICKETS) )
+        int saved;
+#endif
+
+        /* TIME_PUBLIC() declares its own ret, so the calls checked outside
+         * of it keep theirs in inner blocks */
+        {
+            int ret;
+
+            if( ( ret = tls_setup() ) != 0 )
+            {
+                mbedtls_printf( HEADER_FORMAT, "TLS setup" );
+                PRINT_ERROR;
+                tls_free();
+                mbedtls_exit( 1 );
+            }
+
+#if defined(BENCHMARK_COUNT_ALLOC)
+            mbedtls_platform_set_calloc_free( counting_calloc, free );
+            alloc_count = alloc_bytes = 0;
+            ret = tls_new_connection( 0 );
+            mbedtls_printf( HEADER_FORMAT, "TLS full handshake" );
+            if( ret != 0 )
+            {
+                PRINT_ERROR;
+            }
+            else
+            {
+                mbedtls_printf( "%6u allocs, %9u bytes\n",
+                                (unsigned) alloc_count, (unsigned) alloc_bytes );
+            }
+            mbedtls_platform_set_calloc_free( calloc, free );
+#endif /* BENCHMARK_COUNT_ALLOC */
+        }
+
+        TIME_PUBLIC( "TLS full handshake", "handshake",
+                     ret = tls_new_connection( 0 ) );
+
+#if defined(MBEDTLS_SSL_CACHE_C)
+#if defined(MBEDTLS_SSL_SESSION_TICKETS)
+        mbedtls_ssl_conf_session_tickets( &tls.cli_conf,
+                                          MBEDTLS_SSL_SESSION_TICKETS_DISABLED );
+#endif
+        {
+            int ret;
+
+            if( ( ret = tls_save_session() ) != 0 )
+            {
+                mbedtls_printf( HEADER_FORMAT, "TLS resume (cache)" );
+                PRINT_ERROR;
+            }
+            saved = ( ret == 0 );
+        }
+        if( saved )
+            TIME_PUBLIC( "TLS resume (cache)", "handshake",
+                         ret = tls_new_connection( 1 ) );
+#endif
+
+#if defined(MBEDTLS_SSL_TICKET_C) && defined(MBEDTLS_GCM_C) && \
+    defined(MBEDTLS_SSL_SESSION_TICKETS)
+        mbedtls_ssl_conf_session_tickets( &tls.cli_conf,
+                                          MBEDTLS_SSL_SESSION_TICKETS_ENABLED );
+        {
+            int ret;
+
+            if( ( ret = tls_save_session() ) != 0 )
+            {
+                mbedtls_printf( HEADER_FORMAT, "TLS resume (ticket)" );
+                PRINT_ERROR;
+            }
+            saved = ( ret == 0 );
+        }
+        if( saved )
+            TIME_PUBLIC( "TLS resume (ticket)", "handshake",
+                         ret = tls_new_connection( 1 ) );
+#endif
+
+        memset( tls_data, 0xAA, sizeof( tls_data ) );
+
+        for( id = tls_bench_ciphersuites; *id != 0; id++ )
+        {
+            if( ( info = mbedtls_ssl_ciphersuite_from_id( *id ) ) == NULL ||
+                ! mbedtls_pk_can_do( &tls.pkey,
+                        mbedtls_ssl_get_ciphersuite_sig_pk_alg( info ) ) )
+                continue;
+
+            suite[0] = *id;
+            mbedtls_ssl_conf_ciphersuites( &tls.cli_conf, suite );
+            mbedtls_printf( "  %s\n", info->name );
+
+            for( size = tls_bench_record_sizes; *size != 0; size++ )
+            {
+                int ret;
+
+                if( *size > MBEDTLS_SSL_OUT_CONTENT_LEN ||
+                    *size > MBEDTLS_SSL_IN_CONTENT_LEN )
+                    continue;
+
+                mbedtls_snprintf( title, sizeof( title ),
+                                  "  %5u-byte records", (unsigned) *size );
+                mbedtls_printf( HEADER_FORMAT, title );
+                fflush( stdout );
+
+                if( ( ret = tls_new_connection( 0 ) ) == 0 )
+                {
+                    unsigned long ii;
+
+                    mbedtls_set_alarm( 1 );
+                    for( ii = 0; ret == 0 && ! mbedtls_timing_alarmed; ii++ )
+                        ret = tls_transfer( *size );
+
+                    if( ret == 0 )
+                        mbedtls_printf( "%9lu KiB/s\n", ii * *size / 1024 );
+                }
+
+                if( ret != 0 )
+                {
+                    PRINT_ERROR;
+                }
+            }
+        }
+
+        mbedtls_ssl_conf_ciphersuites( &tls.cli_conf,
+                                       mbedtls_ssl_list_ciphersuites() );
+        tls_free();
+    }
+#endif /* BENCHMARK_TLS */
+
+#if defined(BENCHMARK_X509)
+    if( todo.x509 )
+    {
+        TIME_PUBLIC( "PEM decode (generic)", "bundle",
+                     ret = x509_bench_pem( 0 ) );
+        TIME_PUBLIC( "PEM decode (X.509)", "bundle",
+                     ret = x509_bench_pem( 1 ) );
+        TIME_PUBLIC( "X.509 parse CA bundle", "bundle",
+                     ret = x509_bench_parse() );
+    }
+#endif /* BENCHMARK_X509 */
+
     mbedtls_printf( "\n" );
 
 #if defined(MBEDTLS_MEMORY_BUFFER_ALLOC_C)
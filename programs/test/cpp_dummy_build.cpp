@@ -92,7 +92,10 @@
 #include "mbedtls/ssl_cache.h"
 #include "mbedtls/ssl_ciphersuites.h"
 #include "mbedtls/ssl_cookie.h"
+#include "mbedtls/ssl_credentials.h"
 #include "mbedtls/ssl_internal.h"
+#include "mbedtls/ssl_sni_cache.h"
+#include "mbedtls/ssl_sni_registry.h"
 #include "mbedtls/ssl_ticket.h"
 #include "mbedtls/threading.h"
 #include "mbedtls/timing.h"
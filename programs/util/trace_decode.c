@@ -0,0 +1,443 @@
+/*
+ *  Decode binary debug traces
+ *
+ *  Copyright (C) 2006-2019, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *  This file is part of mbed TLS (https://tls.mbed.org)
+ */
+
+#if !defined(MBEDTLS_CONFIG_FILE)
+#include "mbedtls/config.h"
+#else
+#include MBEDTLS_CONFIG_FILE
+#endif
+
+#if defined(MBEDTLS_PLATFORM_C)
+#include "mbedtls/platform.h"
+#else
+#include <stdio.h>
+#include <stdlib.h>
+#define mbedtls_free            free
+#define mbedtls_calloc          calloc
+#define mbedtls_printf          printf
+#define mbedtls_snprintf        snprintf
+#define mbedtls_exit            exit
+#define MBEDTLS_EXIT_SUCCESS    EXIT_SUCCESS
+#define MBEDTLS_EXIT_FAILURE    EXIT_FAILURE
+#endif /* MBEDTLS_PLATFORM_C */
+
+#if defined(MBEDTLS_FS_IO)
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#endif
+
+/* Record types, see mbedtls/debug.h */
+#define TRACE_MSG       1
+#define TRACE_RET       2
+#define TRACE_BUF       3
+
+#define LINE_SIZE       1024
+#define NAME_SIZE       256
+#define TEXT_SIZE       512
+
+#define USAGE \
+    "\n usage: trace_decode <file>\n"                                       \
+    "\n Print the records of a binary debug trace written by\n"             \
+    " mbedtls_debug_trace_write_file() in the text debug format.\n"         \
+    "\n"
+
+#if !defined(MBEDTLS_FS_IO)
+int main( void )
+{
+    mbedtls_printf("MBEDTLS_FS_IO not defined.\n");
+    return( 0 );
+}
+#else
+
+static uint64_t get_u64( const unsigned char *p )
+{
+    uint64_t v = 0;
+    int i;
+
+    for( i = 0; i < 8; i++ )
+        v = ( v << 8 ) | p[i];
+
+    return( v );
+}
+
+static uint32_t get_u32( const unsigned char *p )
+{
+    return( ( (uint32_t) p[0] << 24 ) | ( (uint32_t) p[1] << 16 ) |
+            ( (uint32_t) p[2] <<  8 ) | ( (uint32_t) p[3]       ) );
+}
+
+/*
+ * Append to a line, truncating if needed
+ */
+static void line_append( char *line, size_t *len, const char *str, size_t n )
+{
+    if( n > LINE_SIZE - 1 - *len )
+        n = LINE_SIZE - 1 - *len;
+
+    memcpy( line + *len, str, n );
+    *len += n;
+    line[*len] = '\0';
+}
+
+/*
+ * Format a message from its format string and recorded arguments, as
+ * mbedtls_debug_print_msg() would have done.
+ */
+static void format_msg( char *line, size_t *len, const char *fmt,
+                        const unsigned char *args, size_t args_len )
+{
+    const unsigned char *end = args + args_len;
+    const char *f = fmt, *start;
+    char spec[32], tmp[LINE_SIZE], str[256], width[16];
+    size_t n, spec_len;
+    uint64_t v;
+    double d;
+
+    while( *f != '\0' )
+    {
+        if( *f != '%' )
+        {
+            line_append( line, len, f++, 1 );
+            continue;
+        }
+
+        if( f[1] == '%' )
+        {
+            line_append( line, len, "%", 1 );
+            f += 2;
+            continue;
+        }
+
+        /* Rebuild the conversion, widening integers to long long and
+         * substituting the recorded value of '*'. The last 4 bytes of spec
+         * are kept for the length modifier, the conversion and the NUL;
+         * conversions that do not fit are printed verbatim. */
+        start = f;
+        spec[0] = '%';
+        spec_len = 1;
+        for( f++; *f != '\0' && strchr( "-+ #0123456789.*", *f ) != NULL; f++ )
+        {
+            if( *f == '*' )
+            {
+                if( end - args < 9 || args[0] != 'i' )
+                    goto verbatim;
+                n = mbedtls_snprintf( width, sizeof( width ), "%d",
+                                      (int) get_u64( args + 1 ) );
+                if( n >= sizeof( width ) || n > sizeof( spec ) - 4 - spec_len )
+                    goto verbatim;
+                memcpy( spec + spec_len, width, n );
+                spec_len += n;
+                args += 9;
+            }
+            else
+            {
+                if( spec_len >= sizeof( spec ) - 4 )
+                    goto verbatim;
+                spec[spec_len++] = *f;
+            }
+        }
+
+        while( *f == 'h' || *f == 'l' || *f == 'z' )
+            f++;
+
+        if( *f == '\0' || end - args < 2 )
+            goto verbatim;
+
+        if( args[0] == 's' )
+        {
+            n = args[1];
+            if( (size_t)( end - args ) < 2 + n || *f != 's' )
+                goto verbatim;
+            memcpy( str, args + 2, n );
+            str[n] = '\0';
+            args += 2 + n;
+
+            spec[spec_len++] = 's';
+            spec[spec_len] = '\0';
+            n = mbedtls_snprintf( tmp, sizeof( tmp ), spec, str );
+        }
+        else
+        {
+            if( end - args < 9 )
+                goto verbatim;
+            v = get_u64( args + 1 );
+
+            if( args[0] == 'f' )
+            {
+                memcpy( &d, &v, sizeof( d ) );
+                spec[spec_len++] = *f;
+                spec[spec_len] = '\0';
+                n = mbedtls_snprintf( tmp, sizeof( tmp ), spec, d );
+            }
+            else if( args[0] == 'p' )
+            {
+                n = mbedtls_snprintf( tmp, sizeof( tmp ), "%p",
+                                      (void *)(uintptr_t) v );
+            }
+            else if( *f == 'c' )
+            {
+                spec[spec_len++] = 'c';
+                spec[spec_len] = '\0';
+                n = mbedtls_snprintf( tmp, sizeof( tmp ), spec, (int) v );
+            }
+            else
+            {
+                spec[spec_len++] = 'l';
+                spec[spec_len++] = 'l';
+                spec[spec_len++] = *f;
+                spec[spec_len] = '\0';
+                if( args[0] == 'i' )
+                    n = mbedtls_snprintf( tmp, sizeof( tmp ), spec,
+                                          (long long)(int64_t) v );
+                else
+                    n = mbedtls_snprintf( tmp, sizeof( tmp ), spec,
+                                          (unsigned long long) v );
+            }
+            args += 9;
+        }
+
+        if( n >= sizeof( tmp ) )
+            n = sizeof( tmp ) - 1;
+        line_append( line, len, tmp, n );
+        f++;
+        continue;
+
+verbatim:
+        /* Arguments were not recorded past this point */
+        line_append( line, len, start, strlen( start ) );
+        return;
+    }
+}
+
+static void print_line( const char *prefix, const char *line )
+{
+    mbedtls_printf( "%s%s", prefix, line );
+    if( line[0] == '\0' || line[strlen( line ) - 1] != '\n' )
+        mbedtls_printf( "\n" );
+}
+
+static void print_buf( const char *prefix, const char *text,
+                       const unsigned char *payload, size_t payload_len )
+{
+    char line[LINE_SIZE], txt[17];
+    size_t i, len, idx = 0;
+
+    if( payload_len < 4 )
+        return;
+
+    len = get_u32( payload );
+    payload += 4;
+    payload_len -= 4;
+
+    mbedtls_snprintf( line, sizeof( line ), "dumping '%s' (%u bytes)\n",
+                      text, (unsigned int) len );
+    print_line( prefix, line );
+
+    memset( txt, 0, sizeof( txt ) );
+    for( i = 0; i < payload_len; i++ )
+    {
+        if( i % 16 == 0 )
+        {
+            if( i > 0 )
+            {
+                mbedtls_snprintf( line + idx, sizeof( line ) - idx, "  %s\n", txt );
+                print_line( prefix, line );
+
+                idx = 0;
+                memset( txt, 0, sizeof( txt ) );
+            }
+
+            idx += mbedtls_snprintf( line + idx, sizeof( line ) - idx, "%04x: ",
+                                     (unsigned int) i );
+        }
+
+        idx += mbedtls_snprintf( line + idx, sizeof( line ) - idx, " %02x",
+                                 (unsigned int) payload[i] );
+        txt[i % 16] = ( payload[i] > 31 && payload[i] < 127 ) ? payload[i] : '.' ;
+    }
+
+    if( payload_len > 0 )
+    {
+        for( /* i = i */; i % 16 != 0; i++ )
+            idx += mbedtls_snprintf( line + idx, sizeof( line ) - idx, "   " );
+
+        mbedtls_snprintf( line + idx, sizeof( line ) - idx, "  %s\n", txt );
+        print_line( prefix, line );
+    }
+}
+
+/*
+ * Decode one record, return its length or 0 if it is malformed
+ */
+static size_t decode_record( const unsigned char *p, size_t avail )
+{
+    const unsigned char *start = p, *end = p + avail;
+    const unsigned char *file, *text, *payload;
+    size_t file_len, text_len, payload_len, len = 0;
+    int type, level;
+    uint32_t line_nb;
+    uint64_t ssl;
+    char prefix[LINE_SIZE], line[LINE_SIZE];
+    char file_str[NAME_SIZE], text_str[TEXT_SIZE];
+    const char *basename;
+
+    if( end - p < 16 )
+        return( 0 );
+
+    type = p[0];
+    level = p[1];
+    line_nb = get_u32( p + 2 );
+    ssl = get_u64( p + 6 );
+    p += 14;
+
+    /* Each length is checked against the rest of the record, including
+     * the next length field, before moving past it */
+    file_len = ( p[0] << 8 ) | p[1];
+    if( (size_t)( end - p ) < 2 + file_len + 2 )
+        return( 0 );
+    file = p + 2;
+    p += 2 + file_len;
+
+    text_len = ( p[0] << 8 ) | p[1];
+    if( (size_t)( end - p ) < 2 + text_len + 4 )
+        return( 0 );
+    text = p + 2;
+    p += 2 + text_len;
+
+    payload_len = get_u32( p );
+    if( (size_t)( end - p ) - 4 < payload_len )
+        return( 0 );
+    payload = p + 4;
+    p += 4 + payload_len;
+
+    /* Same prefix as the debug callback of the example programs */
+    if( file_len >= sizeof( file_str ) )
+        file_len = sizeof( file_str ) - 1;
+    memcpy( file_str, file, file_len );
+    file_str[file_len] = '\0';
+    basename = strrchr( file_str, '/' );
+    basename = basename != NULL ? basename + 1 : file_str;
+    mbedtls_snprintf( prefix, sizeof( prefix ), "%s:%04u: |%d| 0x%llx: ",
+                      basename, (unsigned) line_nb, level,
+                      (unsigned long long) ssl );
+
+    if( text_len >= sizeof( text_str ) )
+        text_len = sizeof( text_str ) - 1;
+    memcpy( text_str, text, text_len );
+    text_str[text_len] = '\0';
+
+    switch( type )
+    {
+        case TRACE_MSG:
+            line[0] = '\0';
+            format_msg( line, &len, text_str, payload, payload_len );
+            print_line( prefix, line );
+            break;
+
+        case TRACE_RET:
+            if( payload_len < 4 )
+                return( 0 );
+            mbedtls_snprintf( line, sizeof( line ),
+                              "%s() returned %d (-0x%04x)\n", text_str,
+                              (int) get_u32( payload ),
+                              (unsigned) -(int) get_u32( payload ) );
+            print_line( prefix, line );
+            break;
+
+        case TRACE_BUF:
+            print_buf( prefix, text_str, payload, payload_len );
+            break;
+
+        default:
+            mbedtls_printf( "%sunknown record type %d\n", prefix, type );
+            break;
+    }
+
+    return( p - start );
+}
+
+int main( int argc, char *argv[] )
+{
+    int exit_code = MBEDTLS_EXIT_FAILURE;
+    FILE *f = NULL;
+    unsigned char *buf = NULL;
+    long size;
+    size_t off, n;
+
+    if( argc != 2 )
+    {
+        mbedtls_printf( USAGE );
+        goto exit;
+    }
+
+    if( ( f = fopen( argv[1], "rb" ) ) == NULL ||
+        fseek( f, 0, SEEK_END ) != 0 ||
+        ( size = ftell( f ) ) < 0 ||
+        fseek( f, 0, SEEK_SET ) != 0 )
+    {
+        mbedtls_printf( "  ! Could not read %s\n", argv[1] );
+        goto exit;
+    }
+
+    if( ( buf = mbedtls_calloc( 1, size + 1 ) ) == NULL ||
+        fread( buf, 1, size, f ) != (size_t) size )
+    {
+        mbedtls_printf( "  ! Could not read %s\n", argv[1] );
+        goto exit;
+    }
+
+    if( size < 12 || memcmp( buf, "MBTR", 4 ) != 0 || get_u32( buf + 4 ) != 1 )
+    {
+        mbedtls_printf( "  ! %s is not a binary debug trace\n", argv[1] );
+        goto exit;
+    }
+
+    if( get_u32( buf + 8 ) != 0 )
+        mbedtls_printf( "  . %u older records were lost\n",
+                        (unsigned) get_u32( buf + 8 ) );
+
+    for( off = 12; off < (size_t) size; off += n )
+    {
+        if( ( n = decode_record( buf + off, size - off ) ) == 0 )
+        {
+            mbedtls_printf( "  ! Malformed record at offset %lu\n",
+                            (unsigned long) off );
+            goto exit;
+        }
+    }
+
+    exit_code = MBEDTLS_EXIT_SUCCESS;
+
+exit:
+    if( f != NULL )
+        fclose( f );
+    mbedtls_free( buf );
+
+#if defined(_WIN32)
+    mbedtls_printf( "  + Press Enter to exit this program.\n" );
+    fflush( stdout ); getchar();
+#endif
+
+    return( exit_code );
+}
+#endif /* MBEDTLS_FS_IO */
@@ -120,6 +120,8 @@ MBEDTLS_DEPRECATED_WARNING
 MBEDTLS_HAVEGE_C
 MBEDTLS_THREADING_C
 MBEDTLS_THREADING_PTHREAD
+MBEDTLS_X509_CRT_PARSE_PATH_PARALLEL
+MBEDTLS_SSL_ASYNC_ENGINE_C
 MBEDTLS_MEMORY_BACKTRACE
 MBEDTLS_MEMORY_BUFFER_ALLOC_C
 MBEDTLS_PLATFORM_TIME_ALT
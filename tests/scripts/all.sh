@@ -769,6 +769,16 @@ component_test_small_mbedtls_ssl_dtls_max_buffering () {
     if_build_succeeded tests/ssl-opt.sh -f "DTLS reordering: Buffer encrypted Finished message, drop for fragmented NewSessionTicket"
 }
 
+component_test_large_ssl_dtls_replay_window () {
+    msg "build: large MBEDTLS_SSL_DTLS_REPLAY_WINDOW"
+    scripts/config.pl set MBEDTLS_SSL_DTLS_REPLAY_WINDOW 4096
+    CC=gcc cmake -D CMAKE_BUILD_TYPE:String=Asan .
+    make
+
+    msg "test: large MBEDTLS_SSL_DTLS_REPLAY_WINDOW - test_suite_ssl"
+    if_build_succeeded tests/test_suite_ssl
+}
+
 component_test_full_cmake_clang () {
     msg "build: cmake, full config, clang" # ~ 50s
     scripts/config.pl full
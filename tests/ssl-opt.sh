@@ -2952,6 +2952,20 @@ run_test    "Renegotiation: client-initiated" \
             -s "=> renegotiate" \
             -S "write hello request"
 
+requires_config_enabled MBEDTLS_SSL_RENEGOTIATION
+run_test    "Renegotiation: client-initiated, record stats" \
+            "$P_SRV debug_level=3 exchanges=2 renegotiation=1 auth_mode=optional" \
+            "$P_CLI exchanges=2 renegotiation=1 renegotiate=1 stats=1" \
+            0 \
+            -c "Record stats: .*renegotiations 1" \
+            -s "=> renegotiate"
+
+run_test    "Record stats: not printed by default" \
+            "$P_SRV" \
+            "$P_CLI" \
+            0 \
+            -C "Record stats:"
+
 requires_config_enabled MBEDTLS_SSL_RENEGOTIATION
 run_test    "Renegotiation: server-initiated" \
             "$P_SRV debug_level=3 exchanges=2 renegotiation=1 auth_mode=optional renegotiate=1" \
@@ -3545,6 +3559,30 @@ run_test    "Authentication: client SHA384, server required" \
             -c "Supported Signature Algorithm found: 4," \
             -c "Supported Signature Algorithm found: 5,"
 
+run_test    "Authentication: server none, single handshake digest" \
+            "$P_SRV debug_level=3 auth_mode=none" \
+            "$P_CLI" \
+            0 \
+            -s "use a single handshake digest" \
+            -S "keep all handshake digests"
+
+run_test    "Authentication: server required, all handshake digests" \
+            "$P_SRV debug_level=3 auth_mode=required" \
+            "$P_CLI crt_file=data_files/server6.crt \
+             key_file=data_files/server6.key" \
+            0 \
+            -s "keep all handshake digests" \
+            -S "use a single handshake digest"
+
+requires_config_enabled MBEDTLS_SSL_PROTO_TLS1_1
+run_test    "Authentication: server required (TLS 1.1), single handshake digest" \
+            "$P_SRV debug_level=3 auth_mode=required min_version=tls1_1" \
+            "$P_CLI force_version=tls1_1 crt_file=data_files/server6.crt \
+             key_file=data_files/server6.key" \
+            0 \
+            -s "use a single handshake digest" \
+            -S "keep all handshake digests"
+
 requires_config_enabled MBEDTLS_SSL_PROTO_SSL3
 run_test    "Authentication: client has no cert, server required (SSLv3)" \
             "$P_SRV debug_level=3 min_version=ssl3 auth_mode=required" \
@@ -4218,6 +4256,83 @@ run_test    "SNI: CA override with CRL" \
             -S "! The certificate is not correctly signed by the trusted CA" \
             -s "The certificate has been revoked (is on a CRL)"
 
+requires_config_enabled MBEDTLS_SSL_SNI_REGISTRY_C
+run_test    "SNI: registry, name in another case" \
+            "$P_SRV debug_level=3 \
+             crt_file=data_files/server5.crt key_file=data_files/server5.key \
+             sni=localhost,data_files/server2.crt,data_files/server2.key,-,-,-,polarssl.example,data_files/server1-nospace.crt,data_files/server1.key,-,-,-" \
+            "$P_CLI server_name=PolarSSL.Example" \
+            0 \
+            -s "parse ServerName extension" \
+            -c "issuer name *: C=NL, O=PolarSSL, CN=PolarSSL Test CA" \
+            -c "subject name *: C=NL, O=PolarSSL, CN=polarssl.example"
+
+requires_config_enabled MBEDTLS_SSL_SNI_REGISTRY_C
+run_test    "SNI: registry, wildcard name" \
+            "$P_SRV debug_level=3 \
+             crt_file=data_files/server5.crt key_file=data_files/server5.key \
+             sni=localhost,data_files/server2.crt,data_files/server2.key,-,-,-,*.example,data_files/server1-nospace.crt,data_files/server1.key,-,-,-" \
+            "$P_CLI server_name=polarssl.example" \
+            0 \
+            -s "parse ServerName extension" \
+            -c "issuer name *: C=NL, O=PolarSSL, CN=PolarSSL Test CA" \
+            -c "subject name *: C=NL, O=PolarSSL, CN=polarssl.example"
+
+requires_config_enabled MBEDTLS_SSL_SNI_REGISTRY_C
+run_test    "SNI: registry, exact name before wildcard" \
+            "$P_SRV debug_level=3 \
+             crt_file=data_files/server5.crt key_file=data_files/server5.key \
+             sni=*.example,data_files/server2.crt,data_files/server2.key,-,-,-,polarssl.example,data_files/server1-nospace.crt,data_files/server1.key,-,-,-" \
+            "$P_CLI server_name=polarssl.example" \
+            0 \
+            -s "parse ServerName extension" \
+            -c "subject name *: C=NL, O=PolarSSL, CN=polarssl.example"
+
+requires_config_enabled MBEDTLS_SSL_SNI_REGISTRY_C
+run_test    "SNI: registry, wildcard matches one label only" \
+            "$P_SRV debug_level=3 \
+             crt_file=data_files/server5.crt key_file=data_files/server5.key \
+             sni=localhost,data_files/server2.crt,data_files/server2.key,-,-,-,*.example,data_files/server1-nospace.crt,data_files/server1.key,-,-,-" \
+            "$P_CLI server_name=www.polarssl.example" \
+            1 \
+            -s "parse ServerName extension" \
+            -s "ssl_sni_wrapper() returned" \
+            -s "mbedtls_ssl_handshake returned" \
+            -c "mbedtls_ssl_handshake returned" \
+            -c "SSL - A fatal alert message was received from our peer"
+
+requires_config_enabled MBEDTLS_SSL_SNI_CACHE_C
+run_test    "SNI: cache, chain from directory" \
+            "$P_SRV debug_level=3 sni_dir=data_files/sni \
+             crt_file=data_files/server5.crt key_file=data_files/server5.key" \
+            "$P_CLI server_name=polarssl.example" \
+            0 \
+            -s "parse ServerName extension" \
+            -c "issuer name *: C=NL, O=PolarSSL, CN=PolarSSL Test CA" \
+            -c "subject name *: C=NL, O=PolarSSL, CN=polarssl.example"
+
+requires_config_enabled MBEDTLS_SSL_SNI_CACHE_C
+run_test    "SNI: cache, DER key" \
+            "$P_SRV debug_level=3 sni_dir=data_files/sni \
+             crt_file=data_files/server5.crt key_file=data_files/server5.key" \
+            "$P_CLI server_name=localhost" \
+            0 \
+            -s "parse ServerName extension" \
+            -c "issuer name *: C=NL, O=PolarSSL, CN=PolarSSL Test CA" \
+            -c "subject name *: C=NL, O=PolarSSL, CN=localhost"
+
+requires_config_enabled MBEDTLS_SSL_SNI_CACHE_C
+run_test    "SNI: cache, unknown name" \
+            "$P_SRV debug_level=3 sni_dir=data_files/sni \
+             crt_file=data_files/server5.crt key_file=data_files/server5.key" \
+            "$P_CLI server_name=nonesuch.example" \
+            1 \
+            -s "parse ServerName extension" \
+            -s "ssl_sni_wrapper() returned" \
+            -s "mbedtls_ssl_handshake returned" \
+            -c "mbedtls_ssl_handshake returned" \
+            -c "SSL - A fatal alert message was received from our peer"
+
 # Tests for SNI and DTLS
 
 run_test    "SNI: DTLS, no SNI callback" \
@@ -7036,6 +7151,91 @@ run_test    "SSL async private: renegotiation: server-initiated; decrypt" \
             -s "Async decrypt callback: using key slot " \
             -s "Async resume (slot [0-9]): decrypt done, status=0"
 
+requires_config_enabled MBEDTLS_SSL_ASYNC_ENGINE_C
+run_test    "SSL async engine: sign" \
+            "$P_SRV async_operations=s async_engine=2 debug_level=2" \
+            "$P_CLI" \
+            0 \
+            -s "ssl_resume_server_key_exchange() returned 0" \
+            -S "Async sign callback"
+
+requires_config_enabled MBEDTLS_SSL_ASYNC_ENGINE_C
+run_test    "SSL async engine: decrypt" \
+            "$P_SRV async_operations=d async_engine=2 debug_level=2" \
+            "$P_CLI force_ciphersuite=TLS-RSA-WITH-AES-128-CBC-SHA" \
+            0 \
+            -s "ssl_decrypt_encrypted_pms() returned 0" \
+            -S "Async decrypt callback"
+
+requires_config_enabled MBEDTLS_SSL_ASYNC_ENGINE_C
+run_test    "SSL async engine: sign, batch=4" \
+            "$P_SRV async_operations=s async_engine=2 async_batch=4 debug_level=2" \
+            "$P_CLI" \
+            0 \
+            -s "ssl_resume_server_key_exchange() returned 0" \
+            -S "Async sign callback"
+
+requires_config_enabled MBEDTLS_SSL_ASYNC_ENGINE_C
+requires_config_enabled MBEDTLS_SSL_RENEGOTIATION
+run_test    "SSL async engine: renegotiation: client-initiated; decrypt" \
+            "$P_SRV async_operations=d async_engine=2 debug_level=2 \
+             exchanges=2 renegotiation=1" \
+            "$P_CLI force_ciphersuite=TLS-RSA-WITH-AES-128-CBC-SHA \
+             exchanges=2 renegotiation=1 renegotiate=1" \
+            0 \
+            -s "ssl_decrypt_encrypted_pms() returned 0" \
+            -c "HTTP/1.0 200 OK"
+
+# Tests for asynchronous certificate verification
+
+requires_config_enabled MBEDTLS_SSL_ASYNC_VERIFY
+run_test    "SSL async verify: delay=0" \
+            "$P_SRV" \
+            "$P_CLI async_verify=0 auth_mode=required" \
+            0 \
+            -c "Async verify callback: started, delay=0" \
+            -c "Async verify callback: done, flags=0x00000000" \
+            -C "chain verification in progress"
+
+requires_config_enabled MBEDTLS_SSL_ASYNC_VERIFY
+run_test    "SSL async verify: delay=2" \
+            "$P_SRV" \
+            "$P_CLI async_verify=2 auth_mode=required debug_level=2" \
+            0 \
+            -c "Async verify callback: call 1 more times." \
+            -c "chain verification in progress" \
+            -c "Async verify callback: done, flags=0x00000000"
+
+requires_config_enabled MBEDTLS_SSL_ASYNC_VERIFY
+run_test    "SSL async verify: badcert, client required" \
+            "$P_SRV crt_file=data_files/server5-badsign.crt \
+             key_file=data_files/server5.key" \
+            "$P_CLI async_verify=1 auth_mode=required" \
+            1 \
+            -c "Async verify callback: done, flags=0x00000008" \
+            -c "! mbedtls_ssl_handshake returned" \
+            -c "X509 - Certificate verification failed"
+
+requires_config_enabled MBEDTLS_SSL_ASYNC_VERIFY
+run_test    "SSL async verify: badcert, client optional" \
+            "$P_SRV crt_file=data_files/server5-badsign.crt \
+             key_file=data_files/server5.key" \
+            "$P_CLI async_verify=1 auth_mode=optional" \
+            0 \
+            -c "Async verify callback: done, flags=0x00000008" \
+            -C "! mbedtls_ssl_handshake returned" \
+            -c "! The certificate is not correctly signed by the trusted CA"
+
+requires_config_enabled MBEDTLS_SSL_ASYNC_VERIFY
+requires_config_enabled MBEDTLS_SSL_RENEGOTIATION
+run_test    "SSL async verify: renegotiation: client-initiated" \
+            "$P_SRV exchanges=2 renegotiation=1" \
+            "$P_CLI async_verify=1 auth_mode=required \
+             exchanges=2 renegotiation=1 renegotiate=1" \
+            0 \
+            -c "Async verify callback: done, flags=0x00000000" \
+            -c "HTTP/1.0 200 OK"
+
 # Tests for ECC extensions (rfc 4492)
 
 requires_config_enabled MBEDTLS_AES_C
@@ -7144,6 +7344,23 @@ run_test    "DTLS cookie: enabled, nbio" \
             -s "hello verification requested" \
             -S "SSL - The requested feature is not available"
 
+# Tests for RTT-based handshake retransmission timeouts with DTLS
+
+run_test    "DTLS RTT-based timeouts: disabled" \
+            "$P_SRV dtls=1 debug_level=3" \
+            "$P_CLI dtls=1 debug_level=3" \
+            0 \
+            -S "rtt sample" \
+            -C "rtt sample"
+
+run_test    "DTLS RTT-based timeouts: enabled" \
+            "$P_SRV dtls=1 debug_level=3 hs_rto_min=10" \
+            "$P_CLI dtls=1 debug_level=3 hs_rto_min=10" \
+            0 \
+            -s "rtt sample" \
+            -c "rtt sample" \
+            -C "mtu autoreduction"
+
 # Tests for client reconnecting from the same port with DTLS
 
 not_with_valgrind # spurious resend